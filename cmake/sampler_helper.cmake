@@ -1,11 +1,13 @@
 
 
 # compile shader
+# TARGET_ENV 是可选的，例如使用 subgroup 的 shader 需要 vulkan1.1 (SPIR-V 1.3)
 function(compile_shader)
     set(options)
     set(oneValueArgs
             TARGET_NAME
-            SHADER_DIR)
+            SHADER_DIR
+            TARGET_ENV)
     set(multiValueArgs
             SHADER_NAMES)
     cmake_parse_arguments(CS "${options}" "${oneValueArgs}" "${multiValueArgs}" ${ARGN})
@@ -15,6 +17,12 @@ function(compile_shader)
     endif ()
 
 
+    set(GLSLC_FLAGS)
+    if (CS_TARGET_ENV)
+        set(GLSLC_FLAGS --target-env=${CS_TARGET_ENV})
+    endif ()
+
+
     set(SPV_FILES)
     set(SHADER_FILES)
     foreach (SHADER_NAME ${CS_SHADER_NAMES})
@@ -25,7 +33,7 @@ function(compile_shader)
 
         add_custom_command(
                 OUTPUT ${SPV_FILE}
-                COMMAND glslc ${SHADER_FILE} -o ${SPV_FILE}
+                COMMAND glslc ${GLSLC_FLAGS} ${SHADER_FILE} -o ${SPV_FILE}
                 DEPENDS ${SHADER_FILE}
                 VERBATIM
         )
@@ -43,7 +51,8 @@ function(add_sample)
     set(options)
     set(oneValueArgs
             TARGET_NAME
-            SHADER_DIR)
+            SHADER_DIR
+            TARGET_ENV)
     set(multiValueArgs
             SOURCES
             SHADER_NAMES)
@@ -57,6 +66,7 @@ function(add_sample)
     compile_shader(
             TARGET_NAME ${SAMPLE_TARGET_NAME}.shader
             SHADER_DIR ${SAMPLE_SHADER_DIR}
+            TARGET_ENV "${SAMPLE_TARGET_ENV}"
             SHADER_NAMES ${SAMPLE_SHADER_NAMES}
     )
     add_executable(${SAMPLE_TARGET_NAME} ${SAMPLE_SOURCES})
@@ -0,0 +1,178 @@
+#include <cmath>
+#include <random>
+#include <limits>
+#include <iterator>
+#include <numeric>
+#include <algorithm>
+#include "benchmark.hpp"
+#include "global.hpp"
+#include "bvh.hpp"
+
+
+namespace
+{
+
+/* 每项测试重复的次数，取平均值 */
+constexpr int REPEAT = 10;
+
+/* 场景的坐标在 1000 以内，float 在这个范围内的精度大约是 1e-4，边界附近的差异允许 1e-3 的误差 */
+constexpr double BOUNDARY_EPS = 1e-3;
+
+
+/**
+ * 在边长为 1000 的立方体中随机生成 cnt 个包围球
+ */
+Hiss::BoundsSoA bounds_generate(size_t cnt, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<float> pos(-500.f, 500.f), radius(.5f, 4.f);
+
+    Hiss::BoundsSoA bounds;
+    bounds.reserve(cnt);
+    for (size_t i = 0; i < cnt; ++i)
+        bounds.add(glm::vec3(pos(rng), pos(rng), pos(rng)), radius(rng));
+    return bounds;
+}
+
+
+/**
+ * 包围球到视锥的距离：所有平面中 dot(n, c) + w + r 的最小值，为负时物体不可见
+ * 使用 double 计算，作为判断边界情况的参考
+ */
+double sphere_margin(const Hiss::BoundsSoA &bounds, const Hiss::Frustum &frustum, uint32_t id)
+{
+    double margin = std::numeric_limits<double>::max();
+    for (const auto &plane: frustum.planes)
+        margin = std::min(margin, glm::dot(glm::dvec3(plane), glm::dvec3(bounds.center(id))) + plane.w
+                                          + bounds.radius[id]);
+    return margin;
+}
+
+
+/**
+ * 比较某个实现和标量实现的剔除结果（都是升序的 id），返回只出现在其中一个结果中的物体数量
+ * SIMD 版本使用 FMA，舍入和标量版本不同，包围球恰好和平面相切时结果可能不同，这样的差异只统计数量；
+ * 距离边界超过 BOUNDARY_EPS 的差异是错误，抛出异常
+ */
+size_t mismatch_count(const Hiss::BoundsSoA &bounds, const Hiss::Frustum &frustum,
+                      const std::vector<uint32_t> &result, const std::vector<uint32_t> &scalar, const char *name)
+{
+    std::vector<uint32_t> diff;
+    std::set_symmetric_difference(result.begin(), result.end(), scalar.begin(), scalar.end(),
+                                  std::back_inserter(diff));
+    for (uint32_t id: diff)
+        if (std::abs(sphere_margin(bounds, frustum, id)) > BOUNDARY_EPS)
+            throw std::runtime_error(std::string("cull benchmark: ") + name + " result differs from scalar result.");
+    return diff.size();
+}
+
+
+/* 执行 REPEAT 次，返回平均每次的耗时，单位是 ms */
+template<typename Fn>
+double time_ms(Fn &&fn)
+{
+    Timer timer;
+    for (int i = 0; i < REPEAT; ++i)
+        fn();
+    return timer.elapsed() * 1000. / REPEAT;
+}
+
+}    // namespace
+
+
+/**
+ * CPU 视锥剔除的性能：标量，SIMD，SIMD + 多线程，BVH；以及 BVH 的构建和 refit
+ * 参数：[物体数量]，默认 1M
+ */
+void bench_cull(const std::vector<std::string> &args)
+{
+    auto   logger = LogStatic::logger();
+    size_t cnt    = args.empty() ? 1'000'000 : std::stoull(args[0]);
+
+    std::mt19937    rng(42);
+    Hiss::BoundsSoA bounds = bounds_generate(cnt, rng);
+
+    /* 相机在场景中心，视锥大约覆盖场景的 1/10 */
+    glm::mat4 proj    = glm::perspective(glm::radians(60.f), 16.f / 9.f, .1f, 400.f);
+    glm::mat4 view    = glm::lookAt(glm::vec3(0.f), glm::vec3(1.f, .2f, .5f), glm::vec3(0.f, 1.f, 0.f));
+    auto      frustum = Hiss::Frustum::extract(proj * view);
+
+    Hiss::ThreadPool thread_pool;
+    logger->info("[cull] objects: {}, isa: {}, threads: {}", cnt, Hiss::frustum_cull_isa(), thread_pool.thread_cnt());
+
+
+    /* 线性扫描：三种实现的结果除了恰好位于边界上的物体之外应该相同 */
+    std::vector<uint32_t> scalar, simd, parallel;
+    scalar.reserve(cnt);
+    simd.reserve(cnt);
+    double scalar_ms = time_ms([&] {
+        scalar.clear();
+        Hiss::frustum_cull_scalar(bounds, frustum, 0, cnt, scalar);
+    });
+    double simd_ms   = time_ms([&] {
+        simd.clear();
+        Hiss::frustum_cull(bounds, frustum, 0, cnt, simd);
+    });
+    double mt_ms     = time_ms([&] { Hiss::frustum_cull(bounds, frustum, thread_pool, parallel); });
+    size_t simd_mismatch     = mismatch_count(bounds, frustum, simd, scalar, "simd");
+    size_t parallel_mismatch = mismatch_count(bounds, frustum, parallel, scalar, "parallel");
+
+    logger->info("[cull] visible: {} ({:.1f}%), boundary mismatches: simd {}, simd + thread {}", scalar.size(),
+                 100. * static_cast<double>(scalar.size()) / cnt, simd_mismatch, parallel_mismatch);
+    logger->info("[cull] scalar:        {:.3f} ms, {:.1f} M objects/s", scalar_ms, cnt / scalar_ms * 1e-3);
+    logger->info("[cull] simd:          {:.3f} ms, {:.1f} M objects/s, {:.2f}x", simd_ms, cnt / simd_ms * 1e-3,
+                 scalar_ms / simd_ms);
+    logger->info("[cull] simd + thread: {:.3f} ms, {:.1f} M objects/s, {:.2f}x", mt_ms, cnt / mt_ms * 1e-3,
+                 scalar_ms / mt_ms);
+
+
+    /* BVH 的构建：单线程和线程池 */
+    Hiss::Bvh bvh;
+    double    build_ms    = time_ms([&] { bvh.build(bounds); });
+    double    build_mt_ms = time_ms([&] { bvh.build(bounds, &thread_pool); });
+    logger->info("[bvh] nodes: {}, build: {:.3f} ms, parallel build: {:.3f} ms, {:.2f}x", bvh.node_cnt(), build_ms,
+                 build_mt_ms, build_ms / build_mt_ms);
+
+
+    /* BVH 剔除：输出的顺序和 id 无关，排序之后和线性扫描的结果比较 */
+    std::vector<uint32_t> bvh_visible;
+    double                bvh_ms = time_ms([&] {
+        bvh_visible.clear();
+        bvh.cull(bounds, frustum, bvh_visible);
+    });
+    std::sort(bvh_visible.begin(), bvh_visible.end());
+    size_t bvh_mismatch = mismatch_count(bounds, frustum, bvh_visible, scalar, "bvh");
+    logger->info("[bvh] cull: {:.3f} ms, {:.2f}x of scalar, boundary mismatches: {}", bvh_ms, scalar_ms / bvh_ms,
+                 bvh_mismatch);
+
+
+    /* 1% 的物体移动一小段距离：完整 refit 和只更新移动物体的 refit */
+    std::vector<uint32_t> moved(cnt);
+    std::iota(moved.begin(), moved.end(), 0u);
+    std::shuffle(moved.begin(), moved.end(), rng);
+    moved.resize(cnt / 100);
+    std::uniform_real_distribution<float> offset(-1.f, 1.f);
+    auto                                  move = [&] {
+        for (uint32_t id: moved)
+            bounds.set(id, bounds.center(id) + glm::vec3(offset(rng), offset(rng), offset(rng)), bounds.radius[id]);
+    };
+
+    double full_ms = time_ms([&] {
+        move();
+        bvh.refit(bounds);
+    });
+    double incr_ms = time_ms([&] {
+        move();
+        bvh.refit(bounds, moved);
+    });
+    logger->info("[bvh] moved: {}, full refit: {:.3f} ms, incremental refit: {:.3f} ms (including move)", moved.size(),
+                 full_ms, incr_ms);
+
+    /* refit 之后剔除的结果仍然正确 */
+    scalar.clear();
+    bvh_visible.clear();
+    Hiss::frustum_cull_scalar(bounds, frustum, 0, cnt, scalar);
+    bvh.cull(bounds, frustum, bvh_visible);
+    std::sort(bvh_visible.begin(), bvh_visible.end());
+    logger->info("[bvh] boundary mismatches after refit: {}",
+                 mismatch_count(bounds, frustum, bvh_visible, scalar, "bvh after refit"));
+}
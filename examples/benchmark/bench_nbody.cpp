@@ -0,0 +1,118 @@
+#include <random>
+#include <algorithm>
+#include "benchmark.hpp"
+#include "global.hpp"
+#include "nbody_cpu.hpp"
+
+
+namespace
+{
+
+/* 每项测试重复的次数，取平均值；标量实现很慢，只执行一次 */
+constexpr int REPEAT = 3;
+
+/* SIMD 和标量实现之间允许的相对误差：x^POWER 的计算方式不同，累加的顺序也不同 */
+constexpr double TOLERANCE = 1e-4;
+
+
+/* 质点分布在半径为 5 左右的球中，质量和 N-body 示例中的普通质点相同 */
+std::vector<Hiss::NBodyCpu::Particle> particles_generate(size_t cnt, std::mt19937 &rng)
+{
+    std::normal_distribution<float>       pos(0.f, 5.f);
+    std::uniform_real_distribution<float> mass(37.5f, 75.f);
+
+    std::vector<Hiss::NBodyCpu::Particle> particles(cnt);
+    for (auto &p: particles)
+        p = {.pos = glm::vec4(pos(rng), pos(rng), pos(rng), mass(rng)), .vel = glm::vec4(0.f)};
+    return particles;
+}
+
+
+std::vector<glm::vec3> accels(const Hiss::NBodyCpu &nbody)
+{
+    std::vector<glm::vec3> result(nbody.size());
+    for (size_t i = 0; i < nbody.size(); ++i)
+        result[i] = nbody.accel(i);
+    return result;
+}
+
+
+/* 执行 repeat 次，返回平均每次的耗时，单位是 ms */
+template<typename Fn>
+double time_ms(Fn &&fn, int repeat = REPEAT)
+{
+    Timer timer;
+    for (int i = 0; i < repeat; ++i)
+        fn();
+    return timer.elapsed() * 1000. / repeat;
+}
+
+}    // namespace
+
+
+/**
+ * CPU N-body 参考实现的性能：标量，各个 SIMD kernel，以及最快的 kernel 在不同线程数量下的 interactions/s
+ * SIMD 的结果和标量比较，多线程的结果和单线程逐位比较
+ * 参数：[质点数量]，默认 16384
+ */
+void bench_nbody(const std::vector<std::string> &args)
+{
+    using Kernel = Hiss::NBodyCpu::Kernel;
+
+    auto   logger       = LogStatic::logger();
+    size_t cnt          = args.empty() ? 16384 : std::stoull(args[0]);
+    double interactions = static_cast<double>(cnt) * static_cast<double>(cnt);
+
+    std::mt19937   rng(42);
+    Hiss::NBodyCpu nbody;
+    nbody.load(particles_generate(cnt, rng));
+
+    Kernel   best        = Hiss::NBodyCpu::kernel_best();
+    uint32_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    logger->info("[nbody-cpu] particles: {}, best kernel: {}, hardware threads: {}", cnt,
+                 Hiss::NBodyCpu::kernel_name(best), max_threads);
+
+
+    double scalar_ms = time_ms([&] { nbody.accel_compute(Kernel::SCALAR); }, 1);
+    auto   reference = accels(nbody);
+    logger->info("[nbody-cpu] {:>6}, threads: 1, {:.3f} ms, {:.3f} G interactions/s", "scalar", scalar_ms,
+                 interactions / scalar_ms * 1e-6);
+
+    for (Kernel kernel: {Kernel::AVX2, Kernel::AVX512, Kernel::NEON})
+    {
+        if (!Hiss::NBodyCpu::kernel_support(kernel))
+            continue;
+
+        double ms    = time_ms([&] { nbody.accel_compute(kernel); });
+        auto   error = Hiss::NBodyCpu::compare(reference, accels(nbody));
+        logger->info("[nbody-cpu] {:>6}, threads: 1, {:.3f} ms, {:.3f} G interactions/s, {:.2f}x, "
+                     "error rms: {:.2e}, max: {:.2e} (particle {})",
+                     Hiss::NBodyCpu::kernel_name(kernel), ms, interactions / ms * 1e-6, scalar_ms / ms, error.rms,
+                     error.max, error.max_idx);
+        if (error.max > TOLERANCE)
+            throw std::runtime_error("nbody benchmark: simd result differs from scalar result.");
+    }
+
+
+    /* 线程数量按 2 的幂增加，最后一档是所有的硬件线程 */
+    std::vector<uint32_t> thread_cnts;
+    for (uint32_t t = 1; t < max_threads; t *= 2)
+        thread_cnts.push_back(t);
+    thread_cnts.push_back(max_threads);
+
+    nbody.accel_compute(best);
+    auto   single    = accels(nbody);
+    double single_ms = 0.;
+    for (uint32_t t: thread_cnts)
+    {
+        Hiss::ThreadPool thread_pool(t);
+        double           ms = time_ms([&] { nbody.accel_compute(best, &thread_pool); });
+        if (accels(nbody) != single)
+            throw std::runtime_error("nbody benchmark: multithreaded result differs from single thread result.");
+        if (t == 1)
+            single_ms = ms;
+
+        logger->info("[nbody-cpu] {:>6}, threads: {}, {:.3f} ms, {:.3f} G interactions/s, scaling: {:.2f}x",
+                     Hiss::NBodyCpu::kernel_name(best), t, ms, interactions / ms * 1e-6, single_ms / ms);
+    }
+}
@@ -0,0 +1,163 @@
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <memory>
+#include <fstream>
+#include <filesystem>
+#include <unordered_map>
+#include <tiny_obj_loader.h>
+#include "benchmark.hpp"
+#include "global.hpp"
+#include "obj_loader.hpp"
+
+
+namespace
+{
+
+/**
+ * 生成一个大约 target_bytes 大小的 OBJ 文件：带有 uv 的规则网格
+ * 文件已经存在且大小足够时直接使用
+ */
+std::string obj_generate(size_t target_bytes)
+{
+    auto path = (std::filesystem::temp_directory_path() / "hiss_bench.obj").string();
+    if (std::filesystem::exists(path) && std::filesystem::file_size(path) >= target_bytes)
+        return path;
+
+    LogStatic::logger()->info("generate obj file: {}", path);
+
+    /* 每个格子大约 130 字节：一个 v，一个 vt，两个三角形 */
+    auto          n = static_cast<uint32_t>(std::sqrt(static_cast<double>(target_bytes) / 130.0)) + 1;
+    std::ofstream file(path, std::ios::binary);
+    std::string   buffer;
+    char          line[128];
+    auto          flush = [&]() {
+        file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    };
+
+    buffer += "o grid\n";
+    for (uint32_t y = 0; y <= n; ++y)
+        for (uint32_t x = 0; x <= n; ++x)
+        {
+            float u = static_cast<float>(x) / static_cast<float>(n), v = static_cast<float>(y) / static_cast<float>(n);
+            buffer.append(line, std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\n", u, v,
+                                              0.1f * std::sin(u * 20.f) * std::cos(v * 20.f), u, v));
+            if (buffer.size() > (1 << 24))
+                flush();
+        }
+    buffer += "usemtl grid\n";
+    for (uint32_t y = 0; y < n; ++y)
+        for (uint32_t x = 0; x < n; ++x)
+        {
+            uint32_t a = y * (n + 1) + x + 1, b = a + 1, c = a + n + 1, d = c + 1;
+            buffer.append(line, std::snprintf(line, sizeof(line), "f %u/%u %u/%u %u/%u\nf %u/%u %u/%u %u/%u\n", a, a,
+                                              c, c, b, b, b, b, c, c, d, d));
+            if (buffer.size() > (1 << 24))
+                flush();
+        }
+    flush();
+    return path;
+}
+
+}    // namespace
+
+
+/**
+ * 比较 tinyobj 和 Hiss::ObjLoader 读取同一个 OBJ 文件的耗时
+ * 两者的结果都写入同一块目标内存，代替 map 之后的 stage buffer
+ * 参数：[obj 文件路径]，不指定时生成一个约 500 MB 的网格
+ */
+void bench_obj(const std::vector<std::string> &args)
+{
+    auto   logger    = LogStatic::logger();
+    auto   path      = args.empty() ? obj_generate(500ull << 20) : args[0];
+    double file_mb   = static_cast<double>(std::filesystem::file_size(path)) / (1 << 20);
+    size_t index_cnt = 0, vertex_cnt = 0;
+
+    /* 两者的结果，计时结束之后比较 */
+    std::vector<Vertex>         tiny_vertices;
+    std::vector<uint32_t>       tiny_indices;
+    std::unique_ptr<Vertex[]>   loader_vertices;
+    std::unique_ptr<uint32_t[]> loader_indices;
+
+
+    /* tinyobj：解析之后用 unordered_map 焊接到数组中，再拷贝到目标内存，也就是原来 TestModel 的做法 */
+    Timer  timer;
+    double tinyobj_time;
+    {
+        tinyobj::attrib_t                attr;
+        std::vector<tinyobj::shape_t>    shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string                      err;
+        if (!tinyobj::LoadObj(&attr, &shapes, &materials, &err, path.c_str()))
+            throw std::runtime_error(err);
+
+        std::unordered_map<Vertex, uint32_t> uniq_vertices;
+        std::vector<Vertex>                 &vertices = tiny_vertices;
+        std::vector<uint32_t>               &indices  = tiny_indices;
+        for (const auto &shape: shapes)
+            for (const auto &index: shape.mesh.indices)
+            {
+                Vertex vertex = {
+                        .pos       = {attr.vertices[3 * index.vertex_index + 0],
+                                      attr.vertices[3 * index.vertex_index + 1],
+                                      attr.vertices[3 * index.vertex_index + 2]},
+                        .color     = {1.f, 1.f, 1.f},
+                        .tex_coord = {attr.texcoords[2 * index.texcoord_index + 0],
+                                      1.f - attr.texcoords[2 * index.texcoord_index + 1]},
+                };
+                auto [iter, inserted] = uniq_vertices.try_emplace(vertex, static_cast<uint32_t>(vertices.size()));
+                if (inserted)
+                    vertices.push_back(vertex);
+                indices.push_back(iter->second);
+            }
+
+        auto vertex_dst = std::make_unique<Vertex[]>(vertices.size());
+        auto index_dst  = std::make_unique<uint32_t[]>(indices.size());
+        std::memcpy(vertex_dst.get(), vertices.data(), sizeof(Vertex) * vertices.size());
+        std::memcpy(index_dst.get(), indices.data(), sizeof(uint32_t) * indices.size());
+
+        tinyobj_time = timer.elapsed();
+        index_cnt    = indices.size();
+        vertex_cnt   = vertices.size();
+    }
+    logger->info("[obj] tinyobj:   {:.3f} s, {:.1f} MB/s, vertices {}, indices {}", tinyobj_time,
+                 file_mb / tinyobj_time, vertex_cnt, index_cnt);
+
+
+    /* ObjLoader：多线程解析，焊接的结果直接写入目标内存 */
+    timer.reset();
+    double loader_time;
+    {
+        Hiss::ObjLoader loader(path);
+        loader.parse();
+        loader_indices  = std::make_unique<uint32_t[]>(loader.index_cnt());
+        vertex_cnt      = loader.indices_write(loader_indices.get());
+        loader_vertices = std::make_unique<Vertex[]>(vertex_cnt);
+        loader.vertices_write(loader_vertices.get());
+
+        loader_time = timer.elapsed();
+        index_cnt   = loader.index_cnt();
+    }
+    logger->info("[obj] ObjLoader: {:.3f} s, {:.1f} MB/s, vertices {}, indices {}, threads {}", loader_time,
+                 file_mb / loader_time, vertex_cnt, index_cnt, std::thread::hardware_concurrency());
+
+
+    /**
+     * 结果需要和 tinyobj 相同才比较速度：顶点和 index 的数量相同，并且每个三角形的每个角都是同一个顶点
+     * 焊接之后顶点的顺序可能不同，因此通过 index 比较顶点；tinyobj 解析浮点数不保证正确舍入，允许很小的误差
+     */
+    if (vertex_cnt != tiny_vertices.size() || index_cnt != tiny_indices.size())
+        throw std::runtime_error("obj benchmark: vertex or index count differs from tinyobj.");
+    auto approx = [](const auto &a, const auto &b) { return glm::length(a - b) <= 1e-5f * (1.f + glm::length(a)); };
+    for (size_t i = 0; i < index_cnt; ++i)
+    {
+        const Vertex &expect = tiny_vertices[tiny_indices[i]];
+        const Vertex &actual = loader_vertices[loader_indices[i]];
+        if (!approx(expect.pos, actual.pos) || !approx(expect.tex_coord, actual.tex_coord)
+            || expect.color != actual.color)
+            throw std::runtime_error("obj benchmark: vertex data differs from tinyobj.");
+    }
+    logger->info("[obj] speedup: {:.2f}x", tinyobj_time / loader_time);
+}
@@ -0,0 +1,39 @@
+#include <map>
+#include <iostream>
+#include <functional>
+#include "benchmark.hpp"
+#include "global.hpp"
+
+
+/**
+ * 用法：benchmark <name> [args...]
+ */
+int main(int argc, char **argv)
+{
+    const std::map<std::string, std::function<void(const std::vector<std::string> &)>> benchmarks = {
+            {"obj", bench_obj},
+            {"cull", bench_cull},
+            {"nbody", bench_nbody},
+    };
+
+    if (argc < 2 || !benchmarks.contains(argv[1]))
+    {
+        std::cerr << "usage: benchmark <name> [args...]" << std::endl << "available:";
+        for (const auto &[name, _]: benchmarks)
+            std::cerr << " " << name;
+        std::cerr << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        LogStatic::init();
+        benchmarks.at(argv[1])(std::vector<std::string>(argv + 2, argv + argc));
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "exception: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
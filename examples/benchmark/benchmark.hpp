@@ -0,0 +1,26 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <chrono>
+
+
+/* 计时工具，单位是秒 */
+class Timer
+{
+public:
+    Timer() { reset(); }
+    void   reset() { _start = std::chrono::high_resolution_clock::now(); }
+    double elapsed() const
+    {
+        return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - _start).count();
+    }
+
+private:
+    std::chrono::high_resolution_clock::time_point _start;
+};
+
+
+/* 各个 benchmark 的入口，参数是命令行中 benchmark 名称之后的部分 */
+void bench_obj(const std::vector<std::string> &args);
+void bench_cull(const std::vector<std::string> &args);
+void bench_nbody(const std::vector<std::string> &args);
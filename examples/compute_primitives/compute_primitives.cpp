@@ -0,0 +1,317 @@
+#include "compute_primitives.hpp"
+#include <cctype>
+#include <numeric>
+#include <iostream>
+#include <algorithm>
+
+
+/**
+ * 用法：compute_primitives [count] [--repeat N] [--no-bench]
+ */
+int main(int argc, char **argv)
+{
+    try
+    {
+        ComputePrimitives app(ComputePrimitives::options_parse(argc, argv));
+        app.run();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "exception: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+ComputePrimitives::ComputePrimitives(Options options)
+    : ApplicationBase("compute primitives", true),
+      _options(options)
+{
+    if (_options.cnt == 0 || _options.repeat == 0)
+        throw std::runtime_error("compute primitives: count and repeat must be positive.");
+}
+
+
+ComputePrimitives::~ComputePrimitives()
+{
+    vk::Device d = device().handle_get();
+    d.waitIdle();
+
+    _primitives.reset();
+    _pipelines.reset();
+    d.destroy(_command_pool);
+}
+
+
+ComputePrimitives::Options ComputePrimitives::options_parse(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--repeat")
+        {
+            if (i + 1 >= argc)
+                throw std::runtime_error("compute primitives: missing value for " + arg);
+            options.repeat = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--no-bench")
+            options.bench = false;
+        else if (!arg.empty() && std::isdigit(static_cast<unsigned char>(arg[0])))
+            options.cnt = static_cast<uint32_t>(std::stoul(arg));
+        else
+            throw std::runtime_error("compute primitives: unknown option " + arg);
+    }
+    return options;
+}
+
+
+void ComputePrimitives::prepare()
+{
+    vk::Device d = device().handle_get();
+    if (!device().sync2_support())
+        throw std::runtime_error("synchronization2 unsupported.");
+
+    _command_pool = d.createCommandPool(vk::CommandPoolCreateInfo{
+            .queueFamilyIndex = device().compute_queue_get().family_index,
+    });
+
+    _pipelines  = std::make_unique<Hiss::PipelineRegistry>(d, shader_library());
+    _primitives = std::make_unique<Hiss::GpuPrimitives>(device(), *_pipelines, descriptor_layout_cache());
+    _primitives->reserve(_options.cnt);
+
+
+    auto create = [this](Hiss::Buffer &b, uint32_t cnt) {
+        b = Hiss::Buffer(device(), sizeof(uint32_t) * cnt,
+                         vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc
+                                 | vk::BufferUsageFlagBits::eTransferDst,
+                         vk::MemoryPropertyFlagBits::eDeviceLocal);
+    };
+    create(_a, _options.cnt);
+    create(_b, _options.cnt);
+    create(_c, _options.cnt);
+    create(_d, _options.cnt);
+    create(_result, HIST_BINS);
+}
+
+
+void ComputePrimitives::run()
+{
+    prepare();
+    auto logger = LogStatic::logger();
+    logger->info("[primitives] element count: {}", _options.cnt);
+
+
+    scan_verify(false, false);
+    scan_verify(true, true);
+    reduce_verify(Hiss::GpuPrimitives::ReduceOp::ADD);
+    reduce_verify(Hiss::GpuPrimitives::ReduceOp::MIN);
+    reduce_verify(Hiss::GpuPrimitives::ReduceOp::MAX);
+    histogram_verify();
+    compact_verify();
+    sort_verify(true, 32);
+    sort_verify(false, 20);    // 5 趟，结果从临时 buffer 复制回来
+    logger->info("[primitives] all primitives match the cpu reference.");
+    if (!_options.bench)
+        return;
+
+
+    /* 输入保持不变的原语直接重复执行；sort 原地修改，对已经有序的 key 和随机的 key 工作量相同 */
+    uint32_t cnt = _options.cnt;
+    upload(_a, random(cnt, UINT32_MAX));
+    upload(_c, random(cnt, 1));
+    bench("scan", [&](vk::CommandBuffer cmd) { _primitives->scan_record(cmd, _a.handle_get(), _b.handle_get(), cnt); });
+    bench("reduce", [&](vk::CommandBuffer cmd) {
+        _primitives->reduce_record(cmd, _a.handle_get(), cnt, _result.handle_get());
+    });
+    bench("histogram", [&](vk::CommandBuffer cmd) {
+        _primitives->histogram_record(cmd, _a.handle_get(), cnt, _result.handle_get(), HIST_BINS, HIST_SHIFT);
+    });
+    bench("compact", [&](vk::CommandBuffer cmd) {
+        _primitives->compact_record(cmd, _a.handle_get(), _c.handle_get(), cnt, _b.handle_get(), _result.handle_get());
+    });
+    bench("sort keys", [&](vk::CommandBuffer cmd) { _primitives->sort_record(cmd, _b.handle_get(), {}, cnt); });
+    bench("sort pairs", [&](vk::CommandBuffer cmd) {
+        _primitives->sort_record(cmd, _b.handle_get(), _d.handle_get(), cnt);
+    });
+}
+
+
+double ComputePrimitives::submit_wait(const std::function<void(vk::CommandBuffer)> &record)
+{
+    return device().submit_wait(device().compute_queue_get(), _command_pool, record);
+}
+
+
+void ComputePrimitives::upload(const Hiss::Buffer &dst, const std::vector<uint32_t> &data)
+{
+    device().buffer_upload(device().compute_queue_get(), _command_pool, dst.handle_get(), data.data(),
+                           sizeof(uint32_t) * data.size());
+}
+
+
+std::vector<uint32_t> ComputePrimitives::download(const Hiss::Buffer &src, uint32_t cnt)
+{
+    return device().buffer_download<uint32_t>(device().compute_queue_get(), _command_pool, src.handle_get(), cnt);
+}
+
+
+std::vector<uint32_t> ComputePrimitives::random(uint32_t cnt, uint32_t max)
+{
+    std::uniform_int_distribution<uint32_t> dist(0, max);
+    std::vector<uint32_t>                   data(cnt);
+    for (auto &x: data)
+        x = dist(_rng);
+    return data;
+}
+
+
+namespace
+{
+
+void expect_equal(const std::string &name, const std::vector<uint32_t> &gpu, const std::vector<uint32_t> &cpu)
+{
+    auto [g, c] = std::mismatch(gpu.begin(), gpu.end(), cpu.begin());
+    if (g != gpu.end())
+        throw std::runtime_error(name + ": mismatch at " + std::to_string(g - gpu.begin()) + ", gpu "
+                                 + std::to_string(*g) + ", cpu " + std::to_string(*c));
+    LogStatic::logger()->info("[primitives] {}: ok", name);
+}
+
+}    // namespace
+
+
+/* 加法在 uint32 上回绕，和 GPU 一致，因此可以使用任意的输入 */
+void ComputePrimitives::scan_verify(bool inclusive, bool in_place)
+{
+    uint32_t              cnt  = _options.cnt;
+    std::vector<uint32_t> data = random(cnt, UINT32_MAX);
+    std::vector<uint32_t> expected(cnt);
+    if (inclusive)
+        std::inclusive_scan(data.begin(), data.end(), expected.begin());
+    else
+        std::exclusive_scan(data.begin(), data.end(), expected.begin(), 0u);
+
+    upload(_a, data);
+    const Hiss::Buffer &dst = in_place ? _a : _b;
+    submit_wait([&](vk::CommandBuffer cmd) {
+        _primitives->scan_record(cmd, _a.handle_get(), dst.handle_get(), cnt, inclusive);
+    });
+    expect_equal(std::string(inclusive ? "inclusive" : "exclusive") + " scan" + (in_place ? " in place" : ""),
+                 download(dst, cnt), expected);
+}
+
+
+void ComputePrimitives::reduce_verify(Hiss::GpuPrimitives::ReduceOp op)
+{
+    using Op                   = Hiss::GpuPrimitives::ReduceOp;
+    uint32_t              cnt  = _options.cnt;
+    std::vector<uint32_t> data = random(cnt, UINT32_MAX);
+    uint32_t              expected = 0;
+    switch (op)
+    {
+        case Op::ADD: expected = std::accumulate(data.begin(), data.end(), 0u); break;
+        case Op::MIN: expected = *std::min_element(data.begin(), data.end()); break;
+        case Op::MAX: expected = *std::max_element(data.begin(), data.end()); break;
+    }
+
+    upload(_a, data);
+    submit_wait([&](vk::CommandBuffer cmd) {
+        _primitives->reduce_record(cmd, _a.handle_get(), cnt, _result.handle_get(), op);
+    });
+    const char *names[] = {"reduce add", "reduce min", "reduce max"};
+    expect_equal(names[static_cast<uint32_t>(op)], download(_result, 1), {expected});
+}
+
+
+void ComputePrimitives::histogram_verify()
+{
+    uint32_t              cnt  = _options.cnt;
+    std::vector<uint32_t> data = random(cnt, UINT32_MAX);
+    std::vector<uint32_t> expected(HIST_BINS, 0);
+    for (uint32_t x: data)
+        ++expected[(x >> HIST_SHIFT) & (HIST_BINS - 1)];
+
+    upload(_a, data);
+    submit_wait([&](vk::CommandBuffer cmd) {
+        _primitives->histogram_record(cmd, _a.handle_get(), cnt, _result.handle_get(), HIST_BINS, HIST_SHIFT);
+    });
+    expect_equal("histogram", download(_result, HIST_BINS), expected);
+}
+
+
+/* 大约保留三分之一的元素，flag 使用任意的非零值 */
+void ComputePrimitives::compact_verify()
+{
+    uint32_t              cnt   = _options.cnt;
+    std::vector<uint32_t> data  = random(cnt, UINT32_MAX);
+    std::vector<uint32_t> flags = random(cnt, 2);
+    std::vector<uint32_t> expected;
+    for (uint32_t i = 0; i < cnt; ++i)
+        if (flags[i] == 1)
+            expected.push_back(data[i]);
+    for (auto &f: flags)
+        f = f == 1 ? f + _rng() % 7 : 0;
+
+    upload(_a, data);
+    upload(_c, flags);
+    submit_wait([&](vk::CommandBuffer cmd) {
+        _primitives->compact_record(cmd, _a.handle_get(), _c.handle_get(), cnt, _b.handle_get(), _result.handle_get());
+    });
+    auto kept = static_cast<uint32_t>(expected.size());
+    expect_equal("compact count", download(_result, 1), {kept});
+    if (kept > 0)
+        expect_equal("compact", download(_b, kept), expected);
+}
+
+
+/**
+ * value 是元素原来的下标，和 CPU 的 stable_sort 比较同时检查了排序的稳定性
+ * key 只有低 key_bits 位参与排序；key 的范围小于元素数量，保证有大量重复的 key
+ */
+void ComputePrimitives::sort_verify(bool with_values, uint32_t key_bits)
+{
+    uint32_t              cnt  = _options.cnt;
+    uint32_t              mask = key_bits == 32 ? UINT32_MAX : (1u << key_bits) - 1;
+    std::vector<uint32_t> keys = random(cnt, UINT32_MAX);
+    for (auto &k: keys)
+        k = (k & ~mask) | (k & mask) % std::max(cnt / 4, 1u);
+    std::vector<uint32_t> values(cnt);
+    std::iota(values.begin(), values.end(), 0u);
+
+    std::vector<uint32_t> expected_values = values;
+    std::stable_sort(expected_values.begin(), expected_values.end(),
+                     [&](uint32_t a, uint32_t b) { return (keys[a] & mask) < (keys[b] & mask); });
+    std::vector<uint32_t> expected_keys(cnt);
+    for (uint32_t i = 0; i < cnt; ++i)
+        expected_keys[i] = keys[expected_values[i]];
+
+    upload(_b, keys);
+    upload(_d, values);
+    submit_wait([&](vk::CommandBuffer cmd) {
+        _primitives->sort_record(cmd, _b.handle_get(), with_values ? _d.handle_get() : vk::Buffer{}, cnt, key_bits);
+    });
+    std::string name = (with_values ? "sort pairs " : "sort keys ") + std::to_string(key_bits) + " bit";
+    expect_equal(name + " keys", download(_b, cnt), expected_keys);
+    if (with_values)
+        expect_equal(name + " values", download(_d, cnt), expected_values);
+}
+
+
+/**
+ * 先执行一次，排除 pipeline 的创建和第一次执行的开销；
+ * 之后 repeat 次录制在同一个 command buffer 中，时间包括提交和 fence 的等待，对于较少的元素偏大
+ */
+void ComputePrimitives::bench(const std::string &name, const std::function<void(vk::CommandBuffer)> &record)
+{
+    submit_wait(record);
+    double ms = submit_wait([&](vk::CommandBuffer cmd) {
+        for (uint32_t i = 0; i < _options.repeat; ++i)
+            record(cmd);
+    });
+
+    double per_run_ms = ms / _options.repeat;
+    LogStatic::logger()->info("[primitives] {:<10}: {:8.3f} ms, {:8.1f} M elements/s", name, per_run_ms,
+                              _options.cnt / per_run_ms * 1e-3);
+}
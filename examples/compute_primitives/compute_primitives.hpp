@@ -0,0 +1,69 @@
+#pragma once
+#include <memory>
+#include <random>
+#include <functional>
+#include <application.hpp>
+#include <pipeline.hpp>
+#include <gpu_primitives.hpp>
+
+
+/**
+ * 没有窗口的 GPU 并行原语测试：
+ *  1. 随机的输入，每个原语的结果和 CPU 的实现逐个元素比较，不一致时抛出异常
+ *  2. 每个原语在一个 command buffer 中连续录制 repeat 次，按照提交到完成的时间计算每秒处理的元素数量
+ */
+class ComputePrimitives : public Hiss::ApplicationBase
+{
+public:
+    struct Options
+    {
+        uint32_t cnt    = 1u << 22;
+        uint32_t repeat = 20;
+        bool     bench  = true;
+    };
+
+
+    explicit ComputePrimitives(Options options);
+    ~ComputePrimitives();
+
+
+    /* [count] [--repeat N] [--no-bench]；未知的参数抛出异常 */
+    static Options options_parse(int argc, char **argv);
+
+    void prepare() override;
+    void run() override;
+
+
+private:
+    static constexpr uint32_t HIST_BINS  = 256;
+    static constexpr uint32_t HIST_SHIFT = 8;
+
+
+    Options                                 _options;
+    std::mt19937                            _rng{20240501};
+    std::unique_ptr<Hiss::PipelineRegistry> _pipelines;
+    std::unique_ptr<Hiss::GpuPrimitives>    _primitives;
+
+    vk::CommandPool _command_pool;
+    Hiss::Buffer    _a;
+    Hiss::Buffer    _b;
+    Hiss::Buffer    _c;
+    Hiss::Buffer    _d;
+    Hiss::Buffer    _result;    // reduce，histogram 和 compact 的数量
+
+
+    /* 在 compute queue 上一次性地执行，见 Hiss::Device 中的同名函数 */
+    double                submit_wait(const std::function<void(vk::CommandBuffer)> &record);
+    void                  upload(const Hiss::Buffer &dst, const std::vector<uint32_t> &data);
+    std::vector<uint32_t> download(const Hiss::Buffer &src, uint32_t cnt);
+    std::vector<uint32_t> random(uint32_t cnt, uint32_t max);
+
+    void scan_verify(bool inclusive, bool in_place);
+    void reduce_verify(Hiss::GpuPrimitives::ReduceOp op);
+    void histogram_verify();
+    void compact_verify();
+    void sort_verify(bool with_values, uint32_t key_bits);
+
+    /* 录制 repeat 次 record，打印每秒处理的元素数量 */
+    void bench(const std::string &name, const std::function<void(vk::CommandBuffer)> &record);
+};
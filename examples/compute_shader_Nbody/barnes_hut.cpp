@@ -0,0 +1,189 @@
+#include "barnes_hut.hpp"
+
+
+BarnesHut::BarnesHut(Hiss::Device &device, Hiss::PipelineRegistry &pipelines,
+                     Hiss::DescriptorLayoutCache &layout_cache, Hiss::DescriptorAllocator &allocator,
+                     const Physics &physics, uint32_t particle_buffer_cnt)
+    : _device(device),
+      _pipelines(pipelines),
+      _primitives(device, pipelines, layout_cache),
+      _buffer_cnt(particle_buffer_cnt)
+{
+    vk::Device d = _device.handle_get();
+
+
+    /**
+     * binding 0: particles, binding 1: ubo, binding 2: bounds
+     * binding 3: Morton code, binding 4: 质点的下标, binding 8: nodes, binding 10: 写入速度的质点
+     */
+    std::vector<vk::DescriptorSetLayoutBinding> bindings;
+    for (uint32_t i: {0u, 1u, 2u, 3u, 4u, 8u, 10u})
+        bindings.push_back(vk::DescriptorSetLayoutBinding{
+                .binding         = i,
+                .descriptorType  = i == 1 ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer,
+                .descriptorCount = 1,
+                .stageFlags      = vk::ShaderStageFlagBits::eCompute,
+        });
+    _set_layout = layout_cache.get(bindings);
+
+    vk::PushConstantRange push_range = {
+            .stageFlags = vk::ShaderStageFlagBits::eCompute,
+            .offset     = 0,
+            .size       = sizeof(Push),
+    };
+    _pipeline_layout = d.createPipelineLayout(vk::PipelineLayoutCreateInfo{
+            .setLayoutCount         = 1,
+            .pSetLayouts            = &_set_layout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges    = &push_range,
+    });
+    _sets.resize(_buffer_cnt * _buffer_cnt);
+    for (auto &set: _sets)
+        set = allocator.allocate(_set_layout);
+
+
+    auto shader = [](const std::string &path) {
+        Hiss::ShaderDesc desc{.stage = vk::ShaderStageFlagBits::eCompute, .path = path};
+        desc.spec_add(0, WORKGROUP_SIZE);
+        return desc;
+    };
+    _shader_bounds   = shader(SHADER("compute_Nbody/bh_bounds.comp.spv"));
+    _shader_morton   = shader(SHADER("compute_Nbody/bh_morton.comp.spv"));
+    _shader_build    = shader(SHADER("compute_Nbody/bh_build.comp.spv"));
+    _shader_reduce   = shader(SHADER("compute_Nbody/bh_reduce.comp.spv"));
+    _shader_traverse = shader(SHADER("compute_Nbody/bh_traverse.comp.spv"));
+    _shader_traverse.spec_add(2, physics.gravity).spec_add(3, physics.power).spec_add(4, physics.soften);
+}
+
+
+BarnesHut::~BarnesHut()
+{
+    _device.handle_get().destroy(_pipeline_layout);
+}
+
+
+void BarnesHut::buffers_free()
+{
+    for (Hiss::Buffer *b: {&_bounds, &_keys, &_values, &_nodes})
+        b->reset();
+    _memory_size = 0;
+}
+
+
+void BarnesHut::resize(uint32_t particle_cnt, const std::vector<vk::Buffer> &particles, vk::Buffer ubo)
+{
+    if (particle_cnt == 0)
+        throw std::runtime_error("barnes-hut: particle count is zero.");
+    if (particles.size() != _buffer_cnt)
+        throw std::runtime_error("barnes-hut: particle buffer count mismatch.");
+
+    buffers_free();
+    _particle_cnt = particle_cnt;
+    _block_cnt    = (particle_cnt + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE;
+
+    /* 排序的 key 和 value 重新创建之后，_primitives 中旧的 descriptor set 需要丢弃 */
+    _primitives.descriptors_reset();
+    _primitives.reserve(particle_cnt);
+
+
+    auto create = [this](Hiss::Buffer &b, vk::DeviceSize size, vk::BufferUsageFlags usage = {}) {
+        b = Hiss::Buffer(_device, size, vk::BufferUsageFlagBits::eStorageBuffer | usage,
+                         vk::MemoryPropertyFlagBits::eDeviceLocal);
+        _memory_size += size;
+    };
+    vk::DeviceSize array_size = sizeof(uint32_t) * particle_cnt;
+    create(_bounds, sizeof(glm::uvec4) * 2, vk::BufferUsageFlagBits::eTransferDst);
+    create(_keys, array_size, vk::BufferUsageFlagBits::eTransferDst);
+    create(_values, array_size, vk::BufferUsageFlagBits::eTransferDst);
+    create(_nodes, sizeof(Node) * (2 * particle_cnt - 1));
+
+
+    for (uint32_t p = 0; p < _sets.size(); ++p)
+    {
+        std::array<std::pair<uint32_t, vk::DescriptorBufferInfo>, 7> infos = {{
+                {0, {particles[p / _buffer_cnt], 0, VK_WHOLE_SIZE}},
+                {1, {ubo, 0, VK_WHOLE_SIZE}},
+                {2, {_bounds.handle_get(), 0, VK_WHOLE_SIZE}},
+                {3, {_keys.handle_get(), 0, VK_WHOLE_SIZE}},
+                {4, {_values.handle_get(), 0, VK_WHOLE_SIZE}},
+                {8, {_nodes.handle_get(), 0, VK_WHOLE_SIZE}},
+                {10, {particles[p % _buffer_cnt], 0, VK_WHOLE_SIZE}},
+        }};
+
+        std::vector<vk::WriteDescriptorSet> writes;
+        for (const auto &[binding, info]: infos)
+            writes.push_back(vk::WriteDescriptorSet{
+                    .dstSet          = _sets[p],
+                    .dstBinding      = binding,
+                    .descriptorCount = 1,
+                    .descriptorType  = binding == 1 ? vk::DescriptorType::eUniformBuffer
+                                                    : vk::DescriptorType::eStorageBuffer,
+                    .pBufferInfo     = &info,
+            });
+        _device.handle_get().updateDescriptorSets(writes, {});
+    }
+
+    LogStatic::logger()->info("[barnes-hut] particles: {}, tree and sort buffers: {:.1f} MB", particle_cnt,
+                              static_cast<double>(_memory_size) / (1024. * 1024.));
+}
+
+
+void BarnesHut::dispatch(vk::CommandBuffer cmd, const Hiss::ShaderDesc &shader, vk::DescriptorSet set,
+                         const Push &push, uint32_t group_cnt)
+{
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute,
+                     _pipelines.get(Hiss::PipelineDesc::compute(shader, _pipeline_layout)));
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, _pipeline_layout, 0, {set}, nullptr);
+    cmd.pushConstants(_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(Push), &push);
+    cmd.dispatch(group_cnt, 1, 1);
+
+
+    /* 每个 pass 都读取上一个 pass 的结果，使用 global memory barrier 覆盖所有的 buffer */
+    vk::MemoryBarrier2 barrier = {
+            .srcStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .srcAccessMask = vk::AccessFlagBits2::eShaderWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .dstAccessMask = vk::AccessFlagBits2::eShaderRead | vk::AccessFlagBits2::eShaderWrite,
+    };
+    cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &barrier});
+}
+
+
+void BarnesHut::record(vk::CommandBuffer cmd, float theta, uint32_t src, uint32_t dst)
+{
+    vk::DescriptorSet set  = _sets.at(src * _buffer_cnt + dst);
+    Push              push = {.theta = theta};
+
+
+    /**
+     * 包围盒的初值：min 为最大的 uint，max 为 0
+     * 清零之前等待上一步的 bh_bounds 对 bounds 的原子写入，以及 bh_morton 对 bounds 的读取；
+     * 一个 command buffer 中可能连续录制多步
+     */
+    vk::MemoryBarrier2 clear_barrier = {
+            .srcStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .srcAccessMask = vk::AccessFlagBits2::eShaderWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eTransfer,
+            .dstAccessMask = vk::AccessFlagBits2::eTransferWrite,
+    };
+    cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &clear_barrier});
+    cmd.fillBuffer(_bounds.handle_get(), 0, sizeof(glm::uvec4), 0xFFFFFFFFu);
+    cmd.fillBuffer(_bounds.handle_get(), sizeof(glm::uvec4), sizeof(glm::uvec4), 0u);
+    vk::MemoryBarrier2 fill_barrier = {
+            .srcStageMask  = vk::PipelineStageFlagBits2::eTransfer,
+            .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .dstAccessMask = vk::AccessFlagBits2::eShaderRead | vk::AccessFlagBits2::eShaderWrite,
+    };
+    cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &fill_barrier});
+
+    dispatch(cmd, _shader_bounds, set, push, _block_cnt);
+    dispatch(cmd, _shader_morton, set, push, _block_cnt);
+
+    /* bh_morton 之后的 barrier 已经让 key 和 value 对排序可见；排序结束时的 barrier 让建树可以读取结果 */
+    _primitives.sort_record(cmd, _keys.handle_get(), _values.handle_get(), _particle_cnt, MORTON_BITS);
+
+    dispatch(cmd, _shader_build, set, push, _block_cnt);
+    dispatch(cmd, _shader_reduce, set, push, _block_cnt);
+    dispatch(cmd, _shader_traverse, set, push, _block_cnt);
+}
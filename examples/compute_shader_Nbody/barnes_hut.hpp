@@ -0,0 +1,110 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <device.hpp>
+#include <pipeline.hpp>
+#include <descriptor.hpp>
+#include <gpu_primitives.hpp>
+#include "profile.hpp"
+
+
+/**
+ * GPU 上的 Barnes-Hut 求解器，每一步的复杂度为 O(n log n)，用于替代 O(n^2) 的 calculate
+ *
+ * 每一步都在 GPU 上重新建树：
+ *  1. 包围盒，Morton code
+ *  2. Morton code 的 key-value 排序（GpuPrimitives）
+ *  3. Karras 的并行 radix tree 构建，所有内部节点同时构建
+ *  4. 自底向上归约节点的质量、质心和包围盒
+ *  5. 按 opening angle theta 遍历，新的速度写入 dst
+ * 位置的积分仍然由调用者的 integrate pass 完成，和 calculate 的接口一致
+ * 质点可以是轮换的多个 buffer：每一对 (src, dst) 有自己的 descriptor set，src 和 dst 可以相同
+ * 设备不支持 GpuPrimitives 需要的 subgroup 操作时，构造函数抛出异常
+ */
+class BarnesHut
+{
+public:
+    static constexpr uint32_t WORKGROUP_SIZE = 256;
+    static constexpr uint32_t MORTON_BITS    = 30;
+
+
+    /* 和 calculate 相同的 specialization constant，两个求解器才有可比性 */
+    struct Physics
+    {
+        float gravity;
+        float power;
+        float soften;
+    };
+
+
+    BarnesHut(Hiss::Device &device, Hiss::PipelineRegistry &pipelines, Hiss::DescriptorLayoutCache &layout_cache,
+              Hiss::DescriptorAllocator &allocator, const Physics &physics, uint32_t particle_buffer_cnt = 1);
+    ~BarnesHut();
+    BarnesHut(const BarnesHut &)            = delete;
+    BarnesHut &operator=(const BarnesHut &) = delete;
+
+
+    /**
+     * 按照质点数量重新分配树和排序使用的 buffer，并绑定质点的 storage buffer 和 uniform buffer
+     * particles 的数量和构造时的 particle_buffer_cnt 一致；调用者需要保证 device 已经空闲
+     */
+    void resize(uint32_t particle_cnt, const std::vector<vk::Buffer> &particles, vk::Buffer ubo);
+
+    /**
+     * 录制建树和遍历的所有 pass：从 particles[src] 读取，新的速度写入 particles[dst]，
+     * 结束时插入了 compute -> compute 的 barrier；需要在 compute queue 上执行
+     */
+    void record(vk::CommandBuffer cmd, float theta, uint32_t src = 0, uint32_t dst = 0);
+
+    /* 求解器额外占用的显存 */
+    [[nodiscard]] vk::DeviceSize memory_size() const { return _memory_size + _primitives.memory_size(); }
+
+
+private:
+    /* 和 bh_common.glsl 中的 push constant 一致 */
+    struct Push
+    {
+        float theta;
+    };
+
+    struct Node
+    {
+        glm::vec4 com_mass;
+        glm::vec4 bmin;
+        glm::vec4 bmax;
+        int32_t   left;
+        int32_t   right;
+        int32_t   parent;
+        uint32_t  visits;
+    };
+
+
+    Hiss::Device           &_device;
+    Hiss::PipelineRegistry &_pipelines;
+    Hiss::GpuPrimitives     _primitives;
+    vk::DescriptorSetLayout _set_layout;
+    vk::PipelineLayout      _pipeline_layout;
+
+    /* _sets[src * _buffer_cnt + dst] 是一对质点 buffer 的 set */
+    uint32_t                       _buffer_cnt;
+    std::vector<vk::DescriptorSet> _sets;
+
+    Hiss::ShaderDesc _shader_bounds;
+    Hiss::ShaderDesc _shader_morton;
+    Hiss::ShaderDesc _shader_build;
+    Hiss::ShaderDesc _shader_reduce;
+    Hiss::ShaderDesc _shader_traverse;
+
+    uint32_t       _particle_cnt = 0;
+    uint32_t       _block_cnt    = 0;
+    Hiss::Buffer   _bounds;
+    Hiss::Buffer   _keys;      // Morton code，由 _primitives 原地排序
+    Hiss::Buffer   _values;    // 质点的下标
+    Hiss::Buffer   _nodes;
+    vk::DeviceSize _memory_size = 0;
+
+
+    void buffers_free();
+    void dispatch(vk::CommandBuffer cmd, const Hiss::ShaderDesc &shader, vk::DescriptorSet set, const Push &push,
+                  uint32_t group_cnt);
+};
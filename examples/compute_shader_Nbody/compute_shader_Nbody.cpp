@@ -1,283 +1,1573 @@
 #include "compute_shader_Nbody.hpp"
 #include "application.hpp"
+#include <random>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <utility>
 
 
 APP_RUN(ExampleComputeShaderNBody);
 
 
+ExampleComputeShaderNBody::~ExampleComputeShaderNBody()
+{
+    vk::Device d = device().handle_get();
+    d.waitIdle();
+
+    _barnes_hut.reset();
+    _depth_sort.reset();
+    _morton_reorder.reset();
+    _pipelines.reset();
+
+    swapchain_free();
+    for (auto &frame: graphics.frames)
+    {
+        device().buffer_free(frame.uniform_buffer, frame.uniform_memory);
+        d.destroy(frame.image_available);
+    }
+    d.destroy(graphics.render_pass);
+    d.destroy(graphics.pipeline_layout);
+    d.destroy(graphics.timeline);
+    d.destroy(graphics.query_pool);
+    d.destroy(graphics.command_pool);
+
+    for (uint32_t i = 0; i < STORAGE_CNT; ++i)
+        device().buffer_free(storage_buffers[i], storage_memories[i]);
+    device().buffer_free(compute.uniform_buffer, compute.uniform_memory);
+    d.destroy(compute.pipeline_layout);
+    d.destroy(compute.timeline);
+    d.destroy(compute.query_pool);
+    d.destroy(compute.command_pool);
+}
+
+
 void ExampleComputeShaderNBody::prepare()
 {
     Hiss::ApplicationBase::prepare();
+    vk::Device d = device().handle_get();
+
+    if (!device().timeline_semaphore_support())
+        throw std::runtime_error("timeline semaphore unsupported.");
+    if (!device().sync2_support())
+        throw std::runtime_error("synchronization2 unsupported.");
+
+
+    /* compute queue 上的 command pool；command buffer 每一步重新录制 */
+    compute.command_pool = d.createCommandPool(vk::CommandPoolCreateInfo{
+            .flags            = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+            .queueFamilyIndex = device().compute_queue_get().family_index,
+    });
+
+
+    /* 两个 queue 之间通过 timeline semaphore 同步，计数就是步数 */
+    vk::SemaphoreTypeCreateInfo timeline_info = {.semaphoreType = vk::SemaphoreType::eTimeline, .initialValue = 0};
+    compute.timeline  = d.createSemaphore(vk::SemaphoreCreateInfo{.pNext = &timeline_info});
+    graphics.timeline = d.createSemaphore(vk::SemaphoreCreateInfo{.pNext = &timeline_info});
+
+
+    /**
+     * 两个 queue family 都支持 timestamp 时，记录每一步和每一帧在 GPU 上的执行区间
+     * 规范只保证同一个 queue 上的 timestamp 可以比较；桌面平台上各个 queue 使用同一个时钟，可以用来观察重叠
+     */
+    auto families      = device().physical_device_get().getQueueFamilyProperties();
+    _timestamp_support = families[device().compute_queue_get().family_index].timestampValidBits > 0
+                      && families[device().graphics_queue_get().family_index].timestampValidBits > 0;
+    _timestamp_period  = device().physical_device_get().getProperties().limits.timestampPeriod;
+    vk::QueryPoolCreateInfo query_info = {.queryType = vk::QueryType::eTimestamp, .queryCount = 2 * STORAGE_CNT};
+    compute.query_pool                 = d.createQueryPool(query_info);
+    graphics.query_pool                = d.createQueryPool(query_info);
+
+
+    _pipelines = std::make_unique<Hiss::PipelineRegistry>(d, shader_library());
+
+    /* Barnes-Hut 和 Morton 重排都使用 GpuPrimitives 排序，设备不支持 subgroup 操作时关闭 */
+    try
+    {
+        _barnes_hut = std::make_unique<BarnesHut>(device(), *_pipelines, descriptor_layout_cache(),
+                                                  descriptor_allocator(),
+                                                  BarnesHut::Physics{
+                                                          .gravity = compute.movement_specialization_data.gravity,
+                                                          .power   = compute.movement_specialization_data.power,
+                                                          .soften  = compute.movement_specialization_data.soften,
+                                                  },
+                                                  STORAGE_CNT);
+        _bh_support = true;
+    }
+    catch (const std::exception &e)
+    {
+        LogStatic::logger()->warn("[barnes-hut] barnes-hut solver disabled: {}", e.what());
+    }
+
+    try
+    {
+        _morton_reorder  = std::make_unique<MortonReorder>(device(), *_pipelines, descriptor_layout_cache(),
+                                                           descriptor_allocator(), STORAGE_CNT, STORAGE_CNT);
+        _reorder_support = true;
+    }
+    catch (const std::exception &e)
+    {
+        LogStatic::logger()->warn("[reorder] morton reorder disabled: {}", e.what());
+    }
 
-    vk::PhysicalDevice           pd;     // FIXME
-    vk::Device                   d;      // FIXME
-    vk::PhysicalDeviceProperties pdp;    // FIXME
+    particles_create(PARTICLE_CNTS[_particle_cnt_idx]);
+    compute_prepare();
+    graphics_prepare();
+
+    LogStatic::logger()->info("[nbody] compute queue family: {}, graphics queue family: {}, async compute: {}, "
+                              "timestamp: {}",
+                              device().compute_queue_get().family_index, device().graphics_queue_get().family_index,
+                              device().async_compute_support(), _timestamp_support);
 }
 
 
 void ExampleComputeShaderNBody::compute_prepare()
 {
-    vk::PhysicalDeviceProperties pdp;    // FIXME
-    vk::Device                   d;      // FIXME
-    vk::CommandPool              p;      // FIXME
-    vk::Queue                    q;      // FIXME
-
+    vk::PhysicalDeviceProperties pdp = device().physical_device_get().getProperties();
+    vk::Device                   d   = device().handle_get();
+    vk::CommandPool              p   = compute.command_pool;
 
-    /* workgroup 相关的数据 */
-    compute.work_group_size  = std::max<uint32_t>(256, pdp.limits.maxComputeWorkGroupSize[0]);
-    compute.shared_data_size = std::max<uint32_t>(1024, pdp.limits.maxComputeSharedMemorySize / sizeof(glm::vec4));
-    compute.work_group_cnt   = compute.num_particles / compute.work_group_size;
 
-    compute.movement_specialization_data.workgroup_size   = compute.work_group_size;
-    compute.movement_specialization_data.shared_data_size = compute.shared_data_size;
+    /* workgroup 相关的数据：默认值不能超过设备的限制；tuning cache 中有当前设备的结果时使用调优的结果 */
+    compute.work_group_size      = std::min({256u, pdp.limits.maxComputeWorkGroupSize[0],
+                                             pdp.limits.maxComputeWorkGroupInvocations});
+    compute.shared_data_size     = std::min<uint32_t>(1024, pdp.limits.maxComputeSharedMemorySize / sizeof(glm::vec4));
+    compute.integrate_group_size = compute.work_group_size;
+    compute_tuning_load();
+    group_cnt_update();
 
 
     compute_descriptor_create();
     compute_pipeline_create();
 
 
-    /* 创建 command buffer */
-    compute.command_buffer = d.allocateCommandBuffers(vk::CommandBufferAllocateInfo{
+    /* 每个 slot 一个 command buffer，每一步重新录制 */
+    auto command_buffers = d.allocateCommandBuffers(vk::CommandBufferAllocateInfo{
             .commandPool        = p,
             .level              = vk::CommandBufferLevel::ePrimary,
-            .commandBufferCount = 1,
-    })[0];
+            .commandBufferCount = STORAGE_CNT,
+    });
+    std::copy(command_buffers.begin(), command_buffers.end(), compute.command_buffers.begin());
+}
 
 
-    /* 创建 semaphore，并设为 signaled 状态 */
-    compute.semaphore = d.createSemaphore({});
-    q.submit(vk::SubmitInfo{.signalSemaphoreCount = 1, .pSignalSemaphores = &compute.semaphore});
-    q.waitIdle();
+/**
+ * 绘制质点的 graphics pass：render pass，每一帧的资源，swapchain 以及 pipeline
+ */
+void ExampleComputeShaderNBody::graphics_prepare()
+{
+    vk::Device d = device().handle_get();
 
 
-    /* 录制 command buffer */
-    compute_command_prepare();
+    graphics.command_pool = d.createCommandPool(vk::CommandPoolCreateInfo{
+            .flags            = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+            .queueFamilyIndex = device().graphics_queue_get().family_index,
+    });
 
 
-    // TODO 或许这里要进行 queue family owner transfer，看应用的实现情况
-}
+    /* 只有一个 color attachment，直接绘制到 swapchain 的 image 上 */
+    vk::AttachmentDescription color_attachment = {
+            .format         = device().present_format_get().format,
+            .samples        = vk::SampleCountFlagBits::e1,
+            .loadOp         = vk::AttachmentLoadOp::eClear,
+            .storeOp        = vk::AttachmentStoreOp::eStore,
+            .stencilLoadOp  = vk::AttachmentLoadOp::eDontCare,
+            .stencilStoreOp = vk::AttachmentStoreOp::eDontCare,
+            .initialLayout  = vk::ImageLayout::eUndefined,
+            .finalLayout    = vk::ImageLayout::ePresentSrcKHR,
+    };
+    vk::AttachmentReference color_ref = {.attachment = 0, .layout = vk::ImageLayout::eColorAttachmentOptimal};
+    vk::SubpassDescription  subpass   = {
+               .pipelineBindPoint    = vk::PipelineBindPoint::eGraphics,
+               .colorAttachmentCount = 1,
+               .pColorAttachments    = &color_ref,
+    };
+    vk::SubpassDependency dependency = {
+            .srcSubpass    = VK_SUBPASS_EXTERNAL,
+            .dstSubpass    = 0,
+            .srcStageMask  = vk::PipelineStageFlagBits::eColorAttachmentOutput,
+            .dstStageMask  = vk::PipelineStageFlagBits::eColorAttachmentOutput,
+            .srcAccessMask = {},
+            .dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
+    };
+    graphics.render_pass = d.createRenderPass(vk::RenderPassCreateInfo{
+            .attachmentCount = 1,
+            .pAttachments    = &color_attachment,
+            .subpassCount    = 1,
+            .pSubpasses      = &subpass,
+            .dependencyCount = 1,
+            .pDependencies   = &dependency,
+    });
 
 
-void ExampleComputeShaderNBody::graphics_prepare() {}
+    /**
+     * 每一帧有自己的 uniform buffer 和 descriptor set，host 更新时不会影响还在执行的帧
+     * binding 0: 相机，binding 1: 这一帧绘制的 storage buffer，binding 2: 排序之后的质点下标，vertex shader 直接读取
+     */
+    graphics.descriptor_set_layout = descriptor_layout_cache().get({
+            {0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex},
+            {1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eVertex},
+            {2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eVertex},
+    });
+    graphics.pipeline_layout       = d.createPipelineLayout(vk::PipelineLayoutCreateInfo{
+                  .setLayoutCount = 1,
+                  .pSetLayouts    = &graphics.descriptor_set_layout,
+    });
+
+    auto command_buffers = d.allocateCommandBuffers(vk::CommandBufferAllocateInfo{
+            .commandPool        = graphics.command_pool,
+            .level              = vk::CommandBufferLevel::ePrimary,
+            .commandBufferCount = STORAGE_CNT,
+    });
+    for (uint32_t i = 0; i < STORAGE_CNT; ++i)
+    {
+        auto &frame           = graphics.frames[i];
+        frame.command_buffer  = command_buffers[i];
+        frame.image_available = d.createSemaphore({});
+
+        device().buffer_create(sizeof(Graphics::GraphcisUBO), vk::BufferUsageFlagBits::eUniformBuffer,
+                               vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                               frame.uniform_buffer, frame.uniform_memory);
+        frame.uniform_data   = d.mapMemory(frame.uniform_memory, 0, sizeof(Graphics::GraphcisUBO));
+        frame.descriptor_set = descriptor_allocator().allocate(graphics.descriptor_set_layout);
+    }
 
 
-void ExampleComputeShaderNBody::descriptor_pool_set()
-{
-    vk::Device d;    // FIXME
     /**
-     * compute shader: 1 uniform buffer, 1 storage buffer
-     * vertex shader: 1 uniform buffer
-     * fragment shader: 2 sampler
+     * 深度排序在 graphics queue 上执行，需要它支持 compute；不支持时仍然创建，排序结果的 binding 需要有效
+     * 排序使用 GpuPrimitives，设备不支持 subgroup 操作时无法创建，order 的 binding 改为绑定质点的 buffer
      */
-    std::array<vk::DescriptorPoolSize, 3> pool_size = {{
-            {vk::DescriptorType::eUniformBuffer, 2},
-            {vk::DescriptorType::eStorageBuffer, 1},
-            {vk::DescriptorType::eCombinedImageSampler, 2},
-    }};
+    auto families = device().physical_device_get().getQueueFamilyProperties();
+    _sort_support = static_cast<bool>(families[device().graphics_queue_get().family_index].queueFlags
+                                      & vk::QueueFlagBits::eCompute);
+    try
+    {
+        _depth_sort = std::make_unique<DepthSort>(device(), *_pipelines, descriptor_layout_cache(),
+                                                  descriptor_allocator(), STORAGE_CNT);
+    }
+    catch (const std::exception &e)
+    {
+        LogStatic::logger()->warn("[render] depth sort disabled: {}", e.what());
+        _sort_support = false;
+    }
+    graphics_descriptor_update();
+
+    if (device().large_points_support())
+        _point_size_max = device().physical_device_get().getProperties().limits.pointSizeRange[1];
+
+    swapchain_create();
+}
+
+
+/**
+ * 第 k 帧（slot k % 3）绘制第 k 步读取的 storage buffer[k % 3]，slot 和 buffer 的对应关系是固定的
+ */
+void ExampleComputeShaderNBody::graphics_descriptor_update()
+{
+    std::vector<vk::Buffer> particles;
+    std::vector<vk::Buffer> cameras;
+    for (uint32_t i = 0; i < STORAGE_CNT; ++i)
+    {
+        particles.push_back(storage_buffers[i]);
+        cameras.push_back(graphics.frames[i].uniform_buffer);
+    }
+    if (_depth_sort)
+        _depth_sort->resize(compute.num_particles, particles, cameras);
+
+    for (uint32_t i = 0; i < STORAGE_CNT; ++i)
+    {
+        std::array<vk::DescriptorBufferInfo, 3> infos = {{
+                {graphics.frames[i].uniform_buffer, 0, VK_WHOLE_SIZE},
+                {particles[i], 0, VK_WHOLE_SIZE},
+                {_depth_sort ? _depth_sort->order_buffer() : particles[i], 0, VK_WHOLE_SIZE},
+        }};
+
+        std::vector<vk::WriteDescriptorSet> writes;
+        for (uint32_t b = 0; b < infos.size(); ++b)
+            writes.push_back(vk::WriteDescriptorSet{
+                    .dstSet          = graphics.frames[i].descriptor_set,
+                    .dstBinding      = b,
+                    .descriptorCount = 1,
+                    .descriptorType  = b == 0 ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer,
+                    .pBufferInfo     = &infos[b],
+            });
+        device().handle_get().updateDescriptorSets(writes, {});
+    }
+}
+
+
+/**
+ * 质点的 pipeline：没有 vertex input，vertex shader 按照 gl_InstanceIndex（quad）或者 gl_VertexIndex（点）读取质点
+ * 不排序时使用加法混合，和绘制顺序无关；排序时从远到近绘制，使用 over 混合
+ */
+vk::Pipeline ExampleComputeShaderNBody::graphics_pipeline_get()
+{
+    bool sorted = _sorted && _sort_support;
 
-    descriptor_pool = d.createDescriptorPool(vk::DescriptorPoolCreateInfo{
-            .maxSets       = 2,    // 最多可以分配 2 个 descriptor set
-            .poolSizeCount = static_cast<uint32_t>(pool_size.size()),
-            .pPoolSizes    = pool_size.data(),
+    Hiss::ShaderDesc vert = {.stage = vk::ShaderStageFlagBits::eVertex,
+                             .path  = SHADER("compute_Nbody/particle.vert.spv")};
+    Hiss::ShaderDesc frag = {.stage = vk::ShaderStageFlagBits::eFragment,
+                             .path  = SHADER("compute_Nbody/particle.frag.spv")};
+    vert.spec_add(0, static_cast<vk::Bool32>(_quad))
+            .spec_add(1, static_cast<vk::Bool32>(sorted))
+            .spec_add(2, _point_size_max);
+    frag.spec_add(0, static_cast<vk::Bool32>(_quad));
+
+    return _pipelines->get(Hiss::PipelineDesc{
+            .shaders      = {vert, frag},
+            .topology     = _quad ? vk::PrimitiveTopology::eTriangleStrip : vk::PrimitiveTopology::ePointList,
+            .cull_mode    = vk::CullModeFlagBits::eNone,
+            .depth_test   = false,
+            .depth_write  = false,
+            .color_blends = {sorted ? Hiss::PipelineDesc::color_blend_premultiplied()
+                                    : Hiss::PipelineDesc::color_blend_additive()},
+            .layout       = graphics.pipeline_layout,
+            .render_pass  = graphics.render_pass,
     });
 }
 
 
 /**
- * 创建两个 compute pipeline
+ * 按照 surface 当前的尺寸创建 swapchain；窗口最小化时尺寸为 0，不创建，之后的帧不绘制
  */
-void ExampleComputeShaderNBody::compute_pipeline_create()
+void ExampleComputeShaderNBody::swapchain_create()
 {
-    vk::Device                    d;    // FIXME
-    vk::ComputePipelineCreateInfo pipeline_info;
+    vk::Device                 d          = device().handle_get();
+    vk::SurfaceCapabilitiesKHR capability = device().physical_device_get().getSurfaceCapabilitiesKHR(surface());
+    vk::SurfaceFormatKHR       format     = device().present_format_get();
+
+    graphics.extent = capability.currentExtent;
+    if (capability.currentExtent.width == std::numeric_limits<uint32_t>::max())
+    {
+        vk::Extent2D window_extent = window().extent_get();
+        graphics.extent            = vk::Extent2D{
+                           .width  = std::clamp(window_extent.width, capability.minImageExtent.width,
+                                                capability.maxImageExtent.width),
+                           .height = std::clamp(window_extent.height, capability.minImageExtent.height,
+                                                capability.maxImageExtent.height),
+        };
+    }
+    graphics.swapchain_dirty = graphics.extent.width == 0 || graphics.extent.height == 0;
+    if (graphics.swapchain_dirty)
+        return;
 
+    uint32_t image_cnt = capability.minImageCount + 1;
+    if (capability.maxImageCount > 0)
+        image_cnt = std::min(image_cnt, capability.maxImageCount);
 
-    /* pipeline layout */
-    compute.descriptor_set_layout = d.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo{
-            .bindingCount = static_cast<uint32_t>(compute.layout_bindinds.size()),
-            .pBindings    = compute.layout_bindinds.data(),
+    graphics.swapchain = d.createSwapchainKHR(vk::SwapchainCreateInfoKHR{
+            .surface          = surface(),
+            .minImageCount    = image_cnt,
+            .imageFormat      = format.format,
+            .imageColorSpace  = format.colorSpace,
+            .imageExtent      = graphics.extent,
+            .imageArrayLayers = 1,
+            .imageUsage       = vk::ImageUsageFlagBits::eColorAttachment,
+            .imageSharingMode = vk::SharingMode::eExclusive,
+            .preTransform     = capability.currentTransform,
+            .compositeAlpha   = vk::CompositeAlphaFlagBitsKHR::eOpaque,
+            .presentMode      = device().present_mode_get(),
+            .clipped          = VK_TRUE,
     });
+
+    graphics.images = d.getSwapchainImagesKHR(graphics.swapchain);
+    for (vk::Image image: graphics.images)
+    {
+        graphics.image_views.push_back(d.createImageView(vk::ImageViewCreateInfo{
+                .image            = image,
+                .viewType         = vk::ImageViewType::e2D,
+                .format           = format.format,
+                .subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1},
+        }));
+        graphics.framebuffers.push_back(d.createFramebuffer(vk::FramebufferCreateInfo{
+                .renderPass      = graphics.render_pass,
+                .attachmentCount = 1,
+                .pAttachments    = &graphics.image_views.back(),
+                .width           = graphics.extent.width,
+                .height          = graphics.extent.height,
+                .layers          = 1,
+        }));
+        graphics.render_finished.push_back(d.createSemaphore({}));
+    }
+}
+
+
+void ExampleComputeShaderNBody::swapchain_free()
+{
+    vk::Device d = device().handle_get();
+
+    for (auto framebuffer: graphics.framebuffers)
+        d.destroy(framebuffer);
+    for (auto view: graphics.image_views)
+        d.destroy(view);
+    for (auto semaphore: graphics.render_finished)
+        d.destroy(semaphore);
+    d.destroy(graphics.swapchain);
+
+    graphics.framebuffers.clear();
+    graphics.image_views.clear();
+    graphics.render_finished.clear();
+    graphics.images.clear();
+    graphics.swapchain = nullptr;
+}
+
+
+/**
+ * calculate 和 integrate 的 pipeline，specialization constant 来自 compute 中当前的 workgroup size 和 tile 大小
+ */
+void ExampleComputeShaderNBody::compute_pipeline_create()
+{
+    vk::Device d = device().handle_get();
+
+
+    /* pipeline layout，descriptor set layout 来自 cache，相同的 bindings 只会创建一次 */
+    compute.descriptor_set_layout = descriptor_layout_cache().get(compute.layout_bindinds);
     compute.pipeline_layout       = d.createPipelineLayout(vk::PipelineLayoutCreateInfo{
                   .setLayoutCount = 1,
                   .pSetLayouts    = &compute.descriptor_set_layout,
     });
-    pipeline_info.layout          = compute.pipeline_layout;
-
-
-    /* 1st pipeline: calculate */
-    {
-        /* shader, and specialization constant */
-        pipeline_info.stage = shader_load(compute.shader_file_calculate, vk::ShaderStageFlagBits::eCompute);
-        std::array<vk::SpecializationMapEntry, 5> specialization_entries = {{
-                {0, offsetof(Compute::MovementSpecializationData, workgroup_size),
-                 sizeof(compute.movement_specialization_data.workgroup_size)},
-                {1, offsetof(Compute::MovementSpecializationData, shared_data_size),
-                 sizeof(compute.movement_specialization_data.shared_data_size)},
-                {2, offsetof(Compute::MovementSpecializationData, gravity),
-                 sizeof(compute.movement_specialization_data.gravity)},
-                {3, offsetof(Compute::MovementSpecializationData, power),
-                 sizeof(compute.movement_specialization_data.power)},
-                {4, offsetof(Compute::MovementSpecializationData, soften),
-                 sizeof(compute.movement_specialization_data.soften)},
-        }};
 
-        vk::SpecializationInfo specialization_info = {
-                static_cast<uint32_t>(specialization_entries.size()),
-                specialization_entries.data(),
-                sizeof(compute.movement_specialization_data),
-                &compute.movement_specialization_data,
-        };
-        pipeline_info.stage.pSpecializationInfo = &specialization_info;
+    compute.pipeline_calculate  = calculate_pipeline_create(compute.work_group_size, compute.shared_data_size);
+    compute.pipeline_intergrate = integrate_pipeline_create(compute.integrate_group_size);
+}
 
-        /* create pipeline */
-        vk::Result result;
-        std::tie(result, compute.pipeline_calculate) = d.createComputePipeline(VK_NULL_HANDLE, pipeline_info);
-        if (result != vk::Result::eSuccess)
-            throw std::runtime_error("fail to create compute pipeline: calculate.");
-    }
 
+/**
+ * pipeline 由 registry 持有：相同的 specialization constant 只会创建一次，调优时尝试过的组合可以直接复用
+ * 引力相关的常量不变，只替换 workgroup size 和 tile 大小
+ */
+vk::Pipeline ExampleComputeShaderNBody::calculate_pipeline_create(uint32_t work_group_size, uint32_t shared_data_size)
+{
+    const auto      &constants = compute.movement_specialization_data;
+    Hiss::ShaderDesc shader    = {.stage = vk::ShaderStageFlagBits::eCompute, .path = compute.shader_file_calculate};
+    shader.spec_add(0, work_group_size)
+            .spec_add(1, shared_data_size)
+            .spec_add(2, constants.gravity)
+            .spec_add(3, constants.power)
+            .spec_add(4, constants.soften);
+    return _pipelines->get(Hiss::PipelineDesc::compute(shader, compute.pipeline_layout));
+}
 
-    /* 2nd pipeline: integrate */
-    {
-        /* shader, and specialization */
-        pipeline_info.stage = shader_load(compute.shader_file_integrate, vk::ShaderStageFlagBits::eCompute);
-        vk::SpecializationMapEntry specialization_entry = {0, 0, sizeof(compute.work_group_size)};
-        vk::SpecializationInfo     specialization_info  = {
-                1,
-                &specialization_entry,
-                sizeof(compute.work_group_size),
-                &compute.work_group_size,
-        };
-        pipeline_info.stage.pSpecializationInfo = &specialization_info;
 
-        /* create pipeline */
-        vk::Result result;
-        std::tie(result, compute.pipeline_intergrate) = d.createComputePipeline(VK_NULL_HANDLE, pipeline_info);
-    }
+vk::Pipeline ExampleComputeShaderNBody::integrate_pipeline_create(uint32_t work_group_size)
+{
+    Hiss::ShaderDesc shader = {.stage = vk::ShaderStageFlagBits::eCompute, .path = compute.shader_file_integrate};
+    shader.spec_add(0, work_group_size);
+    return _pipelines->get(Hiss::PipelineDesc::compute(shader, compute.pipeline_layout));
+}
+
+
+void ExampleComputeShaderNBody::group_cnt_update()
+{
+    compute.work_group_cnt = (compute.num_particles + compute.work_group_size - 1) / compute.work_group_size;
+    compute.integrate_group_cnt =
+            (compute.num_particles + compute.integrate_group_size - 1) / compute.integrate_group_size;
 }
 
 
 /**
  * 创建 descriptor set，并将其绑定到 uniform buffer 和 storage buffer
+ * 重新创建 buffer 之后再次调用，只更新 descriptor，不会重新分配 set
  */
 void ExampleComputeShaderNBody::compute_descriptor_create()
 {
-    vk::Device d;    // FIXME
+    vk::Device d = device().handle_get();
 
-    compute.descriptor_set = d.allocateDescriptorSets(vk::DescriptorSetAllocateInfo{
-            .descriptorPool     = descriptor_pool,
-            .descriptorSetCount = 1,
-            .pSetLayouts        = &compute.descriptor_set_layout,
-    })[0];
+    /* allocator 会按需增长，不需要手动计算 pool 的容量 */
+    compute.descriptor_set_layout = descriptor_layout_cache().get(compute.layout_bindinds);
 
 
-    /* 将 descriptor 和 buffer 绑定起来 */
-    vk::DescriptorBufferInfo storage_buffer_info = {storage_buffer, 0, VK_WHOLE_SIZE};
-    vk::DescriptorBufferInfo uniform_buffer_info = {compute.uniform_buffer, 0, VK_WHOLE_SIZE};
+    /* 每一对 (src, dst) 一个 set：binding 0 是 src，binding 2 是 dst */
+    for (uint32_t src = 0; src < STORAGE_CNT; ++src)
+        for (uint32_t dst = 0; dst < STORAGE_CNT; ++dst)
+        {
+            vk::DescriptorSet &set = compute.descriptor_sets[src][dst];
+            if (!set)
+                set = descriptor_allocator().allocate(compute.descriptor_set_layout);
 
-    std::array<vk::WriteDescriptorSet, 2> descriptor_writes = {{
-            {
-                    .dstSet          = compute.descriptor_set,
-                    .dstBinding      = 0,
-                    .dstArrayElement = 0,
-                    .descriptorCount = 1,
-                    .descriptorType  = vk::DescriptorType::eStorageBuffer,
-                    .pBufferInfo     = &storage_buffer_info,
-            },
-            {
-                    .dstSet          = compute.descriptor_set,
-                    .dstBinding      = 1,
-                    .dstArrayElement = 0,
-                    .descriptorCount = 1,
-                    .descriptorType  = vk::DescriptorType::eUniformBuffer,
-                    .pBufferInfo     = &storage_buffer_info,
-            },
-    }};
-    d.updateDescriptorSets(descriptor_writes, {});
+            std::array<vk::DescriptorBufferInfo, 3> infos = {{
+                    {storage_buffers[src], 0, VK_WHOLE_SIZE},
+                    {compute.uniform_buffer, 0, VK_WHOLE_SIZE},
+                    {storage_buffers[dst], 0, VK_WHOLE_SIZE},
+            }};
+
+            std::vector<vk::WriteDescriptorSet> writes;
+            for (uint32_t b = 0; b < infos.size(); ++b)
+                writes.push_back(vk::WriteDescriptorSet{
+                        .dstSet          = set,
+                        .dstBinding      = b,
+                        .descriptorCount = 1,
+                        .descriptorType  = b == 1 ? vk::DescriptorType::eUniformBuffer
+                                                  : vk::DescriptorType::eStorageBuffer,
+                        .pBufferInfo     = &infos[b],
+                });
+            d.updateDescriptorSets(writes, {});
+        }
+}
+
+
+/**
+ * 录制第 k 步模拟：calculate（或者 Barnes-Hut）-> integrate，从 storage buffer[k % 3] 读取，写入 [(k + 1) % 3]
+ * 第 k - 1 帧可能同时在绘制第三个 buffer，这一步不会访问它；第 k 帧在这一步完成之后绘制 src，不需要复制
+ * 质点数量不是 workgroup size 的整数倍时，多出来的 invocation 在 shader 中跳过
+ */
+void ExampleComputeShaderNBody::compute_command_record(uint64_t k)
+{
+    uint32_t          slot = k % STORAGE_CNT;
+    uint32_t          src  = k % STORAGE_CNT;
+    uint32_t          dst  = (k + 1) % STORAGE_CNT;
+    uint32_t          draw = src;    // 第 k 帧绘制的 buffer
+    vk::CommandBuffer cmd  = compute.command_buffers[slot];
+
+    cmd.reset();
+    cmd.begin(vk::CommandBufferBeginInfo{.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    if (_timestamp_support)
+    {
+        cmd.resetQueryPool(compute.query_pool, 2 * slot, 2);
+        cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, compute.query_pool, 2 * slot);
+    }
+
+
+    /* dst 上一次由第 k - 2 帧绘制，从 graphics acquire；创建 storage buffer 之后的前两步写入的 buffer 还没有绘制过 */
+    if (k >= storage_step + STORAGE_CNT)
+        storage_transfer_record(cmd, dst, false, false);
+
+    /* 上一步对 src 的写入需要对这一步可见；上上步对 dst 的读取需要在这一步写入之前完成 */
+    vk::MemoryBarrier2 step_barrier = {
+            .srcStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .srcAccessMask = vk::AccessFlagBits2::eShaderWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .dstAccessMask = vk::AccessFlagBits2::eShaderRead | vk::AccessFlagBits2::eShaderWrite,
+    };
+    cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &step_barrier});
+
+
+    /* 0th pass: 按需统计一致性，或者在计算受力之前将质点按 Morton 顺序收集到 dst 中，之后在 dst 上原地计算 */
+    ReorderTask task = reorder_task_get(k);
+    if (task == ReorderTask::REORDER)
+    {
+        _morton_reorder->reorder_record(cmd, slot, src);
+        src = dst;
+    }
+    else if (task == ReorderTask::COHERENCE)
+        _morton_reorder->coherence_record(cmd, slot, 0, src);
+    _reorder_stat.tasks[slot] = task;
+
+
+    /* 1st pass: 计算受力，新的速度写入 dst */
+    kick_record(cmd, _solver, THETAS[_theta_idx], src, dst);
+
+
+    /* 2nd pass: 新的位置写入 dst；Barnes-Hut 绑定了自己的 descriptor set，需要重新绑定 */
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, compute.pipeline_intergrate);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, compute.pipeline_layout, 0,
+                           {compute.descriptor_sets[src][dst]}, nullptr);
+    cmd.dispatch(compute.integrate_group_cnt, 1, 1);
+
+
+    /* 这一步不再读取原来的 src，release 给绘制它的第 k 帧 */
+    storage_transfer_record(cmd, draw, true, true);
+
+    if (_timestamp_support)
+        cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, compute.query_pool, 2 * slot + 1);
+    cmd.end();
 }
 
 
-void ExampleComputeShaderNBody::compute_command_prepare()
+/**
+ * 录制第 k 帧，绘制第 k 步读取的状态；没有拿到 swapchain 的 image 时不绘制，
+ * 仍然提交，这样 graphics 的 timeline 会推进，storage buffer 的所有权也会交还给 compute
+ */
+void ExampleComputeShaderNBody::frame_record(uint64_t k, std::optional<uint32_t> image_idx)
 {
-    uint32_t graphics_queue_idx = 114;    // FIXME
-    uint32_t compute_queue_idx  = 514;
-    uint32_t storage_size       = 1919810;    // 是否仿照 sample 的写法，构造一个 obj
+    uint32_t          slot  = k % STORAGE_CNT;
+    auto             &frame = graphics.frames[slot];
+    vk::CommandBuffer cmd   = frame.command_buffer;
 
-    compute.command_buffer.begin(vk::CommandBufferBeginInfo{});
+    cmd.reset();
+    cmd.begin(vk::CommandBufferBeginInfo{.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    if (_timestamp_support)
+    {
+        cmd.resetQueryPool(graphics.query_pool, 2 * slot, 2);
+        cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, graphics.query_pool, 2 * slot);
+    }
+
+    /* 第 k 步结束时 release 了这个 buffer */
+    storage_transfer_record(cmd, slot, true, false);
 
 
-    /* queue family owner transfer: acquire */
-    if (compute_queue_idx != graphics_queue_idx)
+    if (image_idx)
     {
-        vk::BufferMemoryBarrier2 barrier = {
-                .srcStageMask        = vk::PipelineStageFlagBits2::eVertexShader,
-                .srcAccessMask       = {},    // acquire 中的这个字段被忽略
-                .dstStageMask        = vk::PipelineStageFlagBits2::eComputeShader,
-                .dstAccessMask       = vk::AccessFlagBits2::eShaderWrite,
-                .srcQueueFamilyIndex = graphics_queue_idx,
-                .dstQueueFamilyIndex = compute_queue_idx,
-                .buffer              = storage_buffer,
-                .offset              = 0,
-                .size                = storage_size,
-        };
-        compute.command_buffer.pipelineBarrier2(vk::DependencyInfo{
-                .bufferMemoryBarrierCount = 1,
-                .pBufferMemoryBarriers    = &barrier,
-        });
+        if (_sorted && _sort_support)
+            _depth_sort->record(cmd, slot);
+
+        vk::ClearValue clear_value = {.color = {.float32 = std::array<float, 4>{0.f, 0.f, 0.f, 1.f}}};
+        cmd.beginRenderPass(
+                vk::RenderPassBeginInfo{
+                        .renderPass      = graphics.render_pass,
+                        .framebuffer     = graphics.framebuffers[*image_idx],
+                        .renderArea      = {.offset = {0, 0}, .extent = graphics.extent},
+                        .clearValueCount = 1,
+                        .pClearValues    = &clear_value,
+                },
+                vk::SubpassContents::eInline);
+        cmd.setViewport(0, vk::Viewport{
+                                   .x        = 0.f,
+                                   .y        = 0.f,
+                                   .width    = static_cast<float>(graphics.extent.width),
+                                   .height   = static_cast<float>(graphics.extent.height),
+                                   .minDepth = 0.f,
+                                   .maxDepth = 1.f,
+                           });
+        cmd.setScissor(0, vk::Rect2D{.offset = {0, 0}, .extent = graphics.extent});
+        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, graphics_pipeline_get());
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, graphics.pipeline_layout, 0,
+                               {frame.descriptor_set}, nullptr);
+        if (_quad)
+            cmd.draw(4, compute.num_particles, 0, 0);
+        else
+            cmd.draw(compute.num_particles, 1, 0, 0);
+        cmd.endRenderPass();
     }
 
 
-    /* 1st pass: 计算受力，更新速度 */
-    compute.command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, compute.pipeline_calculate);
-    compute.command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, compute.pipeline_layout, 0,
-                                              {compute.descriptor_set}, nullptr);
-    compute.command_buffer.dispatch(compute.num_particles / compute.work_group_size, 1, 1);
+    /* 交还给 compute，第 k + 2 步写入这个 buffer 之前 acquire */
+    storage_transfer_record(cmd, slot, false, true);
 
+    if (_timestamp_support)
+        cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, graphics.query_pool, 2 * slot + 1);
+    cmd.end();
+}
+
+
+/**
+ * calculate 或者 Barnes-Hut 从 src 读取，新的速度写入 dst；两者都不修改位置，之后由 integrate 更新
+ */
+void ExampleComputeShaderNBody::kick_record(vk::CommandBuffer cmd, Solver solver, float theta, uint32_t src,
+                                            uint32_t dst)
+{
+    if (solver == Solver::BARNES_HUT)
+    {
+        _barnes_hut->record(cmd, theta, src, dst);
+        return;
+    }
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, compute.pipeline_calculate);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, compute.pipeline_layout, 0,
+                           {compute.descriptor_sets[src][dst]}, nullptr);
+    cmd.dispatch(compute.work_group_cnt, 1, 1);
 
-    /* 在 1st 和 2nd 之间插入 memory barrier */
     vk::BufferMemoryBarrier2 memory_barrier = {
             .srcStageMask        = vk::PipelineStageFlagBits2::eComputeShader,
             .srcAccessMask       = vk::AccessFlagBits2::eShaderWrite,
             .dstStageMask        = vk::PipelineStageFlagBits2::eComputeShader,
-            .dstAccessMask       = vk::AccessFlagBits2::eShaderRead,
+            .dstAccessMask       = vk::AccessFlagBits2::eShaderRead | vk::AccessFlagBits2::eShaderWrite,
             .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
             .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-            .buffer              = storage_buffer,
+            .buffer              = storage_buffers[dst],
             .offset              = 0,
-            .size                = storage_size,
+            .size                = sizeof(Particle) * compute.num_particles,
     };
-    compute.command_buffer.pipelineBarrier2(vk::DependencyInfo{
+    cmd.pipelineBarrier2(vk::DependencyInfo{
             .bufferMemoryBarrierCount = 1,
             .pBufferMemoryBarriers    = &memory_barrier,
     });
+}
 
 
-    /* 2nd pass: 更新质点的位置 */
-    compute.command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, compute.pipeline_intergrate);
-    compute.command_buffer.dispatch(compute.num_particles / compute.work_group_size, 1, 1);
-    // 两个 pass descriptor 是一样的，因此无需再次 bingding
+double ExampleComputeShaderNBody::submit_wait(const std::function<void(vk::CommandBuffer)> &record)
+{
+    return device().submit_wait(device().compute_queue_get(), compute.command_pool, record);
+}
+
+
+void ExampleComputeShaderNBody::particles_create(uint32_t cnt)
+{
+    vk::Device d = device().handle_get();
+    d.waitIdle();
+    device().buffer_free(compute.uniform_buffer, compute.uniform_memory);
+    for (uint32_t i = 0; i < STORAGE_CNT; ++i)
+        device().buffer_free(storage_buffers[i], storage_memories[i]);
 
+    compute.num_particles = cnt;
+    compute.ubo           = {.delta_time = DELTA_TIME, .particle_count = static_cast<int32_t>(cnt)};
 
-    /* queue family owner transfer: release */
-    if (graphics_queue_idx != compute_queue_idx)
+
+    /* uniform buffer 的内容只和质点数量有关，创建时写入一次 */
+    device().buffer_create(sizeof(Compute::ComputeUBO), vk::BufferUsageFlagBits::eUniformBuffer,
+                           vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                           compute.uniform_buffer, compute.uniform_memory);
+    void *ubo_data = d.mapMemory(compute.uniform_memory, 0, sizeof(Compute::ComputeUBO));
+    std::memcpy(ubo_data, &compute.ubo, sizeof(Compute::ComputeUBO));
+    d.unmapMemory(compute.uniform_memory);
+
+
+    /**
+     * storage buffer 只在 device 上访问，初始数据通过 staging buffer 上传到最新状态所在的 buffer
+     * 上传在 compute queue 上执行，之后 buffer 属于 compute；solver_compare 等也需要将它复制出来
+     */
+    std::vector<Particle> particles = galaxies_init(cnt);
+    vk::DeviceSize        size      = sizeof(Particle) * particles.size();
+    uint32_t              current   = storage_current();
+    for (uint32_t i = 0; i < STORAGE_CNT; ++i)
+        device().buffer_create(size,
+                               vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc
+                                       | vk::BufferUsageFlagBits::eTransferDst,
+                               vk::MemoryPropertyFlagBits::eDeviceLocal, storage_buffers[i], storage_memories[i]);
+    storage_step = _step_id;
+
+    device().buffer_upload(device().compute_queue_get(), compute.command_pool, storage_buffers[current],
+                           particles.data(), size);
+    if (_barnes_hut)
+        _barnes_hut->resize(cnt, {storage_buffers.begin(), storage_buffers.end()}, compute.uniform_buffer);
+    if (_morton_reorder)
+        _morton_reorder->resize(cnt, {storage_buffers.begin(), storage_buffers.end()}, compute.uniform_buffer);
+    reorder_reset();
+
+    LogStatic::logger()->info("[nbody] particles: {}, storage buffers: {} x {:.1f} MB", cnt, STORAGE_CNT,
+                              static_cast<double>(size) / (1024. * 1024.));
+}
+
+
+/**
+ * 按键从松开变为按下时返回 true，key_down 记录上一次的状态
+ */
+bool ExampleComputeShaderNBody::key_pressed(int key, bool &key_down)
+{
+    bool down    = glfwGetKey(window().handle_get(), key) == GLFW_PRESS;
+    bool pressed = down && !key_down;
+    key_down     = down;
+    return pressed;
+}
+
+
+void ExampleComputeShaderNBody::particle_cnt_switch()
+{
+    _particle_cnt_idx = (_particle_cnt_idx + 1) % static_cast<uint32_t>(PARTICLE_CNTS.size());
+    particles_create(PARTICLE_CNTS[_particle_cnt_idx]);
+
+    group_cnt_update();
+    compute_descriptor_create();
+    graphics_descriptor_update();
+    _stat = {};
+}
+
+
+void ExampleComputeShaderNBody::solver_switch()
+{
+    if (!_bh_support)
     {
-        vk::BufferMemoryBarrier2 barrier = {
-                .srcStageMask        = vk::PipelineStageFlagBits2::eComputeShader,
-                .srcAccessMask       = vk::AccessFlagBits2::eShaderWrite,
-                .dstStageMask        = vk::PipelineStageFlagBits2::eVertexShader,
-                .dstAccessMask       = {},    // release 中的这个字段被忽略
-                .srcQueueFamilyIndex = compute_queue_idx,
-                .dstQueueFamilyIndex = graphics_queue_idx,
-                .buffer              = storage_buffer,
-                .offset              = 0,
-                .size                = storage_size,
-        };
-        compute.command_buffer.pipelineBarrier2(vk::DependencyInfo{
-                .bufferMemoryBarrierCount = 1,
-                .pBufferMemoryBarriers    = &barrier,
+        LogStatic::logger()->warn("[nbody] gpu primitives unsupported, barnes-hut solver disabled.");
+        return;
+    }
+    _solver = _solver == Solver::EXACT ? Solver::BARNES_HUT : Solver::EXACT;
+    LogStatic::logger()->info("[nbody] solver: {}", _solver == Solver::EXACT ? "exact" : "barnes-hut");
+    _stat = {};
+}
+
+
+void ExampleComputeShaderNBody::theta_switch()
+{
+    _theta_idx = (_theta_idx + 1) % static_cast<uint32_t>(THETAS.size());
+    LogStatic::logger()->info("[nbody] barnes-hut theta: {:.2f}", THETAS[_theta_idx]);
+    _stat = {};
+}
+
+
+void ExampleComputeShaderNBody::solver_compare()
+{
+    if (!_bh_support)
+    {
+        LogStatic::logger()->warn("[nbody] gpu primitives unsupported, barnes-hut solver disabled.");
+        return;
+    }
+
+    vk::Device     d    = device().handle_get();
+    uint32_t       n    = compute.num_particles;
+    vk::DeviceSize size = sizeof(Particle) * n;
+    uint32_t       src  = storage_current();
+    uint32_t       dst  = (src + 1) % STORAGE_CNT;
+    d.waitIdle();
+
+
+    /* original 是原来的状态；exact 是精确解的结果，bh 是每个 theta 的结果 */
+    const auto           &queue    = device().compute_queue_get();
+    std::vector<Particle> original = device().buffer_download<Particle>(queue, compute.command_pool,
+                                                                        storage_buffers[src], n);
+    std::vector<Particle> exact, bh;
+
+
+    /* 速度清零之后执行一次 kick，结果的速度就是 dt * a，避免和原来的速度相减损失精度 */
+    auto kick = [&](std::vector<Particle> &result, Solver solver, float theta) {
+        std::vector<Particle> probe = original;
+        for (auto &p: probe)
+            p.vel = glm::vec4(0.f, 0.f, 0.f, p.vel.w);
+
+        device().buffer_upload(queue, compute.command_pool, storage_buffers[src], probe.data(), size);
+        double ms = submit_wait([&](vk::CommandBuffer cmd) { kick_record(cmd, solver, theta, src, dst); });
+        result    = device().buffer_download<Particle>(queue, compute.command_pool, storage_buffers[dst], n);
+        return ms;
+    };
+
+    double exact_ms = kick(exact, Solver::EXACT, 0.f);
+    for (uint32_t t = 0; t < THETAS.size(); ++t)
+    {
+        double bh_ms = kick(bh, Solver::BARNES_HUT, THETAS[t]);
+
+        /* 每个质点的相对误差，以及整体的 RMS 相对误差 */
+        double err_sum = 0., err_max = 0., diff2 = 0., exact2 = 0.;
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            glm::dvec3 a_exact = glm::dvec3(exact[i].vel);
+            glm::dvec3 a_bh    = glm::dvec3(bh[i].vel);
+            double     d2      = glm::dot(a_bh - a_exact, a_bh - a_exact);
+            double     e2      = glm::dot(a_exact, a_exact);
+            diff2 += d2;
+            exact2 += e2;
+            double err = e2 > 0. ? std::sqrt(d2 / e2) : 0.;
+            err_sum += err;
+            err_max = std::max(err_max, err);
+        }
+
+        LogStatic::logger()->info(
+                "[barnes-hut] particles: {}, theta: {:.2f}, exact: {:.3f} ms, barnes-hut: {:.3f} ms, speedup: {:.2f}x, "
+                "error rms: {:.4f}%, mean: {:.4f}%, max: {:.4f}%",
+                n, THETAS[t], exact_ms, bh_ms, exact_ms / bh_ms, std::sqrt(diff2 / std::max(exact2, 1e-30)) * 100.,
+                err_sum / n * 100., err_max * 100.);
+    }
+
+
+    /* 恢复原来的状态 */
+    device().buffer_upload(queue, compute.command_pool, storage_buffers[src], original.data(), size);
+    _stat = {};
+}
+
+
+/**
+ * GPU 的一步和 compute_command_record 中的前两个 pass 相同；CPU 使用最快的 kernel 和所有的硬件线程
+ */
+void ExampleComputeShaderNBody::cpu_check()
+{
+    uint32_t n = compute.num_particles;
+    if (n > CPU_CHECK_MAX_CNT)
+    {
+        LogStatic::logger()->warn("[nbody-cpu] particles: {}, too many for the cpu reference, limit: {}", n,
+                                  CPU_CHECK_MAX_CNT);
+        return;
+    }
+
+    vk::Device d   = device().handle_get();
+    uint32_t   src = storage_current();
+    uint32_t   dst = (src + 1) % STORAGE_CNT;
+    d.waitIdle();
+
+
+    /* before 是这一步之前的状态，after 是 GPU 推进一步之后的状态；这一步写入 dst，src 不变 */
+    const auto &queue  = device().compute_queue_get();
+    auto        before = device().buffer_download<Particle>(queue, compute.command_pool, storage_buffers[src], n);
+    double      gpu_ms = submit_wait([&](vk::CommandBuffer cmd) {
+        kick_record(cmd, Solver::EXACT, 0.f, src, dst);
+        cmd.bindPipeline(vk::PipelineBindPoint::eCompute, compute.pipeline_intergrate);
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, compute.pipeline_layout, 0,
+                               {compute.descriptor_sets[src][dst]}, nullptr);
+        cmd.dispatch(compute.integrate_group_cnt, 1, 1);
+    });
+    auto after = device().buffer_download<Particle>(queue, compute.command_pool, storage_buffers[dst], n);
+
+
+    Hiss::NBodyCpu cpu({
+            .gravity = compute.movement_specialization_data.gravity,
+            .power   = compute.movement_specialization_data.power,
+            .soften  = compute.movement_specialization_data.soften,
+    });
+    Hiss::ThreadPool       thread_pool;
+    Hiss::NBodyCpu::Kernel kernel = Hiss::NBodyCpu::kernel_best();
+    cpu.load(before.data(), n);
+    auto start = std::chrono::steady_clock::now();
+    cpu.step(DELTA_TIME, kernel, &thread_pool);
+    std::chrono::duration<double> cpu_time = std::chrono::steady_clock::now() - start;
+
+    std::vector<Particle> cpu_after;
+    cpu.store(cpu_after);
+    std::vector<glm::vec3> cpu_accel(n), gpu_accel(n), cpu_pos(n), gpu_pos(n);
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        cpu_accel[i] = cpu.accel(i);
+        gpu_accel[i] = (glm::vec3(after[i].vel) - glm::vec3(before[i].vel)) / DELTA_TIME;
+        cpu_pos[i]   = glm::vec3(cpu_after[i].pos);
+        gpu_pos[i]   = glm::vec3(after[i].pos);
+    }
+
+
+    /* 速度的变化量是两个相近的数相减，相对误差会被放大，因此同时给出位置的误差 */
+    auto   accel_error  = Hiss::NBodyCpu::compare(cpu_accel, gpu_accel);
+    auto   pos_error    = Hiss::NBodyCpu::compare(cpu_pos, gpu_pos);
+    double interactions = static_cast<double>(n) * n;
+    LogStatic::logger()->info("[nbody-cpu] particles: {}, kernel: {}, threads: {}, cpu: {:.3f} ms ({:.3f} G/s), "
+                              "gpu: {:.3f} ms ({:.3f} G/s)",
+                              n, Hiss::NBodyCpu::kernel_name(kernel), thread_pool.thread_cnt(),
+                              cpu_time.count() * 1000., interactions / cpu_time.count() * 1e-9,
+                              gpu_ms, interactions / gpu_ms * 1e-6);
+    LogStatic::logger()->info("[nbody-cpu] accel error rms: {:.2e}, max: {:.2e} (particle {}), position error max: "
+                              "{:.2e}, {}",
+                              accel_error.rms, accel_error.max, accel_error.max_idx, pos_error.max,
+                              accel_error.rms <= CPU_CHECK_TOL && pos_error.max <= CPU_CHECK_TOL ? "pass" : "FAIL");
+    _stat = {};
+}
+
+
+/**
+ * 有 timestamp 时使用 GPU 上的时间，否则使用提交到完成的 wall time
+ * 每次 dispatch 之后都有 barrier，和实际运行时一样，calculate 的多次执行不会重叠
+ * 从最新的状态读取，写入另一个 storage buffer：每次执行的输入相同，模拟的状态不变
+ */
+double ExampleComputeShaderNBody::pipeline_time(vk::Pipeline pipeline, uint32_t group_cnt, vk::QueryPool query_pool)
+{
+    uint32_t src = storage_current();
+
+    vk::MemoryBarrier2 barrier = {
+            .srcStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .srcAccessMask = vk::AccessFlagBits2::eShaderWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .dstAccessMask = vk::AccessFlagBits2::eShaderRead | vk::AccessFlagBits2::eShaderWrite,
+    };
+    double wall_ms = submit_wait([&](vk::CommandBuffer cmd) {
+        if (_timestamp_support)
+        {
+            cmd.resetQueryPool(query_pool, 0, 2);
+            cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, query_pool, 0);
+        }
+        cmd.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, compute.pipeline_layout, 0,
+                               {compute.descriptor_sets[src][(src + 1) % STORAGE_CNT]}, nullptr);
+        for (uint32_t i = 0; i < TUNE_REPEAT; ++i)
+        {
+            cmd.dispatch(group_cnt, 1, 1);
+            cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &barrier});
+        }
+        if (_timestamp_support)
+            cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, query_pool, 1);
+    });
+
+    if (_timestamp_support)
+    {
+        std::array<uint64_t, 2> ticks{};
+        vk::Result result = device().handle_get().getQueryPoolResults(
+                query_pool, 0, 2, sizeof(ticks), ticks.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+        if (result == vk::Result::eSuccess)
+            return static_cast<double>(ticks[1] - ticks[0]) * _timestamp_period * 1e-6 / TUNE_REPEAT;
+    }
+    return wall_ms / TUNE_REPEAT;
+}
+
+
+void ExampleComputeShaderNBody::autotune()
+{
+    vk::Device         d      = device().handle_get();
+    vk::PhysicalDevice pd     = device().physical_device_get();
+    auto               limits = pd.getProperties().limits;
+    auto               logger = LogStatic::logger();
+    uint32_t           n      = compute.num_particles;
+    if (n > TUNE_MAX_CNT)
+    {
+        logger->warn("[tune] particles: {}, too many for autotune, limit: {}", n, TUNE_MAX_CNT);
+        return;
+    }
+    d.waitIdle();
+
+
+    /* calculate 和 integrate 只写入另一个 storage buffer，不需要备份模拟的状态 */
+    vk::QueryPool query_pool =
+            d.createQueryPool(vk::QueryPoolCreateInfo{.queryType = vk::QueryType::eTimestamp, .queryCount = 2});
+
+    auto group_cnt = [n](uint32_t group_size) { return (n + group_size - 1) / group_size; };
+    auto group_ok  = [&](uint32_t group_size) {
+        return group_size <= limits.maxComputeWorkGroupSize[0] && group_size <= limits.maxComputeWorkGroupInvocations;
+    };
+
+
+    /* calculate：所有合法的 (workgroup size, tile) 组合 */
+    double   current_ms = pipeline_time(compute.pipeline_calculate, compute.work_group_cnt, query_pool);
+    double   best_ms    = std::numeric_limits<double>::max();
+    uint32_t best_group = compute.work_group_size;
+    uint32_t best_tile  = compute.shared_data_size;
+    for (uint32_t group_size: TUNE_WORKGROUP_SIZES)
+    {
+        if (!group_ok(group_size))
+            continue;
+        for (uint32_t tile: TUNE_TILE_SIZES)
+        {
+            if (tile * sizeof(glm::vec4) > limits.maxComputeSharedMemorySize)
+                continue;
+
+            vk::Pipeline pipeline = calculate_pipeline_create(group_size, tile);
+            double       ms       = pipeline_time(pipeline, group_cnt(group_size), query_pool);
+
+            double interactions = static_cast<double>(n) * n;
+            logger->info("[tune] calculate workgroup: {:4}, tile: {:4}, {:.3f} ms, interactions/s: {:.3f} G",
+                         group_size, tile, ms, interactions / ms * 1e-6);
+            if (ms < best_ms)
+            {
+                best_ms    = ms;
+                best_group = group_size;
+                best_tile  = tile;
+            }
+        }
+    }
+
+
+    /* integrate：只有 workgroup size */
+    double   integrate_current_ms = pipeline_time(compute.pipeline_intergrate, compute.integrate_group_cnt, query_pool);
+    double   integrate_best_ms    = std::numeric_limits<double>::max();
+    uint32_t integrate_best_group = compute.integrate_group_size;
+    for (uint32_t group_size: TUNE_WORKGROUP_SIZES)
+    {
+        if (!group_ok(group_size))
+            continue;
+
+        vk::Pipeline pipeline = integrate_pipeline_create(group_size);
+        double       ms       = pipeline_time(pipeline, group_cnt(group_size), query_pool);
+
+        logger->info("[tune] integrate workgroup: {:4}, {:.4f} ms", group_size, ms);
+        if (ms < integrate_best_ms)
+        {
+            integrate_best_ms    = ms;
+            integrate_best_group = group_size;
+        }
+    }
+
+
+    /* 使用最快的组合，pipeline 在调优时已经创建过，registry 直接返回 */
+    d.destroy(query_pool);
+
+    compute.work_group_size      = best_group;
+    compute.shared_data_size     = best_tile;
+    compute.integrate_group_size = integrate_best_group;
+    group_cnt_update();
+    compute.pipeline_calculate  = calculate_pipeline_create(best_group, best_tile);
+    compute.pipeline_intergrate = integrate_pipeline_create(integrate_best_group);
+
+    logger->info("[tune] particles: {}, calculate: workgroup {}, tile {}, {:.3f} ms -> {:.3f} ms ({:.2f}x); "
+                 "integrate: workgroup {}, {:.4f} ms -> {:.4f} ms",
+                 n, best_group, best_tile, current_ms, best_ms, current_ms / best_ms, integrate_best_group,
+                 integrate_current_ms, integrate_best_ms);
+
+
+    Hiss::TuningCache cache(TUNING_CACHE_PATH);
+    std::string       device_key = Hiss::TuningCache::device_key(pd);
+    cache.set(device_key, "nbody.calculate", {best_group, best_tile});
+    cache.set(device_key, "nbody.integrate", {integrate_best_group});
+    cache.save();
+    logger->info("[tune] saved to {}, device: {}", cache.path(), device_key);
+    _stat = {};
+}
+
+
+void ExampleComputeShaderNBody::compute_tuning_load()
+{
+    vk::PhysicalDevice pd     = device().physical_device_get();
+    auto               limits = pd.getProperties().limits;
+
+    Hiss::TuningCache cache(TUNING_CACHE_PATH);
+    std::string       device_key = Hiss::TuningCache::device_key(pd);
+    auto              calculate  = cache.get(device_key, "nbody.calculate");
+    auto              integrate  = cache.get(device_key, "nbody.integrate");
+
+    auto group_ok = [&](uint32_t group_size) {
+        return group_size > 0 && group_size <= limits.maxComputeWorkGroupSize[0]
+            && group_size <= limits.maxComputeWorkGroupInvocations;
+    };
+    bool loaded = false;
+    if (calculate && calculate->size() == 2 && group_ok((*calculate)[0]) && (*calculate)[1] > 0
+        && (*calculate)[1] * sizeof(glm::vec4) <= limits.maxComputeSharedMemorySize)
+    {
+        compute.work_group_size  = (*calculate)[0];
+        compute.shared_data_size = (*calculate)[1];
+        loaded                   = true;
+    }
+    if (integrate && integrate->size() == 1 && group_ok((*integrate)[0]))
+    {
+        compute.integrate_group_size = (*integrate)[0];
+        loaded                       = true;
+    }
+
+    LogStatic::logger()->info("[tune] calculate: workgroup {}, tile {}, integrate: workgroup {} ({})",
+                              compute.work_group_size, compute.shared_data_size, compute.integrate_group_size,
+                              loaded ? "from tuning cache" : "default, press U to tune");
+}
+
+
+void ExampleComputeShaderNBody::timeline_wait(vk::Semaphore timeline, uint64_t value)
+{
+    if (value == 0)
+        return;
+    (void) device().handle_get().waitSemaphores(
+            vk::SemaphoreWaitInfo{.semaphoreCount = 1, .pSemaphores = &timeline, .pValues = &value}, UINT64_MAX);
+}
+
+
+/**
+ * release 和 acquire 使用相同的 family 和范围：release 只有 src 的同步范围，acquire 只有 dst 的
+ * compute 上有写入，release 时需要让写入 available；graphics 上只读取质点，release 只需要执行依赖
+ */
+void ExampleComputeShaderNBody::storage_transfer_record(vk::CommandBuffer cmd, uint32_t idx, bool to_graphics,
+                                                        bool release)
+{
+    uint32_t compute_family  = device().compute_queue_get().family_index;
+    uint32_t graphics_family = device().graphics_queue_get().family_index;
+    if (compute_family == graphics_family)
+        return;
+
+    /* graphics queue 上读取质点的是 vertex shader，以及深度排序的 compute shader */
+    vk::PipelineStageFlags2 graphics_stages =
+            vk::PipelineStageFlagBits2::eVertexShader | vk::PipelineStageFlagBits2::eComputeShader;
+    vk::BufferMemoryBarrier2 barrier = {
+            .srcQueueFamilyIndex = to_graphics ? compute_family : graphics_family,
+            .dstQueueFamilyIndex = to_graphics ? graphics_family : compute_family,
+            .buffer              = storage_buffers[idx],
+            .offset              = 0,
+            .size                = VK_WHOLE_SIZE,
+    };
+    if (release)
+    {
+        barrier.srcStageMask  = to_graphics ? vk::PipelineStageFlagBits2::eComputeShader : graphics_stages;
+        barrier.srcAccessMask = to_graphics ? vk::AccessFlagBits2::eShaderWrite : vk::AccessFlagBits2::eNone;
+    }
+    else
+    {
+        barrier.dstStageMask  = to_graphics ? graphics_stages : vk::PipelineStageFlagBits2::eComputeShader;
+        barrier.dstAccessMask = to_graphics ? vk::AccessFlagBits2::eShaderStorageRead
+                                            : vk::AccessFlagBits2::eShaderRead | vk::AccessFlagBits2::eShaderWrite;
+    }
+    cmd.pipelineBarrier2(vk::DependencyInfo{.bufferMemoryBarrierCount = 1, .pBufferMemoryBarriers = &barrier});
+}
+
+
+/**
+ * 第 k 步写入 storage buffer[(k + 1) % 3]，需要等待上一次绘制它的第 k - 2 帧完成
+ * 异步模式下第 k 步和第 k - 1 帧可以同时执行；串行模式下等待第 k - 1 帧，两个 queue 交替执行
+ */
+void ExampleComputeShaderNBody::compute_submit(uint64_t k)
+{
+    uint32_t slot = k % STORAGE_CNT;
+
+    /* command buffer 上一次的提交完成之后才能重新录制，同时读取那一次的 timestamp */
+    uint64_t prev = k > STORAGE_CNT ? k - STORAGE_CNT : 0;
+    timeline_wait(compute.timeline, prev);
+    std::optional<Interval> interval;
+    if (_timestamp_support && prev > 0)
+        interval = timestamp_collect(compute.query_pool, slot, prev, true);
+    if (prev > 0)
+        reorder_collect(slot, prev, interval);
+    compute_command_record(k);
+
+    uint64_t                drawn     = k + 1 > STORAGE_CNT ? k + 1 - STORAGE_CNT : 0;
+    vk::SemaphoreSubmitInfo wait_info = {
+            .semaphore = graphics.timeline,
+            .value     = _async ? drawn : k - 1,
+            .stageMask = vk::PipelineStageFlagBits2::eAllCommands,
+    };
+    vk::SemaphoreSubmitInfo signal_info = {
+            .semaphore = compute.timeline,
+            .value     = k,
+            .stageMask = vk::PipelineStageFlagBits2::eAllCommands,
+    };
+    vk::CommandBufferSubmitInfo cmd_info = {.commandBuffer = compute.command_buffers[slot]};
+    device().compute_queue_get().queue.submit2(vk::SubmitInfo2{
+            .waitSemaphoreInfoCount   = 1,
+            .pWaitSemaphoreInfos      = &wait_info,
+            .commandBufferInfoCount   = 1,
+            .pCommandBufferInfos      = &cmd_info,
+            .signalSemaphoreInfoCount = 1,
+            .pSignalSemaphoreInfos    = &signal_info,
+    });
+    ++_stat.steps;
+}
+
+
+/**
+ * 第 k 帧等待第 k 步完成，绘制它读取的 storage buffer[k % 3]，完成时 signal graphics timeline 为 k
+ */
+void ExampleComputeShaderNBody::frame_submit(uint64_t k)
+{
+    vk::Device d     = device().handle_get();
+    uint32_t   slot  = k % STORAGE_CNT;
+    auto      &frame = graphics.frames[slot];
+
+    uint64_t prev = k > STORAGE_CNT ? k - STORAGE_CNT : 0;
+    timeline_wait(graphics.timeline, prev);
+    if (_timestamp_support && prev > 0)
+        timestamp_collect(graphics.query_pool, slot, prev, false);
+
+
+    /* 窗口尺寸变化，或者 swapchain 已经过期，需要重新创建 swapchain */
+    if (graphics.swapchain_dirty || window().has_resized())
+    {
+        d.waitIdle();
+        swapchain_free();
+        swapchain_create();
+        window().resize_state_clear();
+    }
+
+    std::optional<uint32_t> image_idx;
+    if (graphics.swapchain)
+    {
+        /* 这里不用 vulkan-cpp，因为 out of date 会被当作异常抛出 */
+        uint32_t idx;
+        auto     result = static_cast<vk::Result>(
+                vkAcquireNextImageKHR(d, graphics.swapchain, UINT64_MAX, frame.image_available, {}, &idx));
+        if (result == vk::Result::eErrorOutOfDateKHR)
+            graphics.swapchain_dirty = true;
+        else if (result != vk::Result::eSuccess && result != vk::Result::eSuboptimalKHR)
+            throw std::runtime_error("failed to acquire swapchain image.");
+        else
+            image_idx = idx;
+    }
+
+
+    /* 相机绕 y 轴缓慢旋转；vulkan 的 clip space 中 y 轴向下，需要翻转 */
+    _camera_angle += 0.002f;
+    glm::vec3 eye    = glm::vec3(std::cos(_camera_angle), 0.35f, std::sin(_camera_angle)) * 22.f;
+    float     aspect = graphics.extent.height > 0 ? static_cast<float>(graphics.extent.width) / graphics.extent.height
+                                                  : 1.f;
+    graphics.ubo.view       = glm::lookAt(eye, glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+    graphics.ubo.projection = glm::perspective(glm::radians(45.f), aspect, .1f, 256.f);
+    graphics.ubo.projection[1][1] *= -1.f;
+    graphics.ubo.screen_dim = glm::vec2(graphics.extent.width, graphics.extent.height);
+    std::memcpy(frame.uniform_data, &graphics.ubo, sizeof(Graphics::GraphcisUBO));
+
+    frame_record(k, image_idx);
+
+
+    std::vector<vk::SemaphoreSubmitInfo> wait_infos = {{
+            .semaphore = compute.timeline,
+            .value     = k,
+            .stageMask = vk::PipelineStageFlagBits2::eAllCommands,
+    }};
+    std::vector<vk::SemaphoreSubmitInfo> signal_infos = {{
+            .semaphore = graphics.timeline,
+            .value     = k,
+            .stageMask = vk::PipelineStageFlagBits2::eAllCommands,
+    }};
+    if (image_idx)
+    {
+        wait_infos.push_back({
+                .semaphore = frame.image_available,
+                .stageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+        });
+        signal_infos.push_back({
+                .semaphore = graphics.render_finished[*image_idx],
+                .stageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
         });
+    }
+    vk::CommandBufferSubmitInfo cmd_info = {.commandBuffer = frame.command_buffer};
+    device().graphics_queue_get().queue.submit2(vk::SubmitInfo2{
+            .waitSemaphoreInfoCount   = static_cast<uint32_t>(wait_infos.size()),
+            .pWaitSemaphoreInfos      = wait_infos.data(),
+            .commandBufferInfoCount   = 1,
+            .pCommandBufferInfos      = &cmd_info,
+            .signalSemaphoreInfoCount = static_cast<uint32_t>(signal_infos.size()),
+            .pSignalSemaphoreInfos    = signal_infos.data(),
+    });
+
+    if (!image_idx)
+        return;
+    VkSemaphore      render_finished = graphics.render_finished[*image_idx];
+    VkSwapchainKHR   swapchain       = graphics.swapchain;
+    VkPresentInfoKHR present_info    = {
+               .sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+               .waitSemaphoreCount = 1,
+               .pWaitSemaphores    = &render_finished,
+               .swapchainCount     = 1,
+               .pSwapchains        = &swapchain,
+               .pImageIndices      = &*image_idx,
+    };
+    auto result = static_cast<vk::Result>(vkQueuePresentKHR(device().present_queue_get().queue, &present_info));
+    if (result == vk::Result::eErrorOutOfDateKHR || result == vk::Result::eSuboptimalKHR)
+        graphics.swapchain_dirty = true;
+    else if (result != vk::Result::eSuccess)
+        throw std::runtime_error("failed to present swapchain image.");
+}
+
+
+std::optional<ExampleComputeShaderNBody::Interval>
+ExampleComputeShaderNBody::timestamp_collect(vk::QueryPool pool, uint32_t slot, uint64_t id, bool compute_queue)
+{
+    std::array<uint64_t, 2> ticks{};
+    vk::Result result = device().handle_get().getQueryPoolResults(pool, 2 * slot, 2, sizeof(ticks), ticks.data(),
+                                                                   sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess)
+        return std::nullopt;
+
+    Interval interval = {
+            .id    = id,
+            .begin = static_cast<double>(ticks[0]) * _timestamp_period,
+            .end   = static_cast<double>(ticks[1]) * _timestamp_period,
+    };
+    auto &intervals = compute_queue ? _stat.compute_intervals : _stat.graphics_intervals;
+    auto &trace     = compute_queue ? _compute_trace : _graphics_trace;
+    intervals.push_back(interval);
+    trace.push_back(interval);
+    if (trace.size() > TRACE_CAPACITY)
+        trace.pop_front();
+    if (compute_queue)
+        _stat.time += std::chrono::duration<double>((interval.end - interval.begin) * 1e-9);
+    return interval;
+}
 
 
-        compute.command_buffer.end();
+/**
+ * 重排的优先级高于一致性的统计；重排之后的第一次统计作为之后的参照
+ */
+ExampleComputeShaderNBody::ReorderTask ExampleComputeShaderNBody::reorder_task_get(uint64_t k)
+{
+    if (!_reorder || !_reorder_support)
+        return ReorderTask::NONE;
+    if (_reorder_stat.due || k - _reorder_stat.last_step >= REORDER_INTERVAL)
+    {
+        _reorder_stat.due       = false;
+        _reorder_stat.last_step = k;
+        return ReorderTask::REORDER;
+    }
+    return k % COHERENCE_INTERVAL == 0 ? ReorderTask::COHERENCE : ReorderTask::NONE;
+}
+
+
+/**
+ * 一致性的统计在重排之前录制时，它的结果已经过时，不再触发重排
+ * 重排的那一步包括重排的开销，不计入前后的耗时；有 timestamp 时，重排之后 REORDER_WINDOW 步输出对比
+ */
+void ExampleComputeShaderNBody::reorder_collect(uint32_t slot, uint64_t step, const std::optional<Interval> &interval)
+{
+    auto        logger = LogStatic::logger();
+    auto       &stat   = _reorder_stat;
+    ReorderTask task   = std::exchange(stat.tasks[slot], ReorderTask::NONE);
+    double      ms     = interval ? (interval->end - interval->begin) * 1e-6 : 0.;
+
+    if (task == ReorderTask::COHERENCE && step > stat.last_step)
+    {
+        double coherence = _morton_reorder->coherence_get(slot, 0);
+        if (coherence < stat.coherence_after * COHERENCE_DROP)
+        {
+            stat.due = true;
+            logger->info("[reorder] step {}: coherence {:.3f} dropped below {:.0f}% of {:.3f}", step, coherence,
+                         COHERENCE_DROP * 100., stat.coherence_after);
+        }
+    }
+    else if (task == ReorderTask::REORDER)
+    {
+        double before        = _morton_reorder->coherence_get(slot, 0);
+        stat.coherence_after = _morton_reorder->coherence_get(slot, 1);
+        logger->info("[reorder] step {}: coherence {:.3f} -> {:.3f}{}", step, before, stat.coherence_after,
+                     interval ? fmt::format(", reorder step: {:.3f} ms", ms) : std::string());
+
+        if (!stat.step_ms.empty())
+        {
+            stat.before_ms     = std::accumulate(stat.step_ms.begin(), stat.step_ms.end(), 0.) / stat.step_ms.size();
+            stat.after_pending = true;
+        }
+        stat.step_ms.clear();
+        return;
     }
+
+    if (!interval)
+        return;
+    stat.step_ms.push_back(ms);
+    if (stat.step_ms.size() > REORDER_WINDOW)
+        stat.step_ms.pop_front();
+    if (stat.after_pending && stat.step_ms.size() == REORDER_WINDOW)
+    {
+        double after_ms = std::accumulate(stat.step_ms.begin(), stat.step_ms.end(), 0.) / REORDER_WINDOW;
+        logger->info("[reorder] step time before: {:.3f} ms, after: {:.3f} ms ({:+.1f}%)", stat.before_ms, after_ms,
+                     (after_ms / stat.before_ms - 1.) * 100.);
+        stat.after_pending = false;
+    }
+}
+
+
+void ExampleComputeShaderNBody::reorder_reset()
+{
+    _reorder_stat           = {};
+    _reorder_stat.last_step = _step_id;
+}
+
+
+/**
+ * 每秒输出一次吞吐量；有 timestamp 时，同时输出两个 queue 的忙碌时间以及重叠的比例
+ * 重叠时间 = compute 忙碌时间 + graphics 忙碌时间 - 两者区间的并集
+ */
+void ExampleComputeShaderNBody::stat_report()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (now - _stat.last_report < std::chrono::seconds(1) || _stat.steps == 0)
+        return;
+
+    auto   time     = _timestamp_support ? _stat.time : std::chrono::duration<double>(now - _stat.last_report);
+    size_t step_cnt = _timestamp_support ? _stat.compute_intervals.size() : _stat.steps;
+    if (time.count() <= 0. || step_cnt == 0)
+    {
+        _stat = {.last_report = now};
+        return;
+    }
+
+    /* Barnes-Hut 的 interactions/s 是等效值：精确解在相同时间内需要完成的相互作用数量 */
+    double      step_ms      = time.count() * 1000. / static_cast<double>(step_cnt);
+    double      interactions = static_cast<double>(compute.num_particles) * compute.num_particles * step_cnt;
+    std::string solver       = _solver == Solver::EXACT ? std::string("exact")
+                                                        : fmt::format("barnes-hut(theta {:.2f})", THETAS[_theta_idx]);
+    LogStatic::logger()->info(
+            "[nbody] solver: {}, particles: {}, workgroup: {}, tile: {}, step: {:.3f} ms, interactions/s: {:.3f} G",
+            solver, compute.num_particles, compute.work_group_size, compute.shared_data_size, step_ms,
+            interactions / time.count() * 1e-9);
+
+
+    if (_timestamp_support && !_stat.graphics_intervals.empty())
+    {
+        std::vector<Interval> all = _stat.compute_intervals;
+        all.insert(all.end(), _stat.graphics_intervals.begin(), _stat.graphics_intervals.end());
+        std::sort(all.begin(), all.end(), [](const Interval &a, const Interval &b) { return a.begin < b.begin; });
+
+        double busy_union = 0., cur_begin = all.front().begin, cur_end = all.front().end;
+        for (const auto &interval: all)
+        {
+            if (interval.begin > cur_end)
+            {
+                busy_union += cur_end - cur_begin;
+                cur_begin = interval.begin;
+            }
+            cur_end = std::max(cur_end, interval.end);
+        }
+        busy_union += cur_end - cur_begin;
+
+        auto busy = [](const std::vector<Interval> &intervals) {
+            double sum = 0.;
+            for (const auto &interval: intervals)
+                sum += interval.end - interval.begin;
+            return sum;
+        };
+        double compute_busy  = busy(_stat.compute_intervals);
+        double graphics_busy = busy(_stat.graphics_intervals);
+        double overlap       = std::max(0., compute_busy + graphics_busy - busy_union);
+
+        LogStatic::logger()->info(
+                "[async] mode: {}, compute: {:.3f} ms/step, graphics: {:.3f} ms/frame, overlap: {:.1f}% of compute",
+                _async ? "async" : "serial", compute_busy * 1e-6 / _stat.compute_intervals.size(),
+                graphics_busy * 1e-6 / _stat.graphics_intervals.size(), overlap / compute_busy * 100.);
+    }
+
+    _stat = {.last_report = now};
+}
+
+
+void ExampleComputeShaderNBody::trace_dump(const std::string &path)
+{
+    if (_compute_trace.empty() && _graphics_trace.empty())
+    {
+        LogStatic::logger()->warn("[async] no gpu timestamps to dump.");
+        return;
+    }
+
+    double origin = std::numeric_limits<double>::max();
+    for (const auto *trace: {&_compute_trace, &_graphics_trace})
+        for (const auto &interval: *trace)
+            origin = std::min(origin, interval.begin);
+
+
+    /* chrome trace 的时间单位是 us；tid 0 是 compute queue，tid 1 是 graphics queue */
+    std::ofstream file(path);
+    if (!file)
+        throw std::runtime_error("fail to open trace file: " + path);
+    file << "{\"traceEvents\":[\n";
+    file << R"({"name":"thread_name","ph":"M","pid":0,"tid":0,"args":{"name":"compute queue"}},)" << "\n";
+    file << R"({"name":"thread_name","ph":"M","pid":0,"tid":1,"args":{"name":"graphics queue"}})";
+    for (uint32_t tid = 0; tid < 2; ++tid)
+        for (const auto &interval: tid == 0 ? _compute_trace : _graphics_trace)
+            file << ",\n"
+                 << fmt::format(R"({{"name":"{} {}","ph":"X","pid":0,"tid":{},"ts":{:.3f},"dur":{:.3f}}})",
+                                tid == 0 ? "step" : "frame", interval.id, tid, (interval.begin - origin) * 1e-3,
+                                (interval.end - interval.begin) * 1e-3);
+    file << "\n]}\n";
+
+    LogStatic::logger()->info("[async] gpu trace: {}, steps: {}, frames: {}", path, _compute_trace.size(),
+                              _graphics_trace.size());
+}
+
+
+void ExampleComputeShaderNBody::run()
+{
+    prepare();
+
+    while (!glfwWindowShouldClose(window().handle_get()))
+    {
+        glfwPollEvents();
+        if (glfwGetKey(window().handle_get(), GLFW_KEY_ESCAPE) == GLFW_PRESS)
+            glfwSetWindowShouldClose(window().handle_get(), true);
+
+        /* 按 N 切换质点的数量 */
+        if (key_pressed(GLFW_KEY_N, _cnt_key_down))
+            particle_cnt_switch();
+
+        /* 按 B 切换求解器，按 T 切换 theta，按 E 对比 Barnes-Hut 和精确解的误差以及耗时 */
+        if (key_pressed(GLFW_KEY_B, _solver_key_down))
+            solver_switch();
+        if (key_pressed(GLFW_KEY_T, _theta_key_down))
+            theta_switch();
+        if (key_pressed(GLFW_KEY_E, _compare_key_down))
+            solver_compare();
+
+        /* 按 C 用 CPU 参考实现校验 GPU 的一步 */
+        if (key_pressed(GLFW_KEY_C, _check_key_down))
+            cpu_check();
+
+        /* 按 U 自动调优 calculate 和 integrate 的 workgroup size 以及 tile 大小 */
+        if (key_pressed(GLFW_KEY_U, _tune_key_down))
+            autotune();
+
+        /* 按 A 切换 compute 和 graphics 是否重叠执行，按 P 导出最近的 GPU trace */
+        if (key_pressed(GLFW_KEY_A, _async_key_down))
+        {
+            _async = !_async;
+            LogStatic::logger()->info("[async] mode: {}", _async ? "async" : "serial");
+            _stat = {};
+        }
+        if (key_pressed(GLFW_KEY_P, _trace_key_down))
+            trace_dump("nbody_trace.json");
+
+        /* 按 R 切换 quad 和 point sprite，按 D 切换是否按深度排序 */
+        if (key_pressed(GLFW_KEY_R, _quad_key_down))
+        {
+            _quad = !_quad;
+            LogStatic::logger()->info("[render] primitive: {}", _quad ? "quad" : "point sprite");
+        }
+        if (key_pressed(GLFW_KEY_D, _sort_key_down))
+        {
+            _sorted = !_sorted;
+            if (_sorted && !_sort_support)
+                LogStatic::logger()->warn("[render] depth sort unsupported on this device.");
+            else
+                LogStatic::logger()->info("[render] depth sort: {}, blend: {}", _sorted,
+                                          _sorted ? "premultiplied over" : "additive");
+        }
+
+        /* 按 O 切换 Morton 重排 */
+        if (key_pressed(GLFW_KEY_O, _reorder_key_down))
+        {
+            _reorder = !_reorder;
+            if (_reorder && !_reorder_support)
+                LogStatic::logger()->warn("[reorder] gpu primitives unsupported, morton reorder disabled.");
+            else
+                LogStatic::logger()->info("[reorder] morton reorder: {}", _reorder);
+            reorder_reset();
+        }
+
+        ++_step_id;
+        compute_submit(_step_id);
+        frame_submit(_step_id);
+        stat_report();
+    }
+
+    device().handle_get().waitIdle();
 }
@@ -1,13 +1,90 @@
 #pragma once
+#include <array>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <optional>
 #include <application.hpp>
+#include <pipeline.hpp>
+#include <nbody_cpu.hpp>
+#include <tuning_cache.hpp>
 #include "profile.hpp"
+#include "barnes_hut.hpp"
+#include "depth_sort.hpp"
+#include "morton_reorder.hpp"
+#include "galaxy.hpp"
 
 
 class ExampleComputeShaderNBody : public Hiss::ApplicationBase
 {
+public:
     ExampleComputeShaderNBody()
-        : ApplicationBase()
-    {} /* graphics pass resource */
+        : ApplicationBase("compute shader N-body")
+    {}
+    ~ExampleComputeShaderNBody();
+
+
+private:
+    /* 质点数量的档位，运行时按 N 切换；精确解每一步的计算量是 N^2，最后一档只适合 Barnes-Hut */
+    static constexpr std::array<uint32_t, 6> PARTICLE_CNTS    = {16384, 32768, 65536, 131072, 262144, 1048576};
+    static constexpr uint32_t                PARTICLE_CNT_IDX = 2;
+    static constexpr float                   DELTA_TIME       = 0.0005f;    // 固定的时间步长，结果可以复现
+
+    /* Barnes-Hut 的 opening angle 档位，运行时按 T 切换；按 E 对所有档位和精确解做对比 */
+    static constexpr std::array<float, 4> THETAS    = {0.3f, 0.5f, 0.7f, 1.0f};
+    static constexpr uint32_t             THETA_IDX = 1;
+
+    /**
+     * 轮换的 storage buffer 数量：compute 读取一个、写入一个的同时，graphics 绘制第三个，
+     * 每个 buffer 同一时间只属于一个 queue family；帧的资源以及 compute 的 command buffer 也按照这个数量轮换
+     */
+    static constexpr uint32_t STORAGE_CNT = 3;
+
+    static constexpr size_t TRACE_CAPACITY = 256;    // 保留最近若干个 GPU 区间，按 P 导出为 chrome trace
+
+    /* 按 C 用 CPU 参考实现校验 GPU 的一步；CPU 上是 O(N^2)，质点太多时跳过 */
+    static constexpr uint32_t CPU_CHECK_MAX_CNT = 131072;
+    static constexpr double   CPU_CHECK_TOL     = 1e-3;    // GPU 的 pow 精度较低，累加顺序也不同
+
+    /**
+     * 按 U 自动调优：在当前设备上测量每一组 workgroup size 和 tile 大小，超出设备限制的组合跳过
+     * 结果按照设备保存在 tuning cache 中，启动时读取
+     */
+    static constexpr std::array<uint32_t, 5> TUNE_WORKGROUP_SIZES = {64, 128, 256, 512, 1024};
+    static constexpr std::array<uint32_t, 5> TUNE_TILE_SIZES      = {256, 512, 1024, 2048, 4096};
+    static constexpr uint32_t                TUNE_REPEAT          = 5;         // 每个组合连续 dispatch 的次数
+    static constexpr uint32_t                TUNE_MAX_CNT         = 262144;    // 质点更多时测量太慢
+    static constexpr const char             *TUNING_CACHE_PATH    = Hiss::TuningCache::DEFAULT_PATH;
+
+    /**
+     * 按 O 切换 Morton 重排：每隔 COHERENCE_INTERVAL 步统计一次质点在内存中的一致性，
+     * 距离上一次重排超过 REORDER_INTERVAL 步，或者一致性低于上一次重排之后的 COHERENCE_DROP 倍时重排
+     * 重排之前和之后各 REORDER_WINDOW 步的平均耗时用于对比
+     */
+    static constexpr uint32_t REORDER_INTERVAL   = 4096;
+    static constexpr uint32_t COHERENCE_INTERVAL = 64;
+    static constexpr double   COHERENCE_DROP     = 0.8;
+    static constexpr size_t   REORDER_WINDOW     = 128;
+
+
+    /* 计算受力的方法：精确的 all-pairs，或者 O(n log n) 的 Barnes-Hut */
+    enum class Solver
+    {
+        EXACT,
+        BARNES_HUT,
+    };
+
+
+    /* 一步中额外录制的 Morton 重排任务 */
+    enum class ReorderTask
+    {
+        NONE,
+        COHERENCE,
+        REORDER,
+    };
+
+
+    /* graphics pass resource */
     struct Graphics
     {
         struct GraphcisUBO
@@ -18,12 +95,33 @@ class ExampleComputeShaderNBody : public Hiss::ApplicationBase
         } ubo{};
 
 
-        vk::Buffer              uniform_buffer;
-        vk::DescriptorSetLayout descriptor_set_layout;
-        vk::DescriptorSet       descriptor_set;
-        vk::PipelineLayout      pipeline_layout;
-        vk::Pipeline            pipeline;
-        vk::Semaphore           semaphore;    // 渲染完成的标记
+        /* 每一帧绘制一个 storage buffer，帧的资源按照 slot 轮换 */
+        struct Frame
+        {
+            vk::CommandBuffer command_buffer;
+            vk::Buffer        uniform_buffer;
+            vk::DeviceMemory  uniform_memory;
+            void             *uniform_data = nullptr;
+            vk::DescriptorSet descriptor_set;
+            vk::Semaphore     image_available;
+        };
+
+
+        vk::SwapchainKHR             swapchain;
+        vk::Extent2D                 extent{};
+        std::vector<vk::Image>       images;
+        std::vector<vk::ImageView>   image_views;
+        std::vector<vk::Framebuffer> framebuffers;
+        std::vector<vk::Semaphore>   render_finished;    // 每个 swapchain image 一个，present 等待它
+        bool                         swapchain_dirty = false;
+
+        vk::RenderPass                 render_pass;
+        vk::CommandPool                command_pool;
+        std::array<Frame, STORAGE_CNT> frames;
+        vk::DescriptorSetLayout        descriptor_set_layout;
+        vk::PipelineLayout             pipeline_layout;
+        vk::Semaphore                  timeline;      // 第 k 帧完成时 signal k
+        vk::QueryPool                  query_pool;    // 每一帧开始和结束的 timestamp
     } graphics;
 
 
@@ -41,8 +139,6 @@ class ExampleComputeShaderNBody : public Hiss::ApplicationBase
         /* shader 中 specialization 的 constant 量，可以理解为 macro */
         struct MovementSpecializationData
         {
-            uint32_t    workgroup_size;
-            uint32_t    shared_data_size;
             const float gravity = 0.002f;
             const float power   = 0.75f;
             const float soften  = 0.05f;
@@ -51,50 +147,230 @@ class ExampleComputeShaderNBody : public Hiss::ApplicationBase
 
         /* 一些配置信息 */
         uint32_t          num_particles{};
-        uint32_t          work_group_size;
+        uint32_t          work_group_size;         // calculate 的 workgroup
         uint32_t          work_group_cnt;
-        uint32_t          shared_data_size;    // 单位是 sizeof(glm::vec4)
-        const std::string shader_file_calculate = SHADER("compute_Nbody/calculate.comp");
-        const std::string shader_file_integrate = SHADER("compute_Nbody/integrate.comp");
+        uint32_t          shared_data_size;        // 单位是 sizeof(glm::vec4)
+        uint32_t          integrate_group_size;    // integrate 是访存密集的，单独调优
+        uint32_t          integrate_group_cnt;
+        const std::string shader_file_calculate = SHADER("compute_Nbody/calculate.comp.spv");
+        const std::string shader_file_integrate = SHADER("compute_Nbody/integrate.comp.spv");
 
 
-        const std::array<vk::DescriptorSetLayoutBinding, 2> layout_bindinds = {{
+        const std::vector<vk::DescriptorSetLayoutBinding> layout_bindinds = {
                 {0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute},
                 {1, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eCompute},
-        }};
+                {2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute},
+        };
+
 
+        /* command buffer 每一步重新录制，按照 slot 区分 */
+        vk::CommandPool                            command_pool;
+        std::array<vk::CommandBuffer, STORAGE_CNT> command_buffers;
+        vk::Semaphore                              timeline;      // 第 k 步完成时 signal k
+        vk::QueryPool                              query_pool;    // 每一步开始和结束的 timestamp
+        vk::DescriptorSetLayout                    descriptor_set_layout;
+        vk::PipelineLayout                         pipeline_layout;        // 两个 pipeline 的 layout 相同
+        vk::Pipeline                               pipeline_calculate;     // 计算质点受力，写入新的速度
+        vk::Pipeline                               pipeline_intergrate;    // 写入新的位置；两者都由 registry 持有
+        vk::Buffer                                 uniform_buffer;
+        vk::DeviceMemory                           uniform_memory;
 
-        vk::CommandBuffer       command_buffer;
-        vk::Semaphore           semaphore;    // compute 过程完成的标记
-        vk::DescriptorSetLayout descriptor_set_layout;
-        vk::DescriptorSet       descriptor_set;
-        vk::PipelineLayout      pipeline_layout;        // 两个 pipeline 的 layout 相同
-        vk::Pipeline            pipeline_calculate;     // 计算质点受力，更新质点速度
-        vk::Pipeline            pipeline_intergrate;    // 更新质点的位置
-        vk::Buffer              uniform_buffer;
+        /* [src][dst]：从 storage buffer[src] 读取，写入 storage buffer[dst]；两者相同时原地更新 */
+        std::array<std::array<vk::DescriptorSet, STORAGE_CNT>, STORAGE_CNT> descriptor_sets{};
     } compute;
 
 
-    struct Particle
+    /* 和 CPU 参考实现使用相同的布局：xyz: position, w: mass；xyz: velocity, w: uv coord */
+    using Particle = Hiss::NBodyCpu::Particle;
+
+
+    /**
+     * 模拟的状态：第 k 步从 storage buffer[k % 3] 读取，写入 storage buffer[(k + 1) % 3]，第 k 帧直接绘制前者
+     * buffer 是 exclusive 的，两个 queue family 不同时：第 k 步结束时将 src release 给 graphics，第 k 帧 acquire，
+     * 绘制之后再 release 给 compute，由写入它的第 k + 2 步 acquire
+     * solver_compare 等工具在 device 空闲时直接在 compute queue 上使用 storage buffer，写入的 buffer 之后会被完整覆盖
+     */
+    std::array<vk::Buffer, STORAGE_CNT>       storage_buffers;
+    std::array<vk::DeviceMemory, STORAGE_CNT> storage_memories;
+    uint64_t                                  storage_step = 0;    // 创建 storage buffer 时的步数，之前的帧没有 release
+
+    std::unique_ptr<Hiss::PipelineRegistry> _pipelines;
+    std::unique_ptr<BarnesHut>              _barnes_hut;
+    std::unique_ptr<DepthSort>              _depth_sort;
+    std::unique_ptr<MortonReorder>          _morton_reorder;
+
+
+    /* GPU 上的一段执行区间，来自 timestamp query，单位是 ns */
+    struct Interval
+    {
+        uint64_t id;
+        double   begin;
+        double   end;
+    };
+
+
+    /**
+     * 每秒输出一次吞吐量：每一步有 N^2 次质点之间的相互作用
+     * 有 timestamp 时 time 是 GPU 上 compute 的执行时间，否则是 wall time
+     */
+    struct
+    {
+        uint32_t                              steps = 0;
+        std::chrono::duration<double>         time  = {};
+        std::vector<Interval>                 compute_intervals;
+        std::vector<Interval>                 graphics_intervals;
+        std::chrono::steady_clock::time_point last_report = std::chrono::steady_clock::now();
+    } _stat;
+
+    /* Morton 重排的状态；一致性和耗时在 slot 的下一次提交之前读取 */
+    struct ReorderStat
     {
-        glm::vec4 pos;    // xyz: position, w: mass
-        glm::vec4 vel;    // xyz: velocity, w: uv coord
+        std::array<ReorderTask, STORAGE_CNT> tasks{};                    // 每个 slot 上一次提交中录制的任务
+        uint64_t                             last_step       = 0;        // 上一次重排的步数
+        double                               coherence_after = 1.;       // 上一次重排之后的一致性
+        bool                                 due             = false;    // 一致性下降，下一步重排
+        std::deque<double>                   step_ms;                    // 最近的不包括重排的步的耗时
+        double                               before_ms     = 0.;         // 重排之前的平均耗时
+        bool                                 after_pending = false;      // 重排之后的耗时还没有输出
     };
+    ReorderStat _reorder_stat;
+
+    std::deque<Interval> _compute_trace;
+    std::deque<Interval> _graphics_trace;
+    bool                 _timestamp_support = false;
+    double               _timestamp_period  = 1.;    // 一个 tick 的 ns 数
+
+    uint64_t _step_id      = 0;       // 已经提交的步数，也是两个 timeline semaphore 的计数
+    bool     _async        = true;    // 关闭时，compute 等待上一帧绘制完成，两个 queue 串行执行
+    float    _camera_angle = 0.f;
+
+    /**
+     * 质点的绘制方式：面向相机的 quad 或者 point sprite；不排序时使用加法混合，
+     * 排序时按深度从远到近绘制，使用 over 混合；graphics queue 不支持 compute 或者设备不支持 GpuPrimitives 时不能排序
+     * point sprite 的大小不能超过设备的 pointSizeRange，不支持 largePoints 时只能是 1
+     */
+    bool  _quad           = true;
+    bool  _sorted         = false;
+    bool  _sort_support   = false;
+    float _point_size_max = 1.f;
+
+    bool _reorder         = true;
+    bool _reorder_support = false;    // 设备不支持 GpuPrimitives 时不能重排
+
+    uint32_t _particle_cnt_idx = PARTICLE_CNT_IDX;
+    bool     _cnt_key_down     = false;
+    Solver   _solver           = Solver::EXACT;
+    bool     _bh_support       = false;    // 设备不支持 GpuPrimitives 时只能使用精确解
+    uint32_t _theta_idx        = THETA_IDX;
+    bool     _solver_key_down  = false;
+    bool     _theta_key_down   = false;
+    bool     _compare_key_down = false;
+    bool     _async_key_down   = false;
+    bool     _trace_key_down   = false;
+    bool     _check_key_down   = false;
+    bool     _tune_key_down    = false;
+    bool     _quad_key_down    = false;
+    bool     _sort_key_down    = false;
+    bool     _reorder_key_down = false;
+
+
+    /* 在 compute queue 上执行一次性的命令并等待完成，返回提交到完成的时间（ms），见 Hiss::Device::submit_wait */
+    double submit_wait(const std::function<void(vk::CommandBuffer)> &record);
+
+    /* 按照质点数量重新创建 storage buffer 以及 uniform buffer，会等待 device 空闲 */
+    void particles_create(uint32_t cnt);
+
+    /* 最新的状态所在的 storage buffer，也就是下一步读取的 buffer */
+    [[nodiscard]] uint32_t storage_current() const { return (_step_id + 1) % STORAGE_CNT; }
+
+    void particle_cnt_switch();
+    void solver_switch();
+    void theta_switch();
+
+    /**
+     * 在当前的状态上分别执行一次精确解和各个 theta 的 Barnes-Hut，比较加速度和耗时
+     * 比较时速度清零，kick 之后的速度就是 dt * a；结束时恢复原来的状态
+     */
+    void solver_compare();
+
+    /**
+     * 在当前的状态上分别用 GPU 的精确解和 CPU 参考实现推进一步，比较加速度和位置
+     * 加速度由速度的变化量除以 dt 得到；GPU 的结果写入另一个 storage buffer，模拟的状态不变
+     */
+    void cpu_check();
 
+    /**
+     * 测量 calculate 的每一组 (workgroup size, tile) 以及 integrate 的每一个 workgroup size，使用最快的组合
+     * 测量时只写入另一个 storage buffer，模拟的状态不变；结果写入 tuning cache
+     */
+    void autotune();
 
-    vk::DescriptorPool descriptor_pool;
-    vk::Buffer         storage_buffer;
+    /* 在 compute queue 上连续执行 TUNE_REPEAT 次 dispatch，返回平均每次的耗时，单位是 ms */
+    double pipeline_time(vk::Pipeline pipeline, uint32_t group_cnt, vk::QueryPool query_pool);
+
+    /* 从 tuning cache 中读取当前设备的结果；没有记录或者超出设备限制时保留默认值 */
+    void compute_tuning_load();
+
+    /**
+     * 提交第 k 步模拟，以及绘制第 k 步结果的一帧
+     * 第 k + 1 步写入的 storage buffer 只需要等待第 k - 1 帧绘制完成，因此和第 k 帧的绘制重叠
+     */
+    void compute_submit(uint64_t k);
+    void frame_submit(uint64_t k);
+
+    /* host 等待 timeline semaphore 到达 value，value 为 0 时直接返回 */
+    void timeline_wait(vk::Semaphore timeline, uint64_t value);
+
+    /**
+     * 录制 storage buffer[idx] 在 compute 和 graphics 的 queue family 之间的 release 或者 acquire
+     * 两个 family 相同时什么也不做，timeline semaphore 已经建立了内存依赖
+     */
+    void storage_transfer_record(vk::CommandBuffer cmd, uint32_t idx, bool to_graphics, bool release);
+
+    /* 读取 slot 上一次提交的 timestamp，加入统计和 trace；结果不可用时返回 nullopt */
+    std::optional<Interval> timestamp_collect(vk::QueryPool pool, uint32_t slot, uint64_t id, bool compute_queue);
+
+    /* 第 k 步需要录制的重排任务 */
+    ReorderTask reorder_task_get(uint64_t k);
+
+    /* 读取 slot 上一次提交（第 step 步）的一致性，决定是否重排；输出重排前后的一致性和耗时 */
+    void reorder_collect(uint32_t slot, uint64_t step, const std::optional<Interval> &interval);
+
+    /* 质点数量改变之后，重排的统计重新开始 */
+    void reorder_reset();
+
+    void stat_report();
+
+    /* 将最近的 GPU 区间写为 chrome://tracing 的 json，两个 queue 分别是两行，可以直观地看到重叠 */
+    void trace_dump(const std::string &path);
+
+    bool key_pressed(int key, bool &key_down);
 
 
 public:
     void prepare() override;
-    void descriptor_pool_set();
+    void run() override;
 
     void graphics_prepare();
-    // TODO 判断 storage buffer 是否是初次使用，否则需要 queue family transfer
+
+    /* 按照当前的绘制方式返回 pipeline，由 pipeline registry 创建并持有 */
+    vk::Pipeline graphics_pipeline_get();
+
+    /* 每一帧的 descriptor set 绑定这一帧绘制的 storage buffer 和排序结果；质点数量改变之后需要重新调用 */
+    void graphics_descriptor_update();
+
+    void swapchain_create();
+    void swapchain_free();
+    void frame_record(uint64_t k, std::optional<uint32_t> image_idx);
 
     void compute_prepare();
     void compute_pipeline_create();
+    vk::Pipeline calculate_pipeline_create(uint32_t work_group_size, uint32_t shared_data_size);
+    vk::Pipeline integrate_pipeline_create(uint32_t work_group_size);
+    void         group_cnt_update();
     void compute_descriptor_create();
-    void compute_command_prepare();
-};
\ No newline at end of file
+    void compute_command_record(uint64_t k);
+
+    /* 录制受力的计算：按 solver 从 storage buffer[src] 读取，新的速度写入 [dst]，结束时插入 barrier */
+    void kick_record(vk::CommandBuffer cmd, Solver solver, float theta, uint32_t src, uint32_t dst);
+};
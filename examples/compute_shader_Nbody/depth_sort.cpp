@@ -0,0 +1,157 @@
+#include "depth_sort.hpp"
+
+
+DepthSort::DepthSort(Hiss::Device &device, Hiss::PipelineRegistry &pipelines,
+                     Hiss::DescriptorLayoutCache &layout_cache, Hiss::DescriptorAllocator &allocator,
+                     uint32_t slot_cnt)
+    : _device(device),
+      _pipelines(pipelines),
+      _primitives(device, pipelines, layout_cache)
+{
+    vk::Device d = _device.handle_get();
+
+
+    /**
+     * binding 的编号和 bh_common.glsl 一致：0: particles, 1: ubo, 3: 深度, 4: 质点的下标
+     * 用不到的 bounds 和 nodes 不需要绑定；binding 9 是相机
+     */
+    std::vector<vk::DescriptorSetLayoutBinding> bindings;
+    for (uint32_t i: {0u, 1u, 3u, 4u, 9u})
+        bindings.push_back(vk::DescriptorSetLayoutBinding{
+                .binding         = i,
+                .descriptorType  = i == 1 || i == 9 ? vk::DescriptorType::eUniformBuffer
+                                                    : vk::DescriptorType::eStorageBuffer,
+                .descriptorCount = 1,
+                .stageFlags      = vk::ShaderStageFlagBits::eCompute,
+        });
+    _set_layout = layout_cache.get(bindings);
+
+    vk::PushConstantRange push_range = {
+            .stageFlags = vk::ShaderStageFlagBits::eCompute,
+            .offset     = 0,
+            .size       = sizeof(Push),
+    };
+    _pipeline_layout = d.createPipelineLayout(vk::PipelineLayoutCreateInfo{
+            .setLayoutCount         = 1,
+            .pSetLayouts            = &_set_layout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges    = &push_range,
+    });
+    _sets.resize(slot_cnt);
+    for (auto &set: _sets)
+        set = allocator.allocate(_set_layout);
+
+    _shader_key = Hiss::ShaderDesc{.stage = vk::ShaderStageFlagBits::eCompute,
+                                   .path  = SHADER("compute_Nbody/depth_key.comp.spv")};
+    _shader_key.spec_add(0, WORKGROUP_SIZE);
+}
+
+
+DepthSort::~DepthSort()
+{
+    _device.handle_get().destroy(_pipeline_layout);
+}
+
+
+void DepthSort::buffers_free()
+{
+    for (Hiss::Buffer *b: {&_ubo, &_keys, &_values})
+        b->reset();
+}
+
+
+void DepthSort::resize(uint32_t particle_cnt, const std::vector<vk::Buffer> &particles,
+                       const std::vector<vk::Buffer> &cameras)
+{
+    if (particle_cnt == 0)
+        throw std::runtime_error("depth sort: particle count is zero.");
+    if (particles.size() != _sets.size() || cameras.size() != _sets.size())
+        throw std::runtime_error("depth sort: one particle buffer and one camera buffer are required per slot.");
+
+    vk::Device d = _device.handle_get();
+    buffers_free();
+    _particle_cnt = particle_cnt;
+    _block_cnt    = (particle_cnt + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE;
+
+    /* 排序的 key 和 value 重新创建之后，_primitives 中旧的 descriptor set 需要丢弃 */
+    _primitives.descriptors_reset();
+    _primitives.reserve(particle_cnt);
+
+
+    /* uniform buffer 只有质点数量，创建时写入一次 */
+    UBO ubo = {.delta_time = 0.f, .particle_count = static_cast<int32_t>(particle_cnt)};
+    _ubo = Hiss::Buffer(_device, sizeof(UBO), vk::BufferUsageFlagBits::eUniformBuffer,
+                        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+    _ubo.write(&ubo, sizeof(UBO));
+
+    /* 奇数趟时 GpuPrimitives 将结果复制回来，key 和 value 需要 eTransferDst */
+    auto create = [this](Hiss::Buffer &b, vk::DeviceSize size) {
+        b = Hiss::Buffer(_device, size,
+                         vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                         vk::MemoryPropertyFlagBits::eDeviceLocal);
+    };
+    vk::DeviceSize array_size = sizeof(uint32_t) * particle_cnt;
+    create(_keys, array_size);
+    create(_values, array_size);
+
+
+    for (uint32_t slot = 0; slot < _sets.size(); ++slot)
+    {
+        std::array<std::pair<uint32_t, vk::DescriptorBufferInfo>, 5> infos = {{
+                {0, {particles[slot], 0, VK_WHOLE_SIZE}},
+                {1, {_ubo.handle_get(), 0, VK_WHOLE_SIZE}},
+                {3, {_keys.handle_get(), 0, VK_WHOLE_SIZE}},
+                {4, {_values.handle_get(), 0, VK_WHOLE_SIZE}},
+                {9, {cameras[slot], 0, VK_WHOLE_SIZE}},
+        }};
+
+        std::vector<vk::WriteDescriptorSet> writes;
+        for (const auto &[binding, info]: infos)
+            writes.push_back(vk::WriteDescriptorSet{
+                    .dstSet          = _sets[slot],
+                    .dstBinding      = binding,
+                    .descriptorCount = 1,
+                    .descriptorType  = binding == 1 || binding == 9 ? vk::DescriptorType::eUniformBuffer
+                                                                    : vk::DescriptorType::eStorageBuffer,
+                    .pBufferInfo     = &info,
+            });
+        d.updateDescriptorSets(writes, {});
+    }
+}
+
+
+void DepthSort::record(vk::CommandBuffer cmd, uint32_t slot)
+{
+    /* 上一帧的 vertex shader 还可能在读取 order，写入之前需要等待（write after read，只需要执行依赖） */
+    vk::MemoryBarrier2 war_barrier = {
+            .srcStageMask = vk::PipelineStageFlagBits2::eVertexShader,
+            .dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+    };
+    cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &war_barrier});
+
+    Push push = {.theta = 0.f};
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute,
+                     _pipelines.get(Hiss::PipelineDesc::compute(_shader_key, _pipeline_layout)));
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, _pipeline_layout, 0, {_sets[slot]}, nullptr);
+    cmd.pushConstants(_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(Push), &push);
+    cmd.dispatch(_block_cnt, 1, 1);
+
+    vk::MemoryBarrier2 key_barrier = {
+            .srcStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .srcAccessMask = vk::AccessFlagBits2::eShaderWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .dstAccessMask = vk::AccessFlagBits2::eShaderRead | vk::AccessFlagBits2::eShaderWrite,
+    };
+    cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &key_barrier});
+    _primitives.sort_record(cmd, _keys.handle_get(), _values.handle_get(), _particle_cnt, KEY_BITS);
+
+
+    /* 排序结束时只有 compute -> compute 的 barrier，vertex shader 读取 order 还需要一个 */
+    vk::MemoryBarrier2 order_barrier = {
+            .srcStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .srcAccessMask = vk::AccessFlagBits2::eShaderWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eVertexShader,
+            .dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead,
+    };
+    cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &order_barrier});
+}
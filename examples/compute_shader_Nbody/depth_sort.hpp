@@ -0,0 +1,84 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <device.hpp>
+#include <pipeline.hpp>
+#include <descriptor.hpp>
+#include <gpu_primitives.hpp>
+#include "profile.hpp"
+
+
+/**
+ * 按照 view space 中的深度对质点排序，得到从远到近的质点下标，用于 over 混合的绘制
+ *
+ * 在 graphics queue 上执行，每一帧：
+ *  1. depth_key：key 是 16 bit 的深度，value 是质点的下标
+ *  2. key-value 排序（GpuPrimitives），16 bit 的 key 共 4 趟
+ * 排序的结果在 order_buffer() 中，vertex shader 按照它读取质点
+ * 每个 slot 有自己的 descriptor set，质点来自这一帧绘制的 storage buffer，相机来自对应帧的 uniform buffer
+ * 设备不支持 GpuPrimitives 需要的 subgroup 操作时，构造函数抛出异常
+ */
+class DepthSort
+{
+public:
+    static constexpr uint32_t WORKGROUP_SIZE = 256;
+    static constexpr uint32_t KEY_BITS       = 16;
+
+
+    DepthSort(Hiss::Device &device, Hiss::PipelineRegistry &pipelines, Hiss::DescriptorLayoutCache &layout_cache,
+              Hiss::DescriptorAllocator &allocator, uint32_t slot_cnt);
+    ~DepthSort();
+    DepthSort(const DepthSort &)            = delete;
+    DepthSort &operator=(const DepthSort &) = delete;
+
+
+    /**
+     * 按照质点数量重新分配排序使用的 buffer；particles 和 cameras 每个 slot 一个
+     * 调用者需要保证 device 已经空闲
+     */
+    void resize(uint32_t particle_cnt, const std::vector<vk::Buffer> &particles,
+                const std::vector<vk::Buffer> &cameras);
+
+    /**
+     * 录制 slot 的深度排序：开始时等待上一帧的 vertex shader 读完 order，
+     * 结束时插入 compute -> vertex shader 的 barrier
+     */
+    void record(vk::CommandBuffer cmd, uint32_t slot);
+
+    /* 从远到近的质点下标 */
+    [[nodiscard]] vk::Buffer order_buffer() const { return _values.handle_get(); }
+
+
+private:
+    /* 和 bh_common.glsl 中的 push constant 一致，depth_key 不使用 */
+    struct Push
+    {
+        float theta;
+    };
+
+    /* 和 bh_common.glsl 中的 UBO 一致，只使用 particle_count */
+    struct UBO
+    {
+        float   delta_time;
+        int32_t particle_count;
+    };
+
+
+    Hiss::Device           &_device;
+    Hiss::PipelineRegistry &_pipelines;
+    Hiss::GpuPrimitives     _primitives;
+    vk::DescriptorSetLayout _set_layout;
+    vk::PipelineLayout      _pipeline_layout;
+
+    std::vector<vk::DescriptorSet> _sets;
+    Hiss::ShaderDesc               _shader_key;
+
+    uint32_t     _particle_cnt = 0;
+    uint32_t     _block_cnt    = 0;
+    Hiss::Buffer _ubo;
+    Hiss::Buffer _keys;      // 深度，由 _primitives 原地排序
+    Hiss::Buffer _values;    // 质点的下标，排序之后就是 order
+
+
+    void buffers_free();
+};
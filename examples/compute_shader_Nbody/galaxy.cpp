@@ -0,0 +1,49 @@
+#include "galaxy.hpp"
+#include <array>
+#include <random>
+#include <algorithm>
+
+
+/**
+ * 初始状态：质点分布在 4 个星系中，每个星系的中心是一个大质量的质点，其余质点在盘面附近绕中心旋转
+ * 随机数的种子固定，相同的质点数量总是得到相同的初始状态
+ */
+std::vector<Hiss::NBodyCpu::Particle> galaxies_init(uint32_t cnt)
+{
+    static constexpr std::array<glm::vec3, 4> CENTERS = {{
+            {5.f, 0.f, 0.f},
+            {-5.f, 0.f, 0.f},
+            {0.f, 0.f, 5.f},
+            {0.f, 0.f, -5.f},
+    }};
+    constexpr float CENTER_MASS = 90000.f;
+    constexpr float ORBIT_SPEED = 8.f;
+
+    std::mt19937                          rng(42);
+    std::normal_distribution<float>       normal(0.f, 1.f);
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+    auto     galaxy_cnt = static_cast<uint32_t>(CENTERS.size());
+    uint32_t per_galaxy = std::max<uint32_t>(1, cnt / galaxy_cnt);
+
+    std::vector<Hiss::NBodyCpu::Particle> particles(cnt);
+    for (uint32_t i = 0; i < cnt; ++i)
+    {
+        uint32_t  galaxy = std::min(i / per_galaxy, galaxy_cnt - 1);
+        float     uv     = static_cast<float>(galaxy) / static_cast<float>(galaxy_cnt);
+        glm::vec3 center = CENTERS[galaxy];
+        if (i % per_galaxy == 0)
+        {
+            particles[i] = {.pos = glm::vec4(center, CENTER_MASS), .vel = glm::vec4(0.f, 0.f, 0.f, uv)};
+            continue;
+        }
+
+        glm::vec3 offset = glm::vec3(normal(rng), normal(rng) * .1f, normal(rng));
+        glm::vec3 vel    = glm::cross(offset, glm::vec3(0.f, 1.f, 0.f)) * ORBIT_SPEED / (glm::length(offset) + 1.f);
+        particles[i]     = {
+                    .pos = glm::vec4(center + offset, (.5f + .5f * uniform(rng)) * 75.f),
+                    .vel = glm::vec4(vel, uv),
+        };
+    }
+    return particles;
+}
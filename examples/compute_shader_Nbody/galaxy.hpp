@@ -0,0 +1,7 @@
+#pragma once
+#include <vector>
+#include <nbody_cpu.hpp>
+
+
+/* 窗口示例和 headless runner 共用的初始状态 */
+std::vector<Hiss::NBodyCpu::Particle> galaxies_init(uint32_t cnt);
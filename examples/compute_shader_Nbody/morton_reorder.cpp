@@ -0,0 +1,222 @@
+#include "morton_reorder.hpp"
+
+
+MortonReorder::MortonReorder(Hiss::Device &device, Hiss::PipelineRegistry &pipelines,
+                             Hiss::DescriptorLayoutCache &layout_cache, Hiss::DescriptorAllocator &allocator,
+                             uint32_t slot_cnt, uint32_t particle_buffer_cnt)
+    : _device(device),
+      _pipelines(pipelines),
+      _primitives(device, pipelines, layout_cache)
+{
+    vk::Device d = _device.handle_get();
+
+
+    /**
+     * binding 的编号和 bh_common.glsl 一致：0: particles, 1: ubo, 2: bounds,
+     * 3: Morton code, 4: 质点的下标, 5: coherence 的 flag；binding 10 是收集的目标，轮换的下一个 buffer
+     */
+    std::vector<vk::DescriptorSetLayoutBinding> bindings;
+    for (uint32_t i: {0u, 1u, 2u, 3u, 4u, 5u, 10u})
+        bindings.push_back(vk::DescriptorSetLayoutBinding{
+                .binding         = i,
+                .descriptorType  = i == 1 ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer,
+                .descriptorCount = 1,
+                .stageFlags      = vk::ShaderStageFlagBits::eCompute,
+        });
+    _set_layout = layout_cache.get(bindings);
+
+    vk::PushConstantRange push_range = {
+            .stageFlags = vk::ShaderStageFlagBits::eCompute,
+            .offset     = 0,
+            .size       = sizeof(Push),
+    };
+    _pipeline_layout = d.createPipelineLayout(vk::PipelineLayoutCreateInfo{
+            .setLayoutCount         = 1,
+            .pSetLayouts            = &_set_layout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges    = &push_range,
+    });
+    _sets.resize(particle_buffer_cnt);
+    for (auto &set: _sets)
+        set = allocator.allocate(_set_layout);
+
+
+    auto shader = [](const std::string &path) {
+        Hiss::ShaderDesc desc{.stage = vk::ShaderStageFlagBits::eCompute, .path = path};
+        desc.spec_add(0, WORKGROUP_SIZE);
+        return desc;
+    };
+    _shader_bounds    = shader(SHADER("compute_Nbody/bh_bounds.comp.spv"));
+    _shader_morton    = shader(SHADER("compute_Nbody/bh_morton.comp.spv"));
+    _shader_coherence = shader(SHADER("compute_Nbody/reorder_coherence.comp.spv"));
+    _shader_gather    = shader(SHADER("compute_Nbody/reorder_gather.comp.spv"));
+    _shader_coherence.spec_add(1, COHERENCE_LEVEL);
+
+
+    /* 每个结果只有一个 uint，由 GpuPrimitives 的 reduce 写入 */
+    for (uint32_t i = 0; i < slot_cnt * RESULT_CNT; ++i)
+    {
+        auto &result = _results.emplace_back(
+                _device, sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer,
+                vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+        _result_data.push_back(static_cast<const uint32_t *>(d.mapMemory(result.memory_get(), 0, sizeof(uint32_t))));
+    }
+}
+
+
+MortonReorder::~MortonReorder()
+{
+    _device.handle_get().destroy(_pipeline_layout);
+}
+
+
+void MortonReorder::buffers_free()
+{
+    for (Hiss::Buffer *b: {&_bounds, &_keys, &_values, &_flags})
+        b->reset();
+    _memory_size = 0;
+}
+
+
+void MortonReorder::resize(uint32_t particle_cnt, const std::vector<vk::Buffer> &particles, vk::Buffer ubo)
+{
+    if (particle_cnt < 2)
+        throw std::runtime_error("morton reorder: at least two particles are required.");
+    if (particles.size() != _sets.size())
+        throw std::runtime_error("morton reorder: particle buffer count mismatch.");
+
+    vk::Device d = _device.handle_get();
+    buffers_free();
+    _particle_cnt = particle_cnt;
+    _block_cnt    = (particle_cnt + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE;
+
+    /* 排序的 key 和 value 由 _primitives 原地排序，旧的 buffer 对应的 descriptor set 需要丢弃 */
+    _primitives.descriptors_reset();
+    _primitives.reserve(particle_cnt);
+
+
+    auto create = [this](Hiss::Buffer &b, vk::DeviceSize size, vk::BufferUsageFlags usage = {}) {
+        b = Hiss::Buffer(_device, size, vk::BufferUsageFlagBits::eStorageBuffer | usage,
+                         vk::MemoryPropertyFlagBits::eDeviceLocal);
+        _memory_size += size;
+    };
+    vk::DeviceSize array_size = sizeof(uint32_t) * particle_cnt;
+    create(_bounds, sizeof(glm::uvec4) * 2, vk::BufferUsageFlagBits::eTransferDst);
+    create(_keys, array_size, vk::BufferUsageFlagBits::eTransferDst);
+    create(_values, array_size, vk::BufferUsageFlagBits::eTransferDst);
+    create(_flags, array_size);
+
+
+    /* 每个 set 只有 binding 0 和 10 不同：质点的 src 和轮换的下一个 buffer */
+    uint32_t buffer_cnt = static_cast<uint32_t>(particles.size());
+    for (uint32_t src = 0; src < buffer_cnt; ++src)
+    {
+        std::array<std::pair<uint32_t, vk::DescriptorBufferInfo>, 7> infos = {{
+                {0, {particles[src], 0, VK_WHOLE_SIZE}},
+                {1, {ubo, 0, VK_WHOLE_SIZE}},
+                {2, {_bounds.handle_get(), 0, VK_WHOLE_SIZE}},
+                {3, {_keys.handle_get(), 0, VK_WHOLE_SIZE}},
+                {4, {_values.handle_get(), 0, VK_WHOLE_SIZE}},
+                {5, {_flags.handle_get(), 0, VK_WHOLE_SIZE}},
+                {10, {particles[(src + 1) % buffer_cnt], 0, VK_WHOLE_SIZE}},
+        }};
+        std::vector<vk::WriteDescriptorSet> writes;
+        for (const auto &[binding, info]: infos)
+            writes.push_back(vk::WriteDescriptorSet{
+                    .dstSet          = _sets[src],
+                    .dstBinding      = binding,
+                    .descriptorCount = 1,
+                    .descriptorType  = binding == 1 ? vk::DescriptorType::eUniformBuffer
+                                                    : vk::DescriptorType::eStorageBuffer,
+                    .pBufferInfo     = &info,
+            });
+        d.updateDescriptorSets(writes, {});
+    }
+}
+
+
+void MortonReorder::dispatch(vk::CommandBuffer cmd, const Hiss::ShaderDesc &shader, uint32_t src, uint32_t group_cnt)
+{
+    Push push = {.theta = 0.f};
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute,
+                     _pipelines.get(Hiss::PipelineDesc::compute(shader, _pipeline_layout)));
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, _pipeline_layout, 0, {_sets[src]}, nullptr);
+    cmd.pushConstants(_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(Push), &push);
+    cmd.dispatch(group_cnt, 1, 1);
+
+    vk::MemoryBarrier2 barrier = {
+            .srcStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .srcAccessMask = vk::AccessFlagBits2::eShaderWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .dstAccessMask = vk::AccessFlagBits2::eShaderRead | vk::AccessFlagBits2::eShaderWrite,
+    };
+    cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &barrier});
+}
+
+
+void MortonReorder::keys_record(vk::CommandBuffer cmd, uint32_t src)
+{
+    /* 包围盒的初值：min 为最大的 uint，max 为 0；清零之前等待上一次统计对 bounds 的读写 */
+    vk::MemoryBarrier2 clear_barrier = {
+            .srcStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .srcAccessMask = vk::AccessFlagBits2::eShaderWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eTransfer,
+            .dstAccessMask = vk::AccessFlagBits2::eTransferWrite,
+    };
+    cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &clear_barrier});
+    cmd.fillBuffer(_bounds.handle_get(), 0, sizeof(glm::uvec4), 0xFFFFFFFFu);
+    cmd.fillBuffer(_bounds.handle_get(), sizeof(glm::uvec4), sizeof(glm::uvec4), 0u);
+    vk::MemoryBarrier2 fill_barrier = {
+            .srcStageMask  = vk::PipelineStageFlagBits2::eTransfer,
+            .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .dstAccessMask = vk::AccessFlagBits2::eShaderRead | vk::AccessFlagBits2::eShaderWrite,
+    };
+    cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &fill_barrier});
+
+    dispatch(cmd, _shader_bounds, src, _block_cnt);
+    dispatch(cmd, _shader_morton, src, _block_cnt);
+}
+
+
+/* coherence 只读取 _keys，两个 set 都可以使用 */
+void MortonReorder::flags_record(vk::CommandBuffer cmd, uint32_t slot, uint32_t idx)
+{
+    dispatch(cmd, _shader_coherence, 0, _block_cnt);
+    _primitives.reduce_record(cmd, _flags.handle_get(), _particle_cnt,
+                              _results.at(slot * RESULT_CNT + idx).handle_get());
+
+    vk::MemoryBarrier2 host_barrier = {
+            .srcStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .srcAccessMask = vk::AccessFlagBits2::eShaderWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eHost,
+            .dstAccessMask = vk::AccessFlagBits2::eHostRead,
+    };
+    cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &host_barrier});
+}
+
+
+void MortonReorder::coherence_record(vk::CommandBuffer cmd, uint32_t slot, uint32_t idx, uint32_t src)
+{
+    keys_record(cmd, src);
+    flags_record(cmd, slot, idx);
+}
+
+
+/**
+ * 重排之前的一致性统计已经计算了当前顺序的 Morton code，直接排序；
+ * 包围盒不变，收集之后质点的 Morton code 就是排好序的 _keys，直接统计得到重排之后的一致性
+ */
+void MortonReorder::reorder_record(vk::CommandBuffer cmd, uint32_t slot, uint32_t src)
+{
+    coherence_record(cmd, slot, 0, src);
+    _primitives.sort_record(cmd, _keys.handle_get(), _values.handle_get(), _particle_cnt, MORTON_BITS);
+    dispatch(cmd, _shader_gather, src, _block_cnt);
+    flags_record(cmd, slot, 1);
+}
+
+
+double MortonReorder::coherence_get(uint32_t slot, uint32_t idx) const
+{
+    return static_cast<double>(*_result_data.at(slot * RESULT_CNT + idx)) / static_cast<double>(_particle_cnt - 1);
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <device.hpp>
+#include <pipeline.hpp>
+#include <descriptor.hpp>
+#include <gpu_primitives.hpp>
+#include "profile.hpp"
+
+
+/**
+ * 按照 Morton code 重排模拟的质点，让空间上相邻的质点在内存中也相邻
+ * 质点的顺序不影响模拟的结果，只影响访存的局部性：Barnes-Hut 遍历时 warp 中的质点路径相近，
+ * 精确解的 tile 也更可能是空间上聚集的质点
+ *
+ * 在 compute queue 上执行：
+ *  - coherence：bh_bounds -> bh_morton -> 相邻质点是否位于同一个 cell -> 求和，结果写入 host 可见的 buffer
+ *  - reorder：Morton code 的 key-value 排序（GpuPrimitives），按排序之后的下标将质点收集到轮换的下一个 buffer 中
+ * 质点是轮换使用的多个 buffer，每个 buffer 作为 src 时有自己的 descriptor set，src 本身不会被修改
+ * 设备不支持 GpuPrimitives 需要的 subgroup 操作时，构造函数抛出异常
+ */
+class MortonReorder
+{
+public:
+    static constexpr uint32_t WORKGROUP_SIZE  = 256;
+    static constexpr uint32_t MORTON_BITS     = 30;
+    static constexpr uint32_t COHERENCE_LEVEL = 5;    // 每个轴 32 个 cell
+
+
+    MortonReorder(Hiss::Device &device, Hiss::PipelineRegistry &pipelines, Hiss::DescriptorLayoutCache &layout_cache,
+                  Hiss::DescriptorAllocator &allocator, uint32_t slot_cnt, uint32_t particle_buffer_cnt = 2);
+    ~MortonReorder();
+    MortonReorder(const MortonReorder &)            = delete;
+    MortonReorder &operator=(const MortonReorder &) = delete;
+
+
+    /**
+     * 按照质点数量重新分配 buffer，并绑定质点的 storage buffer 和 uniform buffer
+     * particles 的数量和构造时的 particle_buffer_cnt 一致；调用者需要保证 device 已经空闲
+     */
+    void resize(uint32_t particle_cnt, const std::vector<vk::Buffer> &particles, vk::Buffer ubo);
+
+    /**
+     * 统计 particles[src] 当前顺序的一致性，写入 slot 的第 idx 个结果；结束时插入 compute -> host 的 barrier，
+     * 提交完成之后用 coherence_get() 读取
+     */
+    void coherence_record(vk::CommandBuffer cmd, uint32_t slot, uint32_t idx, uint32_t src);
+
+    /**
+     * 将 particles[src] 按 Morton 顺序收集到 particles[(src + 1) % n] 中，结束时结果对之后的 compute shader 可见
+     * 重排之前和之后的一致性分别写入 slot 的第 0 个和第 1 个结果
+     */
+    void reorder_record(vk::CommandBuffer cmd, uint32_t slot, uint32_t src);
+
+    /* 相邻质点位于同一个 cell 的比例，范围是 [0, 1] */
+    [[nodiscard]] double coherence_get(uint32_t slot, uint32_t idx) const;
+
+    /* 重排额外占用的显存 */
+    [[nodiscard]] vk::DeviceSize memory_size() const { return _memory_size + _primitives.memory_size(); }
+
+
+private:
+    static constexpr uint32_t RESULT_CNT = 2;    // 每个 slot 的结果数量：重排之前和之后
+
+
+    /* 和 bh_common.glsl 中的 push constant 一致，这里的 pass 都不使用 */
+    struct Push
+    {
+        float theta;
+    };
+
+
+    Hiss::Device           &_device;
+    Hiss::PipelineRegistry &_pipelines;
+    Hiss::GpuPrimitives     _primitives;
+    vk::DescriptorSetLayout _set_layout;
+    vk::PipelineLayout      _pipeline_layout;
+
+    /* _sets[src]：binding 0 是 particles[src]，binding 10 是轮换的下一个 buffer */
+    std::vector<vk::DescriptorSet> _sets;
+
+    Hiss::ShaderDesc _shader_bounds;
+    Hiss::ShaderDesc _shader_morton;
+    Hiss::ShaderDesc _shader_coherence;
+    Hiss::ShaderDesc _shader_gather;
+
+    uint32_t       _particle_cnt = 0;
+    uint32_t       _block_cnt    = 0;
+    Hiss::Buffer   _bounds;
+    Hiss::Buffer   _keys;
+    Hiss::Buffer   _values;
+    Hiss::Buffer   _flags;
+    vk::DeviceSize _memory_size = 0;
+
+    /* [slot * RESULT_CNT + idx]，host 可见，一直 map，释放 memory 时隐式地 unmap */
+    std::vector<Hiss::Buffer>     _results;
+    std::vector<const uint32_t *> _result_data;
+
+
+    void buffers_free();
+    void dispatch(vk::CommandBuffer cmd, const Hiss::ShaderDesc &shader, uint32_t src, uint32_t group_cnt);
+
+    /* bounds -> morton，_keys 是 particles[src] 当前顺序的 Morton code，_values 是质点的下标 */
+    void keys_record(vk::CommandBuffer cmd, uint32_t src);
+
+    /* 按照 _keys 统计相邻质点是否位于同一个 cell，求和之后写入 slot 的第 idx 个结果 */
+    void flags_record(vk::CommandBuffer cmd, uint32_t slot, uint32_t idx);
+};
@@ -0,0 +1,675 @@
+#include "nbody_headless.hpp"
+#include "galaxy.hpp"
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <tuning_cache.hpp>
+#include <glm/gtc/packing.hpp>
+
+
+/**
+ * 用法：compute_shader_Nbody_headless [options]，参数见 NBodyHeadless::options_parse
+ */
+int main(int argc, char **argv)
+{
+    try
+    {
+        NBodyHeadless::Options options = NBodyHeadless::options_parse(argc, argv);
+        if (options.cpu)
+        {
+            /* ApplicationBase 会创建 Vulkan device，CPU 模式不构造 NBodyHeadless */
+            LogStatic::init();
+            NBodyHeadless::cpu_run(options);
+        }
+        else
+        {
+            NBodyHeadless app(std::move(options));
+            app.run();
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "exception: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+NBodyHeadless::NBodyHeadless(Options options)
+    : ApplicationBase("compute shader N-body headless", true),
+      _options(std::move(options))
+{
+    if (_options.particle_cnt == 0 || _options.substeps == 0 || _options.ring_size == 0)
+        throw std::runtime_error("nbody headless: particles, substeps and ring size must be positive.");
+}
+
+
+NBodyHeadless::~NBodyHeadless()
+{
+    vk::Device d = device().handle_get();
+    d.waitIdle();
+    writer_stop();
+
+    _barnes_hut.reset();
+    _pipelines.reset();
+    _readback.reset();
+
+    device().buffer_free(_storage_buffer, _storage_memory);
+    device().buffer_free(_uniform_buffer, _uniform_memory);
+    d.destroy(_pipeline_layout);
+    d.destroy(_timeline);
+    d.destroy(_command_pool);
+}
+
+
+NBodyHeadless::Options NBodyHeadless::options_parse(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg   = argv[i];
+        auto        value = [&]() -> std::string {
+            if (i + 1 >= argc)
+                throw std::runtime_error("nbody headless: missing value for " + arg);
+            return argv[++i];
+        };
+
+        if (arg == "--particles")
+            options.particle_cnt = static_cast<uint32_t>(std::stoul(value()));
+        else if (arg == "--steps")
+            options.steps = std::stoull(value());
+        else if (arg == "--substeps")
+            options.substeps = static_cast<uint32_t>(std::stoul(value()));
+        else if (arg == "--snapshot")
+            options.snapshot_interval = static_cast<uint32_t>(std::stoul(value()));
+        else if (arg == "--ring")
+            options.ring_size = static_cast<uint32_t>(std::stoul(value()));
+        else if (arg == "--fp16")
+            options.fp16 = true;
+        else if (arg == "--barnes-hut")
+            options.barnes_hut = true;
+        else if (arg == "--cpu")
+            options.cpu = true;
+        else if (arg == "--theta")
+            options.theta = std::stof(value());
+        else if (arg == "--dt")
+            options.delta_time = std::stof(value());
+        else if (arg == "--output")
+            options.output = value();
+        else
+            throw std::runtime_error("nbody headless: unknown option " + arg);
+    }
+    return options;
+}
+
+
+void NBodyHeadless::prepare()
+{
+    vk::Device d = device().handle_get();
+    if (!device().timeline_semaphore_support())
+        throw std::runtime_error("timeline semaphore unsupported.");
+    if (!device().sync2_support())
+        throw std::runtime_error("synchronization2 unsupported.");
+
+
+    _command_pool = d.createCommandPool(vk::CommandPoolCreateInfo{
+            .queueFamilyIndex = device().compute_queue_get().family_index,
+    });
+
+    vk::SemaphoreTypeCreateInfo timeline_info = {.semaphoreType = vk::SemaphoreType::eTimeline, .initialValue = 0};
+    _timeline = d.createSemaphore(vk::SemaphoreCreateInfo{.pNext = &timeline_info});
+
+
+    /* uniform buffer 在整个模拟中不变 */
+    UBO ubo = {.delta_time = _options.delta_time, .particle_count = static_cast<int32_t>(_options.particle_cnt)};
+    device().buffer_create(sizeof(UBO), vk::BufferUsageFlagBits::eUniformBuffer,
+                           vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                           _uniform_buffer, _uniform_memory);
+    std::memcpy(d.mapMemory(_uniform_memory, 0, sizeof(UBO)), &ubo, sizeof(UBO));
+    d.unmapMemory(_uniform_memory);
+
+    vk::DeviceSize size = sizeof(Hiss::NBodyCpu::Particle) * _options.particle_cnt;
+    device().buffer_create(size,
+                           vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc
+                                   | vk::BufferUsageFlagBits::eTransferDst,
+                           vk::MemoryPropertyFlagBits::eDeviceLocal, _storage_buffer, _storage_memory);
+
+
+    /**
+     * 和窗口示例相同的 descriptor：binding 0 是读取的质点，binding 1 是 uniform buffer，binding 2 是写入的质点
+     * 这里只有一个 storage buffer，读取和写入绑定同一个 buffer，原地更新
+     */
+    _set_layout      = descriptor_layout_cache().get({
+            {0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute},
+            {1, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eCompute},
+            {2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute},
+    });
+    _set             = descriptor_allocator().allocate(_set_layout);
+    _pipeline_layout = d.createPipelineLayout(vk::PipelineLayoutCreateInfo{
+            .setLayoutCount = 1,
+            .pSetLayouts    = &_set_layout,
+    });
+
+    vk::DescriptorBufferInfo              storage_info = {_storage_buffer, 0, VK_WHOLE_SIZE};
+    vk::DescriptorBufferInfo              uniform_info = {_uniform_buffer, 0, VK_WHOLE_SIZE};
+    std::array<vk::WriteDescriptorSet, 3> writes       = {{
+            {
+                          .dstSet          = _set,
+                          .dstBinding      = 0,
+                          .descriptorCount = 1,
+                          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+                          .pBufferInfo     = &storage_info,
+            },
+            {
+                          .dstSet          = _set,
+                          .dstBinding      = 1,
+                          .descriptorCount = 1,
+                          .descriptorType  = vk::DescriptorType::eUniformBuffer,
+                          .pBufferInfo     = &uniform_info,
+            },
+            {
+                          .dstSet          = _set,
+                          .dstBinding      = 2,
+                          .descriptorCount = 1,
+                          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+                          .pBufferInfo     = &storage_info,
+            },
+    }};
+    d.updateDescriptorSets(writes, {});
+
+
+    _pipelines = std::make_unique<Hiss::PipelineRegistry>(d, shader_library());
+    tuning_load();
+    pipelines_create();
+    if (_options.barnes_hut)
+    {
+        _barnes_hut = std::make_unique<BarnesHut>(device(), *_pipelines, descriptor_layout_cache(),
+                                                  descriptor_allocator(),
+                                                  BarnesHut::Physics{
+                                                          .gravity = _physics.gravity,
+                                                          .power   = _physics.power,
+                                                          .soften  = _physics.soften,
+                                                  });
+        _barnes_hut->resize(_options.particle_cnt, {_storage_buffer}, _uniform_buffer);
+    }
+
+    if (_options.snapshot_interval > 0)
+    {
+        _readback = std::make_unique<Hiss::ReadbackRing>(device(), size, _options.ring_size);
+        _slot_busy.assign(_options.ring_size, false);
+        readback_commands_record();
+    }
+}
+
+
+/**
+ * 默认值不超过设备的限制；窗口示例调优过当前设备时使用调优的结果
+ */
+void NBodyHeadless::tuning_load()
+{
+    vk::PhysicalDevice pd     = device().physical_device_get();
+    auto               limits = pd.getProperties().limits;
+    auto group_ok = [&](uint32_t group_size) {
+        return group_size > 0 && group_size <= limits.maxComputeWorkGroupSize[0]
+            && group_size <= limits.maxComputeWorkGroupInvocations;
+    };
+
+    _work_group_size      = std::min({256u, limits.maxComputeWorkGroupSize[0], limits.maxComputeWorkGroupInvocations});
+    _shared_data_size     = std::min<uint32_t>(1024, limits.maxComputeSharedMemorySize / sizeof(glm::vec4));
+    _integrate_group_size = _work_group_size;
+
+    Hiss::TuningCache cache;
+    std::string       device_key = Hiss::TuningCache::device_key(pd);
+    auto              calculate  = cache.get(device_key, "nbody.calculate");
+    auto              integrate  = cache.get(device_key, "nbody.integrate");
+    if (calculate && calculate->size() == 2 && group_ok((*calculate)[0]) && (*calculate)[1] > 0
+        && (*calculate)[1] * sizeof(glm::vec4) <= limits.maxComputeSharedMemorySize)
+    {
+        _work_group_size  = (*calculate)[0];
+        _shared_data_size = (*calculate)[1];
+    }
+    if (integrate && integrate->size() == 1 && group_ok((*integrate)[0]))
+        _integrate_group_size = (*integrate)[0];
+}
+
+
+void NBodyHeadless::pipelines_create()
+{
+    Hiss::ShaderDesc calculate = {.stage = vk::ShaderStageFlagBits::eCompute,
+                                  .path  = SHADER("compute_Nbody/calculate.comp.spv")};
+    calculate.spec_add(0, _work_group_size)
+            .spec_add(1, _shared_data_size)
+            .spec_add(2, _physics.gravity)
+            .spec_add(3, _physics.power)
+            .spec_add(4, _physics.soften);
+    _pipeline_calculate = _pipelines->get(Hiss::PipelineDesc::compute(calculate, _pipeline_layout));
+
+    Hiss::ShaderDesc integrate = {.stage = vk::ShaderStageFlagBits::eCompute,
+                                  .path  = SHADER("compute_Nbody/integrate.comp.spv")};
+    integrate.spec_add(0, _integrate_group_size);
+    _pipeline_integrate = _pipelines->get(Hiss::PipelineDesc::compute(integrate, _pipeline_layout));
+}
+
+
+void NBodyHeadless::particles_upload()
+{
+    std::vector<Hiss::NBodyCpu::Particle> particles = galaxies_init(_options.particle_cnt);
+    device().buffer_upload(device().compute_queue_get(), _command_pool, _storage_buffer, particles.data(),
+                           sizeof(Hiss::NBodyCpu::Particle) * particles.size());
+
+    if (_options.snapshot_interval > 0)
+        header_write(_file, _options, particles);
+}
+
+
+void NBodyHeadless::header_write(std::ofstream &file, const Options &options,
+                                 const std::vector<Hiss::NBodyCpu::Particle> &particles)
+{
+    file.open(options.output, std::ios::binary | std::ios::trunc);
+    if (!file)
+        throw std::runtime_error("fail to open snapshot file: " + options.output);
+
+    uint32_t particle_cnt = options.particle_cnt;
+    uint32_t flags        = options.fp16 ? FLAG_FP16 : 0;
+    file.write(MAGIC, sizeof(MAGIC));
+    file.write(reinterpret_cast<const char *>(&VERSION), sizeof(VERSION));
+    file.write(reinterpret_cast<const char *>(&particle_cnt), sizeof(particle_cnt));
+    file.write(reinterpret_cast<const char *>(&flags), sizeof(flags));
+    file.write(reinterpret_cast<const char *>(&options.delta_time), sizeof(float));
+    file.write(reinterpret_cast<const char *>(&options.snapshot_interval), sizeof(uint32_t));
+
+    std::vector<float> constants;
+    constants.reserve(2 * particles.size());
+    for (const auto &p: particles)
+    {
+        constants.push_back(p.pos.w);
+        constants.push_back(p.vel.w);
+    }
+    file.write(reinterpret_cast<const char *>(constants.data()),
+               static_cast<std::streamsize>(constants.size() * sizeof(float)));
+    if (!file)
+        throw std::runtime_error("fail to write snapshot header: " + options.output);
+}
+
+
+uint64_t NBodyHeadless::submit(vk::CommandBuffer cmd)
+{
+    vk::SemaphoreSubmitInfo signal_info = {
+            .semaphore = _timeline,
+            .value     = ++_timeline_value,
+            .stageMask = vk::PipelineStageFlagBits2::eAllCommands,
+    };
+    vk::CommandBufferSubmitInfo cmd_info = {.commandBuffer = cmd};
+    device().compute_queue_get().queue.submit2(vk::SubmitInfo2{
+            .commandBufferInfoCount   = 1,
+            .pCommandBufferInfos      = &cmd_info,
+            .signalSemaphoreInfoCount = 1,
+            .pSignalSemaphoreInfos    = &signal_info,
+    });
+    return _timeline_value;
+}
+
+
+void NBodyHeadless::timeline_wait(uint64_t value)
+{
+    if (value == 0)
+        return;
+    (void) device().handle_get().waitSemaphores(
+            vk::SemaphoreWaitInfo{.semaphoreCount = 1, .pSemaphores = &_timeline, .pValues = &value}, UINT64_MAX);
+}
+
+
+/**
+ * 每一步：kick（精确解或者 Barnes-Hut）-> integrate；每一步开始时的 barrier 覆盖上一步 integrate 的写入，
+ * 以及上一次回读的读取（同一个 queue 上，barrier 对之前提交的命令同样有效）
+ * 同一个 command buffer 可能同时在队列中出现多次，因此使用 simultaneous use
+ */
+vk::CommandBuffer NBodyHeadless::step_command_get(uint32_t step_cnt)
+{
+    if (auto iter = _step_commands.find(step_cnt); iter != _step_commands.end())
+        return iter->second;
+
+    vk::CommandBuffer cmd = device().handle_get().allocateCommandBuffers(vk::CommandBufferAllocateInfo{
+            .commandPool        = _command_pool,
+            .level              = vk::CommandBufferLevel::ePrimary,
+            .commandBufferCount = 1,
+    })[0];
+
+    vk::MemoryBarrier2 step_barrier = {
+            .srcStageMask  = vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eTransfer,
+            .srcAccessMask = vk::AccessFlagBits2::eShaderWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .dstAccessMask = vk::AccessFlagBits2::eShaderRead | vk::AccessFlagBits2::eShaderWrite,
+    };
+    vk::MemoryBarrier2 kick_barrier = {
+            .srcStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .srcAccessMask = vk::AccessFlagBits2::eShaderWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .dstAccessMask = vk::AccessFlagBits2::eShaderRead | vk::AccessFlagBits2::eShaderWrite,
+    };
+    uint32_t calculate_group_cnt = (_options.particle_cnt + _work_group_size - 1) / _work_group_size;
+    uint32_t integrate_group_cnt = (_options.particle_cnt + _integrate_group_size - 1) / _integrate_group_size;
+
+    cmd.begin(vk::CommandBufferBeginInfo{.flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse});
+    for (uint32_t s = 0; s < step_cnt; ++s)
+    {
+        cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &step_barrier});
+
+        if (_barnes_hut)
+            _barnes_hut->record(cmd, _options.theta);
+        else
+        {
+            cmd.bindPipeline(vk::PipelineBindPoint::eCompute, _pipeline_calculate);
+            cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, _pipeline_layout, 0, {_set}, nullptr);
+            cmd.dispatch(calculate_group_cnt, 1, 1);
+            cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &kick_barrier});
+        }
+
+        /* Barnes-Hut 绑定了自己的 descriptor set，需要重新绑定 */
+        cmd.bindPipeline(vk::PipelineBindPoint::eCompute, _pipeline_integrate);
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, _pipeline_layout, 0, {_set}, nullptr);
+        cmd.dispatch(integrate_group_cnt, 1, 1);
+    }
+    cmd.end();
+
+    _step_commands[step_cnt] = cmd;
+    return cmd;
+}
+
+
+void NBodyHeadless::readback_commands_record()
+{
+    _readback_commands = device().handle_get().allocateCommandBuffers(vk::CommandBufferAllocateInfo{
+            .commandPool        = _command_pool,
+            .level              = vk::CommandBufferLevel::ePrimary,
+            .commandBufferCount = _options.ring_size,
+    });
+
+    vk::MemoryBarrier2 copy_barrier = {
+            .srcStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .srcAccessMask = vk::AccessFlagBits2::eShaderWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eTransfer,
+            .dstAccessMask = vk::AccessFlagBits2::eTransferRead,
+    };
+    vk::DeviceSize size = sizeof(Hiss::NBodyCpu::Particle) * _options.particle_cnt;
+    for (uint32_t slot = 0; slot < _options.ring_size; ++slot)
+    {
+        vk::CommandBuffer cmd = _readback_commands[slot];
+        cmd.begin(vk::CommandBufferBeginInfo{});
+        cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &copy_barrier});
+        _readback->copy_record(cmd, slot, _storage_buffer, 0, size);
+        cmd.end();
+    }
+}
+
+
+/**
+ * slot 按照顺序轮流使用；slot 还没有被 writer 写完时等待，这是 host 唯一会因为 writer 而阻塞的地方
+ * slot 空闲时，上一次使用它的回读一定已经完成，因此 GPU 可以直接覆盖它
+ */
+void NBodyHeadless::snapshot_submit(uint64_t step)
+{
+    uint32_t slot = _snapshot_cnt % _options.ring_size;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_slot_busy[slot])
+        {
+            auto start = std::chrono::steady_clock::now();
+            ++_stall_cnt;
+            _cv.wait(lock, [&] { return !_slot_busy[slot] || _writer_exception; });
+            _stall_time += std::chrono::steady_clock::now() - start;
+        }
+        if (_writer_exception)
+            std::rethrow_exception(_writer_exception);
+        _slot_busy[slot] = true;
+    }
+
+    uint64_t value = submit(_readback_commands[slot]);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _jobs.push_back({.slot = slot, .step = step, .timeline_value = value});
+    }
+    _cv.notify_all();
+    ++_snapshot_cnt;
+}
+
+
+void NBodyHeadless::writer_loop()
+{
+    std::vector<uint8_t> bytes;
+    while (true)
+    {
+        Job job{};
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv.wait(lock, [&] { return !_jobs.empty() || _writer_stop; });
+            if (_jobs.empty())
+                return;
+            job = _jobs.front();
+            _jobs.pop_front();
+        }
+
+        try
+        {
+            timeline_wait(job.timeline_value);
+            _bytes_written += snapshot_write(_file, _options, job.step,
+                                             _readback->read<Hiss::NBodyCpu::Particle>(job.slot), bytes);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _writer_exception = std::current_exception();
+            _cv.notify_all();
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _slot_busy[job.slot] = false;
+        }
+        _cv.notify_all();
+    }
+}
+
+
+/**
+ * 先在内存中编码一个完整的 snapshot，再一次性写入文件
+ */
+size_t NBodyHeadless::snapshot_write(std::ofstream &file, const Options &options, uint64_t step,
+                                     const Hiss::NBodyCpu::Particle *particles, std::vector<uint8_t> &bytes)
+{
+    size_t component = options.fp16 ? sizeof(uint16_t) : sizeof(float);
+    bytes.resize(sizeof(uint64_t) + options.particle_cnt * COMPONENT_CNT * component);
+    std::memcpy(bytes.data(), &step, sizeof(uint64_t));
+
+    uint8_t *dst = bytes.data() + sizeof(uint64_t);
+    for (uint32_t i = 0; i < options.particle_cnt; ++i)
+    {
+        const auto &p                     = particles[i];
+        float       values[COMPONENT_CNT] = {p.pos.x, p.pos.y, p.pos.z, p.vel.x, p.vel.y, p.vel.z};
+        if (options.fp16)
+        {
+            uint16_t halves[COMPONENT_CNT];
+            for (uint32_t c = 0; c < COMPONENT_CNT; ++c)
+                halves[c] = glm::packHalf1x16(values[c]);
+            std::memcpy(dst, halves, sizeof(halves));
+            dst += sizeof(halves);
+        }
+        else
+        {
+            std::memcpy(dst, values, sizeof(values));
+            dst += sizeof(values);
+        }
+    }
+
+    file.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    if (!file)
+        throw std::runtime_error("fail to write snapshot: " + options.output);
+    return bytes.size();
+}
+
+
+/* 等待 writer 写完所有的 snapshot 之后退出 */
+void NBodyHeadless::writer_stop()
+{
+    if (!_writer.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _writer_stop = true;
+    }
+    _cv.notify_all();
+    _writer.join();
+    _file.flush();
+}
+
+
+void NBodyHeadless::run()
+{
+    prepare();
+    particles_upload();
+
+    auto   logger       = LogStatic::logger();
+    double interactions = static_cast<double>(_options.particle_cnt) * _options.particle_cnt;
+    logger->info("[headless] particles: {}, steps: {}, substeps: {}, snapshot every {} steps, ring: {}, fp16: {}, "
+                 "solver: {}, workgroup: {}, tile: {}",
+                 _options.particle_cnt, _options.steps, _options.substeps, _options.snapshot_interval,
+                 _options.ring_size, _options.fp16, _options.barnes_hut ? "barnes-hut" : "exact", _work_group_size,
+                 _shared_data_size);
+
+    if (_options.snapshot_interval > 0)
+    {
+        _writer = std::thread(&NBodyHeadless::writer_loop, this);
+        snapshot_submit(0);
+    }
+
+
+    auto     start       = std::chrono::steady_clock::now();
+    auto     last_report = start;
+    uint64_t last_step   = 0;
+    uint64_t step        = 0;
+    while (step < _options.steps)
+    {
+        /* 一次提交不跨过 snapshot，回读的就是第 step 步之后的状态 */
+        uint64_t next = _options.steps;
+        if (_options.snapshot_interval > 0)
+            next = std::min(next, (step / _options.snapshot_interval + 1) * _options.snapshot_interval);
+        auto step_cnt = static_cast<uint32_t>(std::min<uint64_t>(_options.substeps, next - step));
+
+        if (_timeline_value >= MAX_INFLIGHT)
+            timeline_wait(_timeline_value - MAX_INFLIGHT + 1);
+        submit(step_command_get(step_cnt));
+        step += step_cnt;
+
+        if (_options.snapshot_interval > 0 && (step % _options.snapshot_interval == 0 || step == _options.steps))
+            snapshot_submit(step);
+
+
+        /* 每秒输出一次进度；提交的步数最多领先 GPU MAX_INFLIGHT 次提交 */
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_report >= std::chrono::seconds(1))
+        {
+            double seconds = std::chrono::duration<double>(now - last_report).count();
+            double rate    = static_cast<double>(step - last_step) / seconds;
+            logger->info("[headless] step: {} / {}, {:.1f} steps/s, interactions/s: {:.3f} G, snapshots: {}, "
+                         "stalls: {}",
+                         step, _options.steps, rate, rate * interactions * 1e-9, _snapshot_cnt, _stall_cnt);
+            last_report = now;
+            last_step   = step;
+        }
+    }
+
+    device().handle_get().waitIdle();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    writer_stop();
+    if (_writer_exception)
+        std::rethrow_exception(_writer_exception);
+
+
+    /* Barnes-Hut 的 interactions/s 是等效值：精确解在相同时间内需要完成的相互作用数量 */
+    logger->info("[headless] done, steps: {}, {:.3f} s, {:.1f} steps/s, interactions/s: {:.3f} G", _options.steps,
+                 seconds, static_cast<double>(_options.steps) / seconds,
+                 static_cast<double>(_options.steps) * interactions / seconds * 1e-9);
+    if (_options.snapshot_interval > 0)
+        logger->info("[headless] snapshots: {}, {:.1f} MB written to {}, writer stalls: {} ({:.3f} s)",
+                     _snapshot_cnt, static_cast<double>(_bytes_written) / (1024. * 1024.), _options.output,
+                     _stall_cnt, _stall_time.count());
+}
+
+
+void NBodyHeadless::cpu_run(const Options &options)
+{
+    if (options.particle_cnt == 0)
+        throw std::runtime_error("nbody headless: particles must be positive.");
+    if (options.barnes_hut)
+        throw std::runtime_error("nbody headless: barnes-hut is not available on the cpu.");
+
+    Hiss::NBodyCpu         cpu;
+    Hiss::ThreadPool       thread_pool;
+    Hiss::NBodyCpu::Kernel kernel = Hiss::NBodyCpu::kernel_best();
+
+    auto   logger       = LogStatic::logger();
+    double interactions = static_cast<double>(options.particle_cnt) * options.particle_cnt;
+    logger->info("[headless] particles: {}, steps: {}, snapshot every {} steps, fp16: {}, solver: cpu, kernel: {}, "
+                 "threads: {}",
+                 options.particle_cnt, options.steps, options.snapshot_interval, options.fp16,
+                 Hiss::NBodyCpu::kernel_name(kernel), thread_pool.thread_cnt());
+
+    std::vector<Hiss::NBodyCpu::Particle> particles = galaxies_init(options.particle_cnt);
+    std::ofstream                         file;
+    std::vector<uint8_t>                  bytes;
+    uint32_t                              snapshot_cnt  = 0;
+    size_t                                bytes_written = 0;
+    if (options.snapshot_interval > 0)
+    {
+        header_write(file, options, particles);
+        bytes_written += snapshot_write(file, options, 0, particles.data(), bytes);
+        ++snapshot_cnt;
+    }
+    cpu.load(particles);
+
+
+    auto     start       = std::chrono::steady_clock::now();
+    auto     last_report = start;
+    uint64_t last_step   = 0;
+    for (uint64_t step = 1; step <= options.steps; ++step)
+    {
+        cpu.step(options.delta_time, kernel, &thread_pool);
+
+        /* CPU 上没有可以重叠的回读，snapshot 同步写出 */
+        if (options.snapshot_interval > 0 && (step % options.snapshot_interval == 0 || step == options.steps))
+        {
+            cpu.store(particles);
+            bytes_written += snapshot_write(file, options, step, particles.data(), bytes);
+            ++snapshot_cnt;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_report >= std::chrono::seconds(1))
+        {
+            double seconds = std::chrono::duration<double>(now - last_report).count();
+            double rate    = static_cast<double>(step - last_step) / seconds;
+            logger->info("[headless] step: {} / {}, {:.1f} steps/s, interactions/s: {:.3f} G, snapshots: {}", step,
+                         options.steps, rate, rate * interactions * 1e-9, snapshot_cnt);
+            last_report = now;
+            last_step   = step;
+        }
+    }
+
+    if (options.snapshot_interval > 0)
+    {
+        file.flush();
+        if (!file)
+            throw std::runtime_error("fail to write snapshot: " + options.output);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+
+    logger->info("[headless] done, steps: {}, {:.3f} s, {:.1f} steps/s, interactions/s: {:.3f} G", options.steps,
+                 seconds, static_cast<double>(options.steps) / seconds,
+                 static_cast<double>(options.steps) * interactions / seconds * 1e-9);
+    if (options.snapshot_interval > 0)
+        logger->info("[headless] snapshots: {}, {:.1f} MB written to {}", snapshot_cnt,
+                     static_cast<double>(bytes_written) / (1024. * 1024.), options.output);
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include <map>
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <exception>
+#include <condition_variable>
+#include <application.hpp>
+#include <pipeline.hpp>
+#include <readback.hpp>
+#include <nbody_cpu.hpp>
+#include "barnes_hut.hpp"
+
+
+/**
+ * 没有窗口的 N-body 模拟，用于长时间的离线运行
+ *
+ * - 每次提交执行 substeps 步，command buffer 按照步数预先录制一次，之后重复提交
+ * - 每隔 snapshot_interval 步将质点复制到 readback ring 的一个 slot 中（host cached 的内存），
+ *   由单独的 writer 线程等待复制完成之后写入文件；GPU 的提交不等待 writer，
+ *   只有 ring 中所有的 slot 都还没有写完时，host 才会在提交下一次回读之前等待
+ * - 队列中最多有 MAX_INFLIGHT 次提交，host 不会无限地领先 GPU
+ * - workgroup size 和 tile 大小使用窗口示例按 U 调优的结果（tuning cache）
+ * - --cpu 时不创建 Vulkan device，由 cpu_run() 使用 NBodyCpu 推进，snapshot 的格式相同
+ *
+ * snapshot 文件的格式（little endian）：
+ *  header:   char magic[4] = "HNBS"，uint32 version，uint32 particle_cnt，uint32 flags（bit 0: fp16），
+ *            float delta_time，uint32 snapshot_interval；
+ *            之后是 particle_cnt 个 (float mass, float uv)，在整个模拟中不变
+ *  snapshot: uint64 step，之后是 particle_cnt 个 (pos.xyz, vel.xyz)，开启 fp16 时每个分量是 half，否则是 float
+ */
+class NBodyHeadless : public Hiss::ApplicationBase
+{
+public:
+    struct Options
+    {
+        uint32_t    particle_cnt      = 65536;
+        uint64_t    steps             = 10000;
+        uint32_t    substeps          = 32;     // 每次提交执行的步数
+        uint32_t    snapshot_interval = 500;    // 每隔多少步回读一次，0 表示不回读
+        uint32_t    ring_size         = 4;      // readback ring 中 slot 的数量
+        bool        fp16              = false;
+        bool        barnes_hut        = false;
+        bool        cpu               = false;    // 在 CPU 上模拟，用于没有 Vulkan compute 的环境
+        float       theta             = 0.5f;
+        float       delta_time        = 0.0005f;
+        std::string output            = "nbody_snapshots.bin";
+    };
+
+
+    explicit NBodyHeadless(Options options);
+    ~NBodyHeadless();
+
+
+    /**
+     * --particles N --steps N --substeps N --snapshot N --ring N --fp16 --barnes-hut --theta F --dt F --output PATH
+     * --cpu；未知的参数抛出异常
+     */
+    static Options options_parse(int argc, char **argv);
+
+    /**
+     * 只用 CPU 执行模拟，不需要 Vulkan：精确解，NBodyCpu 在当前 CPU 上最快的 kernel，使用所有的核心
+     * substeps，ring 和 Barnes-Hut 的参数不适用；snapshot 在模拟的线程上同步写入
+     * 调用之前需要初始化 LogStatic
+     */
+    static void cpu_run(const Options &options);
+
+    void prepare() override;
+    void run() override;
+
+
+private:
+    static constexpr uint32_t MAX_INFLIGHT  = 3;    // 队列中最多的提交数量
+    static constexpr char     MAGIC[4]      = {'H', 'N', 'B', 'S'};
+    static constexpr uint32_t VERSION       = 1;
+    static constexpr uint32_t FLAG_FP16     = 1u << 0;
+    static constexpr uint32_t COMPONENT_CNT = 6;    // 每个质点写入 pos.xyz 和 vel.xyz
+
+
+    struct UBO
+    {
+        float   delta_time;
+        int32_t particle_count;
+    };
+
+    /* writer 线程的任务：等待 timeline 到达 value 之后，将 slot 写入文件 */
+    struct Job
+    {
+        uint32_t slot;
+        uint64_t step;
+        uint64_t timeline_value;
+    };
+
+
+    Options                 _options;
+    Hiss::NBodyCpu::Physics _physics;
+
+    std::unique_ptr<Hiss::PipelineRegistry> _pipelines;
+    std::unique_ptr<BarnesHut>              _barnes_hut;
+    std::unique_ptr<Hiss::ReadbackRing>     _readback;
+
+    vk::Buffer              _storage_buffer;
+    vk::DeviceMemory        _storage_memory;
+    vk::Buffer              _uniform_buffer;
+    vk::DeviceMemory        _uniform_memory;
+    vk::DescriptorSetLayout _set_layout;
+    vk::DescriptorSet       _set;
+    vk::PipelineLayout      _pipeline_layout;
+    vk::Pipeline            _pipeline_calculate;    // 由 pipeline registry 持有
+    vk::Pipeline            _pipeline_integrate;
+    uint32_t                _work_group_size      = 256;
+    uint32_t                _shared_data_size     = 1024;
+    uint32_t                _integrate_group_size = 256;
+
+    vk::CommandPool                       _command_pool;
+    vk::Semaphore                         _timeline;    // 每次提交 signal 一个新的值
+    uint64_t                              _timeline_value = 0;
+    std::map<uint32_t, vk::CommandBuffer> _step_commands;        // key 是一次提交执行的步数
+    std::vector<vk::CommandBuffer>        _readback_commands;    // 每个 slot 一个
+
+
+    /* writer 线程和 ring 中 slot 的状态，由 _mutex 保护 */
+    std::thread             _writer;
+    std::mutex              _mutex;
+    std::condition_variable _cv;
+    std::deque<Job>         _jobs;
+    std::vector<bool>       _slot_busy;
+    bool                    _writer_stop = false;
+    std::exception_ptr      _writer_exception;
+
+    std::ofstream                 _file;
+    uint64_t                      _bytes_written = 0;    // 只在 writer 线程中修改，join 之后读取
+    uint32_t                      _snapshot_cnt  = 0;
+    uint32_t                      _stall_cnt     = 0;    // host 因为 ring 已满而等待的次数
+    std::chrono::duration<double> _stall_time    = {};
+
+
+    void tuning_load();
+    void pipelines_create();
+    void particles_upload();
+
+    /* 创建 snapshot 文件并写入 header */
+    static void header_write(std::ofstream &file, const Options &options,
+                             const std::vector<Hiss::NBodyCpu::Particle> &particles);
+
+    /* 编码并写入第 step 步的 snapshot，bytes 是复用的缓冲；返回写入的字节数 */
+    static size_t snapshot_write(std::ofstream &file, const Options &options, uint64_t step,
+                                 const Hiss::NBodyCpu::Particle *particles, std::vector<uint8_t> &bytes);
+
+    /* 提交 cmd，完成时 timeline signal 新的值，返回这个值 */
+    uint64_t submit(vk::CommandBuffer cmd);
+    void     timeline_wait(uint64_t value);
+
+    /* 连续执行 step_cnt 步的 command buffer，第一次使用时录制 */
+    vk::CommandBuffer step_command_get(uint32_t step_cnt);
+    void              readback_commands_record();
+
+    void snapshot_submit(uint64_t step);
+    void writer_loop();
+    void writer_stop();
+};
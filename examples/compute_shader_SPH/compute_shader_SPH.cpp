@@ -0,0 +1,342 @@
+#include "compute_shader_SPH.hpp"
+#include <cmath>
+#include <random>
+#include <iostream>
+#include <algorithm>
+#include <glm/gtc/constants.hpp>
+
+
+/**
+ * 用法：compute_shader_SPH [options]，参数见 ComputeShaderSPH::options_parse
+ */
+int main(int argc, char **argv)
+{
+    try
+    {
+        ComputeShaderSPH app(ComputeShaderSPH::options_parse(argc, argv));
+        app.run();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "exception: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+ComputeShaderSPH::ComputeShaderSPH(Options options)
+    : ApplicationBase("compute shader SPH", true),
+      _options(options)
+{
+    if (_options.particle_cnt == 0 || _options.report == 0)
+        throw std::runtime_error("sph: particles and report interval must be positive.");
+}
+
+
+ComputeShaderSPH::~ComputeShaderSPH()
+{
+    vk::Device d = device().handle_get();
+    d.waitIdle();
+
+    _solver.reset();
+    _pipelines.reset();
+    d.destroy(_query_pool);
+    d.destroy(_command_pool);
+}
+
+
+ComputeShaderSPH::Options ComputeShaderSPH::options_parse(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg   = argv[i];
+        auto        value = [&]() -> std::string {
+            if (i + 1 >= argc)
+                throw std::runtime_error("sph: missing value for " + arg);
+            return argv[++i];
+        };
+
+        if (arg == "--particles")
+            options.particle_cnt = static_cast<uint32_t>(std::stoul(value()));
+        else if (arg == "--steps")
+            options.steps = static_cast<uint32_t>(std::stoul(value()));
+        else if (arg == "--report")
+            options.report = static_cast<uint32_t>(std::stoul(value()));
+        else if (arg == "--check")
+            options.check = true;
+        else if (arg == "--scale")
+            options.scale = true;
+        else
+            throw std::runtime_error("sph: unknown option " + arg);
+    }
+    return options;
+}
+
+
+void ComputeShaderSPH::prepare()
+{
+    vk::Device d = device().handle_get();
+    if (!device().sync2_support())
+        throw std::runtime_error("synchronization2 unsupported.");
+
+    _command_pool = d.createCommandPool(vk::CommandPoolCreateInfo{
+            .queueFamilyIndex = device().compute_queue_get().family_index,
+    });
+
+
+    /* compute queue 支持 timestamp 时分段计时 */
+    auto families     = device().physical_device_get().getQueueFamilyProperties();
+    _timestamp_period = device().physical_device_get().getProperties().limits.timestampPeriod;
+    if (families[device().compute_queue_get().family_index].timestampValidBits > 0)
+        _query_pool = d.createQueryPool(vk::QueryPoolCreateInfo{
+                .queryType  = vk::QueryType::eTimestamp,
+                .queryCount = TIMED_STEPS * (SphSolver::PASS_CNT + 1),
+        });
+
+    _pipelines = std::make_unique<Hiss::PipelineRegistry>(d, shader_library());
+    _solver    = std::make_unique<SphSolver>(device(), *_pipelines, descriptor_layout_cache(), descriptor_allocator());
+}
+
+
+double ComputeShaderSPH::steps_run(uint32_t step_cnt)
+{
+    double ms = 0.;
+    for (uint32_t done = 0; done < step_cnt;)
+    {
+        uint32_t batch = std::min(BATCH_STEPS, step_cnt - done);
+        ms += device().submit_wait(device().compute_queue_get(), _command_pool, [&](vk::CommandBuffer cmd) {
+            for (uint32_t s = 0; s < batch; ++s)
+                _solver->record(cmd);
+        });
+        done += batch;
+    }
+    return ms;
+}
+
+
+/**
+ * 水柱的底面是 nx * nx 个质点，高度是底面边长的两倍，位于容器的左侧；容器的宽度是水柱的 4 倍
+ * 质点的质量使得规则排列的内部质点的密度恰好等于 REST_DENSITY
+ */
+void ComputeShaderSPH::scene_create(uint32_t cnt)
+{
+    vk::Device d = device().handle_get();
+    d.waitIdle();
+
+    auto nx = static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<double>(cnt) / 2.)));
+    auto ny = (cnt + nx * nx - 1) / (nx * nx);
+
+    std::mt19937                          rng(20240601);
+    std::uniform_real_distribution<float> jitter(-0.01f * SPACING, 0.01f * SPACING);
+    std::vector<Particle>                 particles;
+    particles.reserve(cnt);
+    for (uint32_t y = 0; y < ny && particles.size() < cnt; ++y)
+        for (uint32_t z = 0; z < nx && particles.size() < cnt; ++z)
+            for (uint32_t x = 0; x < nx && particles.size() < cnt; ++x)
+            {
+                glm::vec3 pos = (glm::vec3(x, y, z) + 0.5f) * SPACING;
+                pos += glm::vec3(jitter(rng), jitter(rng), jitter(rng));
+                particles.push_back({.pos = glm::vec4(pos, REST_DENSITY), .vel = glm::vec4(0.f)});
+            }
+
+
+    /* 规则排列时一个质点的 kernel 之和 */
+    float pi    = glm::pi<float>();
+    float poly6 = 315.f / (64.f * pi * std::pow(H, 9.f));
+    auto  reach = static_cast<int>(std::ceil(H / SPACING));
+    float w_sum = 0.f;
+    for (int z = -reach; z <= reach; ++z)
+        for (int y = -reach; y <= reach; ++y)
+            for (int x = -reach; x <= reach; ++x)
+            {
+                float r2 = glm::dot(glm::vec3(x, y, z), glm::vec3(x, y, z)) * SPACING * SPACING;
+                if (r2 < H * H)
+                    w_sum += std::pow(H * H - r2, 3.f) * poly6;
+            }
+
+    float height = static_cast<float>(ny) * SPACING;
+    float sound  = SOUND_FACTOR * std::sqrt(2.f * GRAVITY * height);
+    float width  = static_cast<float>(nx) * SPACING;
+
+    SphSolver::Params params = {
+            .box          = glm::vec4(4.f * width, 1.5f * height, width, 0.f),
+            .gravity      = glm::vec4(0.f, -GRAVITY, 0.f, 0.f),
+            .h            = H,
+            .mass         = REST_DENSITY / w_sum,
+            .rest_density = REST_DENSITY,
+            .stiffness    = sound * sound,
+            .viscosity    = VISCOSITY_ALPHA * sound * H * REST_DENSITY,
+            .delta_time   = CFL * H / sound,
+            .wall_damping = WALL_DAMPING,
+            .particle_cnt = cnt,
+    };
+    _solver->resize(params);
+
+
+    device().buffer_upload(device().compute_queue_get(), _command_pool, _solver->particle_buffer(), particles.data(),
+                           sizeof(Particle) * particles.size());
+
+    LogStatic::logger()->info("[sph] particles: {}, column: {} x {} x {}, box: ({:.1f}, {:.1f}, {:.1f}), "
+                              "sound speed: {:.1f}, dt: {:.2e}, gpu memory: {:.1f} MB",
+                              cnt, nx, ny, nx, params.box.x, params.box.y, params.box.z, sound, params.delta_time,
+                              static_cast<double>(_solver->memory_size()) / (1024. * 1024.));
+}
+
+
+void ComputeShaderSPH::state_report(uint64_t step)
+{
+    const auto &params = _solver->params();
+    const auto &queue  = device().compute_queue_get();
+    auto        p      = device().buffer_download<Particle>(queue, _command_pool, _solver->particle_buffer(),
+                                                            params.particle_cnt);
+
+    /* integrate 把质点夹在容器内，超出容差说明出现了 NaN 或者数值爆炸 */
+    constexpr float TOL = 1e-3f;
+
+    double density_sum = 0., speed_max = 0.;
+    for (uint32_t i = 0; i < params.particle_cnt; ++i)
+    {
+        glm::vec3 pos    = p[i].pos;
+        bool      inside = pos.x >= -TOL && pos.y >= -TOL && pos.z >= -TOL && pos.x <= params.box.x + TOL
+                   && pos.y <= params.box.y + TOL && pos.z <= params.box.z + TOL;
+        if (!inside || !std::isfinite(p[i].pos.w))
+            throw std::runtime_error("sph: simulation diverged at step " + std::to_string(step));
+
+        density_sum += p[i].pos.w;
+        speed_max = std::max(speed_max, static_cast<double>(glm::length(glm::vec3(p[i].vel))));
+    }
+
+    LogStatic::logger()->info("[sph] step {}, time {:.3f} s, mean density: {:.3f} of rest, max speed: {:.2f}", step,
+                              static_cast<double>(step) * params.delta_time,
+                              density_sum / params.particle_cnt / params.rest_density, speed_max);
+}
+
+
+/**
+ * 一步之后，sorted 是这一步排序之后的质点，fluid 是 GPU 由网格邻居搜索得到的密度
+ * CPU 对 sorted 中的质点两两求和，两者的差别只来自浮点的累加顺序
+ */
+void ComputeShaderSPH::check()
+{
+    uint32_t cnt = std::min(_options.particle_cnt, CHECK_MAX_CNT);
+    scene_create(cnt);
+    const auto &queue = device().compute_queue_get();
+    device().submit_wait(queue, _command_pool, [&](vk::CommandBuffer cmd) { _solver->record(cmd); });
+
+    auto sorted = device().buffer_download<Particle>(queue, _command_pool, _solver->sorted_buffer(), cnt);
+    auto fluid  = device().buffer_download<glm::vec2>(queue, _command_pool, _solver->fluid_buffer(), cnt);
+
+    const auto &params  = _solver->params();
+    float       h2      = params.h * params.h;
+    double      err_max = 0.;
+    uint32_t    err_idx = 0;
+    for (uint32_t i = 0; i < cnt; ++i)
+    {
+        double density = 0.;
+        for (uint32_t j = 0; j < cnt; ++j)
+        {
+            glm::vec3 d  = glm::vec3(sorted[j].pos) - glm::vec3(sorted[i].pos);
+            float     r2 = glm::dot(d, d);
+            if (r2 < h2)
+                density += std::pow(static_cast<double>(h2 - r2), 3.);
+        }
+        density *= static_cast<double>(params.mass) * params.poly6;
+
+        double err = std::abs(fluid[i].x - density) / density;
+        if (err > err_max)
+        {
+            err_max = err;
+            err_idx = i;
+        }
+    }
+
+    LogStatic::logger()->info("[sph] check {} particles, density max relative error: {:.2e} at {}", cnt, err_max,
+                              err_idx);
+    if (err_max > CHECK_TOL)
+        throw std::runtime_error("sph: grid density differs from brute force.");
+}
+
+
+/**
+ * 预热之后，用 wall time 测量 step_cnt 步的平均耗时；再用 TIMED_STEPS 步的 timestamp 得到每个 pass 的耗时
+ */
+ComputeShaderSPH::Bench ComputeShaderSPH::bench(uint32_t cnt, uint32_t step_cnt)
+{
+    scene_create(cnt);
+    steps_run(WARMUP_STEPS);
+
+    Bench result = {.particle_cnt = cnt, .step_ms = steps_run(step_cnt) / step_cnt};
+    if (_query_pool)
+    {
+        constexpr uint32_t QUERY_CNT = SphSolver::PASS_CNT + 1;
+        device().submit_wait(device().compute_queue_get(), _command_pool, [&](vk::CommandBuffer cmd) {
+            for (uint32_t s = 0; s < TIMED_STEPS; ++s)
+                _solver->record(cmd, _query_pool, s * QUERY_CNT);
+        });
+
+        std::vector<uint64_t> ticks(TIMED_STEPS * QUERY_CNT);
+        vk::Result            res = device().handle_get().getQueryPoolResults(
+                _query_pool, 0, static_cast<uint32_t>(ticks.size()), ticks.size() * sizeof(uint64_t), ticks.data(),
+                sizeof(uint64_t), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+        if (res == vk::Result::eSuccess)
+            for (uint32_t s = 0; s < TIMED_STEPS; ++s)
+                for (uint32_t pass = 0; pass < SphSolver::PASS_CNT; ++pass)
+                    result.pass_ms[pass] += static_cast<double>(ticks[s * QUERY_CNT + pass + 1]
+                                                                - ticks[s * QUERY_CNT + pass])
+                                          * _timestamp_period * 1e-6 / TIMED_STEPS;
+    }
+    state_report(WARMUP_STEPS + step_cnt + (_query_pool ? TIMED_STEPS : 0));
+
+    LogStatic::logger()->info("[sph] particles: {}, step: {:.3f} ms, {:.1f} M particles/s, grid: {:.3f} ms, "
+                              "density: {:.3f} ms, force: {:.3f} ms, integrate: {:.3f} ms",
+                              cnt, result.step_ms, cnt / result.step_ms * 1e-3, result.pass_ms[0], result.pass_ms[1],
+                              result.pass_ms[2], result.pass_ms[3]);
+    return result;
+}
+
+
+void ComputeShaderSPH::simulate()
+{
+    scene_create(_options.particle_cnt);
+    state_report(0);
+
+    double ms = 0.;
+    for (uint32_t step = 0; step < _options.steps;)
+    {
+        uint32_t cnt = std::min(_options.report, _options.steps - step);
+        double   t   = steps_run(cnt);
+        ms += t;
+        step += cnt;
+        LogStatic::logger()->info("[sph] {:.3f} ms/step", t / cnt);
+        state_report(step);
+    }
+
+    if (_options.steps > 0)
+        LogStatic::logger()->info("[sph] {} steps, average {:.3f} ms/step", _options.steps, ms / _options.steps);
+}
+
+
+void ComputeShaderSPH::run()
+{
+    prepare();
+
+    if (_options.check)
+        check();
+
+    if (_options.scale)
+    {
+        std::vector<Bench> results;
+        for (uint32_t cnt: SCALE_CNTS)
+            results.push_back(bench(cnt, SCALE_STEPS));
+
+        /* 网格邻居搜索的每个质点的耗时应当基本不变；精确的 O(n^2) 会随质点数量线性增长 */
+        for (const auto &r: results)
+            LogStatic::logger()->info("[scale] particles: {:8}, step: {:8.3f} ms, per particle: {:6.2f} ns",
+                                      r.particle_cnt, r.step_ms, r.step_ms * 1e6 / r.particle_cnt);
+    }
+
+    if (!_options.check && !_options.scale)
+        simulate();
+}
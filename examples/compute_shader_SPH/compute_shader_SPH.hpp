@@ -0,0 +1,98 @@
+#pragma once
+#include <array>
+#include <memory>
+#include <vector>
+#include <application.hpp>
+#include <pipeline.hpp>
+#include "sph_solver.hpp"
+
+
+/**
+ * 没有窗口的 SPH 流体示例：容器左侧的一柱水在重力下坍塌（dam break）
+ *
+ * 三种模式：
+ *  - 默认：模拟 steps 步，每隔 report 步输出耗时，平均密度和最大速度
+ *  - --check：一步之后用 CPU 的 O(n^2) 暴力求和校验 GPU 网格邻居搜索得到的密度
+ *  - --scale：质点数量从 64K 到 1M，输出每一步以及每个 pass 的耗时；
+ *             邻居搜索是 O(n) 的，每个质点的耗时应当基本不变
+ *
+ * 场景按照质点数量缩放：质点间距和光滑半径固定，水柱的尺寸随数量增长，
+ * 声速按照水柱高度对应的最大流速选取（弱可压缩），时间步长由 CFL 条件决定
+ */
+class ComputeShaderSPH : public Hiss::ApplicationBase
+{
+public:
+    struct Options
+    {
+        uint32_t particle_cnt = 262144;
+        uint32_t steps        = 4000;
+        uint32_t report       = 500;    // 每隔多少步输出一次
+        bool     check        = false;
+        bool     scale        = false;
+    };
+
+
+    explicit ComputeShaderSPH(Options options);
+    ~ComputeShaderSPH();
+
+
+    /* --particles N --steps N --report N --check --scale；未知的参数抛出异常 */
+    static Options options_parse(int argc, char **argv);
+
+    void prepare() override;
+    void run() override;
+
+
+private:
+    using Particle = SphSolver::Particle;
+
+    static constexpr float H               = 1.f;         // 光滑半径，也是网格 cell 的边长
+    static constexpr float SPACING         = 0.5f * H;    // 初始的质点间距，每个质点大约有 30 个邻居
+    static constexpr float REST_DENSITY    = 1000.f;
+    static constexpr float GRAVITY         = 9.8f;
+    static constexpr float SOUND_FACTOR    = 10.f;        // 声速是最大流速的倍数，密度的波动约为 1%
+    static constexpr float CFL             = 0.4f;
+    static constexpr float VISCOSITY_ALPHA = 0.01f;       // 运动粘度 = alpha * c * h
+    static constexpr float WALL_DAMPING    = 0.5f;
+
+    static constexpr uint32_t BATCH_STEPS   = 50;       // 一次提交的步数
+    static constexpr uint32_t TIMED_STEPS   = 8;        // 分段计时的步数，每一步有 PASS_CNT + 1 个 timestamp
+    static constexpr uint32_t WARMUP_STEPS  = 20;
+    static constexpr uint32_t SCALE_STEPS   = 200;
+    static constexpr uint32_t CHECK_MAX_CNT = 32768;    // CPU 上是 O(n^2)
+    static constexpr double   CHECK_TOL     = 1e-4;
+
+    static constexpr std::array<uint32_t, 5> SCALE_CNTS = {65536, 131072, 262144, 524288, 1048576};
+
+
+    /* 一次基准测试的结果 */
+    struct Bench
+    {
+        uint32_t                                particle_cnt = 0;
+        double                                  step_ms      = 0.;
+        std::array<double, SphSolver::PASS_CNT> pass_ms{};
+    };
+
+
+    Options                                 _options;
+    std::unique_ptr<Hiss::PipelineRegistry> _pipelines;
+    std::unique_ptr<SphSolver>              _solver;
+
+    vk::CommandPool _command_pool;             // compute queue 上一次性提交的 command buffer
+    vk::QueryPool   _query_pool;               // 不支持 timestamp 时为空
+    double          _timestamp_period = 1.;    // 一个 tick 的 ns 数
+
+
+    /* 录制 step_cnt 步，每 BATCH_STEPS 步提交一次，返回总的时间（ms） */
+    double steps_run(uint32_t step_cnt);
+
+    /* 按照质点数量创建场景，上传初始状态 */
+    void scene_create(uint32_t cnt);
+
+    /* 输出平均密度和最大速度；出现 NaN 或者质点离开容器时抛出异常 */
+    void state_report(uint64_t step);
+
+    void check();
+    Bench bench(uint32_t cnt, uint32_t step_cnt);
+    void  simulate();
+};
@@ -0,0 +1,212 @@
+#include "sph_solver.hpp"
+#include <bit>
+#include <cmath>
+#include <glm/gtc/constants.hpp>
+
+
+SphSolver::SphSolver(Hiss::Device &device, Hiss::PipelineRegistry &pipelines,
+                     Hiss::DescriptorLayoutCache &layout_cache, Hiss::DescriptorAllocator &allocator)
+    : _device(device),
+      _pipelines(pipelines),
+      _primitives(device, pipelines, layout_cache)
+{
+    vk::Device d = _device.handle_get();
+
+
+    /**
+     * binding 的编号和 sph_common.glsl 一致：0: particles, 1: ubo, 2: sorted, 3: keys, 4: ranks,
+     * 5: cell count, 6: cell start, 7: (density, pressure), 8: accel
+     */
+    std::vector<vk::DescriptorSetLayoutBinding> bindings;
+    for (uint32_t i = 0; i <= 8; ++i)
+        bindings.push_back(vk::DescriptorSetLayoutBinding{
+                .binding         = i,
+                .descriptorType  = i == 1 ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer,
+                .descriptorCount = 1,
+                .stageFlags      = vk::ShaderStageFlagBits::eCompute,
+        });
+    _set_layout      = layout_cache.get(bindings);
+    _pipeline_layout = d.createPipelineLayout(vk::PipelineLayoutCreateInfo{
+            .setLayoutCount = 1,
+            .pSetLayouts    = &_set_layout,
+    });
+    _set             = allocator.allocate(_set_layout);
+
+
+    auto shader = [](const std::string &path) {
+        Hiss::ShaderDesc desc{.stage = vk::ShaderStageFlagBits::eCompute, .path = path};
+        desc.spec_add(0, WORKGROUP_SIZE);
+        return desc;
+    };
+    _shader_hash      = shader(SHADER("compute_SPH/sph_hash.comp.spv"));
+    _shader_scatter   = shader(SHADER("compute_SPH/sph_scatter.comp.spv"));
+    _shader_density   = shader(SHADER("compute_SPH/sph_density.comp.spv"));
+    _shader_force     = shader(SHADER("compute_SPH/sph_force.comp.spv"));
+    _shader_integrate = shader(SHADER("compute_SPH/sph_integrate.comp.spv"));
+}
+
+
+SphSolver::~SphSolver()
+{
+    _device.handle_get().destroy(_pipeline_layout);
+}
+
+
+void SphSolver::buffers_free()
+{
+    for (Hiss::Buffer *b: {&_ubo, &_particles, &_sorted, &_keys, &_ranks, &_cell_count, &_cell_start, &_fluid, &_accel})
+        b->reset();
+    _memory_size = 0;
+}
+
+
+void SphSolver::resize(const Params &params)
+{
+    if (params.particle_cnt == 0 || params.h <= 0.f)
+        throw std::runtime_error("sph solver: particle count and smoothing length must be positive.");
+
+    vk::Device d = _device.handle_get();
+    buffers_free();
+
+
+    /* bucket 的数量是不小于 2n 的 2 的幂，大部分 bucket 中只有一个 cell */
+    _bucket_cnt = std::bit_ceil(2 * params.particle_cnt);
+    _block_cnt  = (params.particle_cnt + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE;
+
+    float pi          = glm::pi<float>();
+    _params           = params;
+    _params.poly6     = 315.f / (64.f * pi * std::pow(params.h, 9.f));
+    _params.spiky     = 45.f / (pi * std::pow(params.h, 6.f));
+    _params.hash_mask = _bucket_cnt - 1;
+
+    _primitives.descriptors_reset();
+    _primitives.reserve(_bucket_cnt);
+
+
+    _ubo = Hiss::Buffer(_device, sizeof(Params), vk::BufferUsageFlagBits::eUniformBuffer,
+                        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+    _ubo.write(&_params, sizeof(Params));
+
+    auto create = [this](Hiss::Buffer &b, vk::DeviceSize size, vk::BufferUsageFlags usage = {}) {
+        b = Hiss::Buffer(_device, size, vk::BufferUsageFlagBits::eStorageBuffer | usage,
+                         vk::MemoryPropertyFlagBits::eDeviceLocal);
+        _memory_size += size;
+    };
+    uint32_t n = params.particle_cnt;
+    create(_particles, sizeof(Particle) * n,
+           vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst);
+    create(_sorted, sizeof(Particle) * n, vk::BufferUsageFlagBits::eTransferSrc);
+    create(_keys, sizeof(uint32_t) * n);
+    create(_ranks, sizeof(uint32_t) * n);
+    create(_cell_count, sizeof(uint32_t) * _bucket_cnt, vk::BufferUsageFlagBits::eTransferDst);
+    create(_cell_start, sizeof(uint32_t) * _bucket_cnt);
+    create(_fluid, sizeof(glm::vec2) * n, vk::BufferUsageFlagBits::eTransferSrc);
+    create(_accel, sizeof(glm::vec4) * n);
+
+
+    /* 下标就是 binding 的编号 */
+    std::array<vk::Buffer, 9> buffers = {
+            _particles.handle_get(),
+            _ubo.handle_get(),
+            _sorted.handle_get(),
+            _keys.handle_get(),
+            _ranks.handle_get(),
+            _cell_count.handle_get(),
+            _cell_start.handle_get(),
+            _fluid.handle_get(),
+            _accel.handle_get(),
+    };
+    std::array<vk::DescriptorBufferInfo, 9> infos;
+    std::array<vk::WriteDescriptorSet, 9>   writes;
+    for (uint32_t i = 0; i < buffers.size(); ++i)
+    {
+        infos[i]  = {buffers[i], 0, VK_WHOLE_SIZE};
+        writes[i] = vk::WriteDescriptorSet{
+                .dstSet          = _set,
+                .dstBinding      = i,
+                .descriptorCount = 1,
+                .descriptorType  = i == 1 ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer,
+                .pBufferInfo     = &infos[i],
+        };
+    }
+    d.updateDescriptorSets(writes, {});
+}
+
+
+void SphSolver::dispatch(vk::CommandBuffer cmd, const Hiss::ShaderDesc &shader)
+{
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute,
+                     _pipelines.get(Hiss::PipelineDesc::compute(shader, _pipeline_layout)));
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, _pipeline_layout, 0, {_set}, nullptr);
+    cmd.dispatch(_block_cnt, 1, 1);
+
+    vk::MemoryBarrier2 barrier = {
+            .srcStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .srcAccessMask = vk::AccessFlagBits2::eShaderWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .dstAccessMask = vk::AccessFlagBits2::eShaderRead | vk::AccessFlagBits2::eShaderWrite,
+    };
+    cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &barrier});
+}
+
+
+void SphSolver::record(vk::CommandBuffer cmd, vk::QueryPool query_pool, uint32_t query_base)
+{
+    auto timestamp = [&](uint32_t pass) {
+        if (query_pool)
+            cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, query_pool, query_base + pass);
+    };
+    if (query_pool)
+        cmd.resetQueryPool(query_pool, query_base, PASS_CNT + 1);
+
+
+    /* 上一步的 integrate，以及调用者对质点的复制，都需要在这一步之前完成；清空计数之前等待上一步的读取 */
+    vk::MemoryBarrier2 step_barrier = {
+            .srcStageMask  = vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eTransfer,
+            .srcAccessMask = vk::AccessFlagBits2::eShaderWrite | vk::AccessFlagBits2::eTransferWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eTransfer,
+            .dstAccessMask = vk::AccessFlagBits2::eShaderRead | vk::AccessFlagBits2::eShaderWrite
+                           | vk::AccessFlagBits2::eTransferWrite,
+    };
+    cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &step_barrier});
+    timestamp(0);
+
+
+    /* 1st pass: counting sort 重建网格 */
+    cmd.fillBuffer(_cell_count.handle_get(), 0, VK_WHOLE_SIZE, 0u);
+    vk::MemoryBarrier2 fill_barrier = {
+            .srcStageMask  = vk::PipelineStageFlagBits2::eTransfer,
+            .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .dstAccessMask = vk::AccessFlagBits2::eShaderRead | vk::AccessFlagBits2::eShaderWrite,
+    };
+    cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &fill_barrier});
+
+    dispatch(cmd, _shader_hash);
+    _primitives.scan_record(cmd, _cell_count.handle_get(), _cell_start.handle_get(), _bucket_cnt);
+    dispatch(cmd, _shader_scatter);
+    timestamp(1);
+
+
+    /* 2nd pass: 密度和压强 */
+    dispatch(cmd, _shader_density);
+    timestamp(2);
+
+
+    /* 3rd pass: 压强和粘性的加速度 */
+    dispatch(cmd, _shader_force);
+    timestamp(3);
+
+
+    /* 4th pass: 积分，写回状态 */
+    dispatch(cmd, _shader_integrate);
+    timestamp(4);
+
+    vk::MemoryBarrier2 copy_barrier = {
+            .srcStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .srcAccessMask = vk::AccessFlagBits2::eShaderWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eTransfer,
+            .dstAccessMask = vk::AccessFlagBits2::eTransferRead,
+    };
+    cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &copy_barrier});
+}
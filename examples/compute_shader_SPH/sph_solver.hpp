@@ -0,0 +1,119 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <device.hpp>
+#include <pipeline.hpp>
+#include <descriptor.hpp>
+#include <gpu_primitives.hpp>
+#include "profile.hpp"
+
+
+/**
+ * GPU 上的 SPH（smoothed-particle hydrodynamics）求解器，每一步的复杂度为 O(n)
+ *
+ * 每一步：
+ *  1. grid：清空 bucket 的计数 -> hash -> scan（GpuPrimitives）-> scatter，用 counting sort 重建空间哈希网格
+ *  2. density：poly6 估计密度，状态方程得到压强
+ *  3. force：压强梯度和粘性的加速度，加上重力
+ *  4. integrate：半隐式 Euler 和容器壁的碰撞，按照排序之后的顺序写回状态
+ * density 和 force 只访问周围 27 个 cell，邻居的数量和质点总数无关
+ * 需要在 compute queue 上执行；设备不支持 GpuPrimitives 需要的 subgroup 操作时构造函数抛出异常
+ */
+class SphSolver
+{
+public:
+    static constexpr uint32_t WORKGROUP_SIZE = 256;
+
+    /* 每一步的 pass，用于分段计时 */
+    static constexpr uint32_t                   PASS_CNT   = 4;
+    static constexpr std::array<const char *, 4> PASS_NAMES = {"grid", "density", "force", "integrate"};
+
+
+    struct Particle
+    {
+        glm::vec4 pos;    // xyz: position, w: 上一步的密度
+        glm::vec4 vel;    // xyz: velocity
+    };
+
+    /* 和 sph_common.glsl 中的 UBO 一致（std140） */
+    struct Params
+    {
+        glm::vec4 box;
+        glm::vec4 gravity;
+        float     h;
+        float     mass;
+        float     rest_density;
+        float     stiffness;
+        float     viscosity;
+        float     delta_time;
+        float     wall_damping;
+        float     poly6;
+        float     spiky;
+        uint32_t  particle_cnt;
+        uint32_t  hash_mask;
+    };
+
+
+    SphSolver(Hiss::Device &device, Hiss::PipelineRegistry &pipelines, Hiss::DescriptorLayoutCache &layout_cache,
+              Hiss::DescriptorAllocator &allocator);
+    ~SphSolver();
+    SphSolver(const SphSolver &)            = delete;
+    SphSolver &operator=(const SphSolver &) = delete;
+
+
+    /**
+     * 按照质点数量重新分配 buffer，写入参数；poly6，spiky，particle_cnt 和 hash_mask 由这里计算
+     * 初始状态由调用者复制到 particle_buffer() 中；调用者需要保证 device 已经空闲
+     */
+    void resize(const Params &params);
+
+    /**
+     * 录制一步的所有 pass，开始时等待上一步以及之前对质点的读写，结束时质点对之后的 compute shader 和 transfer 可见
+     * query_pool 不为空时，在每个 pass 的边界写入 timestamp，占用 [query_base, query_base + PASS_CNT] 的 query
+     */
+    void record(vk::CommandBuffer cmd, vk::QueryPool query_pool = {}, uint32_t query_base = 0);
+
+    [[nodiscard]] const Params &params() const { return _params; }
+
+    /* 模拟的状态，需要 transfer 时使用 */
+    [[nodiscard]] vk::Buffer particle_buffer() const { return _particles.handle_get(); }
+
+    /* 最后一步中排序之后的质点，以及对应的 (density, pressure)，用于校验 */
+    [[nodiscard]] vk::Buffer sorted_buffer() const { return _sorted.handle_get(); }
+    [[nodiscard]] vk::Buffer fluid_buffer() const { return _fluid.handle_get(); }
+
+    [[nodiscard]] vk::DeviceSize memory_size() const { return _memory_size + _primitives.memory_size(); }
+
+
+private:
+    Hiss::Device           &_device;
+    Hiss::PipelineRegistry &_pipelines;
+    Hiss::GpuPrimitives     _primitives;
+    vk::DescriptorSetLayout _set_layout;
+    vk::PipelineLayout      _pipeline_layout;
+    vk::DescriptorSet       _set;
+
+    Hiss::ShaderDesc _shader_hash;
+    Hiss::ShaderDesc _shader_scatter;
+    Hiss::ShaderDesc _shader_density;
+    Hiss::ShaderDesc _shader_force;
+    Hiss::ShaderDesc _shader_integrate;
+
+    Params         _params{};
+    uint32_t       _block_cnt   = 0;
+    uint32_t       _bucket_cnt  = 0;
+    vk::DeviceSize _memory_size = 0;
+    Hiss::Buffer   _ubo;
+    Hiss::Buffer   _particles;
+    Hiss::Buffer   _sorted;
+    Hiss::Buffer   _keys;
+    Hiss::Buffer   _ranks;
+    Hiss::Buffer   _cell_count;
+    Hiss::Buffer   _cell_start;
+    Hiss::Buffer   _fluid;
+    Hiss::Buffer   _accel;
+
+
+    void buffers_free();
+    void dispatch(vk::CommandBuffer cmd, const Hiss::ShaderDesc &shader);
+};
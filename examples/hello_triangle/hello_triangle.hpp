@@ -4,7 +4,12 @@
 #include <map>
 #include <memory>
 #include <limits>
+#include <cmath>
+#include <chrono>
+#include <functional>
 #include <cassert>
+#include <numeric>
+#include <optional>
 #include <sstream>
 #include <algorithm>
 
@@ -19,6 +24,17 @@
 #include <texture.hpp>
 #include <swapchain.hpp>
 #include <render_pass.hpp>
+#include <pipeline.hpp>
+#include <bindless.hpp>
+#include <cmd_recorder.hpp>
+#include <gpu_culling.hpp>
+#include <gpu_timer.hpp>
+#include <bvh.hpp>
+#include <pipeline_stat.hpp>
+#include <render_scale.hpp>
+#include <fxaa.hpp>
+#include <present_policy.hpp>
+#include <redraw.hpp>
 #include <framebuffer.hpp>
 
 
@@ -26,6 +42,26 @@
 const uint32_t WIDTH  = 800;
 const uint32_t HEIGHT = 600;
 
+// 相机的参数，LOD 的选择也依赖于这些参数
+const glm::vec3 CAMERA_EYE   = glm::vec3(2.f, 2.f, 2.f);
+const float     CAMERA_FOV_Y = glm::radians(45.f);
+
+// 场景的配置：是否使用 depth pre-pass，运行时可以按 P 切换
+// 开启 MSAA 时 overdraw 的代价很高，因此默认开启
+const bool DEPTH_PREPASS = true;
+
+// 动态分辨率希望保持的 GPU 帧耗时，单位是 ms，运行时按 D 开关动态分辨率
+const double TARGET_GPU_MS = 8.0;
+
+// 默认的抗锯齿设置，是 Application::AA_MODES 中的下标，运行时按 A 切换
+const uint32_t AA_MODE = 3;
+
+// 默认的呈现策略：0 默认（FIFO），1 低延迟，2 省电；运行时按 M 切换预设，按 V 切换 present mode
+const uint32_t PRESENT_POLICY = 0;
+
+// 是否按需渲染：场景没有变化时不绘制，阻塞等待窗口事件，运行时按 O 切换
+const bool RENDER_ON_DEMAND = false;
+
 
 //
 std::vector<uint32_t> indices = {
@@ -63,9 +99,53 @@ public:
         // main loop
         while (!glfwWindowShouldClose(WindowStatic::window_get()))
         {
-            glfwPollEvents();
+            /* 按需渲染并且没有需要更新的内容时，阻塞等待窗口事件，而不是轮询 */
+            if (_redraw.idle())
+                _redraw.idle_wait();
+            else
+                glfwPollEvents();
             if (glfwGetKey(WindowStatic::window_get(), GLFW_KEY_ESCAPE) == GLFW_PRESS)
                 glfwSetWindowShouldClose(WindowStatic::window_get(), true);
+
+            /* 按 L 切换 LOD 设置：自动选择 -> 固定为 level 0 -> level 1 -> ... */
+            if (key_pressed(GLFW_KEY_L, _lod_key_down))
+                lod_setting_switch();
+
+            /* 按 I 切换实例的数量，按 R 切换录制 command buffer 的线程数 */
+            if (key_pressed(GLFW_KEY_I, _instance_key_down))
+                instance_cnt_switch();
+            if (key_pressed(GLFW_KEY_R, _record_key_down))
+                record_threads_switch();
+
+            /* 按 G 切换 GPU driven 的绘制，按 N 切换 instancing：一次 draw 绘制所有的实例 */
+            if (key_pressed(GLFW_KEY_G, _gpu_key_down))
+                gpu_driven_switch();
+            if (key_pressed(GLFW_KEY_N, _instanced_key_down))
+                instanced_switch();
+
+            /* 按 C 切换 CPU 视锥剔除，按 P 切换 depth pre-pass */
+            if (key_pressed(GLFW_KEY_C, _cpu_cull_key_down))
+                cpu_cull_switch();
+            if (key_pressed(GLFW_KEY_P, _prepass_key_down))
+                depth_prepass_switch();
+
+            /* 按 D 切换动态分辨率，按 A 切换抗锯齿的设置 */
+            if (key_pressed(GLFW_KEY_D, _dynamic_key_down))
+                dynamic_resolution_switch();
+            if (key_pressed(GLFW_KEY_A, _aa_key_down))
+                aa_mode_switch();
+
+            /* 按 M 切换呈现策略的预设，按 V 切换 present mode */
+            if (key_pressed(GLFW_KEY_M, _policy_key_down))
+                present_policy_switch();
+            if (key_pressed(GLFW_KEY_V, _present_mode_key_down))
+                present_mode_switch();
+
+            /* 按 O 切换按需渲染 */
+            if (key_pressed(GLFW_KEY_O, _redraw_key_down))
+                on_demand_switch();
+
+            redraw_check();
             draw();
         }
 
@@ -85,13 +165,15 @@ private:
     vk::Instance _instance;
     std::shared_ptr<Swapchain> _swapchain;
     std::shared_ptr<MSAAFramebuffer> _framebuffer;
+    std::shared_ptr<ScaledFramebuffer> _scaled_framebuffer;    // 离屏渲染（动态分辨率或者 FXAA）时代替 _framebuffer
 
     /* 控制 GPU 最多可以同时处理多少 frames */
     std::shared_ptr<FramesInflight<MAX_FRAMES_INFLIGHT>> _inflight;
 
 
     vk::RenderPass _render_pass;
-    vk::Pipeline _graphics_pipeline;
+    std::shared_ptr<Hiss::ShaderLibrary> _shader_library;
+    std::unique_ptr<Hiss::PipelineRegistry> _pipelines;
     vk::PipelineLayout _pipeline_layout;
     vk::DescriptorSetLayout _descriptor_set_layout;
 
@@ -100,14 +182,189 @@ private:
     vk::DeviceMemory _vertex_memory;
     vk::Buffer _index_buffer;
     vk::DeviceMemory _index_memory;
-    vk::DescriptorPool _descriptor_pool;
+    std::unique_ptr<Hiss::DescriptorLayoutCache> _descriptor_layout_cache;
+    std::unique_ptr<Hiss::DescriptorAllocator>   _descriptor_allocator;
     std::vector<vk::DescriptorSet> _descriptor_sets;
 
 
+    /**
+     * bindless 模式：device 支持 descriptor indexing 时开启
+     * 所有材质的 texture 都在同一个 set 中，每个 draw 只需要 push 材质的下标
+     */
+    static constexpr uint32_t            BINDLESS_MAX_TEXTURES = 1024;
+    static constexpr uint32_t            BINDLESS_MAX_SAMPLERS = 16;
+    std::unique_ptr<Hiss::BindlessTable> _bindless;
+    std::vector<Hiss::MaterialIndex>     _materials;
+
+
     TestModel model;
     Texture _tex;
 
 
+    /* 场景中模型的实例，每个实例单独选择 LOD */
+    std::vector<ModelInstance> _instances = {ModelInstance{}};
+
+    /* 为空表示根据屏幕空间误差自动选择 LOD，否则所有实例都使用指定的 LOD */
+    std::optional<uint32_t> _lod_force;
+    bool                    _lod_key_down = false;
+
+    /* 按 I 切换的实例数量，用于测试大量 draw call 时 command buffer 的录制开销 */
+    static constexpr std::array<uint32_t, 4> INSTANCE_CNTS = {1, 1024, 16384, 100000};
+    uint32_t                                 _instance_cnt_idx  = 0;
+    bool                                     _instance_key_down = false;
+
+
+    /**
+     * 多线程录制：每个 worker 将 draw list 的一段录制到自己的 secondary command buffer 中，
+     * 再由 primary command buffer 按顺序 execute
+     * _record_threads 为 0 表示单线程，直接在 primary command buffer 中 inline 录制
+     */
+    std::unique_ptr<Hiss::ThreadPool>  _thread_pool;
+    std::unique_ptr<Hiss::CmdRecorder> _recorder;
+    uint32_t                           _record_threads  = 0;
+    bool                               _record_key_down = false;
+
+
+    /**
+     * GPU driven 模式：device 支持 draw indirect count 时可以开启
+     * compute shader 剔除实例并选择 LOD，每个 LOD 只需要一次 drawIndexedIndirectCount
+     */
+    std::unique_ptr<Hiss::GpuCulling> _culling;
+    vk::PipelineLayout                _instanced_pipeline_layout;    // set 0，1 和普通模式相同，set 2 是实例数据
+    bool                              _gpu_driven   = false;
+    bool                              _gpu_key_down = false;
+
+
+    /**
+     * instancing 模式：实例数据放在 input rate 为 instance 的 vertex buffer 中，
+     * 所有实例使用同一个 LOD，只需要一次 drawIndexed；逐个实例录制时通过 firstInstance 读取同一个 buffer
+     */
+    vk::Buffer       _instance_buffer;
+    vk::DeviceMemory _instance_memory;
+    bool             _instanced          = false;
+    bool             _instanced_key_down = false;
+
+
+    /**
+     * CPU 视锥剔除：实例的包围球以 SoA 的形式存放，BVH 在实例数量改变时重新构建，之后每帧 refit
+     * 剔除的结果 _draw_list 就是这一帧需要录制的实例；关闭剔除时 _draw_list 包含所有实例
+     */
+    Hiss::BoundsSoA       _cull_bounds;
+    Hiss::Bvh             _bvh;
+    std::vector<uint32_t> _draw_list;
+    bool                  _cpu_cull          = false;
+    bool                  _cpu_cull_key_down = false;
+
+
+    /**
+     * depth pre-pass：先用只有 position 的 pipeline 写入 depth，主 pass 使用 eEqual 比较且不写入 depth
+     * 用 pipeline statistics query 统计 fragment shader 的调用次数，比较开启前后的 overdraw
+     */
+    bool                                     _depth_prepass    = DEPTH_PREPASS;
+    bool                                     _prepass_key_down = false;
+    std::unique_ptr<Hiss::PipelineStatQuery> _pipeline_stat;
+
+
+    /**
+     * 动态分辨率：先渲染到按 scale 缩小的区域，再 blit 到 swapchain 的 image 上
+     * scale 由 GPU 的帧耗时决定；_render_extent 是这一帧实际的渲染分辨率
+     */
+    Hiss::RenderScale _render_scale{{.target_ms = TARGET_GPU_MS}};
+    vk::Extent2D      _render_extent;
+    bool              _dynamic_resolution = false;
+    bool              _dynamic_key_down   = false;
+
+
+    /**
+     * 抗锯齿的设置：MSAA 的采样数，是否开启 sample shading（每个 sample 都执行一次 fragment shader），
+     * 以及是否在 resolve 之后做 FXAA；FXAA 需要离屏渲染，结果再 blit 到 swapchain 的 image 上
+     * 切换时只标记 _render_target_dirty，下一帧开始时才重新创建 render pass 和 framebuffer，
+     * pipeline 在第一次使用时由 registry 创建
+     */
+    struct AaMode
+    {
+        const char             *name;
+        vk::SampleCountFlagBits samples;
+        bool                    sample_shading;
+        bool                    fxaa;
+    };
+    static constexpr std::array<AaMode, 8> AA_MODES = {{
+            {"off", vk::SampleCountFlagBits::e1, false, false},
+            {"fxaa", vk::SampleCountFlagBits::e1, false, true},
+            {"msaa 2x", vk::SampleCountFlagBits::e2, false, false},
+            {"msaa 4x", vk::SampleCountFlagBits::e4, false, false},
+            {"msaa 8x", vk::SampleCountFlagBits::e8, false, false},
+            {"msaa 4x + sample shading", vk::SampleCountFlagBits::e4, true, false},
+            {"msaa 8x + sample shading", vk::SampleCountFlagBits::e8, true, false},
+            {"msaa 2x + fxaa", vk::SampleCountFlagBits::e2, false, true},
+    }};
+    uint32_t                    _aa_mode_idx         = 0;
+    bool                        _aa_key_down         = false;
+    bool                        _render_target_dirty = false;
+    vk::DeviceSize              _attachment_memory   = 0;    // 当前设置下 attachment 占用的显存
+    std::unique_ptr<Hiss::Fxaa> _fxaa;
+
+
+    /**
+     * 呈现策略：present mode，swapchain 中 image 的数量，帧率上限，以及是否 late latching
+     * 切换时只标记 _swapchain_dirty，下一帧开始时重新创建 swapchain
+     * 输入是鼠标的横坐标，叠加在模型的旋转上；每一帧的 _frame_id 同时作为 present id，用于测量输入到呈现的延迟
+     */
+    static constexpr std::array<vk::PresentModeKHR, 4> PRESENT_MODES = {
+            vk::PresentModeKHR::eFifo,
+            vk::PresentModeKHR::eFifoRelaxed,
+            vk::PresentModeKHR::eMailbox,
+            vk::PresentModeKHR::eImmediate,
+    };
+    uint32_t             _present_policy_idx    = 0;
+    Hiss::PresentPolicy  _present_policy;
+    Hiss::FrameLimiter   _frame_limiter;
+    Hiss::PresentLatency _latency;
+    uint64_t             _frame_id              = 0;
+    bool                 _swapchain_dirty       = false;
+    bool                 _policy_key_down       = false;
+    bool                 _present_mode_key_down = false;
+
+
+    /**
+     * 按需渲染：场景的状态改变时才绘制；窗口需要刷新时，将离屏渲染保留的上一帧重新 blit 到 swapchain 的 image 上
+     * 动画只在持续渲染时推进，_anim_time 是动画经过的时间，单位是秒
+     */
+    Hiss::RedrawTracker                   _redraw{{.wait_timeout = .5}};
+    bool                                  _represent_supported = false;    // 是否可以重新呈现上一帧
+    double                                _cursor_x            = 0.;
+    float                                 _anim_time           = 0.f;
+    std::chrono::steady_clock::time_point _anim_last           = std::chrono::steady_clock::now();
+    bool                                  _redraw_key_down     = false;
+
+
+    /* 测量 render pass 在 GPU 上的耗时 */
+    enum GpuScope : uint32_t
+    {
+        GPU_SCOPE_FRAME = 0,
+        GPU_SCOPE_CNT,
+    };
+    std::unique_ptr<Hiss::GpuTimer> _gpu_timer;
+
+
+    /* 统计每帧提交的三角形数量，录制 command buffer 的耗时，GPU 剔除之后的可见实例数量，以及 GPU 耗时 */
+    struct
+    {
+        uint64_t                                       triangles   = 0;
+        uint32_t                                       frames      = 0;
+        std::chrono::duration<double, std::milli>      record_time = {};
+        std::chrono::duration<double, std::milli>      cull_time   = {};
+        uint64_t                                       visible     = 0;
+        uint64_t                                       total       = 0;
+        uint32_t                                       cull_frames = 0;
+        double                                         gpu_time    = 0.;    // ms
+        uint32_t                                       gpu_frames  = 0;
+        uint64_t                                       fragments   = 0;     // fragment shader 的调用次数
+        uint32_t                                       stat_frames = 0;
+        std::chrono::high_resolution_clock::time_point last_report = std::chrono::high_resolution_clock::now();
+    } _lod_stat;
+
+
     FramebufferLayout_temp _framebuffer_layout;
 
 
@@ -124,9 +381,14 @@ private:
 
         /* device 相关 */
         Hiss::Env::init_once(_instance);
-        auto env   = Hiss::Env::env();
-        _inflight  = FramesInflight<MAX_FRAMES_INFLIGHT>::create();
-        _swapchain = Swapchain::create();
+        auto env            = Hiss::Env::env();
+        _inflight           = FramesInflight<MAX_FRAMES_INFLIGHT>::create();
+        _present_policy_idx = PRESENT_POLICY % PRESENT_POLICY_CNT;
+        _present_policy     = present_policy_preset(_present_policy_idx);
+        _swapchain          = Swapchain::create(_present_policy);
+        _frame_limiter.fps_set(_present_policy.fps_limit);
+        if (!env->present_wait)
+            LogStatic::logger()->warn("[latency] VK_KHR_present_wait is not supported, input->present is unavailable.");
 
 
         /* framebuffer 的各个 attachment 的格式 */
@@ -141,23 +403,45 @@ private:
             throw std::runtime_error("failed to find supported format.");
         _framebuffer_layout = FramebufferLayout_temp{
                 .color_format   = env->present_format.format,
-                .color_sample   = env->max_sample_cnt(),
                 .depth_format   = depth_format.value(),
-                .depth_sample   = env->max_sample_cnt(),
                 .resolve_format = _swapchain->format(),
                 .resolve_sample = vk::SampleCountFlagBits::e1,
         };
+        _aa_mode_idx         = aa_mode_supported(AA_MODES[AA_MODE]) ? AA_MODE : 0;
+        _represent_supported = present_blit_supported(false);
+        _redraw.enable(RENDER_ON_DEMAND);
+        framebuffer_layout_update();
 
 
         /* render pass 和 pipeline */
-        _descriptor_set_layout = descriptor_set_layout_create();
-        _pipeline_layout       = pipeline_layout_create({_descriptor_set_layout});
-        _render_pass           = render_pass_create(_framebuffer_layout);
-        _graphics_pipeline     = pipeline_create(_pipeline_layout, _render_pass);
+        _descriptor_layout_cache = std::make_unique<Hiss::DescriptorLayoutCache>(env->device);
+        _descriptor_allocator    = std::make_unique<Hiss::DescriptorAllocator>(env->device);
+        _descriptor_set_layout   = descriptor_set_layout_create(*_descriptor_layout_cache);
+        if (env->bindless)
+        {
+            const auto &limits = env->info->descriptor_indexing_props;
+            uint32_t    texture_cnt =
+                    std::min({BINDLESS_MAX_TEXTURES, limits.maxDescriptorSetUpdateAfterBindSampledImages,
+                              limits.maxPerStageDescriptorUpdateAfterBindSampledImages});
+            _bindless = std::make_unique<Hiss::BindlessTable>(env->device, *_descriptor_layout_cache, texture_cnt,
+                                                              BINDLESS_MAX_SAMPLERS);
+            _pipeline_layout = pipeline_layout_create({_descriptor_set_layout, _bindless->layout()},
+                                                      {vk::PushConstantRange{
+                                                              .stageFlags = vk::ShaderStageFlagBits::eFragment,
+                                                              .offset     = 0,
+                                                              .size       = sizeof(Hiss::MaterialIndex),
+                                                      }});
+        }
+        else
+            _pipeline_layout = pipeline_layout_create({_descriptor_set_layout});
+        _render_pass             = render_pass_create(_framebuffer_layout, _depth_prepass);
+        _shader_library          = std::make_shared<Hiss::ShaderLibrary>(env->device);
+        _pipelines               = std::make_unique<Hiss::PipelineRegistry>(env->device, _shader_library);
+        _fxaa                    = std::make_unique<Hiss::Fxaa>(*_pipelines, *_descriptor_layout_cache,
+                                                                *_descriptor_allocator);
 
 
-        _framebuffer = MSAAFramebuffer::create(_render_pass, _framebuffer_layout,
-                                               _swapchain->img_views(), env->present_extent);
+        framebuffer_create();
 
 
         /* 绘制的对象相关 */
@@ -165,13 +449,54 @@ private:
         index_buffer_create(indices, _index_buffer, _index_memory);
         _tex = Texture::load(TEXTURE("viking_room.png"), vk::Format::eR8G8B8A8Srgb,
                              vk::ImageAspectFlagBits::eColor);
+        if (_bindless)
+            _materials.push_back(Hiss::MaterialIndex{
+                    .texture = _bindless->texture_register(_tex.img_view()),
+                    .sampler = _bindless->sampler_register(_tex.sampler()),
+            });
 
-        _descriptor_pool = create_descriptor_pool(MAX_FRAMES_INFLIGHT);
-        _descriptor_sets = create_descriptor_set(_descriptor_set_layout, _descriptor_pool,
+        _descriptor_sets = create_descriptor_set(_descriptor_set_layout, *_descriptor_allocator,
                                                  MAX_FRAMES_INFLIGHT, _inflight->uniform_buffers(),
                                                  _tex.img_view(), _tex.sampler());
 
+
+        /* secondary command buffer 和 primary command buffer 提交到同一个 queue */
+        _thread_pool = std::make_unique<Hiss::ThreadPool>();
+        _recorder    = std::make_unique<Hiss::CmdRecorder>(env->device, env->graphics_cmd_pool.commit_queue.family_idx,
+                                                           MAX_FRAMES_INFLIGHT, *_thread_pool);
+
         model.model_load();
+        instance_buffer_update();
+        _gpu_timer = std::make_unique<Hiss::GpuTimer>(MAX_FRAMES_INFLIGHT, GPU_SCOPE_CNT);
+        _pipeline_stat = std::make_unique<Hiss::PipelineStatQuery>(
+                MAX_FRAMES_INFLIGHT, vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations);
+
+
+        /* GPU 剔除需要模型的 LOD 信息和实例数据，因此在模型加载之后创建 */
+        if (env->gpu_driven)
+        {
+            _culling = std::make_unique<Hiss::GpuCulling>(*_pipelines, *_descriptor_layout_cache,
+                                                          *_descriptor_allocator, MAX_FRAMES_INFLIGHT);
+
+            /* set 0 和 set 1 和普通模式相同，没有 bindless 时 set 1 是空的 layout；set 2 是实例数据 */
+            if (_bindless)
+                _instanced_pipeline_layout = pipeline_layout_create(
+                        {_descriptor_set_layout, _bindless->layout(), _culling->instance_layout()},
+                        {vk::PushConstantRange{
+                                .stageFlags = vk::ShaderStageFlagBits::eFragment,
+                                .offset     = 0,
+                                .size       = sizeof(Hiss::MaterialIndex),
+                        }});
+            else
+                _instanced_pipeline_layout = pipeline_layout_create(
+                        {_descriptor_set_layout, _descriptor_layout_cache->get({}), _culling->instance_layout()});
+
+            std::vector<Hiss::GpuCulling::Lod> lods;
+            for (uint32_t i = 0; i < std::min(model.lod_cnt(), Hiss::GpuCulling::MAX_LODS); ++i)
+                lods.push_back(Hiss::GpuCulling::Lod{.index_cnt = model.index_cnt(i), .error = model.lod_error(i)});
+            _culling->lods_set(lods);
+            culling_instances_upload();
+        }
     }
 
 
@@ -180,7 +505,13 @@ private:
         vk::Device temp_device = Hiss::Env::env()->device;
 
 
-        _inflight = nullptr;
+        _inflight    = nullptr;
+        _recorder    = nullptr;
+        _thread_pool = nullptr;
+        _culling     = nullptr;
+        _fxaa        = nullptr;
+        _gpu_timer     = nullptr;
+        _pipeline_stat = nullptr;
 
 
         // 各种 buffer
@@ -188,21 +519,28 @@ private:
         temp_device.free(_vertex_memory);
         temp_device.destroyBuffer(_index_buffer);
         temp_device.free(_index_memory);
+        temp_device.destroyBuffer(_instance_buffer);
+        temp_device.free(_instance_memory);
         _tex.free();
-        temp_device.destroyDescriptorPool(_descriptor_pool);
+        _descriptor_allocator = nullptr;
 
         model.resource_free();
 
 
         // render pass
         temp_device.destroyRenderPass(_render_pass);
-        temp_device.destroyPipeline(_graphics_pipeline);
+        _pipelines      = nullptr;
+        _shader_library = nullptr;
         temp_device.destroyPipelineLayout(_pipeline_layout);
-        temp_device.destroyDescriptorSetLayout(_descriptor_set_layout);
+        if (_instanced_pipeline_layout)
+            temp_device.destroyPipelineLayout(_instanced_pipeline_layout);
+        _bindless                = nullptr;
+        _descriptor_layout_cache = nullptr;
 
 
         // swapchain
-        _framebuffer = nullptr;
+        _framebuffer        = nullptr;
+        _scaled_framebuffer = nullptr;
         _swapchain   = nullptr;
 
 
@@ -218,11 +556,34 @@ private:
         auto env = Hiss::Env::env();
 
 
+        /* 按需渲染：场景没有变化时不绘制；重新创建 render target 之后上一帧的结果已经丢失，不能只重新呈现 */
+        auto action = _redraw.frame_begin();
+        if (action == Hiss::RedrawTracker::Action::IDLE)
+            return;
+        if (_render_target_dirty || _swapchain_dirty)
+            action = Hiss::RedrawTracker::Action::DRAW;
+
+
+        /* 上一帧之后切换了 render pass 或者呈现相关的设置 */
+        if (_render_target_dirty)
+            render_target_rebuild();
+        if (_swapchain_dirty)
+        {
+            _swapchain_dirty = false;
+            recreate_swapchain();
+        }
+
+
         /* 等待 fence 进入 signal 状态 */
         (void) env->device.waitForFences({_inflight->current_inflight_fence()}, VK_TRUE,
                                          UINT64_MAX);
 
 
+        /* 帧率限制在采样输入之前等待，等待的时间不计入输入的延迟；之后查询之前提交的帧是否已经呈现 */
+        _frame_limiter.wait();
+        present_poll();
+
+
         /**
          * 向 swapchain 请求一个 presentable 的 image，可能此时 presentation engine 正在读这个 image。
          * 在 presentation engine 读完 image 后，它会把 semaphore 设为 signaled
@@ -243,8 +604,83 @@ private:
         env->device.resetFences({_inflight->current_inflight_fence()});
 
 
-        // 更新 MVP 矩阵
-        update_uniform_memory(_inflight->current_uniform_mem());
+        /* 这一帧上一次提交的 GPU 耗时已经可以读取 */
+        if (auto gpu_time = _gpu_timer->elapsed_ms(_inflight->current_idx(), GPU_SCOPE_FRAME); gpu_time.has_value())
+        {
+            _lod_stat.gpu_time += gpu_time.value();
+            ++_lod_stat.gpu_frames;
+            if (_dynamic_resolution)
+                _render_scale.update(gpu_time.value());
+        }
+        if (auto stat = _pipeline_stat->results(_inflight->current_idx()); stat.has_value())
+        {
+            _lod_stat.fragments += stat->front();
+            ++_lod_stat.stat_frames;
+        }
+
+
+        /* 只重新呈现上一帧；不是离屏渲染时，上一帧的结果不会被保留，只能重新绘制 */
+        if (action == Hiss::RedrawTracker::Action::REPRESENT && offscreen())
+        {
+            represent(image_idx);
+            _inflight->next_frame();
+            return;
+        }
+
+
+        /**
+         * 剔除结果只在绘制时读取：重新呈现不会录制剔除，slot 中还是上一次绘制的结果，
+         * 这个结果会在这个 slot 下一次绘制时读取，因此每次剔除只统计一次
+         */
+        if (_gpu_driven)
+            culling_stat_collect();
+
+
+        /* 动画只在持续渲染时推进 */
+        auto anim_now = std::chrono::steady_clock::now();
+        if (!_redraw.enabled())
+            _anim_time += std::chrono::duration<float>(anim_now - _anim_last).count();
+        _anim_last = anim_now;
+
+
+        /**
+         * 采样输入，更新 MVP 矩阵
+         * late latching 时这里的输入只用于剔除和 LOD 的选择，提交之前会重新采样并覆盖 uniform
+         */
+        uint64_t            frame_id = ++_frame_id;
+        UniformBufferObject ubo      = ubo_compute(_anim_time, input_sample());
+        update_uniform_memory(_inflight->current_uniform_mem(), ubo);
+        if (!_present_policy.late_latch)
+            _latency.input_record(frame_id);
+
+
+        /* 这一帧之前提交的 secondary command buffer 已经执行完毕，可以整体 reset */
+        _recorder->frame_reset(_inflight->current_idx());
+
+
+        /* 逐个实例录制的模式下，先确定这一帧需要绘制的实例 */
+        if (!_gpu_driven && !_instanced)
+            draw_list_update(ubo);
+
+
+        /**
+         * 根据实例在屏幕上的投影误差选择 LOD
+         * GPU driven 模式下由 compute shader 选择；instancing 模式下所有实例使用同一个 LOD
+         */
+        if (_instanced && !_gpu_driven)
+            _lod_stat.triangles += static_cast<uint64_t>(_instances.size()) * model.index_cnt(instanced_lod()) / 3;
+        else if (!_gpu_driven)
+        {
+            for (uint32_t id: _draw_list)
+            {
+                auto &instance = _instances[id];
+                instance.lod   = _lod_force.has_value()
+                                       ? _lod_force.value()
+                                       : model.lod_select(instance, CAMERA_EYE, CAMERA_FOV_Y,
+                                                          static_cast<float>(env->present_extent.height));
+                _lod_stat.triangles += model.index_cnt(instance.lod) / 3;
+            }
+        }
 
 
         /* 设置 clear value，顺序应该和 framebuffer 中 attachment 的顺序一致 */
@@ -254,45 +690,144 @@ private:
         };
 
 
+        /* 动态分辨率时只渲染 attachment 左上角 _render_extent 的区域 */
+        _render_extent = _dynamic_resolution ? _render_scale.extent(env->present_extent) : env->present_extent;
         vk::RenderPassBeginInfo render_pass_info = {
                 .renderPass      = _render_pass,
-                .framebuffer     = _framebuffer->framebuffer_get(image_idx),
-                .renderArea      = {.offset = {0, 0}, .extent = env->present_extent},
+                .framebuffer     = offscreen() ? _scaled_framebuffer->framebuffer_get()
+                                               : _framebuffer->framebuffer_get(image_idx),
+                .renderArea      = {.offset = {0, 0}, .extent = _render_extent},
                 .clearValueCount = static_cast<uint32_t>(clear_values.size()),
                 .pClearValues    = clear_values.data(),
         };
 
 
         /* record command */
+        auto              record_start   = std::chrono::high_resolution_clock::now();
         vk::CommandBuffer cur_cmd_buffer = _inflight->current_cmd_buffer();
         {
+            uint32_t frame_idx = _inflight->current_idx();
             cur_cmd_buffer.reset();
             cur_cmd_buffer.begin(vk::CommandBufferBeginInfo{});
+            _gpu_timer->reset_record(cur_cmd_buffer, frame_idx);
+            _pipeline_stat->reset_record(cur_cmd_buffer, frame_idx);
+            _gpu_timer->begin_record(cur_cmd_buffer, frame_idx, GPU_SCOPE_FRAME);
+
+            /**
+             * 相同的 desc 只会编译一次，之后的每一帧都直接从 registry 中取得
+             * 逐个实例录制时同样使用 instancing 模式的 pipeline，通过 firstInstance 选择实例的变换，
+             * 这样绘制的结果和 instancing 以及 GPU driven 模式相同，吞吐量可以直接比较
+             */
+            Hiss::PipelineDesc desc           = instanced_pipeline_desc();
+            vk::Pipeline       pipeline       = _pipelines->get(desc);
+            vk::Pipeline       depth_pipeline = _depth_prepass ? _pipelines->get(depth_pipeline_desc(desc)) : nullptr;
+            auto               draw_cnt       = static_cast<uint32_t>(_draw_list.size());
+
+            /**
+             * 录制整个 render pass：有 depth pre-pass 时，record 先以 depth_only = true 录制 subpass 0，再录制主 pass
+             * query 只能包含 inline 的 subpass，除非 secondary command buffer 可以继承 query
+             */
+            auto render_pass_record = [&](vk::SubpassContents contents, const std::function<void(bool)> &record) {
+                bool query = contents == vk::SubpassContents::eInline || _pipeline_stat->inherited();
+                if (query)
+                    _pipeline_stat->begin_record(cur_cmd_buffer, frame_idx);
+                cur_cmd_buffer.beginRenderPass(render_pass_info, contents);
+                if (_depth_prepass)
+                {
+                    record(true);
+                    cur_cmd_buffer.nextSubpass(contents);
+                }
+                record(false);
+                cur_cmd_buffer.endRenderPass();
+                if (query)
+                    _pipeline_stat->end_record(cur_cmd_buffer, frame_idx);
+            };
 
-            /* render pass */
+            if (_gpu_driven)
             {
-                cur_cmd_buffer.beginRenderPass(render_pass_info, vk::SubpassContents::eInline);
-                cur_cmd_buffer.bindVertexBuffers(0, {model.vertex_buffer()}, {0});
-                cur_cmd_buffer.bindIndexBuffer(model.index_buffer(), 0, vk::IndexType::eUint32);
-                cur_cmd_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, _graphics_pipeline);
-                cur_cmd_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-                                                  _pipeline_layout, 0,
-                                                  {_descriptor_sets[_inflight->current_idx()]}, {});
-
-                /* draw 需要在 bind 之后执行 */
-                cur_cmd_buffer.drawIndexed(static_cast<uint32_t>(model.index_cnt()), 1, 0, 0, 0);
-                cur_cmd_buffer.endRenderPass();
+                /* 剔除需要在 render pass 之外执行；之后每个 LOD 只有一次 indirect draw，和实例的数量无关 */
+                _culling->cull_record(cur_cmd_buffer, frame_idx, culling_view(ubo));
+                render_pass_record(vk::SubpassContents::eInline,
+                                   [&](bool depth_only) { gpu_draw_record(cur_cmd_buffer, depth_only); });
+            }
+            else if (_instanced)
+                render_pass_record(vk::SubpassContents::eInline,
+                                   [&](bool depth_only) { instanced_draw_record(cur_cmd_buffer, depth_only); });
+            else if (_record_threads == 0)
+                render_pass_record(vk::SubpassContents::eInline, [&](bool depth_only) {
+                    draw_range_record(cur_cmd_buffer, depth_only ? depth_pipeline : pipeline, 0, draw_cnt);
+                });
+            else
+            {
+                /* render pass 中只能 execute secondary command buffer，每个 secondary buffer 都需要重新绑定状态 */
+                render_pass_record(vk::SubpassContents::eSecondaryCommandBuffers, [&](bool depth_only) {
+                    vk::CommandBufferInheritanceInfo inheritance = {
+                            .renderPass         = _render_pass,
+                            .subpass            = _depth_prepass && !depth_only ? 1u : 0u,
+                            .framebuffer        = render_pass_info.framebuffer,
+                            .pipelineStatistics = _pipeline_stat->inherited() ? _pipeline_stat->stats()
+                                                                              : vk::QueryPipelineStatisticFlags{},
+                    };
+                    vk::Pipeline subpass_pipeline = depth_only ? depth_pipeline : pipeline;
+                    auto         secondary_cmds   = _recorder->record(
+                            frame_idx, inheritance, draw_cnt,
+                            [&](vk::CommandBuffer cmd, uint32_t begin, uint32_t end) {
+                                draw_range_record(cmd, subpass_pipeline, begin, end);
+                            },
+                            _record_threads);
+                    cur_cmd_buffer.executeCommands(secondary_cmds);
+                });
+            }
+
+            /* 后处理，然后放大到 swapchain 的 image 上，这些耗时也计入 GPU 的帧耗时 */
+            if (aa_mode().fxaa)
+            {
+                _fxaa->record(cur_cmd_buffer, _scaled_framebuffer->resolve_image(), _render_extent);
+                present_blit_record(cur_cmd_buffer, _fxaa->output(), _render_extent, _swapchain->images()[image_idx],
+                                    env->present_extent);
             }
+            else if (offscreen())
+                _scaled_framebuffer->blit_record(cur_cmd_buffer, _render_extent, _swapchain->images()[image_idx],
+                                                 env->present_extent);
 
+            _gpu_timer->end_record(cur_cmd_buffer, frame_idx, GPU_SCOPE_FRAME);
             cur_cmd_buffer.end();
         }
+        _lod_stat.record_time += std::chrono::high_resolution_clock::now() - record_start;
+
+
+        /* late latching：录制完成之后再处理一次窗口事件，用最新的输入覆盖 uniform，GPU 还没有读取它 */
+        if (_present_policy.late_latch)
+        {
+            glfwPollEvents();
+            update_uniform_memory(_inflight->current_uniform_mem(), ubo_compute(_anim_time, input_sample()));
+            _latency.input_record(frame_id);
+        }
+
+
+        submit_present(cur_cmd_buffer, image_idx, frame_id);
+
+
+        // 最后交换 in flight frame index
+        _inflight->next_frame();
+        lod_stat_report();
+    }
+
+
+    /**
+     * 提交这一帧的 command buffer，然后将 image 送到 surface 显示
+     * @param frame_id 用于统计延迟的 id，0 表示这一帧不统计
+     */
+    void submit_present(vk::CommandBuffer cmd, uint32_t image_idx, uint64_t frame_id)
+    {
+        auto env = Hiss::Env::env();
 
 
         // 提交绘制命令
-        std::vector<vk::CommandBuffer> commit_cmd_buffers = {cur_cmd_buffer};
+        std::vector<vk::CommandBuffer> commit_cmd_buffers = {cmd};
         std::vector<vk::Semaphore> wait_semaphores = {_inflight->current_img_available_semaphore()};
         std::vector<vk::PipelineStageFlags> wait_stages = {
-                vk::PipelineStageFlagBits::eColorAttachmentOutput};
+                offscreen() ? vk::PipelineStageFlagBits::eTransfer : vk::PipelineStageFlagBits::eColorAttachmentOutput};
         std::vector<vk::Semaphore> signal_semaphores = {
                 _inflight->current_render_finish_semaphore()};
         env->graphics_cmd_pool.commit_queue().submit(
@@ -308,17 +843,823 @@ private:
                         .pSignalSemaphores    = signal_semaphores.data(),
                 }},
                 _inflight->current_inflight_fence());
+        _latency.submit_record(frame_id);
 
 
         // 将结果送到 surface 显示
-        need_recreate =
-                _swapchain->present(image_idx, {_inflight->current_render_finish_semaphore()});
+        Recreate need_recreate =
+                _swapchain->present(image_idx, {_inflight->current_render_finish_semaphore()}, frame_id);
         if (need_recreate == Recreate::NEED)
             recreate_swapchain();
+    }
 
 
-        // 最后交换 in flight frame index
-        _inflight->next_frame();
+    /**
+     * 重新呈现上一帧：离屏渲染的结果还保留在 resolve attachment（或者 FXAA 的输出）中，只需要 blit 到新的 image 上
+     * 不更新 uniform，也不录制 render pass；query 同样需要 reset，之后不会读到过期的结果
+     */
+    void represent(uint32_t image_idx)
+    {
+        auto              env       = Hiss::Env::env();
+        uint32_t          frame_idx = _inflight->current_idx();
+        vk::CommandBuffer cmd       = _inflight->current_cmd_buffer();
+
+        cmd.reset();
+        cmd.begin(vk::CommandBufferBeginInfo{});
+        _gpu_timer->reset_record(cmd, frame_idx);
+        _pipeline_stat->reset_record(cmd, frame_idx);
+        if (aa_mode().fxaa)
+            present_blit_record(cmd, _fxaa->output(), _render_extent, _swapchain->images()[image_idx],
+                                env->present_extent);
+        else
+            _scaled_framebuffer->blit_record(cmd, _render_extent, _swapchain->images()[image_idx],
+                                             env->present_extent);
+        cmd.end();
+
+        submit_present(cmd, image_idx, 0);
+    }
+
+
+    /**
+     * 录制 _draw_list 中 [begin, end) 的 draw 命令
+     * 可能在多个 worker 线程中同时执行，只能读取共享的状态
+     * secondary command buffer 不会继承 primary 中绑定的状态，因此每次都需要完整地绑定 pipeline，descriptor 等
+     */
+    void draw_range_record(vk::CommandBuffer cmd, vk::Pipeline pipeline, uint32_t begin, uint32_t end)
+    {
+        cmd.bindVertexBuffers(0, {model.vertex_buffer(), _instance_buffer}, {0, 0});
+        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+
+        /* viewport 和 scissor 是 dynamic 的，窗口尺寸改变时不需要重新创建 pipeline */
+        cmd.setViewport(0, {vk::Viewport{
+                                   .x        = 0.f,
+                                   .y        = 0.f,
+                                   .width    = static_cast<float>(_render_extent.width),
+                                   .height   = static_cast<float>(_render_extent.height),
+                                   .minDepth = 0.f,
+                                   .maxDepth = 1.f,
+                           }});
+        cmd.setScissor(0, {vk::Rect2D{.offset = {0, 0}, .extent = _render_extent}});
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _pipeline_layout, 0,
+                               {_descriptor_sets[_inflight->current_idx()]}, {});
+
+        /* bindless 的 set 在每个 command buffer 中只绑定一次 */
+        if (_bindless)
+            cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _pipeline_layout, 1, {_bindless->set()}, {});
+
+        /* draw 需要在 bind 之后执行；所有 LOD 共享 vertex buffer，只需要切换 index buffer */
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            uint32_t    id       = _draw_list[i];
+            const auto &instance = _instances[id];
+            cmd.bindIndexBuffer(model.index_buffer(instance.lod), 0, vk::IndexType::eUint32);
+            if (_bindless)
+                cmd.pushConstants<Hiss::MaterialIndex>(_pipeline_layout, vk::ShaderStageFlagBits::eFragment, 0,
+                                                       _materials[instance.material]);
+            cmd.drawIndexed(model.index_cnt(instance.lod), 1, 0, 0, id);
+        }
+    }
+
+
+    /**
+     * GPU driven 模式下的绘制：所有 LOD 共享 vertex buffer，每个 LOD 绑定自己的 index buffer，
+     * 再用 GPU 剔除生成的 draw command 绘制；depth pre-pass 和主 pass 使用同一份 draw command
+     */
+    void gpu_draw_record(vk::CommandBuffer cmd, bool depth_only)
+    {
+        uint32_t frame_idx = _inflight->current_idx();
+        auto     desc      = depth_only ? depth_pipeline_desc(gpu_pipeline_desc()) : gpu_pipeline_desc();
+
+        cmd.bindVertexBuffers(0, {model.vertex_buffer()}, {0});
+        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, _pipelines->get(desc));
+        cmd.setViewport(0, {vk::Viewport{
+                                   .x        = 0.f,
+                                   .y        = 0.f,
+                                   .width    = static_cast<float>(_render_extent.width),
+                                   .height   = static_cast<float>(_render_extent.height),
+                                   .minDepth = 0.f,
+                                   .maxDepth = 1.f,
+                           }});
+        cmd.setScissor(0, {vk::Rect2D{.offset = {0, 0}, .extent = _render_extent}});
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _instanced_pipeline_layout, 0,
+                               {_descriptor_sets[frame_idx]}, {});
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _instanced_pipeline_layout, 2,
+                               {_culling->instance_set()}, {});
+
+        /* 一次 indirect draw 包含所有的实例，不能逐个实例切换 material，使用第一个实例的 material */
+        if (_bindless && !depth_only)
+        {
+            cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _instanced_pipeline_layout, 1,
+                                   {_bindless->set()}, {});
+            cmd.pushConstants<Hiss::MaterialIndex>(_instanced_pipeline_layout, vk::ShaderStageFlagBits::eFragment, 0,
+                                                   _materials[_instances.front().material]);
+        }
+
+        for (uint32_t lod = 0; lod < std::min(model.lod_cnt(), Hiss::GpuCulling::MAX_LODS); ++lod)
+        {
+            cmd.bindIndexBuffer(model.index_buffer(lod), 0, vk::IndexType::eUint32);
+            _culling->draw_record(cmd, frame_idx, lod);
+        }
+    }
+
+
+    /**
+     * instancing 模式下的绘制：binding 0 是顶点数据，binding 1 是实例数据，一次 draw 绘制所有的实例
+     */
+    void instanced_draw_record(vk::CommandBuffer cmd, bool depth_only)
+    {
+        uint32_t lod  = instanced_lod();
+        auto     desc = depth_only ? depth_pipeline_desc(instanced_pipeline_desc()) : instanced_pipeline_desc();
+
+        cmd.bindVertexBuffers(0, {model.vertex_buffer(), _instance_buffer}, {0, 0});
+        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, _pipelines->get(desc));
+        cmd.setViewport(0, {vk::Viewport{
+                                   .x        = 0.f,
+                                   .y        = 0.f,
+                                   .width    = static_cast<float>(_render_extent.width),
+                                   .height   = static_cast<float>(_render_extent.height),
+                                   .minDepth = 0.f,
+                                   .maxDepth = 1.f,
+                           }});
+        cmd.setScissor(0, {vk::Rect2D{.offset = {0, 0}, .extent = _render_extent}});
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _pipeline_layout, 0,
+                               {_descriptor_sets[_inflight->current_idx()]}, {});
+
+        /* 一次 draw 包含所有的实例，不能逐个实例切换 material，使用第一个实例的 material */
+        if (_bindless && !depth_only)
+        {
+            cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _pipeline_layout, 1, {_bindless->set()}, {});
+            cmd.pushConstants<Hiss::MaterialIndex>(_pipeline_layout, vk::ShaderStageFlagBits::eFragment, 0,
+                                                   _materials[_instances.front().material]);
+        }
+        cmd.bindIndexBuffer(model.index_buffer(lod), 0, vk::IndexType::eUint32);
+        cmd.drawIndexed(model.index_cnt(lod), static_cast<uint32_t>(_instances.size()), 0, 0, 0);
+    }
+
+
+    /* instancing 模式下所有实例共用的 LOD：按 L 固定的 LOD，自动模式下使用 level 0 */
+    [[nodiscard]] uint32_t instanced_lod() const { return _lod_force.value_or(0); }
+
+
+    /**
+     * 根据 _instances 重新创建 instance buffer，会等待 device 空闲
+     * 实例的颜色由网格中的位置决定，方便区分不同的实例
+     */
+    void instance_buffer_update()
+    {
+        auto env = Hiss::Env::env();
+        env->device.waitIdle();
+        if (_instance_buffer)
+        {
+            env->device.destroyBuffer(_instance_buffer);
+            env->device.free(_instance_memory);
+        }
+
+        std::vector<InstanceData> instances;
+        instances.reserve(_instances.size());
+        for (const auto &instance: _instances)
+        {
+            auto pos = glm::vec3(instance.model[3]);
+            instances.push_back(InstanceData{
+                    .model = instance.model,
+                    .color = glm::vec4(.6f + .4f * glm::sin(pos.x * .37f), .6f + .4f * glm::sin(pos.z * .53f),
+                                       .6f + .4f * glm::cos((pos.x + pos.z) * .29f), 1.f),
+            });
+        }
+        instance_buffer_create(instances, _instance_buffer, _instance_memory);
+        _redraw.mark(Hiss::RedrawTracker::DIRTY_ASSET);
+    }
+
+
+    /**
+     * 切换 instancing 模式
+     */
+    void instanced_switch()
+    {
+        _instanced = !_instanced;
+        _lod_stat  = {};
+        LogStatic::logger()->info("[instance] instanced: {}", _instanced);
+    }
+
+
+    /**
+     * 确定这一帧逐个录制的实例
+     * 开启 CPU 剔除时，实例的包围球随着 ubo 中的 model 矩阵旋转，因此每帧都需要更新包围球并 refit BVH
+     */
+    void draw_list_update(const UniformBufferObject &ubo)
+    {
+        _draw_list.clear();
+        if (!_cpu_cull)
+        {
+            _draw_list.resize(_instances.size());
+            std::iota(_draw_list.begin(), _draw_list.end(), 0u);
+            return;
+        }
+
+        auto      start   = std::chrono::high_resolution_clock::now();
+        glm::vec4 bound   = model.bound();
+        bool      rebuild = _cull_bounds.size() != _instances.size();
+        if (rebuild)
+        {
+            _cull_bounds = {};
+            _cull_bounds.reserve(_instances.size());
+        }
+        for (uint32_t i = 0; i < _instances.size(); ++i)
+        {
+            auto center = glm::vec3(_instances[i].model * ubo.model * glm::vec4(glm::vec3(bound), 1.f));
+            if (rebuild)
+                _cull_bounds.add(center, bound.w);
+            else
+                _cull_bounds.set(i, center, bound.w);
+        }
+        if (rebuild)
+            _bvh.build(_cull_bounds, _thread_pool.get());
+        else
+            _bvh.refit(_cull_bounds);
+
+        /* BVH 输出的顺序和 id 无关，排序之后录制的顺序和关闭剔除时一致 */
+        _bvh.cull(_cull_bounds, Hiss::Frustum::extract(ubo.proj * ubo.view), _draw_list);
+        std::sort(_draw_list.begin(), _draw_list.end());
+
+        _lod_stat.cull_time += std::chrono::high_resolution_clock::now() - start;
+        _lod_stat.visible += _draw_list.size();
+        _lod_stat.total += _instances.size();
+        ++_lod_stat.cull_frames;
+    }
+
+
+    /**
+     * 切换 CPU 视锥剔除，只对逐个实例录制的模式生效
+     */
+    void cpu_cull_switch()
+    {
+        _cpu_cull = !_cpu_cull;
+        _lod_stat = {};
+        LogStatic::logger()->info("[culling] cpu cull: {}, isa: {}", _cpu_cull, Hiss::frustum_cull_isa());
+    }
+
+
+    /**
+     * 切换 depth pre-pass：render pass 的 subpass 数量改变
+     */
+    void depth_prepass_switch()
+    {
+        _depth_prepass       = !_depth_prepass;
+        _render_target_dirty = true;
+
+        _lod_stat = {};
+        LogStatic::logger()->info("[prepass] depth prepass: {}", _depth_prepass);
+    }
+
+
+    /**
+     * 切换动态分辨率：resolve attachment 从 swapchain 的 image 变为离屏的 image，render pass 的 final layout 改变
+     * 需要 swapchain 的 image 可以作为 blit 的目标，并且格式支持线性过滤的 blit
+     */
+    void dynamic_resolution_switch()
+    {
+        if (!present_blit_supported(false))
+        {
+            LogStatic::logger()->warn("[scale] swapchain image can not be the destination of a linear blit.");
+            return;
+        }
+
+        _dynamic_resolution = !_dynamic_resolution;
+        _render_scale.reset();
+        _render_target_dirty = true;
+
+        _lod_stat = {};
+        LogStatic::logger()->info("[scale] dynamic resolution: {}, target gpu time: {:.1f} ms", _dynamic_resolution,
+                                  _render_scale.config().target_ms);
+    }
+
+
+    /**
+     * 离屏渲染的结果通过线性过滤的 blit 呈现：swapchain 的 image 需要可以作为 blit 的目标，
+     * 被 blit 的 image 需要支持线性过滤的 blit 源，开启 FXAA 时是 FXAA 的输出，否则是离屏的 resolve attachment
+     */
+    [[nodiscard]] bool present_blit_supported(bool fxaa) const
+    {
+        auto                   env        = Hiss::Env::env();
+        vk::Format             src_format = fxaa ? Hiss::Fxaa::FORMAT : _framebuffer_layout.resolve_format;
+        auto                   src_props  = env->physical_device.getFormatProperties(src_format);
+        auto                   dst_props  = env->physical_device.getFormatProperties(_swapchain->format());
+        vk::FormatFeatureFlags src_blit   = vk::FormatFeatureFlagBits::eBlitSrc
+                                        | vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+        vk::FormatFeatureFlags dst_blit   = vk::FormatFeatureFlagBits::eBlitDst;
+        return (env->info->surface_capability.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferDst)
+            && BITS_CONTAIN(src_props.optimalTilingFeatures, src_blit)
+            && BITS_CONTAIN(dst_props.optimalTilingFeatures, dst_blit);
+    }
+
+
+    /* 动态分辨率，FXAA 以及需要重新呈现上一帧的按需渲染，都需要先渲染到离屏的 attachment 上 */
+    [[nodiscard]] bool offscreen() const
+    {
+        return _dynamic_resolution || aa_mode().fxaa || (_redraw.enabled() && _represent_supported);
+    }
+
+    [[nodiscard]] const AaMode &aa_mode() const { return AA_MODES[_aa_mode_idx]; }
+
+
+    /**
+     * color 和 depth attachment 都需要支持这个采样数；FXAA 需要离屏渲染
+     */
+    [[nodiscard]] bool aa_mode_supported(const AaMode &mode) const
+    {
+        const auto &limits  = Hiss::Env::env()->info->physical_device_properties.limits;
+        auto        samples = limits.framebufferColorSampleCounts & limits.framebufferDepthSampleCounts;
+        return (samples & mode.samples) && (!mode.fxaa || present_blit_supported(true));
+    }
+
+
+    /**
+     * 切换到下一个 device 支持的抗锯齿设置，render target 在下一帧开始时重新创建
+     */
+    void aa_mode_switch()
+    {
+        do
+            _aa_mode_idx = (_aa_mode_idx + 1) % static_cast<uint32_t>(AA_MODES.size());
+        while (!aa_mode_supported(aa_mode()));
+        _render_target_dirty = true;
+
+        _lod_stat = {};
+        LogStatic::logger()->info("[aa] mode: {}", aa_mode().name);
+    }
+
+
+    static constexpr uint32_t PRESENT_POLICY_CNT = 3;
+
+    /* 0 默认，1 低延迟，2 省电 */
+    static Hiss::PresentPolicy present_policy_preset(uint32_t idx)
+    {
+        if (idx == 1)
+            return Hiss::PresentPolicy::low_latency();
+        if (idx == 2)
+            return Hiss::PresentPolicy::power_saving();
+        return Hiss::PresentPolicy{};
+    }
+
+
+    /**
+     * 切换到下一个呈现策略的预设，swapchain 在下一帧开始时重新创建
+     */
+    void present_policy_switch()
+    {
+        _present_policy_idx = (_present_policy_idx + 1) % PRESENT_POLICY_CNT;
+        _present_policy     = present_policy_preset(_present_policy_idx);
+        _frame_limiter.fps_set(_present_policy.fps_limit);
+        _swapchain_dirty = true;
+
+        _lod_stat = {};
+        LogStatic::logger()->info("[present] policy: {}, mode: {}, images: {}, fps limit: {}, late latch: {}",
+                                  _present_policy.name, vk::to_string(_present_policy.mode),
+                                  _present_policy.image_cnt, _present_policy.fps_limit, _present_policy.late_latch);
+    }
+
+
+    /**
+     * 在当前策略的基础上切换 present mode：FIFO -> FIFO_RELAXED -> MAILBOX -> IMMEDIATE
+     * surface 不支持的模式由 Swapchain 退回到支持的模式
+     */
+    void present_mode_switch()
+    {
+        auto   it  = std::find(PRESENT_MODES.begin(), PRESENT_MODES.end(), _present_policy.mode);
+        size_t idx = it == PRESENT_MODES.end() ? 0 : static_cast<size_t>(it - PRESENT_MODES.begin() + 1);
+        _present_policy.name = "custom";
+        _present_policy.mode = PRESENT_MODES[idx % PRESENT_MODES.size()];
+        _swapchain_dirty     = true;
+
+        _lod_stat = {};
+        LogStatic::logger()->info("[present] policy: {}, mode: {}", _present_policy.name,
+                                  vk::to_string(_present_policy.mode));
+    }
+
+
+    /**
+     * 按照提交的顺序查询之前的帧是否已经呈现，不阻塞；呈现时间的精度受查询频率（每帧一次）的限制
+     */
+    void present_poll()
+    {
+        while (auto frame_id = _latency.oldest_pending())
+        {
+            if (!_swapchain->present_wait(frame_id.value(), 0))
+                break;
+            _latency.present_record(frame_id.value());
+        }
+    }
+
+
+    /* 这一帧的输入：鼠标在窗口中的横坐标 */
+    static double input_sample()
+    {
+        double x, y;
+        glfwGetCursorPos(WindowStatic::window_get(), &x, &y);
+        return x;
+    }
+
+
+    /**
+     * 切换按需渲染；swapchain 的 image 可以作为 blit 的目标时，按需渲染使用离屏渲染，这样上一帧的结果可以重新呈现
+     */
+    void on_demand_switch()
+    {
+        _redraw.enable(!_redraw.enabled());
+        _render_target_dirty = true;
+
+        _lod_stat = {};
+        LogStatic::logger()->info("[redraw] render on demand: {}, represent last image: {}", _redraw.enabled(),
+                                  _redraw.enabled() && _represent_supported);
+    }
+
+
+    /**
+     * 检查输入和窗口的状态，标记需要重新绘制的内容；按键切换设置的标记在 key_pressed 中
+     */
+    void redraw_check()
+    {
+        if (double cursor_x = input_sample(); cursor_x != _cursor_x)
+        {
+            _cursor_x = cursor_x;
+            _redraw.mark(Hiss::RedrawTracker::DIRTY_CAMERA);
+        }
+        if (WindowStatic::resized())
+            _redraw.mark(Hiss::RedrawTracker::DIRTY_RESIZE);
+        if (WindowStatic::need_refresh())
+        {
+            WindowStatic::need_refresh(false);
+            _redraw.represent_request();
+        }
+    }
+
+
+    /**
+     * 根据抗锯齿的设置和是否离屏渲染，更新 framebuffer 的采样数和 resolve attachment 的 final layout
+     */
+    void framebuffer_layout_update()
+    {
+        _framebuffer_layout.color_sample         = aa_mode().samples;
+        _framebuffer_layout.depth_sample         = aa_mode().samples;
+        _framebuffer_layout.resolve_final_layout =
+                offscreen() ? vk::ImageLayout::eTransferSrcOptimal : vk::ImageLayout::ePresentSrcKHR;
+    }
+
+
+    /**
+     * 重新创建 render pass，以及依赖于 render pass 的 framebuffer 和 pipeline，会等待 device 空闲
+     */
+    void render_target_rebuild()
+    {
+        auto env = Hiss::Env::env();
+        env->device.waitIdle();
+
+        _render_target_dirty = false;
+        framebuffer_layout_update();
+        env->device.destroyRenderPass(_render_pass);
+        _render_pass = render_pass_create(_framebuffer_layout, _depth_prepass);
+        _pipelines->clear();
+        framebuffer_create();
+    }
+
+
+    /**
+     * 根据是否离屏渲染，创建 swapchain 大小的 framebuffer；FXAA 的输入是离屏的 resolve attachment
+     */
+    void framebuffer_create()
+    {
+        auto env            = Hiss::Env::env();
+        _framebuffer        = nullptr;
+        _scaled_framebuffer = nullptr;
+        if (offscreen())
+        {
+            _scaled_framebuffer = ScaledFramebuffer::create(_render_pass, _framebuffer_layout, env->present_extent);
+            _attachment_memory  = _scaled_framebuffer->memory_size();
+        }
+        else
+        {
+            _framebuffer       = MSAAFramebuffer::create(_render_pass, _framebuffer_layout, _swapchain->img_views(),
+                                                         env->present_extent);
+            _attachment_memory = _framebuffer->memory_size();
+        }
+        if (aa_mode().fxaa)
+        {
+            _fxaa->resize(_scaled_framebuffer->resolve_view(), env->present_extent);
+            _attachment_memory += _fxaa->memory_size();
+        }
+
+        LogStatic::logger()->info("[aa] mode: {}, attachment memory: {:.1f} MB", aa_mode().name,
+                                  static_cast<double>(_attachment_memory) / (1024. * 1024.));
+    }
+
+
+    /**
+     * 剔除使用的相机参数，和 ubo 中的变换以及 CPU 的 LOD 选择保持一致
+     */
+    [[nodiscard]] Hiss::GpuCulling::View culling_view(const UniformBufferObject &ubo) const
+    {
+        auto env = Hiss::Env::env();
+        return Hiss::GpuCulling::View{
+                .local         = ubo.model,
+                .view_proj     = ubo.proj * ubo.view,
+                .eye           = CAMERA_EYE,
+                .lod_scale     = static_cast<float>(env->present_extent.height) / (2.f * std::tan(CAMERA_FOV_Y * .5f)),
+                .lod_threshold = TestModel::lod_threshold(),
+                .lod_force     = _lod_force.has_value() ? static_cast<int32_t>(_lod_force.value()) : -1,
+        };
+    }
+
+
+    /**
+     * 将实例数据上传到 GPU 剔除使用的 buffer 中，会等待 device 空闲
+     */
+    void culling_instances_upload()
+    {
+        Hiss::Env::env()->device.waitIdle();
+
+        std::vector<Hiss::GpuCulling::Instance> instances;
+        instances.reserve(_instances.size());
+        for (const auto &instance: _instances)
+            instances.push_back(Hiss::GpuCulling::Instance{.model = instance.model, .bound = model.bound()});
+        _culling->instances_upload(instances);
+        _redraw.mark(Hiss::RedrawTracker::DIRTY_ASSET);
+    }
+
+
+    /**
+     * 从 readback ring 中读取当前帧上一次的剔除结果，计入统计
+     */
+    void culling_stat_collect()
+    {
+        auto stat = _culling->stat(_inflight->current_idx());
+        if (!stat.has_value())
+            return;
+
+        _lod_stat.visible += stat->visible;
+        _lod_stat.total += stat->total;
+        ++_lod_stat.cull_frames;
+        for (uint32_t lod = 0; lod < std::min(model.lod_cnt(), Hiss::GpuCulling::MAX_LODS); ++lod)
+            _lod_stat.triangles += static_cast<uint64_t>(stat->lod_visible[lod]) * model.index_cnt(lod) / 3;
+    }
+
+
+    /**
+     * 切换 GPU driven 模式，device 不支持时保持关闭
+     */
+    void gpu_driven_switch()
+    {
+        if (!_culling)
+        {
+            LogStatic::logger()->warn("[culling] device does not support draw indirect count.");
+            return;
+        }
+
+        _gpu_driven = !_gpu_driven;
+        _lod_stat   = {};
+        LogStatic::logger()->info("[culling] gpu driven: {}", _gpu_driven);
+    }
+
+
+    /**
+     * 按键从松开变为按下时返回 true，key_down 记录上一次的状态
+     * 按键都用于切换设置，因此按下时需要重新绘制
+     */
+    bool key_pressed(int key, bool &key_down)
+    {
+        bool down    = glfwGetKey(WindowStatic::window_get(), key) == GLFW_PRESS;
+        bool pressed = down && !key_down;
+        key_down     = down;
+        if (pressed)
+            _redraw.mark(Hiss::RedrawTracker::DIRTY_SETTING);
+        return pressed;
+    }
+
+
+    /**
+     * 切换实例的数量，实例在 xz 平面上排列为网格
+     */
+    void instance_cnt_switch()
+    {
+        _instance_cnt_idx = (_instance_cnt_idx + 1) % static_cast<uint32_t>(INSTANCE_CNTS.size());
+        uint32_t cnt      = INSTANCE_CNTS[_instance_cnt_idx];
+        auto     side     = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(cnt))));
+        float    spacing  = 1.5f;
+
+        _instances.resize(cnt);
+        _cull_bounds = {};
+        for (uint32_t i = 0; i < cnt; ++i)
+        {
+            glm::vec3 pos = {(static_cast<float>(i % side) - static_cast<float>(side - 1) * .5f) * spacing, 0.f,
+                             (static_cast<float>(i / side) - static_cast<float>(side - 1) * .5f) * spacing};
+            _instances[i] = ModelInstance{.model = glm::translate(glm::mat4(1.f), pos)};
+        }
+        instance_buffer_update();
+        if (_culling)
+            culling_instances_upload();
+
+        _lod_stat = {};
+        LogStatic::logger()->info("[instance] instance count: {}", cnt);
+    }
+
+
+    /**
+     * 切换录制的线程数：单线程 inline -> 1 -> 2 -> 4 -> ... -> 线程池的大小 -> 单线程 inline
+     */
+    void record_threads_switch()
+    {
+        uint32_t max_threads = _recorder->thread_cnt();
+        if (_record_threads == 0)
+            _record_threads = 1;
+        else if (_record_threads < max_threads)
+            _record_threads = std::min(_record_threads * 2, max_threads);
+        else
+            _record_threads = 0;
+
+        _lod_stat = {};
+        LogStatic::logger()->info("[record] record threads: {}", record_mode());
+    }
+
+
+    [[nodiscard]] std::string record_mode() const
+    {
+        if (_gpu_driven)
+            return "gpu driven";
+        if (_instanced)
+            return "instanced";
+        return _record_threads == 0 ? std::string("inline") : std::to_string(_record_threads);
+    }
+
+
+    /**
+     * 切换 LOD 设置：自动 -> level 0 -> level 1 -> ... -> 自动
+     */
+    void lod_setting_switch()
+    {
+        if (!_lod_force.has_value())
+            _lod_force = 0;
+        else if (_lod_force.value() + 1 < model.lod_cnt())
+            _lod_force = _lod_force.value() + 1;
+        else
+            _lod_force = std::nullopt;
+
+        _lod_stat.triangles = 0;
+        _lod_stat.frames    = 0;
+        LogStatic::logger()->info("[lod] setting: {}",
+                                  _lod_force.has_value() ? fmt::format("level {}", _lod_force.value()) : "auto");
+    }
+
+
+    /**
+     * 每秒输出一次平均每帧提交的三角形数量
+     */
+    void lod_stat_report()
+    {
+        ++_lod_stat.frames;
+        auto now = std::chrono::high_resolution_clock::now();
+        if (now - _lod_stat.last_report < std::chrono::seconds(1))
+            return;
+
+        LogStatic::logger()->info("[lod] setting: {}, lod of instance 0: {}, triangles/frame: {}",
+                                  _lod_force.has_value() ? fmt::format("level {}", _lod_force.value()) : "auto",
+                                  _instances[0].lod, _lod_stat.triangles / _lod_stat.frames);
+        LogStatic::logger()->info("[record] threads: {}, draws: {}, record time: {:.3f} ms/frame", record_mode(),
+                                  _instances.size(), _lod_stat.record_time.count() / _lod_stat.frames);
+        if (_lod_stat.cull_frames > 0)
+            LogStatic::logger()->info("[culling] visible/total: {}/{}", _lod_stat.visible / _lod_stat.cull_frames,
+                                      _lod_stat.total / _lod_stat.cull_frames);
+        if (_cpu_cull && !_gpu_driven && !_instanced)
+            LogStatic::logger()->info("[culling] cpu cull time: {:.3f} ms/frame",
+                                      _lod_stat.cull_time.count() / _lod_stat.frames);
+
+        if (_dynamic_resolution)
+            LogStatic::logger()->info("[scale] render scale: {:.2f}, extent: {}x{}, smoothed gpu time: {:.3f} ms",
+                                      _render_scale.scale(), _render_extent.width, _render_extent.height,
+                                      _render_scale.smoothed_ms());
+        if (_lod_stat.stat_frames > 0)
+            LogStatic::logger()->info("[prepass] depth prepass: {}, shaded fragments/frame: {}", _depth_prepass,
+                                      _lod_stat.fragments / _lod_stat.stat_frames);
+
+        /* 按需渲染时，统计绘制，重新呈现和空闲等待的次数，以及触发重新绘制的原因 */
+        auto redraw = _redraw.stat_take();
+        if (_redraw.enabled())
+            LogStatic::logger()->info("[redraw] drawn: {}, represented: {}, idle waits: {}, dirty: {}", redraw.drawn,
+                                      redraw.represented, redraw.idle, Hiss::RedrawTracker::dirty_str(redraw.dirty));
+
+        /* 输入到呈现的延迟只有在 device 支持 present wait 时才能测量 */
+        auto   latency = _latency.stat_take();
+        double elapsed = std::chrono::duration<double>(now - _lod_stat.last_report).count();
+        LogStatic::logger()->info("[present] policy: {}, mode: {}, images: {}, fps: {:.1f}", _present_policy.name,
+                                  vk::to_string(_swapchain->present_mode()), _swapchain->images().size(),
+                                  _lod_stat.frames / elapsed);
+        if (latency.presented > 0)
+            LogStatic::logger()->info("[latency] input->submit: {:.3f} ms, input->present: {:.3f} ms",
+                                      latency.input_to_submit, latency.input_to_present);
+        else
+            LogStatic::logger()->info("[latency] input->submit: {:.3f} ms, input->present: n/a",
+                                      latency.input_to_submit);
+
+        /* 吞吐量：每毫秒 GPU 时间可以绘制多少个实例；抗锯齿的开销体现在 GPU 耗时，fragment 数量和显存上 */
+        if (_lod_stat.gpu_frames > 0)
+        {
+            double gpu_ms = _lod_stat.gpu_time / _lod_stat.gpu_frames;
+            LogStatic::logger()->info("[gpu] time: {:.3f} ms/frame, instances/ms: {:.1f}", gpu_ms,
+                                      static_cast<double>(_instances.size()) / gpu_ms);
+            LogStatic::logger()->info("[aa] mode: {}, gpu time: {:.3f} ms/frame, attachment memory: {:.1f} MB",
+                                      aa_mode().name, gpu_ms,
+                                      static_cast<double>(_attachment_memory) / (1024. * 1024.));
+        }
+        _lod_stat = {};
+    }
+
+
+    /**
+     * 绘制模型使用的 pipeline 状态
+     */
+    [[nodiscard]] Hiss::PipelineDesc pipeline_desc() const
+    {
+        auto vert_bind_description = Vertex::binding_description_get();
+        auto vert_attr_description = Vertex::attr_description_get();
+
+        return Hiss::PipelineDesc{
+                .shaders =
+                        {
+                                {.stage = vk::ShaderStageFlagBits::eVertex, .path = SHADER("triangle.vert.spv")},
+                                {.stage = vk::ShaderStageFlagBits::eFragment,
+                                 .path  = _bindless ? SHADER("triangle_bindless.frag.spv")
+                                                    : SHADER("triangle.frag.spv")},
+                        },
+                .vertex_bindings    = {vert_bind_description.begin(), vert_bind_description.end()},
+                .vertex_attrs       = {vert_attr_description.begin(), vert_attr_description.end()},
+                .samples            = _framebuffer_layout.color_sample,
+                .sample_shading     = aa_mode().sample_shading,
+                .min_sample_shading = aa_mode().sample_shading ? 1.f : 0.f,
+
+                /* 有 depth pre-pass 时，depth 已经确定，只有和 depth 相等的 fragment 才需要着色 */
+                .depth_write   = !_depth_prepass,
+                .depth_compare = _depth_prepass ? vk::CompareOp::eEqual : vk::CompareOp::eLess,
+
+                .layout      = _pipeline_layout,
+                .render_pass = _render_pass,
+                .subpass     = _depth_prepass ? 1u : 0u,
+        };
+    }
+
+
+    /**
+     * 主 pass 的 pipeline 对应的 depth pre-pass pipeline：
+     * vertex shader 换成只计算 position 的版本，没有 fragment shader，
+     * 只保留 position 以及实例数据的 vertex attribute，没有 color attachment
+     */
+    [[nodiscard]] static Hiss::PipelineDesc depth_pipeline_desc(const Hiss::PipelineDesc &main_desc)
+    {
+        static const std::map<std::string, std::string> depth_shaders = {
+                {SHADER("triangle.vert.spv"), SHADER("depth_prepass.vert.spv")},
+                {SHADER("triangle_instance_rate.vert.spv"), SHADER("depth_prepass_instance_rate.vert.spv")},
+                {SHADER("triangle_instanced.vert.spv"), SHADER("depth_prepass_instanced.vert.spv")},
+        };
+
+        Hiss::PipelineDesc desc = main_desc;
+        desc.shaders            = {{.stage = vk::ShaderStageFlagBits::eVertex,
+                                    .path  = depth_shaders.at(main_desc.shaders.front().path)}};
+        std::erase_if(desc.vertex_attrs, [](const vk::VertexInputAttributeDescription &attr) {
+            return attr.binding == 0 && attr.location != 0;
+        });
+        desc.sample_shading     = false;
+        desc.min_sample_shading = 0.f;
+        desc.depth_write        = true;
+        desc.depth_compare      = vk::CompareOp::eLess;
+        desc.color_blends       = {};
+        desc.subpass            = 0;
+        return desc;
+    }
+
+
+    /**
+     * instancing 模式使用的 pipeline：在顶点数据之外增加一个 input rate 为 instance 的 binding
+     * 只替换 vertex shader，fragment shader（包括 bindless 的版本）和普通模式相同
+     */
+    [[nodiscard]] Hiss::PipelineDesc instanced_pipeline_desc() const
+    {
+        Hiss::PipelineDesc desc = pipeline_desc();
+        desc.shaders[0]         = {.stage = vk::ShaderStageFlagBits::eVertex,
+                                   .path  = SHADER("triangle_instance_rate.vert.spv")};
+        desc.vertex_bindings.push_back(InstanceData::binding_description_get(1));
+        auto instance_attrs = InstanceData::attr_description_get(1, 3);
+        desc.vertex_attrs.insert(desc.vertex_attrs.end(), instance_attrs.begin(), instance_attrs.end());
+        return desc;
+    }
+
+
+    /**
+     * GPU driven 模式使用的 pipeline：vertex shader 从 storage buffer 中读取实例的变换
+     * 只替换 vertex shader，fragment shader（包括 bindless 的版本）和普通模式相同
+     */
+    [[nodiscard]] Hiss::PipelineDesc gpu_pipeline_desc() const
+    {
+        Hiss::PipelineDesc desc = pipeline_desc();
+        desc.shaders[0]         = {.stage = vk::ShaderStageFlagBits::eVertex,
+                                   .path  = SHADER("triangle_instanced.vert.spv")};
+        desc.layout             = _instanced_pipeline_layout;
+        return desc;
     }
 
 
@@ -340,52 +1681,58 @@ private:
 
 
         /* 回收旧的资源 */
-        _framebuffer = nullptr;
-        env->device.destroyPipeline(_graphics_pipeline);
-        _swapchain = nullptr;
+        _framebuffer        = nullptr;
+        _scaled_framebuffer = nullptr;
+        _swapchain          = nullptr;
 
 
-        /* 创建新的资源 */
+        /* 创建新的资源，动态分辨率的 attachment 按照新的 swapchain 大小分配 */
         Hiss::Env::resize(_instance);
-        _swapchain         = Swapchain::create();
-        _graphics_pipeline = pipeline_create(_pipeline_layout, _render_pass);
-        _framebuffer =
-                MSAAFramebuffer::create(_render_pass, _framebuffer_layout, _swapchain->img_views(),
-                                                     Hiss::Env::env()->present_extent);
+        _swapchain = Swapchain::create(_present_policy);
+        framebuffer_create();
+
+        /* 旧的 swapchain 上等待呈现的帧不会再完成；新的 framebuffer 中还没有内容 */
+        _latency.reset();
+        _redraw.mark(Hiss::RedrawTracker::DIRTY_RESIZE);
     }
 
 
     /**
-     * 更新 uniform buffer 的内容，更新 model 矩阵，让物体旋转起来
+     * 计算这一帧的 MVP 矩阵，更新 model 矩阵，让物体旋转起来
+     * time 是动画经过的时间，单位是秒；鼠标的横坐标每移动一个窗口的宽度，物体额外旋转一周
      */
-    static void update_uniform_memory(const vk::DeviceMemory &uniform_memory)
+    static UniformBufferObject ubo_compute(float time, double cursor_x)
     {
-        auto env = *Hiss::Env::env();
-
-        static auto start_time = std::chrono::high_resolution_clock::now();
+        auto env = Hiss::Env::env();
 
-        auto cur_time = std::chrono::high_resolution_clock::now();
-        float time =
-                std::chrono::duration<float, std::chrono::seconds::period>(cur_time - start_time)
-                        .count();
+        float yaw = static_cast<float>(cursor_x) / static_cast<float>(WIDTH) * glm::radians(360.f);
 
         UniformBufferObject ubo = {
-                .model = glm::rotate(glm::mat4(1.f), time * glm::radians(90.f),
+                .model = glm::rotate(glm::mat4(1.f), time * glm::radians(90.f) + yaw,
                                      glm::vec3(0.f, 1.f, 0.f)),
 
-                .view = glm::lookAt(glm::vec3(2.f, 2.f, 2.f), glm::vec3(0.f),
-                                    glm::vec3(0.f, 1.f, 0.f)),
+                .view = glm::lookAt(CAMERA_EYE, glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f)),
 
                 /* 可以确保 surface extent 是最新的值，因此拉伸窗口物体不会变形 */
-                .proj = glm::perspective(glm::radians(45.f),
-                                         (float) env.present_extent.width
-                                                 / (float) env.present_extent.height,
+                .proj = glm::perspective(CAMERA_FOV_Y,
+                                         (float) env->present_extent.width
+                                                 / (float) env->present_extent.height,
                                          0.1f, 10.f),
         };
         ubo.proj[1][1] *= -1.f;    // OpenGL 和 vulkan 的坐标系差异
+        return ubo;
+    }
+
+
+    /**
+     * 更新 uniform buffer 的内容
+     */
+    static void update_uniform_memory(const vk::DeviceMemory &uniform_memory, const UniformBufferObject &ubo)
+    {
+        auto env = Hiss::Env::env();
 
-        void *data = env.device.mapMemory(uniform_memory, 0, sizeof(ubo), {});
+        void *data = env->device.mapMemory(uniform_memory, 0, sizeof(ubo), {});
         std::memcpy(data, &ubo, sizeof(ubo));
-        env.device.unmapMemory(uniform_memory);
+        env->device.unmapMemory(uniform_memory);
     }
 };
\ No newline at end of file
@@ -4,6 +4,9 @@
 #include "instance.hpp"
 #include "global.hpp"
 #include "window.hpp"
+#include "device.hpp"
+#include "shader.hpp"
+#include "descriptor.hpp"
 
 
 // TODO 不使用 static，但是可以使用 singleton。这样依赖关系明确一些。
@@ -29,21 +32,25 @@ private:
     const int32_t WINDOW_INIT_WIDTH  = 800;
     const int32_t WINDOW_INIT_HEIGHT = 800;
 
-    std::shared_ptr<spdlog::logger>      _logger;
-    DebugUserData                        _debug_user_data;
-    std::unique_ptr<Hiss::Window>        _window;
-    vk::DebugUtilsMessengerCreateInfoEXT _debug_msger_info;
-    std::unique_ptr<Instance>            _instance;
-    vk::DebugUtilsMessengerEXT           _debug_msger;
-    vk::SurfaceKHR                       _surface;
+    std::shared_ptr<spdlog::logger>        _logger;
+    DebugUserData                          _debug_user_data;
+    std::unique_ptr<Hiss::Window>          _window;
+    vk::DebugUtilsMessengerCreateInfoEXT   _debug_msger_info;
+    std::unique_ptr<Instance>              _instance;
+    vk::DebugUtilsMessengerEXT             _debug_msger;
+    vk::SurfaceKHR                         _surface;
+    std::unique_ptr<Device>                _device;
+    std::shared_ptr<ShaderLibrary>         _shader_library;
+    std::unique_ptr<DescriptorLayoutCache> _descriptor_layout_cache;
+    std::unique_ptr<DescriptorAllocator>   _descriptor_allocator;    // 生命周期和 application 相同的 descriptor set
 
 
-    std::vector<vk::ShaderModule> shader_modules;    // 最后一起销毁
+    std::vector<std::shared_ptr<const Shader>> _shaders;    // shader_load 加载的 shader，最后一起释放
 
 
     void logger_init();
     void debug_msger_info_create();
-    void instance_init(const std::string &app_name);
+    void instance_init(const std::string &app_name, bool headless);
     void debug_utils_init();
 
 
@@ -53,11 +60,20 @@ private:
 
 
 protected:
+    /* 通过 shader library 加载，同一个文件只会读取一次，module 在 application 析构时释放 */
     vk::PipelineShaderStageCreateInfo shader_load(const std::string &file, vk::ShaderStageFlagBits stage);
 
+    Device                        &device() { return *_device; }
+    Window                        &window() { return *_window; }
+    vk::SurfaceKHR                 surface() const { return _surface; }
+    std::shared_ptr<ShaderLibrary> shader_library() { return _shader_library; }
+    DescriptorLayoutCache         &descriptor_layout_cache() { return *_descriptor_layout_cache; }
+    DescriptorAllocator           &descriptor_allocator() { return *_descriptor_allocator; }
+
 
 public:
-    ApplicationBase(const std::string &app_name);
+    /* headless 时不创建 window 和 surface，window() 不可用，只能使用 compute 和离屏的渲染 */
+    ApplicationBase(const std::string &app_name, bool headless = false);
     ~ApplicationBase();
     virtual void prepare() {}
     virtual void draw() {}
@@ -23,6 +23,13 @@ public:
     }
 
     vk::ImageView &image_view() { return _view; }
+    vk::Image     &image() { return _img; }
+
+    /* image 实际占用的显存；transient 的 attachment 在 tile based 的 GPU 上可能不会真正分配 */
+    [[nodiscard]] vk::DeviceSize memory_size() const
+    {
+        return Hiss::Env::env()->device.getImageMemoryRequirements(_img).size;
+    }
 };
 
 
@@ -68,8 +75,11 @@ public:
 class ColorAttachment : public AttachmentBase
 {
 public:
+    /* 默认是 transient 的 MSAA render target；作为 resolve 的目标并且需要被读取时，可以指定其他的 usage */
     static std::shared_ptr<ColorAttachment>
-    create(const vk::Format &format, const vk::Extent2D &extent, vk::SampleCountFlagBits msaa)
+    create(const vk::Format &format, const vk::Extent2D &extent, vk::SampleCountFlagBits msaa,
+           vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eTransientAttachment
+                                     | vk::ImageUsageFlagBits::eColorAttachment)
     {
         auto attach     = std::shared_ptr<ColorAttachment>(new ColorAttachment());
         auto env        = Hiss::Env::env();
@@ -85,8 +95,7 @@ public:
                 .samples     = msaa,
                 .tiling      = vk::ImageTiling::eOptimal,
 
-                .usage = vk::ImageUsageFlagBits::eTransientAttachment
-                         | vk::ImageUsageFlagBits::eColorAttachment,
+                .usage         = usage,
                 .sharingMode   = vk::SharingMode::eExclusive,
                 .initialLayout = vk::ImageLayout::eUndefined,
         };
@@ -0,0 +1,81 @@
+#pragma once
+#include <mutex>
+#include <vector>
+#include "include_vk.hpp"
+#include "descriptor.hpp"
+
+
+namespace Hiss
+{
+
+/**
+ * 每个 draw 通过 push constant 传递的材质信息：在 bindless 数组中的下标
+ * 和 shader 中的 push_constant block 对应
+ */
+struct MaterialIndex
+{
+    uint32_t texture{};
+    uint32_t sampler{};
+};
+
+
+/**
+ * bindless 的 texture 表：整个场景只有一个 descriptor set，所有的 texture 和 sampler 都注册在其中
+ * layout(set = x, binding = 0) uniform texture2D textures[];
+ * layout(set = x, binding = 1) uniform sampler   samplers[];
+ *
+ * 两个数组都是 update after bind + partially bound 的：
+ * 只有被 shader 实际访问的 slot 需要是有效的，而且 set 绑定之后仍然可以注册新的 texture
+ * draw 时只需要绑定一次 set，之后用 push constant 中的 MaterialIndex 选择 texture，不再需要切换 descriptor set
+ *
+ * 注销的 slot 会放入 free list 被之后的注册复用，调用者需要保证 GPU 已经不再使用这个 slot
+ * 需要 device 开启 descriptor indexing（Env::bindless）；线程安全
+ */
+class BindlessTable
+{
+public:
+    static constexpr uint32_t TEXTURE_BINDING = 0;
+    static constexpr uint32_t SAMPLER_BINDING = 1;
+
+
+    BindlessTable(vk::Device device, DescriptorLayoutCache &layout_cache, uint32_t max_textures,
+                  uint32_t max_samplers);
+    ~BindlessTable();
+    BindlessTable(const BindlessTable &)            = delete;
+    BindlessTable &operator=(const BindlessTable &) = delete;
+
+
+    /* 将 texture 写入一个空闲的 slot，返回 slot 的下标；image 需要处于 eShaderReadOnlyOptimal */
+    uint32_t texture_register(vk::ImageView img_view);
+    void     texture_unregister(uint32_t slot);
+
+    uint32_t sampler_register(vk::Sampler sampler);
+    void     sampler_unregister(uint32_t slot);
+
+    [[nodiscard]] vk::DescriptorSetLayout layout() const { return _layout; }
+    [[nodiscard]] vk::DescriptorSet       set() const { return _set; }
+
+
+private:
+    /* 基于 free list 的 slot 分配 */
+    struct SlotList
+    {
+        uint32_t              capacity{};
+        uint32_t              next{};    // 从未使用过的 slot 从这里开始
+        std::vector<uint32_t> free;
+
+        uint32_t alloc();
+        void     release(uint32_t slot);
+    };
+
+
+    vk::Device              _device;
+    vk::DescriptorPool      _pool;
+    vk::DescriptorSetLayout _layout;    // 由 layout cache 持有
+    vk::DescriptorSet       _set;
+    SlotList                _textures;
+    SlotList                _samplers;
+    std::mutex              _mutex;
+};
+
+}    // namespace Hiss
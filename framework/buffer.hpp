@@ -79,6 +79,3 @@ void uniform_buffer_create(vk::Buffer &uniform_buffer, vk::DeviceMemory &uniform
                           vk::MemoryPropertyFlagBits::eHostCoherent,
                   uniform_buffer, uniform_mem);
 }
-
-
-vk::DescriptorPool create_descriptor_pool(uint32_t frames_in_flight);
@@ -0,0 +1,78 @@
+#pragma once
+#include <span>
+#include <vector>
+#include "frustum.hpp"
+#include "thread_pool.hpp"
+
+
+namespace Hiss
+{
+
+/**
+ * 基于 BoundsSoA 中包围球的 AABB 层次包围盒，用于大规模静态物体的视锥剔除
+ *
+ * 构建：沿质心包围盒的最长轴按中位数划分
+ * - 顶部的若干层在调用线程中划分，得到足够多互不相交的子区间
+ * - 每个子区间由 ThreadPool 中的 worker 独立构建子树，最后拼接到同一个节点数组中
+ *
+ * 更新：物体移动之后不需要重新构建
+ * - refit() 自底向上重新计算所有节点的包围盒
+ * - refit(moved) 只更新移动的物体所在叶子到根的路径，包围盒不再变化时提前停止
+ * 物体移动的幅度很大时，树的质量会下降，此时应该重新 build
+ */
+class Bvh
+{
+public:
+    static constexpr uint32_t LEAF_SIZE = 4;
+
+
+    struct Node
+    {
+        glm::vec3 min{};
+        uint32_t  left{};     // 内部节点的左孩子；叶子节点中物体的起始位置（在 _indices 中）
+        glm::vec3 max{};
+        uint32_t  right{};    // 内部节点的右孩子；叶子节点中物体的数量
+        uint32_t  parent{};
+        bool      leaf{};
+    };
+
+
+    /* thread_pool 为空时在调用线程中构建 */
+    void build(const BoundsSoA &bounds, ThreadPool *thread_pool = nullptr);
+
+    void refit(const BoundsSoA &bounds);
+    void refit(const BoundsSoA &bounds, std::span<const uint32_t> moved);
+
+    /**
+     * 视锥剔除，可见物体的 id 追加到 visible 中（顺序和 id 无关）
+     * 完全在视锥内的子树不再测试，直接输出其中的所有物体
+     */
+    void cull(const BoundsSoA &bounds, const Frustum &frustum, std::vector<uint32_t> &visible) const;
+
+    [[nodiscard]] size_t node_cnt() const { return _nodes.size(); }
+
+
+private:
+    static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+    std::vector<Node>     _nodes;
+    std::vector<uint32_t> _indices;        // 叶子节点引用的物体 id，每个叶子是其中连续的一段
+    std::vector<uint32_t> _object_leaf;    // 物体所在的叶子节点
+
+
+    /* 子树的构建结果，节点的下标是局部的，0 是子树的根 */
+    struct Subtree
+    {
+        uint32_t          begin{}, end{};    // 在 _indices 中的范围
+        uint32_t          slot{};            // 子树的根在 _nodes 中的位置
+        std::vector<Node> nodes;
+    };
+
+
+    static void node_bounds_leaf(const BoundsSoA &bounds, const uint32_t *indices, Node &node);
+    static uint32_t partition(const BoundsSoA &bounds, uint32_t *indices, uint32_t begin, uint32_t end);
+    static void     subtree_build(const BoundsSoA &bounds, uint32_t *indices, Subtree &subtree);
+    bool            node_refit(const BoundsSoA &bounds, uint32_t idx);
+};
+
+}    // namespace Hiss
@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include "include_vk.hpp"
+#include "thread_pool.hpp"
+
+
+namespace Hiss
+{
+
+/**
+ * 多线程录制 secondary command buffer
+ *
+ * 每个 frame inflight 的每个线程都有一个独立的 transient command pool：
+ * - command pool 不是线程安全的，线程之间不共享 pool 就不需要加锁
+ * - 每帧开始时用 frame_reset() 整体 reset 这一帧的所有 pool，而不是逐个 reset command buffer
+ *   （pool 不带 eResetCommandBuffer flag，驱动可以使用更简单的线性分配器）
+ * - pool 中分配出来的 secondary buffer 会在之后的帧中复用
+ *
+ * 调用者需要保证 frame_reset() 时这一帧之前提交的命令已经执行完毕（例如已经等待了 inflight fence）
+ */
+class CmdRecorder
+{
+public:
+    /* 录制 draw list 中 [begin, end) 这一段，cmd 已经 begin，不需要调用者 end */
+    using RecordFn = std::function<void(vk::CommandBuffer cmd, uint32_t begin, uint32_t end)>;
+
+
+    CmdRecorder(vk::Device device, uint32_t queue_family, uint32_t frame_cnt, ThreadPool &thread_pool);
+    ~CmdRecorder();
+    CmdRecorder(const CmdRecorder &)            = delete;
+    CmdRecorder &operator=(const CmdRecorder &) = delete;
+
+
+    /* reset 这一帧的所有 pool，之前从这一帧录制得到的 command buffer 都会失效 */
+    void frame_reset(uint32_t frame_idx);
+
+    /**
+     * 将 [0, draw_cnt) 划分为最多 thread_cnt 段，每个 worker 录制一个 secondary command buffer
+     * 返回的 command buffer 和划分的顺序一致，可以直接用于 executeCommands
+     * @param inheritance secondary buffer 所在的 render pass，subpass 以及 framebuffer
+     * @param thread_cnt 为 0 时使用线程池中所有的线程
+     */
+    std::vector<vk::CommandBuffer> record(uint32_t frame_idx, const vk::CommandBufferInheritanceInfo &inheritance,
+                                          uint32_t draw_cnt, const RecordFn &fn, uint32_t thread_cnt = 0);
+
+    [[nodiscard]] uint32_t thread_cnt() const { return _thread_pool.thread_cnt(); }
+
+
+private:
+    /* 某一帧中某个线程私有的资源 */
+    struct ThreadFrame
+    {
+        vk::CommandPool                pool;
+        std::vector<vk::CommandBuffer> buffers;    // 从 pool 中分配出来的 secondary buffer，reset 之后复用
+        uint32_t                       used{};     // 这一帧已经使用了多少个 buffer
+    };
+
+
+    vk::Device                            _device;
+    ThreadPool                           &_thread_pool;
+    std::vector<std::vector<ThreadFrame>> _frames;    // [frame][thread]
+
+
+    vk::CommandBuffer buffer_get(ThreadFrame &thread_frame);
+};
+
+}    // namespace Hiss
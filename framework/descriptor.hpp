@@ -0,0 +1,114 @@
+#pragma once
+#include <array>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+#include "include_vk.hpp"
+
+
+namespace Hiss
+{
+
+/**
+ * descriptor set layout 的描述信息，作为 layout cache 的 key
+ * bindings 会按照 binding 的编号排序，因此声明顺序不同的相同 layout 会得到同一个 vk::DescriptorSetLayout
+ * binding_flags 为空，或者和 bindings 一一对应（descriptor indexing 使用）
+ */
+struct DescriptorLayoutDesc
+{
+    std::vector<vk::DescriptorSetLayoutBinding> bindings;
+    std::vector<vk::DescriptorBindingFlags>     binding_flags;
+    vk::DescriptorSetLayoutCreateFlags          flags;
+
+    [[nodiscard]] size_t hash() const;
+
+    bool operator==(const DescriptorLayoutDesc &) const = default;
+};
+
+
+struct DescriptorLayoutDescHash
+{
+    size_t operator()(const DescriptorLayoutDesc &desc) const { return desc.hash(); }
+};
+
+
+/**
+ * descriptor set layout 的缓存：相同的 bindings 只会创建一个 layout
+ * cache 拥有所有的 layout，析构时统一销毁；线程安全
+ */
+class DescriptorLayoutCache
+{
+public:
+    explicit DescriptorLayoutCache(vk::Device device)
+        : _device(device)
+    {}
+    ~DescriptorLayoutCache();
+    DescriptorLayoutCache(const DescriptorLayoutCache &)            = delete;
+    DescriptorLayoutCache &operator=(const DescriptorLayoutCache &) = delete;
+
+
+    vk::DescriptorSetLayout get(const std::vector<vk::DescriptorSetLayoutBinding> &bindings,
+                                vk::DescriptorSetLayoutCreateFlags                 flags         = {},
+                                const std::vector<vk::DescriptorBindingFlags>     &binding_flags = {});
+
+
+private:
+    vk::Device                                                                                  _device;
+    std::unordered_map<DescriptorLayoutDesc, vk::DescriptorSetLayout, DescriptorLayoutDescHash> _layouts;
+    std::mutex                                                                                  _mutex;
+};
+
+
+/**
+ * 可以增长的 descriptor 分配器，使用者不需要计算 pool 的容量
+ * 当前的 pool 耗尽时，自动创建（或者复用）一个新的 pool，后续的 pool 容量翻倍
+ * reset() 会一次性 reset 所有的 pool，适合每帧重新分配的 descriptor set：
+ * 为每个 frame in flight 创建一个 allocator，在 frame 的 fence signal 之后 reset
+ * 不支持单独释放 descriptor set；不是线程安全的，每个线程应该使用自己的 allocator
+ */
+class DescriptorAllocator
+{
+public:
+    explicit DescriptorAllocator(vk::Device device, uint32_t init_sets = 64);
+    ~DescriptorAllocator();
+    DescriptorAllocator(const DescriptorAllocator &)            = delete;
+    DescriptorAllocator &operator=(const DescriptorAllocator &) = delete;
+
+
+    /* 分配一个 descriptor set，pool 不足时自动增长 */
+    vk::DescriptorSet allocate(vk::DescriptorSetLayout layout);
+
+    /* 分配多个相同 layout 的 descriptor set，例如每个 frame in flight 一个 */
+    std::vector<vk::DescriptorSet> allocate(vk::DescriptorSetLayout layout, uint32_t cnt);
+
+    /* reset 所有的 pool，之前分配的 descriptor set 全部失效 */
+    void reset();
+
+
+private:
+    /* 每种 descriptor 在 pool 中的数量：每个 set 平均有多少个该类型的 descriptor */
+    static constexpr std::array<std::pair<vk::DescriptorType, float>, 8> POOL_RATIOS = {{
+            {vk::DescriptorType::eUniformBuffer, 2.f},
+            {vk::DescriptorType::eUniformBufferDynamic, 1.f},
+            {vk::DescriptorType::eStorageBuffer, 2.f},
+            {vk::DescriptorType::eStorageBufferDynamic, 1.f},
+            {vk::DescriptorType::eCombinedImageSampler, 4.f},
+            {vk::DescriptorType::eSampledImage, 4.f},
+            {vk::DescriptorType::eStorageImage, 1.f},
+            {vk::DescriptorType::eSampler, 1.f},
+    }};
+    static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+
+    vk::Device                      _device;
+    uint32_t                        _sets_per_pool;    // 下一个新建 pool 的容量
+    vk::DescriptorPool              _current;
+    std::vector<vk::DescriptorPool> _used_pools;    // 包括 _current
+    std::vector<vk::DescriptorPool> _free_pools;    // reset 之后可以复用的 pool
+
+
+    /* 取得一个可用的 pool：优先复用 reset 过的 pool */
+    vk::DescriptorPool pool_grab();
+};
+
+}    // namespace Hiss
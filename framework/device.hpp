@@ -1,6 +1,9 @@
 #pragma once
+#include <functional>
+#include <vector>
 #include "vk_common.hpp"
 #include "window.hpp"
+#include "present_policy.hpp"
 
 
 namespace Hiss
@@ -34,16 +37,119 @@ private:
     vk::SurfaceFormatKHR  _present_format;
     vk::PresentModeKHR    _present_mode{};
     vk::Extent2D          _present_extent;    // surface 的 extent，以像素为单位
+    bool                  _timeline_semaphore = false;
+    bool                  _sync2              = false;
+    bool                  _large_points       = false;
+    bool                  _headless           = false;
 
 
     bool physical_device_pick(vk::Instance instance, vk::SurfaceKHR surface);
     void logical_device_create();
     void present_format_choose(vk::SurfaceKHR surface);
-    void present_mode_choose(vk::SurfaceKHR surface);
+    void present_mode_choose(vk::SurfaceKHR surface, vk::PresentModeKHR preferred);
     void surface_extent_choose(vk::SurfaceKHR surface, const Hiss::Window &window);
 
 
 public:
-    Device(vk::Instance instance, vk::SurfaceKHR surface, const Hiss::Window &window);
+    /* preferred 是希望使用的 present mode，surface 不支持时由 Hiss::present_mode_choose 退回 */
+    Device(vk::Instance instance, vk::SurfaceKHR surface, const Hiss::Window &window,
+           vk::PresentModeKHR preferred = vk::PresentModeKHR::eFifo);
+
+    /* 没有 surface 的 device，用于离线计算：不开启 swapchain 扩展，present queue 就是 graphics queue */
+    explicit Device(vk::Instance instance);
+    ~Device();
+    Device(const Device &)            = delete;
+    Device &operator=(const Device &) = delete;
+
+
+    vk::Device           handle_get() const { return _device; }
+    vk::PhysicalDevice   physical_device_get() const { return _physical_device; }
+    const Queue         &graphics_queue_get() const { return _graphics_queue; }
+    const Queue         &present_queue_get() const { return _present_queue; }
+    const Queue         &compute_queue_get() const { return _compute_queue; }
+    vk::PresentModeKHR   present_mode_get() const { return _present_mode; }
+    vk::SurfaceFormatKHR present_format_get() const { return _present_format; }
+    bool                 timeline_semaphore_support() const { return _timeline_semaphore; }
+    bool                 sync2_support() const { return _sync2; }
+    bool                 large_points_support() const { return _large_points; }
+    bool                 headless() const { return _headless; }
+
+    /* compute 和 graphics 是否是不同的 queue；是同一个 queue 时，两者的提交只能串行执行 */
+    bool async_compute_support() const { return _compute_queue.queue != _graphics_queue.queue; }
+
+    /* 满足 type_bits 以及 properties 的 memory type，找不到时抛出异常 */
+    uint32_t memory_type_find(uint32_t type_bits, vk::MemoryPropertyFlags properties) const;
+
+    /* 创建 exclusive 的 buffer，分配满足 properties 的 memory 并绑定 */
+    void buffer_create(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties,
+                       vk::Buffer &buffer, vk::DeviceMemory &memory) const;
+
+    /* 释放 buffer 以及 memory，并将两者置空；空的 handle 会被忽略 */
+    void buffer_free(vk::Buffer &buffer, vk::DeviceMemory &memory) const;
+
+
+    /**
+     * 在 queue 上执行一次性的命令并等待完成，返回提交到完成的时间（ms）
+     * 前后各插入一个 global memory barrier：和之前的提交之间没有隐式的内存依赖，结束时的写入对 host 可见
+     * command buffer 从 pool 中分配，用完之后释放；pool 需要属于 queue 的 family
+     */
+    double submit_wait(const Queue &queue, vk::CommandPool pool,
+                       const std::function<void(vk::CommandBuffer)> &record) const;
+
+    /* 通过 staging buffer 将 data 的 size 字节写入 dst 的 offset 处，dst 需要 eTransferDst */
+    void buffer_upload(const Queue &queue, vk::CommandPool pool, vk::Buffer dst, const void *data,
+                       vk::DeviceSize size, vk::DeviceSize offset = 0) const;
+
+    /* 通过 staging buffer 读取 src 的 offset 处的 size 字节，src 需要 eTransferSrc */
+    void buffer_download(const Queue &queue, vk::CommandPool pool, vk::Buffer src, void *data,
+                         vk::DeviceSize size, vk::DeviceSize offset = 0) const;
+
+    /* 读取 src 开头的 cnt 个元素 */
+    template<typename T>
+    std::vector<T> buffer_download(const Queue &queue, vk::CommandPool pool, vk::Buffer src, size_t cnt) const
+    {
+        std::vector<T> data(cnt);
+        buffer_download(queue, pool, src, data.data(), sizeof(T) * cnt);
+        return data;
+    }
+};
+
+
+/**
+ * 一个 buffer 以及绑定的 memory，析构时释放；只能移动，不能复制
+ * 默认构造的 Buffer 是空的；重新赋值时先释放原来的 buffer
+ */
+class Buffer
+{
+public:
+    Buffer() = default;
+
+    /* 参数和 Device::buffer_create 相同 */
+    Buffer(const Device &device, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties);
+    ~Buffer() { reset(); }
+    Buffer(Buffer &&other) noexcept;
+    Buffer &operator=(Buffer &&other) noexcept;
+    Buffer(const Buffer &)            = delete;
+    Buffer &operator=(const Buffer &) = delete;
+
+
+    /* 释放 buffer 以及 memory，之后是空的 */
+    void reset();
+
+    /* 写入 host visible 并且 coherent 的 memory，从 offset 开始的 size 字节 */
+    void write(const void *data, vk::DeviceSize size, vk::DeviceSize offset = 0) const;
+
+    vk::Buffer       handle_get() const { return _buffer; }
+    vk::DeviceMemory memory_get() const { return _memory; }
+    vk::DeviceSize   size_get() const { return _size; }
+
+    explicit operator bool() const { return static_cast<bool>(_buffer); }
+
+
+private:
+    vk::Device       _device;
+    vk::Buffer       _buffer;
+    vk::DeviceMemory _memory;
+    vk::DeviceSize   _size = 0;
 };
 }    // namespace Hiss
\ No newline at end of file
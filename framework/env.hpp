@@ -30,8 +30,25 @@ struct DeviceInfo
     std::vector<uint32_t>                  present_queue_families;
     std::vector<uint32_t>                  transfer_queue_families;
 
+    /* descriptor indexing 相关，bindless 需要这些 feature */
+    vk::PhysicalDeviceDescriptorIndexingFeatures   descriptor_indexing_features;
+    vk::PhysicalDeviceDescriptorIndexingProperties descriptor_indexing_props;
+
+    /* vulkan 1.2 的 feature，其中的 drawIndirectCount 用于 GPU driven 的绘制；设备不是 1.2 时都为 false */
+    bool                               vulkan12{};
+    vk::PhysicalDeviceVulkan12Features vulkan12_features;
+
+    /* 是否支持 VK_KHR_present_id 和 VK_KHR_present_wait，用于测量呈现完成的时间 */
+    bool present_wait{};
+
 
     DeviceInfo(const vk::PhysicalDevice &physical_device, const vk::SurfaceKHR &surface);
+
+    /* 是否支持 bindless：update after bind，partially bound 的 sampled image 数组和 sampler 数组 */
+    [[nodiscard]] bool bindless_support() const;
+
+    /* 是否支持 GPU driven 的绘制：drawIndexedIndirectCount，multi draw indirect，以及非 0 的 firstInstance */
+    [[nodiscard]] bool gpu_driven_support() const;
 };
 
 
@@ -65,8 +82,10 @@ struct Env
     // TODO 创建一个 compute command pool
     MyCmdPool            graphics_cmd_pool;
     vk::SurfaceFormatKHR present_format;
-    vk::PresentModeKHR   present_mode{};
     vk::Extent2D         present_extent; /* surface 的 extent，以像素为单位 */
+    bool                 bindless{};     /* device 是否开启了 bindless 需要的 descriptor indexing feature */
+    bool                 gpu_driven{};   /* device 是否开启了 draw indirect count 相关的 feature */
+    bool                 present_wait{}; /* device 是否开启了 present id 和 present wait */
 
 
     static void                      free(const vk::Instance &instance);
@@ -92,7 +111,6 @@ private:
     static bool            physical_device_pick(const DeviceInfo &info);
     static vk::CommandPool cmd_pool_create(const vk::Device &device, uint32_t queue_family_indx);
     static vk::SurfaceFormatKHR present_format_choose(const std::vector<vk::SurfaceFormatKHR> &format_list_);
-    static vk::PresentModeKHR   present_mode_choose(const std::vector<vk::PresentModeKHR> &present_mode_list_);
     static vk::Extent2D         present_extent_choose(vk::SurfaceCapabilitiesKHR &capability_, GLFWwindow *window);
 };
 }    // namespace Hiss
@@ -12,36 +12,44 @@ struct FramebufferLayout_temp {
 
     vk::Format resolve_format;
     vk::SampleCountFlagBits resolve_sample;
+
+    /* resolve attachment 在 render pass 结束时的 layout：直接 present 是 present src，之后要 blit 是 transfer src */
+    vk::ImageLayout resolve_final_layout = vk::ImageLayout::ePresentSrcKHR;
 };
 
 
 /**
- * 共 3 个 attachment：color，depth，resolve
- * MSAA 使用最大值
+ * 共 3 个 attachment：color，depth，resolve；resolve attachment 就是 swapchain 的 image
+ * 采样数为 1 时没有 resolve，只有 2 个 attachment：color（swapchain 的 image），depth
  */
 class MSAAFramebuffer
 {
 private:
     std::vector<vk::Framebuffer> _framebuffers;
     std::shared_ptr<DepthAttachment> _depth_attach;
-    std::shared_ptr<ColorAttachment> _color_attach;
+    std::shared_ptr<ColorAttachment> _color_attach;    // 采样数为 1 时为空
 
     MSAAFramebuffer(const vk::RenderPass &render_pass,
                     const FramebufferLayout_temp &framebuffer_layout,
                     const std::vector<vk::ImageView> &resolve_views, const vk::Extent2D &extent)
     {
-        auto env = Hiss::Env::env();
+        auto env  = Hiss::Env::env();
+        bool msaa = framebuffer_layout.color_sample != vk::SampleCountFlagBits::e1;
 
 
-        /* 创建各种 attachment */
-        _color_attach = ColorAttachment::create(framebuffer_layout.color_format, extent,
-                                                framebuffer_layout.color_sample);
+        /* 创建各种 attachment，swapchain 的 image 在后面动态填充 */
         _depth_attach = DepthAttachment::create(extent, framebuffer_layout.depth_sample,
                                                 framebuffer_layout.depth_format);
-        std::array<vk::ImageView, 3> attachments = {
-                _color_attach->image_view(), _depth_attach->image_view(),
-                /* resolve attachment 在后面动态填充 */
-        };
+        std::vector<vk::ImageView> attachments;
+        if (msaa)
+        {
+            _color_attach = ColorAttachment::create(framebuffer_layout.color_format, extent,
+                                                    framebuffer_layout.color_sample);
+            attachments   = {_color_attach->image_view(), _depth_attach->image_view(), {}};
+        }
+        else
+            attachments = {{}, _depth_attach->image_view()};
+        size_t target_idx = msaa ? 2 : 0;
 
 
         vk::FramebufferCreateInfo framebuffer_create_info = {
@@ -55,7 +63,7 @@ private:
         _framebuffers.reserve(resolve_views.size());
         for (const auto &resolve_view: resolve_views)
         {
-            attachments[2] = resolve_view;
+            attachments[target_idx] = resolve_view;
             _framebuffers.push_back(Hiss::Env::env()->device.createFramebuffer(
                     framebuffer_create_info));
         }
@@ -78,6 +86,13 @@ public:
     }
 
 
+    /* attachment 占用的显存，不包括 swapchain 的 image */
+    [[nodiscard]] vk::DeviceSize memory_size() const
+    {
+        return _depth_attach->memory_size() + (_color_attach ? _color_attach->memory_size() : 0);
+    }
+
+
     void free()
     {
         auto env = Hiss::Env::env();
@@ -85,8 +100,115 @@ public:
         for (auto &framebuffer: _framebuffers)
             env->device.destroy(framebuffer);
         _depth_attach->free();
-        _color_attach->free();
+        if (_color_attach)
+            _color_attach->free();
     }
 
     ~MSAAFramebuffer() { this->free(); }
 };
+
+
+/**
+ * 离屏的 framebuffer：color，depth，resolve 三个 attachment；采样数为 1 时没有单独的 color attachment
+ * 所有的 attachment 都按照最大的 extent（通常是 swapchain 的 extent）分配，实际只渲染左上角的一部分，
+ * 因此改变渲染分辨率时不需要重新分配；resolve attachment 之后再经过后处理或者 blit 到 swapchain 的 image 上
+ */
+class ScaledFramebuffer
+{
+private:
+    vk::Framebuffer _framebuffer;
+    vk::Extent2D _max_extent;
+    std::shared_ptr<DepthAttachment> _depth_attach;
+    std::shared_ptr<ColorAttachment> _color_attach;    // 采样数为 1 时为空
+    std::shared_ptr<ColorAttachment> _resolve_attach;
+
+    ScaledFramebuffer(const vk::RenderPass &render_pass, const FramebufferLayout_temp &framebuffer_layout,
+                      const vk::Extent2D &max_extent)
+        : _max_extent(max_extent)
+    {
+        _depth_attach   = DepthAttachment::create(max_extent, framebuffer_layout.depth_sample,
+                                                  framebuffer_layout.depth_format);
+        _resolve_attach = ColorAttachment::create(framebuffer_layout.resolve_format, max_extent,
+                                                  framebuffer_layout.resolve_sample,
+                                                  vk::ImageUsageFlagBits::eColorAttachment
+                                                          | vk::ImageUsageFlagBits::eTransferSrc
+                                                          | vk::ImageUsageFlagBits::eSampled);
+        std::vector<vk::ImageView> attachments = {_resolve_attach->image_view(), _depth_attach->image_view()};
+        if (framebuffer_layout.color_sample != vk::SampleCountFlagBits::e1)
+        {
+            _color_attach = ColorAttachment::create(framebuffer_layout.color_format, max_extent,
+                                                    framebuffer_layout.color_sample);
+            attachments   = {_color_attach->image_view(), _depth_attach->image_view(), _resolve_attach->image_view()};
+        }
+
+        _framebuffer = Hiss::Env::env()->device.createFramebuffer(vk::FramebufferCreateInfo{
+                .renderPass      = render_pass,
+                .attachmentCount = static_cast<uint32_t>(attachments.size()),
+                .pAttachments    = attachments.data(),
+                .width           = max_extent.width,
+                .height          = max_extent.height,
+                .layers          = 1,
+        });
+    }
+
+public:
+    static std::shared_ptr<ScaledFramebuffer> create(const vk::RenderPass &render_pass,
+                                                     const FramebufferLayout_temp &framebuffer_layout,
+                                                     const vk::Extent2D &max_extent)
+    {
+        return std::shared_ptr<ScaledFramebuffer>(
+                new ScaledFramebuffer(render_pass, framebuffer_layout, max_extent));
+    }
+
+
+    vk::Framebuffer &framebuffer_get() { return _framebuffer; }
+    vk::Image &resolve_image() { return _resolve_attach->image(); }
+    vk::ImageView &resolve_view() { return _resolve_attach->image_view(); }
+    [[nodiscard]] const vk::Extent2D &max_extent() const { return _max_extent; }
+
+    [[nodiscard]] vk::DeviceSize memory_size() const
+    {
+        return _depth_attach->memory_size() + _resolve_attach->memory_size()
+             + (_color_attach ? _color_attach->memory_size() : 0);
+    }
+
+
+    /**
+     * 将 resolve attachment 左上角 src_extent 的部分线性缩放到 dst_image 的 dst_extent 上
+     * 调用之前 resolve attachment 应该处于 transfer src 的 layout（render pass 的 final layout），
+     * dst_image 的内容会被丢弃，blit 之后转换为 present src
+     */
+    void blit_record(vk::CommandBuffer cmd, const vk::Extent2D &src_extent, vk::Image dst_image,
+                     const vk::Extent2D &dst_extent)
+    {
+        /* resolve 的写入需要在 blit 读取之前完成 */
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eTransfer,
+                            {}, {}, {},
+                            {vk::ImageMemoryBarrier{
+                                    .srcAccessMask       = vk::AccessFlagBits::eColorAttachmentWrite,
+                                    .dstAccessMask       = vk::AccessFlagBits::eTransferRead,
+                                    .oldLayout           = vk::ImageLayout::eTransferSrcOptimal,
+                                    .newLayout           = vk::ImageLayout::eTransferSrcOptimal,
+                                    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                                    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                                    .image               = _resolve_attach->image(),
+                                    .subresourceRange    = {.aspectMask = vk::ImageAspectFlagBits::eColor,
+                                                            .levelCount = 1,
+                                                            .layerCount = 1},
+                            }});
+
+        present_blit_record(cmd, _resolve_attach->image(), src_extent, dst_image, dst_extent);
+    }
+
+
+    void free()
+    {
+        Hiss::Env::env()->device.destroy(_framebuffer);
+        _depth_attach->free();
+        if (_color_attach)
+            _color_attach->free();
+        _resolve_attach->free();
+    }
+
+    ~ScaledFramebuffer() { this->free(); }
+};
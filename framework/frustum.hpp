@@ -0,0 +1,81 @@
+#pragma once
+#include <array>
+#include <vector>
+#include "include_vk.hpp"
+#include "thread_pool.hpp"
+
+
+namespace Hiss
+{
+
+/**
+ * 视锥：6 个平面，xyz 是朝向视锥内部的单位法线，w 是距离
+ * 点 p 在平面内侧当且仅当 dot(xyz, p) + w >= 0
+ */
+struct Frustum
+{
+    enum class Test
+    {
+        OUTSIDE,
+        INTERSECT,
+        INSIDE,
+    };
+
+
+    std::array<glm::vec4, 6> planes{};
+
+
+    /**
+     * 从 view projection 矩阵中提取视锥的 6 个平面（Gribb-Hartmann）
+     * 深度范围是 [0, 1]，因此 near 平面就是第 3 行
+     */
+    static Frustum extract(const glm::mat4 &view_proj);
+
+    [[nodiscard]] bool sphere_visible(const glm::vec3 &center, float radius) const;
+
+    /* AABB 和视锥的关系；只使用离平面最远的顶点（p-vertex）和最近的顶点（n-vertex）进行测试 */
+    [[nodiscard]] Test aabb_test(const glm::vec3 &min, const glm::vec3 &max) const;
+};
+
+
+/**
+ * 场景中物体的包围球，structure of arrays 的布局，方便 SIMD 一次处理多个物体
+ * 物体的 id 就是在数组中的下标
+ */
+struct BoundsSoA
+{
+    std::vector<float> cx, cy, cz, radius;
+
+
+    [[nodiscard]] size_t size() const { return cx.size(); }
+
+    void reserve(size_t cnt);
+
+    /* 追加一个物体，返回它的 id */
+    uint32_t add(const glm::vec3 &center, float r);
+
+    void set(uint32_t id, const glm::vec3 &center, float r);
+
+    [[nodiscard]] glm::vec3 center(uint32_t id) const { return {cx[id], cy[id], cz[id]}; }
+};
+
+
+/**
+ * 对 [begin, end) 中的物体做视锥剔除，将可见物体的 id 按顺序追加到 visible 中
+ * 根据平台选择实现：x86 上 CPU 支持时使用 AVX2（每次 8 个物体），ARM 上使用 NEON（每次 4 个物体），否则使用标量实现
+ */
+void frustum_cull(const BoundsSoA &bounds, const Frustum &frustum, size_t begin, size_t end,
+                  std::vector<uint32_t> &visible);
+
+/* 标量实现，作为 SIMD 实现的参照 */
+void frustum_cull_scalar(const BoundsSoA &bounds, const Frustum &frustum, size_t begin, size_t end,
+                         std::vector<uint32_t> &visible);
+
+/* 多线程版本：每个线程处理一段，结果按照 id 的顺序合并 */
+void frustum_cull(const BoundsSoA &bounds, const Frustum &frustum, ThreadPool &thread_pool,
+                  std::vector<uint32_t> &visible);
+
+/* 当前平台使用的 SIMD 实现的名称：avx2，neon 或者 scalar */
+const char *frustum_cull_isa();
+
+}    // namespace Hiss
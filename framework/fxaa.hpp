@@ -0,0 +1,77 @@
+#pragma once
+#include <string>
+#include "include_vk.hpp"
+#include "profile.hpp"
+#include "pipeline.hpp"
+#include "descriptor.hpp"
+
+
+namespace Hiss
+{
+
+/**
+ * FXAA 后处理：compute shader 读取 resolve 之后的图像，将抗锯齿的结果写入一个 storage image
+ * 相比 MSAA，只需要每个像素一次 invocation，和场景的复杂度无关，但是会让纹理的细节变模糊
+ *
+ * 输入和输出都按照 framebuffer 的最大尺寸分配，每帧只处理左上角 extent 的区域，可以配合动态分辨率
+ * 输出的格式是 R16G16B16A16Sfloat，之后通常 blit 到 swapchain 的 image 上
+ */
+class Fxaa
+{
+public:
+    static constexpr uint32_t   WORKGROUP_SIZE = 8;
+    static constexpr vk::Format FORMAT         = vk::Format::eR16G16B16A16Sfloat;
+
+
+    Fxaa(PipelineRegistry &pipelines, DescriptorLayoutCache &layout_cache, DescriptorAllocator &allocator,
+         const std::string &shader_path = SHADER("fxaa.comp.spv"));
+    ~Fxaa();
+    Fxaa(const Fxaa &)            = delete;
+    Fxaa &operator=(const Fxaa &) = delete;
+
+
+    /**
+     * 绑定输入图像，并按照 max_extent 重新分配输出图像
+     * 输入的 framebuffer 重新创建之后需要再次调用；调用者需要保证 device 已经空闲
+     */
+    void resize(vk::ImageView src_view, const vk::Extent2D &max_extent);
+
+    /**
+     * 录制 FXAA 的 compute pass，需要在 render pass 之外调用
+     * 调用前 src 处于 transfer src layout（render pass 的 final layout），之后处于 shader read only；
+     * 输出图像在结束时处于 transfer src layout，可以直接作为 blit 的源
+     */
+    void record(vk::CommandBuffer cmd, vk::Image src, const vk::Extent2D &extent);
+
+    [[nodiscard]] vk::Image output() const { return _output; }
+
+    /* 输出图像占用的显存 */
+    [[nodiscard]] vk::DeviceSize memory_size() const { return _output_size; }
+
+
+private:
+    struct Push
+    {
+        glm::ivec2 extent;
+        glm::vec2  inv_size;
+    };
+
+
+    PipelineRegistry       &_pipelines;
+    vk::DescriptorSetLayout _set_layout;
+    vk::PipelineLayout      _pipeline_layout;
+    ShaderDesc              _shader;
+    vk::DescriptorSet       _set;
+    vk::Sampler             _sampler;
+
+    vk::Extent2D     _max_extent{};
+    vk::Image        _output;
+    vk::DeviceMemory _output_mem;
+    vk::ImageView    _output_view;
+    vk::DeviceSize   _output_size{};
+
+
+    void output_free();
+};
+
+}    // namespace Hiss
@@ -44,9 +44,10 @@ private:
     struct UserData
     {
         bool resized;
+        bool refresh;    // 窗口的内容需要刷新，例如被遮挡之后重新显示
     };
     inline static GLFWwindow *_window = nullptr;
-    inline static UserData    _user_data{false};
+    inline static UserData    _user_data{false, false};
 
 
 public:
@@ -67,6 +68,10 @@ public:
             auto user_data     = reinterpret_cast<UserData *>(glfwGetWindowUserPointer(window));
             user_data->resized = true;
         });
+        glfwSetWindowRefreshCallback(_window, [](GLFWwindow *window) {
+            auto user_data     = reinterpret_cast<UserData *>(glfwGetWindowUserPointer(window));
+            user_data->refresh = true;
+        });
     }
 
     static GLFWwindow *window_get()
@@ -86,6 +91,10 @@ public:
     /* 设置 window 是否 resize */
     static void resized(bool state) { _user_data.resized = state; }
 
+    /* 窗口系统是否要求刷新窗口的内容 */
+    static bool need_refresh() { return _user_data.refresh; }
+    static void need_refresh(bool state) { _user_data.refresh = state; }
+
     /**
      * 等待退出最小化。等待时阻塞
      */
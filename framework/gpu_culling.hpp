@@ -0,0 +1,159 @@
+#pragma once
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+#include <optional>
+#include "include_vk.hpp"
+#include "profile.hpp"
+#include "pipeline.hpp"
+#include "readback.hpp"
+#include "descriptor.hpp"
+
+
+namespace Hiss
+{
+
+/**
+ * GPU driven 的绘制：compute shader 对实例做视锥剔除，并选择 LOD，
+ * 将可见的实例写成 VkDrawIndexedIndirectCommand，graphics pass 用 drawIndexedIndirectCount 消费
+ * 每个 LOD 有自己的一段 draw command 和一个计数器，因此 CPU 每帧录制的命令数量只和 LOD 的数量有关，和实例的数量无关
+ *
+ * draw command 的 firstInstance 是实例的下标，vertex shader 通过 gl_InstanceIndex 读取实例的变换：
+ * layout(set = x, binding = 0) readonly buffer Instances { Instance instances[]; };
+ *
+ * 每个 frame inflight 有自己的 uniform buffer，draw buffer 和 count buffer，
+ * 可见实例的数量通过 ReadbackRing 回读，在 N 帧之后可以读取
+ * 需要 device 开启 GPU driven 相关的 feature（Env::gpu_driven）
+ */
+class GpuCulling
+{
+public:
+    static constexpr uint32_t MAX_LODS       = 8;
+    static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+
+    /* 和 shader 中的 struct 对应（std430） */
+    struct Instance
+    {
+        glm::mat4 model{1.f};
+        glm::vec4 bound{};    // 模型空间的包围球，xyz：球心，w：半径
+    };
+
+
+    /* LOD 在 index buffer 中的范围，以及几何误差 */
+    struct Lod
+    {
+        uint32_t first_index{};
+        uint32_t index_cnt{};
+        int32_t  vertex_offset{};
+        float    error{};
+    };
+
+
+    /* 相机相关的参数，每帧更新 */
+    struct View
+    {
+        glm::mat4 local{1.f};    // 所有实例共享的变换，先于实例的 model 矩阵作用
+        glm::mat4 view_proj{1.f};
+        glm::vec3 eye{0.f};
+        float     lod_scale{};            // viewport_height / (2 * tan(fov_y / 2))
+        float     lod_threshold = 1.f;    // 允许的屏幕空间误差（像素）
+        int32_t   lod_force     = -1;     // 大于等于 0 时所有实例都使用这个 LOD
+    };
+
+
+    struct Stat
+    {
+        uint32_t                       total{};
+        uint32_t                       visible{};
+        std::array<uint32_t, MAX_LODS> lod_visible{};
+    };
+
+
+    GpuCulling(PipelineRegistry &pipelines, DescriptorLayoutCache &layout_cache, DescriptorAllocator &allocator,
+               uint32_t frame_cnt, const std::string &shader_path = SHADER("cull.comp.spv"));
+    ~GpuCulling();
+    GpuCulling(const GpuCulling &)            = delete;
+    GpuCulling &operator=(const GpuCulling &) = delete;
+
+
+    /**
+     * 上传实例数据，容量不足时会重新创建 buffer
+     * 会覆盖 GPU 正在使用的 buffer，调用者需要保证 device 已经空闲
+     */
+    void instances_upload(const std::vector<Instance> &instances);
+
+    void lods_set(const std::vector<Lod> &lods);
+
+    /**
+     * 录制剔除的 compute pass，需要在 render pass 之外调用
+     * 结束时插入 barrier，之后的 draw indirect 可以读取结果
+     */
+    void cull_record(vk::CommandBuffer cmd, uint32_t frame_idx, const View &view);
+
+    /* 录制某个 LOD 的 drawIndexedIndirectCount，调用者需要绑定这个 LOD 的 index buffer 以及 instance_set */
+    void draw_record(vk::CommandBuffer cmd, uint32_t frame_idx, uint32_t lod) const;
+
+    /* 读取 frame_idx 上一次剔除的统计数据，调用者需要先等待这一帧的 fence */
+    std::optional<Stat> stat(uint32_t frame_idx);
+
+    /* vertex shader 读取实例数据使用的 set */
+    [[nodiscard]] vk::DescriptorSetLayout instance_layout() const { return _instance_layout; }
+    [[nodiscard]] vk::DescriptorSet       instance_set() const { return _instance_set; }
+
+
+private:
+    /* 和 shader 中的 uniform block 对应（std140） */
+    struct CullUBO
+    {
+        glm::mat4                 local;
+        std::array<glm::vec4, 6>  planes;    // 视锥的 6 个平面，xyz：朝内的法线，w：距离
+        glm::vec4                 eye;
+        std::array<Lod, MAX_LODS> lods;
+        uint32_t                  instance_cnt;
+        uint32_t                  lod_cnt;
+        float                     lod_scale;
+        float                     lod_threshold;
+        uint32_t                  draw_capacity;
+        int32_t                   lod_force;
+    };
+
+
+    /* 每个 frame inflight 私有的资源 */
+    struct Frame
+    {
+        vk::Buffer        ubo;
+        vk::DeviceMemory  ubo_mem;
+        CullUBO          *ubo_data{};
+        vk::Buffer        draws;
+        vk::DeviceMemory  draws_mem;
+        vk::Buffer        counts;
+        vk::DeviceMemory  counts_mem;
+        vk::DescriptorSet set;
+        uint32_t          total{};    // 录制时实例的数量，用于统计
+    };
+
+
+    PipelineRegistry       &_pipelines;
+    vk::DescriptorSetLayout _cull_layout;
+    vk::DescriptorSetLayout _instance_layout;
+    vk::PipelineLayout      _pipeline_layout;
+    ShaderDesc              _shader;
+    vk::DescriptorSet       _instance_set;
+
+    vk::Buffer         _instances;
+    vk::DeviceMemory   _instances_mem;
+    uint32_t           _capacity{};
+    uint32_t           _instance_cnt{};
+    std::vector<Lod>   _lods;
+    std::vector<Frame> _frames;
+    ReadbackRing       _readback;
+
+
+    void buffers_create(uint32_t capacity);
+    void buffers_free();
+    void descriptors_write();
+};
+
+}    // namespace Hiss
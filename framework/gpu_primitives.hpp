@@ -0,0 +1,156 @@
+#pragma once
+#include <map>
+#include <array>
+#include <string>
+#include <vector>
+#include "include_vk.hpp"
+#include "profile.hpp"
+#include "device.hpp"
+#include "pipeline.hpp"
+#include "descriptor.hpp"
+
+
+namespace Hiss
+{
+
+/**
+ * GPU 上常用的并行原语，作用于 storage buffer 中的 uint32 数组：
+ *  - scan：exclusive / inclusive 前缀和，reduce-then-scan，每个 block 1024 个元素，block 的和递归 scan
+ *  - reduce：add / min / max，多级归约
+ *  - histogram：(x >> shift) & (bin_cnt - 1)，shared memory 中统计之后合并
+ *  - compact：保留 flag 非零的元素，保持原来的顺序，数量写入 count buffer
+ *  - sort：稳定的 key-value LSD radix sort，4 bit 一趟，趟数由 key 的有效位数决定
+ * workgroup 内的 scan 和排序的 rank 使用 subgroup 的 arithmetic 和 ballot 操作，设备不支持时构造函数抛出异常
+ *
+ * 所有的 *_record 只录制 compute 命令，可以在任何支持 compute 的 queue 上执行：
+ *  - 输入由调用者保证可见，结束时插入 compute -> compute 的 barrier，之后的 compute shader 可以直接读取结果
+ *  - 元素数量不能超过 reserve() 的容量，临时 buffer 由这个对象持有
+ *  - descriptor set 按照使用的 buffer 缓存，buffer 被销毁之后需要调用 descriptors_reset()
+ * 不是线程安全的
+ */
+class GpuPrimitives
+{
+public:
+    static constexpr uint32_t WORKGROUP_SIZE       = 256;
+    static constexpr uint32_t ITEMS_PER_INVOCATION = 4;    // scan，reduce 和 histogram
+    static constexpr uint32_t BLOCK_SIZE           = WORKGROUP_SIZE * ITEMS_PER_INVOCATION;
+    static constexpr uint32_t RADIX_BITS           = 4;    // sort 中每个 block 是 WORKGROUP_SIZE 个元素
+    static constexpr uint32_t RADIX                = 1u << RADIX_BITS;
+    static constexpr uint32_t MAX_BINS             = 4096;
+    static constexpr uint32_t MIN_SUBGROUP_SIZE    = 4;    // 和 shader 中 shared memory 的大小对应
+
+
+    enum class ReduceOp : uint32_t
+    {
+        ADD = 0,
+        MIN = 1,
+        MAX = 2,
+    };
+
+
+    GpuPrimitives(Device &device, PipelineRegistry &pipelines, DescriptorLayoutCache &layout_cache,
+                  const std::string &shader_dir = SHADER("primitives"));
+    ~GpuPrimitives();
+    GpuPrimitives(const GpuPrimitives &)            = delete;
+    GpuPrimitives &operator=(const GpuPrimitives &) = delete;
+
+
+    /**
+     * 按照最大的元素数量分配临时 buffer；容量足够时什么也不做
+     * 会释放 GPU 可能正在使用的 buffer，调用者需要保证 device 已经空闲
+     */
+    void reserve(uint32_t capacity);
+
+    /* 使用过的 buffer 被销毁或者重新创建之后调用；调用者需要保证 device 已经空闲 */
+    void descriptors_reset();
+
+    [[nodiscard]] uint32_t       capacity() const { return _capacity; }
+    [[nodiscard]] vk::DeviceSize memory_size() const { return _memory_size; }
+
+
+    /* dst[i] = src[0] + ... + src[i - 1]（inclusive 时包括 src[i]）；dst 可以和 src 相同 */
+    void scan_record(vk::CommandBuffer cmd, vk::Buffer src, vk::Buffer dst, uint32_t cnt, bool inclusive = false);
+
+    /* 归约的结果写入 dst[0] */
+    void reduce_record(vk::CommandBuffer cmd, vk::Buffer src, uint32_t cnt, vk::Buffer dst,
+                       ReduceOp op = ReduceOp::ADD);
+
+    /* dst[bin_cnt] 先用 fillBuffer 清零再统计，需要 eTransferDst；bin_cnt 是不超过 MAX_BINS 的 2 的幂 */
+    void histogram_record(vk::CommandBuffer cmd, vk::Buffer src, uint32_t cnt, vk::Buffer dst, uint32_t bin_cnt,
+                          uint32_t shift = 0);
+
+    /* flags[i] != 0 的 src[i] 依次写入 dst，保留的数量写入 count[0] */
+    void compact_record(vk::CommandBuffer cmd, vk::Buffer src, vk::Buffer flags, uint32_t cnt, vk::Buffer dst,
+                        vk::Buffer count);
+
+    /**
+     * 按照 key 的低 key_bits 位升序排序，原地修改 keys 和 values；相同的 key 保持原来的顺序
+     * values 可以为空，此时只排序 key；趟数是奇数时结果从临时 buffer 复制回来，keys 和 values 需要 eTransferDst
+     */
+    void sort_record(vk::CommandBuffer cmd, vk::Buffer keys, vk::Buffer values, uint32_t cnt, uint32_t key_bits = 32);
+
+
+private:
+    static constexpr uint32_t BINDING_CNT = 5;
+
+    static constexpr uint32_t FLAG_INCLUSIVE  = 1u << 0;
+    static constexpr uint32_t FLAG_OFFSETS    = 1u << 1;
+    static constexpr uint32_t FLAG_HAS_VALUES = 1u << 2;
+
+
+    /* 和 prim_common.glsl 中的 push constant 一致 */
+    struct Push
+    {
+        uint32_t cnt;
+        uint32_t shift;
+        uint32_t flags;
+        uint32_t block_cnt;
+    };
+
+    using Bindings = std::array<vk::Buffer, BINDING_CNT>;
+
+
+    Device                 &_device;
+    PipelineRegistry       &_pipelines;
+    vk::DescriptorSetLayout _set_layout;
+    vk::PipelineLayout      _pipeline_layout;
+
+    /* descriptor set 由自己的 allocator 分配，descriptors_reset() 时一起 reset */
+    DescriptorAllocator                   _allocator;
+    std::map<Bindings, vk::DescriptorSet> _sets;
+
+    ShaderDesc _shader_reduce;
+    ShaderDesc _shader_scan;
+    ShaderDesc _shader_histogram;
+    ShaderDesc _shader_compact;
+    ShaderDesc _shader_radix_count;
+    ShaderDesc _shader_radix_scatter;
+
+    uint32_t            _max_group_cnt;
+    uint32_t            _shared_memory_size;
+    uint32_t            _capacity    = 0;
+    vk::DeviceSize      _memory_size = 0;
+    Buffer              _dummy;      // 不使用的 binding
+    std::vector<Buffer> _levels;     // scan 和 reduce 每一级 block 的和
+    Buffer              _offsets;    // compact 中 flags 的 scan
+    Buffer              _keys_tmp;
+    Buffer              _values_tmp;
+    Buffer              _hist;
+
+
+    void buffers_free();
+
+    /* 空的 buffer 绑定到 _dummy */
+    vk::DescriptorSet set_get(Bindings bindings);
+
+    void dispatch(vk::CommandBuffer cmd, const ShaderDesc &shader, const Bindings &bindings, const Push &push,
+                  uint32_t group_cnt);
+
+    /* 递归的 scan，level 是使用的第一个 _levels；predicate 为 true 时 scan 的是 (src[i] != 0) */
+    void scan_levels_record(vk::CommandBuffer cmd, vk::Buffer src, vk::Buffer dst, uint32_t cnt, bool inclusive,
+                            bool predicate, uint32_t level);
+
+    void capacity_check(uint32_t cnt) const;
+};
+
+}    // namespace Hiss
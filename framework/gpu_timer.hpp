@@ -0,0 +1,57 @@
+#pragma once
+#include <vector>
+#include <optional>
+#include "include_vk.hpp"
+
+
+namespace Hiss
+{
+
+/**
+ * 基于 timestamp query 的 GPU 计时器
+ * 每个 frame inflight 有 scope_cnt 个计时区间，每个区间占用两个 query（开始和结束）
+ * 和 ReadbackRing 一样，第 i 帧写入的结果在等待第 i 帧的 fence 之后读取，CPU 不会等待 GPU
+ *
+ * 使用方法：
+ *  timer.reset_record(cmd, frame);            // 每帧一次，需要在 render pass 之外
+ *  timer.begin_record(cmd, frame, scope);
+ *  ...
+ *  timer.end_record(cmd, frame, scope);
+ *  // N 帧之后，等待 fence 之后
+ *  timer.elapsed_ms(frame, scope);
+ */
+class GpuTimer
+{
+public:
+    GpuTimer(uint32_t frame_cnt, uint32_t scope_cnt);
+    ~GpuTimer();
+    GpuTimer(const GpuTimer &)            = delete;
+    GpuTimer &operator=(const GpuTimer &) = delete;
+
+
+    /* graphics queue 是否支持 timestamp；不支持时所有的 record 都是空操作 */
+    [[nodiscard]] bool supported() const { return _supported; }
+
+    void reset_record(vk::CommandBuffer cmd, uint32_t frame_idx);
+    void begin_record(vk::CommandBuffer cmd, uint32_t frame_idx, uint32_t scope);
+    void end_record(vk::CommandBuffer cmd, uint32_t frame_idx, uint32_t scope);
+
+    /* 某个区间在 GPU 上的耗时，单位是 ms；区间没有被记录或者结果还不可用时返回 nullopt */
+    std::optional<double> elapsed_ms(uint32_t frame_idx, uint32_t scope);
+
+
+private:
+    vk::QueryPool     _pool;
+    uint32_t          _scope_cnt;
+    bool              _supported = false;
+    double            _period_ns = 1.0;    // 每个 tick 的纳秒数
+    std::vector<bool> _written;            // [frame * scope_cnt + scope]，区间的两端是否都已经写入
+
+
+    [[nodiscard]] uint32_t query_idx(uint32_t frame_idx, uint32_t scope) const
+    {
+        return (frame_idx * _scope_cnt + scope) * 2;
+    }
+};
+
+}    // namespace Hiss
@@ -0,0 +1,71 @@
+#pragma once
+#include <bit>
+#include <array>
+#include <string>
+#include <type_traits>
+#include "include_vk.hpp"
+
+
+namespace Hiss
+{
+
+/**
+ * FNV-1a，逐个字段地加入 hash，用于 PipelineDesc、descriptor set layout 等需要稳定 hash 的描述信息
+ * 只接受标量（整数，枚举，浮点数，vk 的 flags 和 handle），避免将 struct 的 padding 计算进去
+ */
+class Hasher
+{
+public:
+    template<typename T>
+    Hasher &add(const T &val)
+    {
+        if constexpr (std::is_enum_v<T>)
+            bytes_add(static_cast<std::underlying_type_t<T>>(val));
+        else if constexpr (std::is_same_v<T, bool>)
+            bytes_add(static_cast<uint8_t>(val));
+        else if constexpr (std::is_floating_point_v<T>)
+            bytes_add(val == 0 ? T{} : val);    // +0.f 和 -0.f 相等，hash 也需要相同
+        else if constexpr (std::is_arithmetic_v<T>)
+            bytes_add(val);
+        else if constexpr (requires { typename T::MaskType; })    // vk::Flags
+            bytes_add(static_cast<typename T::MaskType>(val));
+        else
+            bytes_add(reinterpret_cast<uint64_t>(static_cast<typename T::CType>(val)));    // vk handle
+        return *this;
+    }
+
+    Hasher &add(const std::string &str)
+    {
+        add(str.size());
+        for (char c: str)
+            byte_add(static_cast<uint8_t>(c));
+        return *this;
+    }
+
+    Hasher &add(const vk::StencilOpState &s)
+    {
+        return add(s.failOp).add(s.passOp).add(s.depthFailOp).add(s.compareOp).add(s.compareMask).add(s.writeMask).add(
+                s.reference);
+    }
+
+    [[nodiscard]] size_t value() const { return _hash; }
+
+private:
+    uint64_t _hash = 0xcbf29ce484222325ull;
+
+    void byte_add(uint8_t b)
+    {
+        _hash ^= b;
+        _hash *= 0x100000001b3ull;
+    }
+
+    template<typename T>
+    void bytes_add(const T &val)
+    {
+        auto bytes = std::bit_cast<std::array<uint8_t, sizeof(T)>>(val);
+        for (uint8_t b: bytes)
+            byte_add(b);
+    }
+};
+
+}    // namespace Hiss
@@ -19,4 +19,11 @@ vk::ImageView img_view_create(const vk::Image &tex_img, const vk::Format &format
 vk::Sampler sampler_create(std::optional<uint32_t> mip_levels);
 
 void mipmap_generate(vk::Image &image, const vk::Format &format, int32_t width, int32_t height,
-                     uint32_t mip_levels);
\ No newline at end of file
+                     uint32_t mip_levels);
+
+/**
+ * 将 src_image 左上角 src_extent 的部分线性缩放到 dst_image 的 dst_extent 上，结束后 dst_image 处于 present src
+ * 调用之前 src_image 应该处于 transfer src 的 layout 并且写入已经可见；dst_image 原来的内容会被丢弃
+ */
+void present_blit_record(vk::CommandBuffer cmd, vk::Image src_image, const vk::Extent2D &src_extent,
+                         vk::Image dst_image, const vk::Extent2D &dst_extent);
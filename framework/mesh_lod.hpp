@@ -0,0 +1,42 @@
+#pragma once
+#include <vector>
+#include "include_vk.hpp"
+#include "vertex.hpp"
+
+
+namespace Hiss
+{
+
+/**
+ * LOD 链中的一个 level，所有 level 共享同一个 vertex buffer，只有 index 不同
+ * error 表示简化带来的几何误差，单位是模型空间的长度，level 0 的误差为 0
+ */
+struct MeshLod
+{
+    std::vector<uint32_t> indices;
+    float                 error{};
+};
+
+
+/**
+ * 基于 quadric error metric 的网格简化，生成 LOD 链
+ * 使用 half-edge collapse：顶点只会被合并到已有的顶点上，不会产生新的顶点，因此可以共享 vertex buffer
+ * 只需要顶点的位置；返回的结果不包含 level 0，也就是原始的 indices
+ * @param max_levels 最多生成多少个 level（包括 level 0）
+ * @param ratio 每一个 level 的三角形数量相对于上一个 level 的比例
+ */
+std::vector<MeshLod> lod_chain_generate(const glm::vec3 *positions, size_t vertex_cnt, const uint32_t *indices,
+                                        size_t index_cnt, uint32_t max_levels, float ratio = 0.5f);
+
+
+/**
+ * 根据投影到屏幕上的误差选择 LOD，返回屏幕误差不超过 threshold（像素）的最粗糙的 level
+ * @param errors 每个 level 的几何误差，需要是递增的
+ * @param distance 物体到相机的距离
+ * @param fov_y 竖直方向的视角，弧度
+ * @param viewport_height viewport 的高度，像素
+ */
+uint32_t lod_select(const std::vector<float> &errors, float distance, float fov_y, float viewport_height,
+                    float threshold);
+
+}    // namespace Hiss
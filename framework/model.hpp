@@ -1,22 +1,48 @@
 #pragma once
 
+#include <cstring>
 #include "./include_vk.hpp"
 #include "./render_pass.hpp"
 #include "profile.hpp"
 #include "env.hpp"
-#include <tiny_obj_loader.h>
-#include <unordered_map>
+#include "buffer.hpp"
+#include "mesh_lod.hpp"
+#include "obj_loader.hpp"
+
+
+/**
+ * 模型的一个实例，LOD 是针对每个实例单独选择的
+ */
+struct ModelInstance
+{
+    glm::mat4 model{1.f};
+    uint32_t  lod{};
+    uint32_t  material{};    // bindless 模式下，在材质列表中的下标
+};
 
 
 class TestModel
 {
-    std::vector<Vertex> _vertices;
-    std::vector<uint32_t> _indices;
+    /* LOD 链的最大层数，以及允许的屏幕空间误差（像素） */
+    static constexpr uint32_t LOD_MAX_LEVELS  = 6;
+    static constexpr float    LOD_PIXEL_ERROR = 1.f;
+
+    /* 每个 LOD 有自己的 index buffer，所有 LOD 共享同一个 vertex buffer */
+    struct LodBuffer
+    {
+        vk::Buffer       index_buffer;
+        vk::DeviceMemory index_mem;
+        uint32_t         index_cnt{};
+    };
 
     vk::Buffer _vertex_buffer;
     vk::DeviceMemory _vertex_mem;
-    vk::Buffer _index_buffer;
-    vk::DeviceMemory _index_mem;
+    std::vector<LodBuffer> _lods;
+    std::vector<float>     _lod_errors;
+
+    /* 模型空间的包围球，用于计算实例到相机的距离 */
+    glm::vec3 _bound_center{0.f};
+    float     _bound_radius{};
 
     std::string MODEL_PATH   = MODEL("viking_room.obj");
     std::string TEXTURE_PATH = TEXTURE("viking_room.png");
@@ -25,65 +51,134 @@ class TestModel
 public:
     void model_load()
     {
-        tinyobj::attrib_t attr;
-        std::vector<tinyobj::shape_t> shapes;
-        std::vector<tinyobj::material_t> materials;
+        auto env = Hiss::Env::env();
+
+        Hiss::ObjLoader loader(MODEL_PATH);
+        loader.parse();
+
+
+        /**
+         * 焊接之后的 vertex 直接写入 stage buffer，不经过中间的数组
+         * LOD 需要读取 index 和位置，而 host visible 的内存可能是 write-combined 的，读取很慢，
+         * 因此 index 先写入 CPU 的数组再复制到 stage buffer，位置单独写入 CPU 的数组
+         */
+        auto                  index_cnt  = static_cast<uint32_t>(loader.index_cnt());
+        std::vector<uint32_t> indices(index_cnt);
+        size_t                vertex_cnt = loader.indices_write(indices.data());
+
+        std::vector<glm::vec3> positions(vertex_cnt);
+        loader.positions_write(positions.data());
+
+        vk::DeviceSize   index_size = sizeof(uint32_t) * index_cnt;
+        vk::Buffer       index_stage;
+        vk::DeviceMemory index_stage_mem;
+        buffer_create(index_size, vk::BufferUsageFlagBits::eTransferSrc,
+                      vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                      index_stage, index_stage_mem);
+        std::memcpy(env->device.mapMemory(index_stage_mem, 0, index_size, {}), indices.data(), index_size);
+        env->device.unmapMemory(index_stage_mem);
+
+        vk::DeviceSize   vertex_size = sizeof(Vertex) * vertex_cnt;
+        vk::Buffer       vertex_stage;
+        vk::DeviceMemory vertex_stage_mem;
+        buffer_create(vertex_size, vk::BufferUsageFlagBits::eTransferSrc,
+                      vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                      vertex_stage, vertex_stage_mem);
+        loader.vertices_write(static_cast<Vertex *>(env->device.mapMemory(vertex_stage_mem, 0, vertex_size, {})));
+        env->device.unmapMemory(vertex_stage_mem);
+
+
+        /* stage buffer -> vertex buffer, level 0 的 index buffer */
+        LodBuffer lod_0{.index_cnt = index_cnt};
+        buffer_create(vertex_size, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer,
+                      vk::MemoryPropertyFlagBits::eDeviceLocal, _vertex_buffer, _vertex_mem);
+        buffer_create(index_size, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer,
+                      vk::MemoryPropertyFlagBits::eDeviceLocal, lod_0.index_buffer, lod_0.index_mem);
+        {
+            OneTimeCmdBuffer cmd;
+            cmd().copyBuffer(vertex_stage, _vertex_buffer, {vk::BufferCopy{.size = vertex_size}});
+            cmd().copyBuffer(index_stage, lod_0.index_buffer, {vk::BufferCopy{.size = index_size}});
+            cmd.end();
+        }
+        _lods.push_back(lod_0);
+        _lod_errors.push_back(0.f);
 
-        std::string err;
 
-        if (!tinyobj::LoadObj(&attr, &shapes, &materials, &err, MODEL_PATH.c_str()))
-            throw std::runtime_error(err);
+        lod_create(positions, indices);
 
 
-        /* TinyObjLoader 不会重复利用模型中的顶点，这里手动重用.
-         * Vertex hash 需要实现两个函数：equality test, hash calculation */
-        std::unordered_map<Vertex, uint32_t> uniq_vertices;
+        env->device.destroy(index_stage);
+        env->device.destroy(vertex_stage);
+        env->device.free(index_stage_mem);
+        env->device.free(vertex_stage_mem);
+    }
+
 
-        for (const auto &shape: shapes)
+    /**
+     * 导入时生成 LOD 链，为 level 0 之外的每个 level 创建 index buffer
+     */
+    void lod_create(const std::vector<glm::vec3> &positions, const std::vector<uint32_t> &indices)
+    {
+        glm::vec3 bound_min(std::numeric_limits<float>::max()), bound_max(std::numeric_limits<float>::lowest());
+        for (const glm::vec3 &pos: positions)
         {
-            for (const auto &index: shape.mesh.indices)
-            {
-                Vertex vertex = {
-                        .pos   = {attr.vertices[3 * index.vertex_index + 0],
-                                  attr.vertices[3 * index.vertex_index + 1],
-                                  attr.vertices[3 * index.vertex_index + 2]},
-                        .color = {1.f, 1.f, 1.f},
-
-                        /**
-                         * stbi 将 picture 左上角视为 data[0]，
-                         * vulkan 将 data[0] 视为 texture 的左上角，
-                         * .obj 文件将 picture 左下角视为 uv 的起点，因此 tex coord 的 v 需要做如下变换
-                         */
-                        .tex_coord = {attr.texcoords[2 * index.texcoord_index + 0],
-                                      1.f - attr.texcoords[2 * index.texcoord_index + 1]},
-                };
-
-                if (uniq_vertices.count(vertex) == 0)
-                {
-                    uniq_vertices[vertex] = static_cast<uint32_t>(_vertices.size());
-                    _vertices.push_back(vertex);
-                }
-
-                _indices.push_back(uniq_vertices[vertex]);
-            }
+            bound_min = glm::min(bound_min, pos);
+            bound_max = glm::max(bound_max, pos);
         }
+        _bound_center = (bound_min + bound_max) * 0.5f;
+        _bound_radius = glm::length(bound_max - bound_min) * 0.5f;
 
-        vertex_buffer_create(_vertices, _vertex_buffer, _vertex_mem);
-        index_buffer_create(_indices, _index_buffer, _index_mem);
+
+        auto lods = Hiss::lod_chain_generate(positions.data(), positions.size(), indices.data(), indices.size(),
+                                             LOD_MAX_LEVELS);
+        for (const auto &lod: lods)
+        {
+            LodBuffer lod_buffer{.index_cnt = static_cast<uint32_t>(lod.indices.size())};
+            index_buffer_create(lod.indices, lod_buffer.index_buffer, lod_buffer.index_mem);
+            _lods.push_back(lod_buffer);
+            _lod_errors.push_back(lod.error);
+        }
+
+        for (uint32_t i = 0; i < _lods.size(); ++i)
+            LogStatic::logger()->info("[lod] level {}: triangles {}, error {:.5f}", i, _lods[i].index_cnt / 3,
+                                      _lod_errors[i]);
+    }
+
+
+    /**
+     * 根据实例在屏幕上的投影误差选择 LOD
+     * @param eye 相机在世界空间的位置
+     */
+    uint32_t lod_select(const ModelInstance &instance, const glm::vec3 &eye, float fov_y, float viewport_height) const
+    {
+        glm::vec3 center   = glm::vec3(instance.model * glm::vec4(_bound_center, 1.f));
+        float     distance = std::max(glm::length(eye - center) - _bound_radius, 0.f);
+        return Hiss::lod_select(_lod_errors, distance, fov_y, viewport_height, LOD_PIXEL_ERROR);
     }
 
 
     vk::Buffer &vertex_buffer() { return _vertex_buffer; }
-    vk::Buffer &index_buffer() { return _index_buffer; }
-    uint32_t index_cnt() { return _indices.size(); }
+    vk::Buffer &index_buffer(uint32_t lod = 0) { return _lods[lod].index_buffer; }
+    uint32_t index_cnt(uint32_t lod = 0) { return _lods[lod].index_cnt; }
+    uint32_t lod_cnt() const { return static_cast<uint32_t>(_lods.size()); }
+    float    lod_error(uint32_t lod) const { return _lod_errors[lod]; }
+
+    /* 允许的屏幕空间误差（像素） */
+    static constexpr float lod_threshold() { return LOD_PIXEL_ERROR; }
+
+    /* 模型空间的包围球，xyz：球心，w：半径 */
+    glm::vec4 bound() const { return glm::vec4(_bound_center, _bound_radius); }
 
 
     void resource_free()
     {
         auto env = Hiss::Env::env();
-        env->device.free(_index_mem);
+        for (auto &lod: _lods)
+        {
+            env->device.free(lod.index_mem);
+            env->device.destroy(lod.index_buffer);
+        }
         env->device.free(_vertex_mem);
         env->device.destroy(_vertex_buffer);
-        env->device.destroy(_index_buffer);
     }
 };
\ No newline at end of file
@@ -0,0 +1,112 @@
+#pragma once
+#include <vector>
+#include "include_vk.hpp"
+#include "thread_pool.hpp"
+
+
+namespace Hiss
+{
+
+/**
+ * CPU 上的 N-body 参考实现，物理模型和 compute_Nbody/calculate.comp 相同：
+ *  a_i = sum_j G * m_j * d / (|d|^2 + SOFTEN)^POWER，d = p_j - p_i
+ *  之后 v += dt * a，p += dt * v（半隐式 Euler）
+ *
+ * 质点的布局和 GPU 一致（pos/mass，vel/uv），计算前复制为 structure of arrays，
+ * 长度补齐到 LANE_ALIGN 的整数倍，补齐的质点质量为 0，不产生引力，SIMD kernel 因此不需要处理余数
+ *
+ * 受力按照分块计算：每个线程负责若干个 I_BLOCK 大小的 i 块，i 块内按照 J_TILE 大小遍历 j，
+ * 一个 j tile 留在 L1 中被 i 块内的所有 SIMD 向量重复使用
+ * 每个质点累加 j 的顺序和线程划分无关，多线程的结果和单线程的结果逐位相同
+ */
+class NBodyCpu
+{
+public:
+    static constexpr size_t LANE_ALIGN = 16;      // AVX-512 一次处理 16 个质点
+    static constexpr size_t I_BLOCK    = 64;      // LANE_ALIGN 的整数倍，也是线程划分的粒度
+    static constexpr size_t J_TILE     = 1024;    // 4 个 float 数组共 16 KB
+
+
+    struct Particle
+    {
+        glm::vec4 pos;    // xyz: position, w: mass
+        glm::vec4 vel;    // xyz: velocity, w: uv coord
+    };
+
+    /* 和 calculate.comp 的 specialization constant 一致 */
+    struct Physics
+    {
+        float gravity = 0.002f;
+        float power   = 0.75f;
+        float soften  = 0.05f;
+    };
+
+    enum class Kernel
+    {
+        SCALAR,
+        AVX2,
+        AVX512,
+        NEON,
+    };
+
+    /* 两组向量之间的相对误差：每个向量的 |a - b| / |a|，以及整体的 RMS */
+    struct Error
+    {
+        double   rms     = 0.;
+        double   max     = 0.;
+        uint32_t max_idx = 0;
+    };
+
+
+    NBodyCpu();
+    explicit NBodyCpu(const Physics &physics);
+
+
+    /* 从 AoS 的质点复制为 SoA；加速度清零 */
+    void load(const std::vector<Particle> &particles);
+    void load(const Particle *particles, size_t cnt);
+
+    /* 写回 AoS 的质点，uv 保持不变 */
+    void store(std::vector<Particle> &particles) const;
+
+    [[nodiscard]] size_t size() const { return _cnt; }
+
+    [[nodiscard]] glm::vec3 accel(size_t i) const { return {_ax[i], _ay[i], _az[i]}; }
+
+
+    /**
+     * 计算所有质点的加速度；thread_pool 为空时在调用线程上执行
+     * kernel 不被当前 CPU 支持时抛出异常
+     */
+    void accel_compute(Kernel kernel, ThreadPool *thread_pool = nullptr);
+
+    /* 使用加速度更新速度，再使用新的速度更新位置 */
+    void integrate(float delta_time);
+
+    /* 完整的一步：accel_compute + integrate */
+    void step(float delta_time, Kernel kernel, ThreadPool *thread_pool = nullptr);
+
+
+    /* 当前 CPU 上最快的 kernel，以及某个 kernel 是否可用 */
+    static Kernel      kernel_best();
+    static bool        kernel_support(Kernel kernel);
+    static const char *kernel_name(Kernel kernel);
+
+    static Error compare(const std::vector<glm::vec3> &reference, const std::vector<glm::vec3> &value);
+
+
+private:
+    Physics _physics;
+    size_t  _cnt = 0;
+
+    /* 长度为 padded 的 SoA；w 是质量 */
+    std::vector<float> _x, _y, _z, _w;
+    std::vector<float> _vx, _vy, _vz, _uv;
+    std::vector<float> _ax, _ay, _az;
+
+
+    /* 计算 [begin, end) 中质点的加速度，begin 和 end 都是 LANE_ALIGN 的整数倍 */
+    void accel_range(Kernel kernel, size_t begin, size_t end);
+};
+
+}    // namespace Hiss
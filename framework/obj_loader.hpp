@@ -0,0 +1,122 @@
+#pragma once
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+#include "include_vk.hpp"
+#include "vertex.hpp"
+
+
+namespace Hiss
+{
+
+/**
+ * OBJ 文件的读取器，只支持用到的子集：v/vt/vn/f，o/g，usemtl
+ * 文件通过 mmap 映射到内存，按行边界切分给多个线程并行解析
+ * 焊接后的 vertex 和 index 直接写入调用者提供的内存（通常是 map 之后的 stage buffer）
+ *
+ * 使用方法：
+ *  ObjLoader loader(path);
+ *  loader.parse();
+ *  size_t vertex_cnt = loader.indices_write(index_dst);    // index_dst 的容量为 loader.index_cnt()
+ *  loader.vertices_write(vertex_dst);                      // vertex_dst 的容量为 vertex_cnt
+ *  loader.positions_write(position_dst);                   // 可选，只需要位置时使用
+ */
+class ObjLoader
+{
+public:
+    /* o/g/usemtl 划分出来的一段连续的 index */
+    struct Group
+    {
+        std::string name;
+        std::string material;
+        size_t      index_offset{};
+        size_t      index_cnt{};
+    };
+
+
+    explicit ObjLoader(const std::string &path, uint32_t thread_cnt = std::thread::hardware_concurrency());
+    ~ObjLoader();
+    ObjLoader(const ObjLoader &)            = delete;
+    ObjLoader &operator=(const ObjLoader &) = delete;
+
+
+    /* 多线程解析整个文件 */
+    void parse();
+
+    /* 三角化之后 index 的数量，在 parse 之后有效 */
+    [[nodiscard]] size_t index_cnt() const { return _index_cnt; }
+
+    /**
+     * 焊接顶点：position 和 tex coord 都相同的 corner 使用同一个 vertex
+     * @param dst 写入 index 的位置，容量至少为 index_cnt()
+     * @return 焊接之后 vertex 的数量
+     */
+    size_t indices_write(uint32_t *dst);
+
+    /* 在 indices_write 之后调用，多线程地将 vertex 写入 dst */
+    void vertices_write(Vertex *dst) const;
+
+    /* 在 indices_write 之后调用，只写入每个 vertex 的位置，例如用于生成 LOD */
+    void positions_write(glm::vec3 *dst) const;
+
+    [[nodiscard]] const std::vector<Group> &groups() const { return _groups; }
+
+
+private:
+    static constexpr uint32_t NO_INDEX = std::numeric_limits<uint32_t>::max();
+
+    /* 面的一个顶点，已经转换为从 0 开始的全局 index */
+    struct Corner
+    {
+        uint32_t v;
+        uint32_t vt;
+    };
+
+    /* 负数（相对）的 index 需要在知道前面的 chunk 有多少数据之后才能确定 */
+    struct Fixup
+    {
+        size_t  corner;
+        int64_t local;    // 相对于 chunk 起点的 index，可能为负
+        bool    tex;
+    };
+
+    struct GroupEvent
+    {
+        size_t      corner;    // 事件发生时，chunk 内已经有多少个 corner
+        bool        material;
+        std::string name;
+    };
+
+    /* 每个线程负责的一段文件 */
+    struct Chunk
+    {
+        const char             *begin{};
+        const char             *end{};
+        std::vector<glm::vec3>  positions;
+        std::vector<glm::vec2>  tex_coords;
+        std::vector<Corner>     corners;    // 三角化之后，每 3 个一组
+        std::vector<Fixup>      fixups;
+        std::vector<GroupEvent> events;
+        size_t                  position_base{};
+        size_t                  tex_coord_base{};
+    };
+
+
+    uint32_t           _thread_cnt;
+    const char        *_data{};
+    size_t             _size{};
+    std::vector<Chunk> _chunks;
+
+    std::vector<glm::vec3> _positions;
+    std::vector<glm::vec2> _tex_coords;
+    std::vector<uint64_t>  _weld_keys;    // 焊接后的每个 vertex 对应的 (v, vt)
+    std::vector<Group>     _groups;
+    size_t                 _index_cnt{};
+
+
+    static void chunk_parse(Chunk &chunk);
+    void        groups_build();
+};
+
+}    // namespace Hiss
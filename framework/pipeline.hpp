@@ -0,0 +1,190 @@
+#pragma once
+#include <array>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "include_vk.hpp"
+#include "shader.hpp"
+
+
+namespace Hiss
+{
+
+/**
+ * pipeline 中的一个 shader stage
+ * specialization constant 以 (map entry, data) 的形式给出，和 vk::SpecializationInfo 的含义相同
+ */
+struct ShaderDesc
+{
+    vk::ShaderStageFlagBits                stage{};
+    std::string                            path;    // SPIR-V 文件的路径，通过 ShaderLibrary 加载
+    std::string                            entry = "main";
+    std::vector<vk::SpecializationMapEntry> spec_entries;
+    std::vector<uint8_t>                    spec_data;
+
+
+    /* 追加一个 specialization constant，offset 和 size 自动计算 */
+    template<typename T>
+    ShaderDesc &spec_add(uint32_t constant_id, const T &value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        spec_entries.push_back({.constantID = constant_id,
+                                .offset     = static_cast<uint32_t>(spec_data.size()),
+                                .size       = sizeof(T)});
+        auto bytes = reinterpret_cast<const uint8_t *>(&value);
+        spec_data.insert(spec_data.end(), bytes, bytes + sizeof(T));
+        return *this;
+    }
+
+    bool operator==(const ShaderDesc &) const = default;
+};
+
+
+/**
+ * pipeline 的声明式描述：shader，vertex input，以及所有的固定功能状态
+ * 是一个值类型，可以比较、可以 hash，相同的 desc 对应同一个 pipeline
+ * 如果 shaders 中只有一个 compute shader，表示 compute pipeline，其他的字段会被忽略
+ *
+ * 默认值和原先 pipeline_create 中写死的状态一致；viewport 和 scissor 默认是 dynamic 的，
+ * 这样窗口尺寸改变时不需要重新创建 pipeline
+ */
+struct PipelineDesc
+{
+    std::vector<ShaderDesc> shaders;
+
+    /* vertex input */
+    std::vector<vk::VertexInputBindingDescription>   vertex_bindings;
+    std::vector<vk::VertexInputAttributeDescription> vertex_attrs;
+    vk::PrimitiveTopology                            topology          = vk::PrimitiveTopology::eTriangleList;
+    bool                                             primitive_restart = false;
+
+    /* 光栅化 */
+    bool              depth_clamp         = false;
+    bool              rasterizer_discard  = false;
+    vk::PolygonMode   polygon_mode        = vk::PolygonMode::eFill;
+    vk::CullModeFlags cull_mode           = vk::CullModeFlagBits::eBack;
+    vk::FrontFace     front_face          = vk::FrontFace::eCounterClockwise;
+    bool              depth_bias          = false;
+    float             depth_bias_constant = 0.f;
+    float             depth_bias_clamp    = 0.f;
+    float             depth_bias_slope    = 0.f;
+    float             line_width          = 1.f;
+
+    /* MSAA */
+    vk::SampleCountFlagBits samples            = vk::SampleCountFlagBits::e1;
+    bool                    sample_shading     = false;
+    float                   min_sample_shading = 0.f;
+    bool                    alpha_to_coverage  = false;
+
+    /* 深度测试和模版测试 */
+    bool               depth_test    = true;
+    bool               depth_write   = true;
+    vk::CompareOp      depth_compare = vk::CompareOp::eLess;
+    bool               stencil_test  = false;
+    vk::StencilOpState stencil_front{};
+    vk::StencilOpState stencil_back{};
+
+    /* blend：每个 color attachment 一个 */
+    std::vector<vk::PipelineColorBlendAttachmentState> color_blends = {color_blend_opaque()};
+    std::array<float, 4>                               blend_constants{};
+
+    std::vector<vk::DynamicState> dynamic_states = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+
+    /* pipeline 的 layout 以及绑定的 render pass */
+    vk::PipelineLayout layout;
+    vk::RenderPass     render_pass;
+    uint32_t           subpass = 0;
+
+
+    /* 不进行 blend，写入所有的 channel */
+    static vk::PipelineColorBlendAttachmentState color_blend_opaque();
+
+    /* 加法混合：dst + src，结果和绘制的顺序无关，适合发光的粒子 */
+    static vk::PipelineColorBlendAttachmentState color_blend_additive();
+
+    /* premultiplied alpha 的 over 混合：src + dst * (1 - src.a)，需要从后向前绘制 */
+    static vk::PipelineColorBlendAttachmentState color_blend_premultiplied();
+
+    /* 只包含一个 compute shader 的 desc */
+    static PipelineDesc compute(const ShaderDesc &shader, vk::PipelineLayout layout);
+
+    [[nodiscard]] bool is_compute() const
+    {
+        return shaders.size() == 1 && shaders.front().stage == vk::ShaderStageFlagBits::eCompute;
+    }
+
+    /**
+     * 稳定的 hash：只依赖于各个字段的值，逐个字段计算，不受 padding 以及 vector 地址的影响
+     * 对于同一个 device，相同的 desc 在不同的进程中得到的 hash 也相同（layout 和 render pass 的 handle 除外）
+     */
+    [[nodiscard]] size_t hash() const;
+
+    bool operator==(const PipelineDesc &) const = default;
+};
+
+
+struct PipelineDescHash
+{
+    size_t operator()(const PipelineDesc &desc) const { return desc.hash(); }
+};
+
+
+/**
+ * pipeline 的注册表：相同的 PipelineDesc 只会编译一次，之后直接返回已有的 pipeline
+ * 材质和 pass 可以随意请求 pipeline，不用担心重复编译
+ * 注册表拥有所有的 pipeline，析构时统一销毁；线程安全
+ * shader module 来自 ShaderLibrary，每个 pipeline 持有它用到的 module 的引用，
+ * pipeline 被销毁之后，不再被任何 pipeline 使用的 module 才会被释放
+ */
+class PipelineRegistry
+{
+public:
+    struct Stat
+    {
+        size_t hit{};
+        size_t miss{};
+    };
+
+
+    PipelineRegistry(vk::Device device, std::shared_ptr<ShaderLibrary> shader_library);
+    ~PipelineRegistry();
+    PipelineRegistry(const PipelineRegistry &)            = delete;
+    PipelineRegistry &operator=(const PipelineRegistry &) = delete;
+
+
+    /* 返回 desc 对应的 pipeline，如果不存在，就创建一个 */
+    vk::Pipeline get(const PipelineDesc &desc);
+
+    /* 销毁所有的 pipeline，例如 render pass 或者 layout 被重新创建之后 */
+    void clear();
+
+    [[nodiscard]] size_t size() const;
+    [[nodiscard]] Stat   stat() const;
+
+
+private:
+    struct Entry
+    {
+        vk::Pipeline                               pipeline;
+        std::vector<std::shared_ptr<const Shader>> shaders;
+    };
+
+    vk::Device                                                _device;
+    std::shared_ptr<ShaderLibrary>                            _shader_library;
+    vk::PipelineCache                                         _cache;
+    std::unordered_map<PipelineDesc, Entry, PipelineDescHash> _pipelines;
+    Stat                                                      _stat;
+    mutable std::mutex                                        _mutex;
+
+
+    vk::Pipeline graphics_pipeline_create(const PipelineDesc &desc, Entry &entry);
+    vk::Pipeline compute_pipeline_create(const PipelineDesc &desc, Entry &entry);
+
+    /* 从 library 获得 shader module 以及对应的 stage info，specialization info 的存储由调用者提供 */
+    std::vector<vk::PipelineShaderStageCreateInfo> stages_create(const PipelineDesc &desc, Entry &entry,
+                                                                 std::vector<vk::SpecializationInfo> &spec_infos);
+};
+
+}    // namespace Hiss
+
@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+#include <optional>
+#include "include_vk.hpp"
+
+
+namespace Hiss
+{
+
+/**
+ * 基于 pipeline statistics query 的计数器，例如统计 fragment shader 的调用次数
+ * 每个 frame inflight 有一个 query，和 GpuTimer 一样在等待这一帧的 fence 之后读取，CPU 不会等待 GPU
+ *
+ * query 在 primary command buffer 中、render pass 之外开始和结束；
+ * 期间 execute 的 secondary command buffer 需要 inheritedQueries feature，
+ * 并且在 inheritance info 中声明 pipelineStatistics
+ */
+class PipelineStatQuery
+{
+public:
+    PipelineStatQuery(uint32_t frame_cnt, vk::QueryPipelineStatisticFlags stats);
+    ~PipelineStatQuery();
+    PipelineStatQuery(const PipelineStatQuery &)            = delete;
+    PipelineStatQuery &operator=(const PipelineStatQuery &) = delete;
+
+
+    /* device 是否开启了 pipelineStatisticsQuery；不支持时所有的 record 都是空操作 */
+    [[nodiscard]] bool supported() const { return _supported; }
+
+    /* secondary command buffer 能否继承 primary 中正在进行的 query */
+    [[nodiscard]] bool inherited() const { return _inherited; }
+
+    [[nodiscard]] vk::QueryPipelineStatisticFlags stats() const { return _stats; }
+
+    void reset_record(vk::CommandBuffer cmd, uint32_t frame_idx);
+    void begin_record(vk::CommandBuffer cmd, uint32_t frame_idx);
+    void end_record(vk::CommandBuffer cmd, uint32_t frame_idx);
+
+    /* 各个计数器的值，顺序和 stats 中 bit 的顺序一致；没有被记录或者结果还不可用时返回 nullopt */
+    std::optional<std::vector<uint64_t>> results(uint32_t frame_idx);
+
+
+private:
+    vk::QueryPool                   _pool;
+    vk::QueryPipelineStatisticFlags _stats;
+    uint32_t                        _stat_cnt{};
+    bool                            _supported = false;
+    bool                            _inherited = false;
+    std::vector<bool>               _written;    // [frame]，query 是否已经结束
+};
+
+}    // namespace Hiss
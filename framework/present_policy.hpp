@@ -0,0 +1,122 @@
+#pragma once
+#include <deque>
+#include <chrono>
+#include <vector>
+#include <optional>
+#include "include_vk.hpp"
+
+
+namespace Hiss
+{
+
+/**
+ * 呈现策略：present mode，swapchain 中 image 的数量，帧率上限，以及是否在提交之前才采样输入
+ * - FIFO：等待垂直同步，不会撕裂，所有设备都支持；队列中等待的帧越多，延迟越高
+ * - FIFO_RELAXED：和 FIFO 相同，但是上一帧错过了垂直同步时立即呈现，可能撕裂
+ * - MAILBOX：不会撕裂，新的帧替换队列中等待的帧，延迟低，但是 GPU 会一直满负荷运行
+ * - IMMEDIATE：立即呈现，延迟最低，会撕裂
+ *
+ * late latching：先用较早的输入录制 command buffer，在提交之前重新采样输入并更新 uniform，
+ * 录制的耗时不再计入输入到呈现的延迟
+ */
+struct PresentPolicy
+{
+    const char        *name       = "default";
+    vk::PresentModeKHR mode       = vk::PresentModeKHR::eFifo;
+    uint32_t           image_cnt  = 0;        // swapchain 中 image 的数量，0 表示 minImageCount + 1
+    double             fps_limit  = 0.;       // 帧率上限，0 表示不限制
+    bool               late_latch = false;    // 提交之前才采样输入并更新 uniform
+
+
+    /**
+     * 低延迟：MAILBOX，3 个 image（呈现一帧的同时保留一个等待的帧，并且渲染下一帧），不限制帧率，开启 late latching
+     * MAILBOX 不被支持时依次退回 IMMEDIATE，FIFO_RELAXED，FIFO
+     */
+    static PresentPolicy low_latency();
+
+    /* 省电：FIFO，2 个 image，限制为 30 帧，GPU 和 CPU 大部分时间都是空闲的 */
+    static PresentPolicy power_saving();
+};
+
+
+/**
+ * 选择 surface 支持的 present mode：preferred 不被支持时，按照延迟从低到高的顺序退回
+ * FIFO 是所有设备都支持的，因此总是可以找到
+ */
+vk::PresentModeKHR present_mode_choose(const std::vector<vk::PresentModeKHR> &supported,
+                                       vk::PresentModeKHR                     preferred);
+
+/* requested 为 0 时使用 minImageCount + 1；结果限制在 surface 允许的范围内（maxImageCount 为 0 表示没有上限） */
+uint32_t swapchain_image_cnt(const vk::SurfaceCapabilitiesKHR &capability, uint32_t requested);
+
+
+/**
+ * 帧率限制：每一帧开始时等待到预定的时间，应该放在采样输入之前，这样等待的时间不会变成输入的延迟
+ * 先 sleep，最后 1 ms 自旋等待，减少 sleep 的误差
+ */
+class FrameLimiter
+{
+public:
+    /* fps 为 0 时不限制 */
+    void fps_set(double fps);
+
+    void wait();
+
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Clock::duration   _interval{};
+    Clock::time_point _next{};
+};
+
+
+/**
+ * 统计输入到提交，以及输入到呈现的延迟
+ * 每一帧有一个递增的 id，同时也作为 VK_KHR_present_id 的 present id；
+ * 呈现完成的时间由调用者通过 Swapchain::present_wait 轮询得到，精度受轮询的频率限制
+ */
+class PresentLatency
+{
+public:
+    struct Stat
+    {
+        uint32_t submitted{};
+        double   input_to_submit{};     // ms
+        uint32_t presented{};
+        double   input_to_present{};    // ms
+    };
+
+
+    void input_record(uint64_t frame_id);
+    void submit_record(uint64_t frame_id);
+    void present_record(uint64_t frame_id);
+
+    /* 最早的已经提交但尚未呈现的帧 */
+    [[nodiscard]] std::optional<uint64_t> oldest_pending() const;
+
+    /* swapchain 重新创建之后，旧的 present id 不会再完成 */
+    void reset() { _pending.clear(); }
+
+    /* 返回累积的平均值，并清空 */
+    Stat stat_take();
+
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    /* 设备不支持 present wait 时，pending 不会被消耗，限制其长度 */
+    static constexpr size_t MAX_PENDING = 64;
+
+    struct Frame
+    {
+        uint64_t          id;
+        Clock::time_point input;
+        bool              submitted;
+    };
+
+    std::deque<Frame> _pending;
+    Stat              _sum;
+};
+
+}    // namespace Hiss
@@ -0,0 +1,69 @@
+#pragma once
+#include <vector>
+#include "include_vk.hpp"
+#include "device.hpp"
+
+
+namespace Hiss
+{
+
+/**
+ * GPU -> CPU 的回读环，每个 frame inflight 有一个 slot
+ * 第 i 帧将数据 copy 到 slot i，等待 slot i 对应的 inflight fence 之后（也就是 N 帧之后）再读取，
+ * 这样 CPU 不会为了读取统计数据而等待 GPU 空闲
+ *
+ * 优先使用 host cached 的内存，CPU 读取更快；内存不是 coherent 时，读取之前会 invalidate
+ * 不同的 slot 可以在不同的线程中读取
+ */
+class ReadbackRing
+{
+public:
+    ReadbackRing(vk::DeviceSize slot_size, uint32_t slot_cnt);
+
+    /* 不依赖 Env，使用 ApplicationBase 的 device */
+    ReadbackRing(const Device &device, vk::DeviceSize slot_size, uint32_t slot_cnt);
+    ~ReadbackRing();
+    ReadbackRing(const ReadbackRing &)            = delete;
+    ReadbackRing &operator=(const ReadbackRing &) = delete;
+
+
+    /**
+     * 录制 src -> slot 的 copy，以及 transfer -> host 的 barrier
+     * 读取之前调用者还需要等待这个 command buffer 执行完毕
+     */
+    void copy_record(vk::CommandBuffer cmd, uint32_t slot, vk::Buffer src, vk::DeviceSize src_offset,
+                     vk::DeviceSize size);
+
+    /* slot 的内容；slot 从来没有被写入过时返回 nullptr */
+    template<typename T>
+    const T *read(uint32_t slot)
+    {
+        return static_cast<const T *>(data_get(slot));
+    }
+
+    [[nodiscard]] uint32_t slot_cnt() const { return static_cast<uint32_t>(_slots.size()); }
+
+
+private:
+    struct Slot
+    {
+        vk::Buffer       buffer;
+        vk::DeviceMemory memory;
+        void            *data{};
+        bool             written = false;
+    };
+
+
+    vk::Device        _device;
+    vk::DeviceSize    _slot_size;
+    bool              _coherent = true;
+    std::vector<Slot> _slots;
+
+
+    /* 选择 slot 使用的 memory property：有 host cached 的内存时使用它 */
+    vk::MemoryPropertyFlags memory_props_choose(const vk::PhysicalDeviceMemoryProperties &mem_props);
+
+    const void *data_get(uint32_t slot);
+};
+
+}    // namespace Hiss
@@ -0,0 +1,97 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include "include_vk.hpp"
+
+
+namespace Hiss
+{
+
+/**
+ * 按需渲染：记录场景中哪些状态发生了变化，没有变化时跳过 acquire，录制和提交，阻塞在 glfwWaitEventsTimeout 中
+ *
+ * 每一帧开始时由 frame_begin 决定这一帧的动作：
+ * - DRAW：有 dirty 标记，完整地绘制一帧，并清空标记
+ * - REPRESENT：场景没有变化，但是窗口需要刷新（例如被遮挡之后重新显示），或者到了定期呈现的时间，
+ *   只把上一帧的结果重新呈现到新的 swapchain image 上
+ * - IDLE：什么都不做，调用者应该通过 idle_wait 等待事件
+ * 关闭按需渲染时总是 DRAW
+ */
+class RedrawTracker
+{
+public:
+    enum Dirty : uint32_t
+    {
+        DIRTY_NONE    = 0,
+        DIRTY_CAMERA  = 1u << 0,    // 相机或者输入
+        DIRTY_UNIFORM = 1u << 1,    // uniform 中的其他内容，例如动画
+        DIRTY_RESIZE  = 1u << 2,    // 窗口大小改变，swapchain 和 framebuffer 重新创建
+        DIRTY_ASSET   = 1u << 3,    // 上传或者流式加载的资源，例如 buffer 和 texture
+        DIRTY_SETTING = 1u << 4,    // 渲染设置
+    };
+
+    enum class Action
+    {
+        DRAW,
+        REPRESENT,
+        IDLE,
+    };
+
+    struct Config
+    {
+        double wait_timeout     = .5;    // 空闲时每次阻塞等待事件的最长时间，单位是秒
+        double represent_period = 0.;    // 空闲时定期重新呈现上一帧的间隔，单位是秒，0 表示只在窗口需要刷新时呈现
+    };
+
+    struct Stat
+    {
+        uint32_t drawn{};
+        uint32_t represented{};
+        uint32_t idle{};
+        uint32_t dirty{};    // 这段时间内出现过的 dirty 标记
+    };
+
+
+    explicit RedrawTracker(const Config &config);
+
+    /* 开启或者关闭按需渲染；开启时先绘制一帧，保证上一帧的结果可以用于重新呈现 */
+    void enable(bool enabled);
+
+    [[nodiscard]] bool enabled() const { return _enabled; }
+
+    void mark(uint32_t dirty) { _dirty |= dirty; }
+
+    /* 窗口系统要求刷新窗口的内容，但是场景没有变化 */
+    void represent_request() { _represent = true; }
+
+    /* 决定这一帧的动作，并清空对应的标记 */
+    Action frame_begin();
+
+    /* 当前是否没有需要做的事情，这时调用者应该用 idle_wait 代替 glfwPollEvents */
+    [[nodiscard]] bool idle() const;
+
+    /* 阻塞等待窗口事件，最长等待到 wait_timeout 或者下一次定期呈现的时间 */
+    void idle_wait() const;
+
+    /* 返回累积的统计，并清空 */
+    Stat stat_take();
+
+    /* 例如 "camera|resize"，没有标记时为 "none" */
+    static std::string dirty_str(uint32_t dirty);
+
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Config            _config;
+    bool              _enabled   = false;
+    uint32_t          _dirty     = DIRTY_NONE;
+    bool              _represent = false;
+    Clock::time_point _last_present{};
+    Stat              _stat;
+
+
+    [[nodiscard]] bool represent_due() const;
+};
+
+}    // namespace Hiss
@@ -4,6 +4,7 @@
 #include "tools.hpp"
 #include "vertex.hpp"
 #include "framebuffer.hpp"
+#include "descriptor.hpp"
 
 
 struct UniformBufferObject {
@@ -18,37 +19,26 @@ struct UniformBufferObject {
 };
 
 
-vk::RenderPass render_pass_create(const FramebufferLayout_temp &framebuffer_layout);
+/**
+ * depth_prepass 为 true 时包含两个 subpass：
+ * - subpass 0 只写入 depth，使用只有 position 的 pipeline，没有 color attachment
+ * - subpass 1 是原来的主 pass，depth 只读，pipeline 应该使用 eEqual 比较并关闭 depth write，
+ *   这样每个 sample 最多只有最前面的 fragment 会执行 fragment shader
+ * 否则只有一个 subpass（原来的主 pass）
+ */
+vk::RenderPass render_pass_create(const FramebufferLayout_temp &framebuffer_layout, bool depth_prepass = false);
 
 
-vk::Pipeline pipeline_create(const vk::PipelineLayout &pipeline_layout,
-                             const vk::RenderPass &render_pass);
-
-
-vk::DescriptorSetLayout descriptor_set_layout_create();
+vk::DescriptorSetLayout descriptor_set_layout_create(Hiss::DescriptorLayoutCache &layout_cache);
 
 
 vk::PipelineLayout
-pipeline_layout_create(const std::vector<vk::DescriptorSetLayout> &descriptor_set_layout);
+pipeline_layout_create(const std::vector<vk::DescriptorSetLayout> &descriptor_set_layout,
+                       const std::vector<vk::PushConstantRange>      &push_constant_ranges = {});
 
 
 std::vector<vk::DescriptorSet>
 create_descriptor_set(const vk::DescriptorSetLayout &descriptor_set_layout,
-                      const vk::DescriptorPool &descriptor_pool, uint32_t frames_in_flight,
+                      Hiss::DescriptorAllocator &descriptor_allocator, uint32_t frames_in_flight,
                       std::array<vk::Buffer, 2U> uniform_buffer_list,
                       const vk::ImageView &tex_img_view, const vk::Sampler &tex_sampler);
-
-
-// TODO pipeline 的配置是 data，是信息。应该是声明式的，而不是命令式的
-struct Pipeline {
-    std::vector<vk::DescriptorSetLayoutBinding> descriptor_set_layout = {
-            {.binding         = 0,
-             .descriptorType  = vk::DescriptorType::eUniformBuffer,
-             .descriptorCount = 1, /* 大于 1 表示数组 */
-             .stageFlags      = vk::ShaderStageFlagBits::eVertex},
-            {.binding            = 1,
-             .descriptorType     = vk::DescriptorType::eCombinedImageSampler,
-             .descriptorCount    = 1,
-             .stageFlags         = vk::ShaderStageFlagBits::eFragment,
-             .pImmutableSamplers = nullptr}};
-};
\ No newline at end of file
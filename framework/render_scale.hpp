@@ -0,0 +1,52 @@
+#pragma once
+#include "include_vk.hpp"
+
+
+namespace Hiss
+{
+
+/**
+ * 动态分辨率的控制器：根据 GPU 的帧耗时调整渲染分辨率的缩放比例，使耗时接近目标值
+ *
+ * 假设 GPU 耗时和像素数量成正比，也就是和 scale 的平方成正比，因此目标 scale = scale * sqrt(target / time)
+ * - 耗时先做指数平滑，避免单帧的波动导致分辨率来回跳动
+ * - 耗时在目标附近的一个范围内时不调整
+ * - 每次调整的幅度有上限：timestamp 的结果有几帧的延迟，调整太快会产生振荡
+ */
+class RenderScale
+{
+public:
+    struct Config
+    {
+        double target_ms = 16.6;
+        float  min_scale = .5f;
+        float  max_scale = 1.f;
+        float  max_step  = .05f;    // 每次调整的最大幅度
+        double tolerance = .05;     // 耗时和目标的相对误差在这个范围内时不调整
+        double smoothing = .2;      // 指数平滑中新样本的权重
+    };
+
+
+    explicit RenderScale(const Config &config);
+
+    /* 输入一帧的 GPU 耗时，返回调整之后的 scale */
+    float update(double gpu_ms);
+
+    /* 恢复到最大的 scale，清空平滑的状态 */
+    void reset();
+
+    [[nodiscard]] float         scale() const { return _scale; }
+    [[nodiscard]] double        smoothed_ms() const { return _smoothed_ms; }
+    [[nodiscard]] const Config &config() const { return _config; }
+
+    /* 缩放之后的渲染分辨率，宽高向下取整到 8 的倍数，不超过 full_extent */
+    [[nodiscard]] vk::Extent2D extent(const vk::Extent2D &full_extent) const;
+
+
+private:
+    Config _config;
+    float  _scale;
+    double _smoothed_ms = 0.;
+};
+
+}    // namespace Hiss
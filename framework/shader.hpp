@@ -0,0 +1,64 @@
+#pragma once
+#include <mutex>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "include_vk.hpp"
+
+
+namespace Hiss
+{
+
+/**
+ * 已经创建好的 shader module
+ * 由 ShaderLibrary 创建，最后一个引用消失时 module 被销毁
+ */
+struct Shader
+{
+    vk::ShaderModule module;
+    uint64_t         hash{};    // SPIR-V 内容的 hash
+    std::string      path;      // 第一次加载时使用的路径
+};
+
+
+/**
+ * shader module 的缓存：每个 SPIR-V 文件只读取一次，每份 SPIR-V 内容只创建一个 vk::ShaderModule
+ * 文件通过 mmap 读取，映射的起始地址是页对齐的，因此一定满足 SPIR-V 要求的 4 字节对齐
+ *
+ * 先按照路径查找，再按照内容的 hash 查找：路径不同但是内容相同的文件也共享同一个 module
+ * library 只持有 weak 引用，使用者（例如 pipeline）持有 shared_ptr，没有使用者时 module 就会被释放
+ * library 需要比所有的 Shader 引用活得更久；线程安全
+ */
+class ShaderLibrary
+{
+public:
+    explicit ShaderLibrary(vk::Device device)
+        : _device(device)
+    {}
+    ~ShaderLibrary();
+    ShaderLibrary(const ShaderLibrary &)            = delete;
+    ShaderLibrary &operator=(const ShaderLibrary &) = delete;
+
+
+    /* 获得 path 对应的 shader module，如果没有缓存，就读取文件并创建 */
+    std::shared_ptr<const Shader> acquire(const std::string &path);
+
+    /* 当前存活的 module 数量 */
+    [[nodiscard]] size_t size() const;
+
+
+private:
+    vk::Device                                              _device;
+    std::unordered_map<std::string, uint64_t>                _path_hash;    // 路径 -> 内容的 hash
+    std::unordered_map<uint64_t, std::weak_ptr<const Shader>> _shaders;      // 内容的 hash -> shader
+    mutable std::mutex                                       _mutex;
+
+
+    /* 在 _shaders 中查找仍然存活的 shader */
+    std::shared_ptr<const Shader> alive_find(uint64_t hash);
+
+    /* 最后一个引用消失时调用 */
+    void shader_release(const Shader *shader);
+};
+
+}    // namespace Hiss
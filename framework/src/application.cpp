@@ -1,5 +1,4 @@
 #include "../application.hpp"
-#include "../tools.hpp"
 #include "../vk_common.hpp"
 
 
@@ -13,21 +12,11 @@ VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE;
 vk::PipelineShaderStageCreateInfo Hiss::ApplicationBase::shader_load(const std::string      &file,
                                                                      vk::ShaderStageFlagBits stage)
 {
-    vk::Device d;    // FIXME
-
-    std::vector<char>          code = read_file(file);
-    vk::ShaderModuleCreateInfo info = {
-            .codeSize = code.size(),    // 单位是字节
-
-            /* vector 容器可以保证转换为 uint32 后仍然是对齐的 */
-            .pCode = reinterpret_cast<const uint32_t *>(code.data()),
-    };
-    vk::ShaderModule shader_module = d.createShaderModule(info);
-    shader_modules.push_back(shader_module);
+    _shaders.push_back(_shader_library->acquire(file));
 
     return vk::PipelineShaderStageCreateInfo{
             .stage  = stage,
-            .module = shader_module,
+            .module = _shaders.back()->module,
             .pName  = "main",
     };
 }
@@ -35,26 +24,38 @@ vk::PipelineShaderStageCreateInfo Hiss::ApplicationBase::shader_load(const std::
 
 Hiss::ApplicationBase::~ApplicationBase()
 {
-    vk::Device d;    // FIXME
-
-
-    for (auto shader_module: shader_modules)
-        d.destroy(shader_module);
+    /* shader module 和 descriptor 相关的对象需要在 device 之前释放 */
+    _shaders.clear();
+    _shader_library          = nullptr;
+    _descriptor_allocator    = nullptr;
+    _descriptor_layout_cache = nullptr;
+    _device                  = nullptr;
 }
 
 
-Hiss::ApplicationBase::ApplicationBase(const std::string &app_name)
+Hiss::ApplicationBase::ApplicationBase(const std::string &app_name, bool headless)
 {
     logger_init();
     debug_msger_info_create();
-    instance_init(app_name);
+    instance_init(app_name, headless);
     _debug_msger = _instance->handle_get().createDebugUtilsMessengerEXT(_debug_msger_info);
-    _window      = std::make_unique<Window>(app_name, WINDOW_INIT_WIDTH, WINDOW_INIT_HEIGHT);
-    _surface     = _window->surface_create(_instance->handle_get());
+    if (headless)
+        _device = std::make_unique<Device>(_instance->handle_get());
+    else
+    {
+        _window  = std::make_unique<Window>(app_name, WINDOW_INIT_WIDTH, WINDOW_INIT_HEIGHT);
+        _surface = _window->surface_create(_instance->handle_get());
+        _device  = std::make_unique<Device>(_instance->handle_get(), _surface, *_window);
+    }
+    VULKAN_HPP_DEFAULT_DISPATCHER.init(_device->handle_get());    // device 级别的函数直接从 driver 中获取
+
+    _shader_library          = std::make_shared<ShaderLibrary>(_device->handle_get());
+    _descriptor_layout_cache = std::make_unique<DescriptorLayoutCache>(_device->handle_get());
+    _descriptor_allocator    = std::make_unique<DescriptorAllocator>(_device->handle_get());
 }
 
 
-void Hiss::ApplicationBase::instance_init(const std::string &app_name)
+void Hiss::ApplicationBase::instance_init(const std::string &app_name, bool headless)
 {
     /* 找到所需的 extensions */
     std::vector<const char *> extensions = {
@@ -64,8 +65,11 @@ void Hiss::ApplicationBase::instance_init(const std::string &app_name)
             VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME,
             VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME,
     };
-    auto glfw_extension = WindowStatic::extensions_get();
-    extensions.insert(extensions.end(), glfw_extension.begin(), glfw_extension.end());
+    if (!headless)
+    {
+        auto glfw_extension = WindowStatic::extensions_get();
+        extensions.insert(extensions.end(), glfw_extension.begin(), glfw_extension.end());
+    }
 
 
     /* 所需的 layers */
@@ -86,15 +90,14 @@ void Hiss::ApplicationBase::instance_init(const std::string &app_name)
 }
 
 
+/**
+ * 和 LogStatic 共用同一组 logger：framework 中的各个模块都通过 LogStatic 输出日志
+ */
 void Hiss::ApplicationBase::logger_init()
 {
-    _logger = spdlog::stdout_color_st("logger");
-    _logger->set_level(spdlog::level::trace);
-    _logger->set_pattern("[%^%L%$] %v");
-
-    _debug_user_data._logger = spdlog::stdout_color_st("validation");
-    _debug_user_data._logger->set_level(spdlog::level::trace);
-    _debug_user_data._logger->set_pattern("[%^%n%$] %v");
+    LogStatic::init();
+    _logger                  = LogStatic::logger();
+    _debug_user_data._logger = LogStatic::val_logger();
 }
 
 
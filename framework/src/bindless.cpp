@@ -0,0 +1,137 @@
+#include "../bindless.hpp"
+#include <array>
+#include <cassert>
+#include "global.hpp"
+
+
+uint32_t Hiss::BindlessTable::SlotList::alloc()
+{
+    if (!free.empty())
+    {
+        uint32_t slot = free.back();
+        free.pop_back();
+        return slot;
+    }
+    if (next >= capacity)
+        throw std::runtime_error("bindless table is full.");
+    return next++;
+}
+
+
+void Hiss::BindlessTable::SlotList::release(uint32_t slot)
+{
+    assert(slot < next);
+    free.push_back(slot);
+}
+
+
+Hiss::BindlessTable::BindlessTable(vk::Device device, DescriptorLayoutCache &layout_cache, uint32_t max_textures,
+                                   uint32_t max_samplers)
+    : _device(device),
+      _textures{.capacity = max_textures},
+      _samplers{.capacity = max_samplers}
+{
+    LogStatic::logger()->info("[bindless] create bindless table, textures: {}, samplers: {}", max_textures,
+                              max_samplers);
+
+
+    /* layout：两个数组都需要 update after bind 和 partially bound */
+    const vk::DescriptorBindingFlags binding_flags =
+            vk::DescriptorBindingFlagBits::eUpdateAfterBind | vk::DescriptorBindingFlagBits::ePartiallyBound;
+    _layout = layout_cache.get(
+            {
+                    vk::DescriptorSetLayoutBinding{
+                            .binding         = TEXTURE_BINDING,
+                            .descriptorType  = vk::DescriptorType::eSampledImage,
+                            .descriptorCount = max_textures,
+                            .stageFlags      = vk::ShaderStageFlagBits::eFragment,
+                    },
+                    vk::DescriptorSetLayoutBinding{
+                            .binding         = SAMPLER_BINDING,
+                            .descriptorType  = vk::DescriptorType::eSampler,
+                            .descriptorCount = max_samplers,
+                            .stageFlags      = vk::ShaderStageFlagBits::eFragment,
+                    },
+            },
+            vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool, {binding_flags, binding_flags});
+
+
+    /* update after bind 的 set 需要从带有相应 flag 的 pool 中分配，因此单独创建一个 pool */
+    std::array<vk::DescriptorPoolSize, 2> pool_sizes = {{
+            {.type = vk::DescriptorType::eSampledImage, .descriptorCount = max_textures},
+            {.type = vk::DescriptorType::eSampler, .descriptorCount = max_samplers},
+    }};
+    _pool = _device.createDescriptorPool(vk::DescriptorPoolCreateInfo{
+            .flags         = vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind,
+            .maxSets       = 1,
+            .poolSizeCount = static_cast<uint32_t>(pool_sizes.size()),
+            .pPoolSizes    = pool_sizes.data(),
+    });
+    _set = _device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo{
+            .descriptorPool     = _pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts        = &_layout,
+    })[0];
+}
+
+
+Hiss::BindlessTable::~BindlessTable()
+{
+    _device.destroyDescriptorPool(_pool);
+}
+
+
+uint32_t Hiss::BindlessTable::texture_register(vk::ImageView img_view)
+{
+    std::lock_guard lock(_mutex);
+    uint32_t        slot = _textures.alloc();
+
+    vk::DescriptorImageInfo img_info = {
+            .imageView   = img_view,
+            .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+    };
+    _device.updateDescriptorSets({vk::WriteDescriptorSet{
+                                         .dstSet          = _set,
+                                         .dstBinding      = TEXTURE_BINDING,
+                                         .dstArrayElement = slot,
+                                         .descriptorCount = 1,
+                                         .descriptorType  = vk::DescriptorType::eSampledImage,
+                                         .pImageInfo      = &img_info,
+                                 }},
+                                 {});
+    return slot;
+}
+
+
+void Hiss::BindlessTable::texture_unregister(uint32_t slot)
+{
+    /* partially bound：不需要清空 descriptor，只要之后的 draw 不再访问这个 slot */
+    std::lock_guard lock(_mutex);
+    _textures.release(slot);
+}
+
+
+uint32_t Hiss::BindlessTable::sampler_register(vk::Sampler sampler)
+{
+    std::lock_guard lock(_mutex);
+    uint32_t        slot = _samplers.alloc();
+
+    vk::DescriptorImageInfo sampler_info = {.sampler = sampler};
+    _device.updateDescriptorSets({vk::WriteDescriptorSet{
+                                         .dstSet          = _set,
+                                         .dstBinding      = SAMPLER_BINDING,
+                                         .dstArrayElement = slot,
+                                         .descriptorCount = 1,
+                                         .descriptorType  = vk::DescriptorType::eSampler,
+                                         .pImageInfo      = &sampler_info,
+                                 }},
+                                 {});
+    return slot;
+}
+
+
+void Hiss::BindlessTable::sampler_unregister(uint32_t slot)
+{
+    std::lock_guard lock(_mutex);
+    _samplers.release(slot);
+}
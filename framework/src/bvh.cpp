@@ -0,0 +1,252 @@
+#include "../bvh.hpp"
+#include <atomic>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+
+
+void Hiss::Bvh::node_bounds_leaf(const BoundsSoA &bounds, const uint32_t *indices, Node &node)
+{
+    node.min = glm::vec3(std::numeric_limits<float>::max());
+    node.max = glm::vec3(std::numeric_limits<float>::lowest());
+    for (uint32_t k = node.left; k < node.left + node.right; ++k)
+    {
+        uint32_t  id     = indices[k];
+        glm::vec3 center = bounds.center(id);
+        node.min         = glm::min(node.min, center - bounds.radius[id]);
+        node.max         = glm::max(node.max, center + bounds.radius[id]);
+    }
+}
+
+
+/**
+ * 沿质心包围盒的最长轴，按照中位数将 [begin, end) 划分为两半，返回划分的位置
+ */
+uint32_t Hiss::Bvh::partition(const BoundsSoA &bounds, uint32_t *indices, uint32_t begin, uint32_t end)
+{
+    glm::vec3 min(std::numeric_limits<float>::max()), max(std::numeric_limits<float>::lowest());
+    for (uint32_t k = begin; k < end; ++k)
+    {
+        min = glm::min(min, bounds.center(indices[k]));
+        max = glm::max(max, bounds.center(indices[k]));
+    }
+    glm::vec3 extent = max - min;
+    int       axis   = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+    const float *axis_data = axis == 0 ? bounds.cx.data() : (axis == 1 ? bounds.cy.data() : bounds.cz.data());
+    uint32_t     mid       = begin + (end - begin) / 2;
+    std::nth_element(indices + begin, indices + mid, indices + end,
+                     [&](uint32_t a, uint32_t b) { return axis_data[a] < axis_data[b]; });
+    return mid;
+}
+
+
+/**
+ * 构建一棵子树，节点的下标都是局部的
+ * 孩子节点总是在父节点之后创建，因此逆序遍历就是自底向上
+ */
+void Hiss::Bvh::subtree_build(const BoundsSoA &bounds, uint32_t *indices, Subtree &subtree)
+{
+    auto &nodes = subtree.nodes;
+    nodes.push_back(Node{.left = subtree.begin, .right = subtree.end - subtree.begin, .parent = NO_PARENT});
+
+    std::vector<uint32_t> stack = {0};
+    while (!stack.empty())
+    {
+        uint32_t idx = stack.back();
+        stack.pop_back();
+
+        uint32_t begin = nodes[idx].left, end = nodes[idx].left + nodes[idx].right;
+        if (end - begin <= LEAF_SIZE)
+        {
+            nodes[idx].leaf = true;
+            node_bounds_leaf(bounds, indices, nodes[idx]);
+            continue;
+        }
+
+        uint32_t mid   = partition(bounds, indices, begin, end);
+        auto     child = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(Node{.left = begin, .right = mid - begin, .parent = idx});
+        nodes.push_back(Node{.left = mid, .right = end - mid, .parent = idx});
+        nodes[idx].left  = child;
+        nodes[idx].right = child + 1;
+        stack.push_back(child);
+        stack.push_back(child + 1);
+    }
+
+    for (auto i = static_cast<uint32_t>(nodes.size()); i-- > 0;)
+        if (!nodes[i].leaf)
+        {
+            nodes[i].min = glm::min(nodes[nodes[i].left].min, nodes[nodes[i].right].min);
+            nodes[i].max = glm::max(nodes[nodes[i].left].max, nodes[nodes[i].right].max);
+        }
+}
+
+
+void Hiss::Bvh::build(const BoundsSoA &bounds, ThreadPool *thread_pool)
+{
+    auto cnt = static_cast<uint32_t>(bounds.size());
+    _nodes.clear();
+    _indices.resize(cnt);
+    std::iota(_indices.begin(), _indices.end(), 0u);
+    _object_leaf.assign(cnt, 0);
+    if (cnt == 0)
+        return;
+
+
+    /**
+     * 顶部的若干层：逐层划分，直到子区间的数量足够让每个 worker 分到几个任务
+     * 这些节点的包围盒在子树拼接完成之后再计算
+     */
+    uint32_t target = thread_pool ? thread_pool->thread_cnt() * 4 : 1;
+
+    std::vector<Subtree> subtrees = {Subtree{.begin = 0, .end = cnt, .slot = 0}};
+    _nodes.push_back(Node{.parent = NO_PARENT});
+    while (subtrees.size() < target)
+    {
+        std::vector<Subtree> next;
+        for (const auto &range: subtrees)
+        {
+            if (range.end - range.begin <= LEAF_SIZE * 64)
+            {
+                next.push_back(range);
+                continue;
+            }
+
+            uint32_t mid   = partition(bounds, _indices.data(), range.begin, range.end);
+            auto     child = static_cast<uint32_t>(_nodes.size());
+            _nodes.push_back(Node{.parent = range.slot});
+            _nodes.push_back(Node{.parent = range.slot});
+            _nodes[range.slot].left  = child;
+            _nodes[range.slot].right = child + 1;
+            next.push_back(Subtree{.begin = range.begin, .end = mid, .slot = child});
+            next.push_back(Subtree{.begin = mid, .end = range.end, .slot = child + 1});
+        }
+        if (next.size() == subtrees.size())
+            break;
+        subtrees = std::move(next);
+    }
+    auto top_cnt = static_cast<uint32_t>(_nodes.size());
+
+
+    /* 各个子树的区间互不相交，可以并行地构建；worker 从计数器中领取任务 */
+    std::atomic<size_t> next_task{0};
+    auto                worker = [&](uint32_t) {
+        for (size_t i = next_task++; i < subtrees.size(); i = next_task++)
+            subtree_build(bounds, _indices.data(), subtrees[i]);
+    };
+    if (thread_pool)
+        thread_pool->run(thread_pool->thread_cnt(), worker);
+    else
+        worker(0);
+
+
+    /* 拼接：子树的根放在预留的位置，其余节点追加到末尾 */
+    for (auto &subtree: subtrees)
+    {
+        auto base  = static_cast<uint32_t>(_nodes.size());
+        auto remap = [&](uint32_t i) { return i == 0 ? subtree.slot : base + i - 1; };
+        for (uint32_t i = 0; i < subtree.nodes.size(); ++i)
+        {
+            Node node   = subtree.nodes[i];
+            node.parent = i == 0 ? _nodes[subtree.slot].parent : remap(node.parent);
+            if (!node.leaf)
+            {
+                node.left  = remap(node.left);
+                node.right = remap(node.right);
+            }
+            if (i == 0)
+                _nodes[subtree.slot] = node;
+            else
+                _nodes.push_back(node);
+        }
+    }
+
+
+    /* 顶部节点的包围盒；孩子的下标总是大于父节点 */
+    for (uint32_t i = top_cnt; i-- > 0;)
+        if (!_nodes[i].leaf)
+            node_refit(bounds, i);
+
+    for (uint32_t i = 0; i < _nodes.size(); ++i)
+        if (_nodes[i].leaf)
+            for (uint32_t k = _nodes[i].left; k < _nodes[i].left + _nodes[i].right; ++k)
+                _object_leaf[_indices[k]] = i;
+}
+
+
+/**
+ * 重新计算一个节点的包围盒，返回包围盒是否发生了变化
+ */
+bool Hiss::Bvh::node_refit(const BoundsSoA &bounds, uint32_t idx)
+{
+    Node     &node = _nodes[idx];
+    glm::vec3 old_min = node.min, old_max = node.max;
+    if (node.leaf)
+        node_bounds_leaf(bounds, _indices.data(), node);
+    else
+    {
+        node.min = glm::min(_nodes[node.left].min, _nodes[node.right].min);
+        node.max = glm::max(_nodes[node.left].max, _nodes[node.right].max);
+    }
+    return node.min != old_min || node.max != old_max;
+}
+
+
+void Hiss::Bvh::refit(const BoundsSoA &bounds)
+{
+    /* 孩子的下标总是大于父节点，逆序遍历就是自底向上 */
+    for (auto i = static_cast<uint32_t>(_nodes.size()); i-- > 0;)
+        node_refit(bounds, i);
+}
+
+
+void Hiss::Bvh::refit(const BoundsSoA &bounds, std::span<const uint32_t> moved)
+{
+    for (uint32_t id: moved)
+        for (uint32_t idx = _object_leaf[id]; idx != NO_PARENT; idx = _nodes[idx].parent)
+            if (!node_refit(bounds, idx))
+                break;
+}
+
+
+void Hiss::Bvh::cull(const BoundsSoA &bounds, const Frustum &frustum, std::vector<uint32_t> &visible) const
+{
+    if (_nodes.empty())
+        return;
+
+    /* inside 表示祖先节点已经完全在视锥内，不需要再测试 */
+    struct Item
+    {
+        uint32_t idx;
+        bool     inside;
+    };
+    std::vector<Item> stack = {{0, false}};
+    while (!stack.empty())
+    {
+        auto [idx, inside] = stack.back();
+        stack.pop_back();
+        const Node &node = _nodes[idx];
+
+        if (!inside)
+        {
+            auto test = frustum.aabb_test(node.min, node.max);
+            if (test == Frustum::Test::OUTSIDE)
+                continue;
+            inside = test == Frustum::Test::INSIDE;
+        }
+
+        if (!node.leaf)
+        {
+            stack.push_back({node.left, inside});
+            stack.push_back({node.right, inside});
+            continue;
+        }
+        for (uint32_t k = node.left; k < node.left + node.right; ++k)
+        {
+            uint32_t id = _indices[k];
+            if (inside || frustum.sphere_visible(bounds.center(id), bounds.radius[id]))
+                visible.push_back(id);
+        }
+    }
+}
@@ -0,0 +1,86 @@
+#include "../cmd_recorder.hpp"
+#include <algorithm>
+#include "global.hpp"
+
+
+Hiss::CmdRecorder::CmdRecorder(vk::Device device, uint32_t queue_family, uint32_t frame_cnt,
+                               ThreadPool &thread_pool)
+    : _device(device),
+      _thread_pool(thread_pool)
+{
+    LogStatic::logger()->info("[cmd recorder] frames: {}, threads: {}", frame_cnt, _thread_pool.thread_cnt());
+
+    _frames.resize(frame_cnt);
+    for (auto &frame: _frames)
+    {
+        frame.resize(_thread_pool.thread_cnt());
+        for (auto &thread_frame: frame)
+            thread_frame.pool = _device.createCommandPool(vk::CommandPoolCreateInfo{
+                    .flags            = vk::CommandPoolCreateFlagBits::eTransient,
+                    .queueFamilyIndex = queue_family,
+            });
+    }
+}
+
+
+Hiss::CmdRecorder::~CmdRecorder()
+{
+    /* 销毁 pool 时会一并释放其中的 command buffer */
+    for (auto &frame: _frames)
+        for (auto &thread_frame: frame)
+            _device.destroyCommandPool(thread_frame.pool);
+}
+
+
+void Hiss::CmdRecorder::frame_reset(uint32_t frame_idx)
+{
+    for (auto &thread_frame: _frames[frame_idx])
+    {
+        _device.resetCommandPool(thread_frame.pool);
+        thread_frame.used = 0;
+    }
+}
+
+
+vk::CommandBuffer Hiss::CmdRecorder::buffer_get(ThreadFrame &thread_frame)
+{
+    if (thread_frame.used == thread_frame.buffers.size())
+        thread_frame.buffers.push_back(_device.allocateCommandBuffers(vk::CommandBufferAllocateInfo{
+                .commandPool        = thread_frame.pool,
+                .level              = vk::CommandBufferLevel::eSecondary,
+                .commandBufferCount = 1,
+        })[0]);
+    return thread_frame.buffers[thread_frame.used++];
+}
+
+
+std::vector<vk::CommandBuffer> Hiss::CmdRecorder::record(uint32_t                                frame_idx,
+                                                         const vk::CommandBufferInheritanceInfo &inheritance,
+                                                         uint32_t                                draw_cnt,
+                                                         const RecordFn                         &fn,
+                                                         uint32_t                                thread_cnt)
+{
+    if (thread_cnt == 0)
+        thread_cnt = _thread_pool.thread_cnt();
+    uint32_t task_cnt = std::min({thread_cnt, _thread_pool.thread_cnt(), std::max(draw_cnt, 1u)});
+
+
+    /* 每个 worker 只访问自己的 ThreadFrame 和 cmds 中自己的位置，不需要加锁 */
+    std::vector<vk::CommandBuffer> cmds(task_cnt);
+    auto                          &frame = _frames[frame_idx];
+    _thread_pool.run(task_cnt, [&](uint32_t worker_idx) {
+        uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(draw_cnt) * worker_idx / task_cnt);
+        uint32_t end   = static_cast<uint32_t>(static_cast<uint64_t>(draw_cnt) * (worker_idx + 1) / task_cnt);
+
+        vk::CommandBuffer cmd = buffer_get(frame[worker_idx]);
+        cmd.begin(vk::CommandBufferBeginInfo{
+                .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit
+                       | vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+                .pInheritanceInfo = &inheritance,
+        });
+        fn(cmd, begin, end);
+        cmd.end();
+        cmds[worker_idx] = cmd;
+    });
+    return cmds;
+}
@@ -0,0 +1,171 @@
+#include "../descriptor.hpp"
+#include <algorithm>
+#include "global.hpp"
+#include "hasher.hpp"
+
+
+size_t Hiss::DescriptorLayoutDesc::hash() const
+{
+    Hasher h;
+    h.add(flags).add(bindings.size());
+    for (const auto &binding: bindings)
+    {
+        h.add(binding.binding).add(binding.descriptorType).add(binding.descriptorCount).add(binding.stageFlags);
+        h.add(reinterpret_cast<uintptr_t>(binding.pImmutableSamplers));
+    }
+    h.add(binding_flags.size());
+    for (auto binding_flag: binding_flags)
+        h.add(binding_flag);
+    return h.value();
+}
+
+
+Hiss::DescriptorLayoutCache::~DescriptorLayoutCache()
+{
+    for (auto &[desc, layout]: _layouts)
+        _device.destroyDescriptorSetLayout(layout);
+}
+
+
+vk::DescriptorSetLayout Hiss::DescriptorLayoutCache::get(const std::vector<vk::DescriptorSetLayoutBinding> &bindings,
+                                                         vk::DescriptorSetLayoutCreateFlags                 flags,
+                                                         const std::vector<vk::DescriptorBindingFlags> &binding_flags)
+{
+    if (!binding_flags.empty() && binding_flags.size() != bindings.size())
+        throw std::runtime_error("descriptor binding flags count mismatch.");
+
+
+    /* 按照 binding 的编号排序，binding flags 跟随 binding 一起移动 */
+    std::vector<size_t> order(bindings.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return bindings[a].binding < bindings[b].binding; });
+
+    DescriptorLayoutDesc desc{.flags = flags};
+    for (size_t i: order)
+    {
+        desc.bindings.push_back(bindings[i]);
+        if (!binding_flags.empty())
+            desc.binding_flags.push_back(binding_flags[i]);
+    }
+
+
+    std::lock_guard lock(_mutex);
+    if (auto iter = _layouts.find(desc); iter != _layouts.end())
+        return iter->second;
+
+    LogStatic::logger()->info("[descriptor] create descriptor set layout, bindings: {}", desc.bindings.size());
+    vk::DescriptorSetLayoutBindingFlagsCreateInfo flags_info = {
+            .bindingCount  = static_cast<uint32_t>(desc.binding_flags.size()),
+            .pBindingFlags = desc.binding_flags.data(),
+    };
+    auto layout = _device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo{
+            .pNext        = desc.binding_flags.empty() ? nullptr : &flags_info,
+            .flags        = desc.flags,
+            .bindingCount = static_cast<uint32_t>(desc.bindings.size()),
+            .pBindings    = desc.bindings.data(),
+    });
+    _layouts.emplace(std::move(desc), layout);
+    return layout;
+}
+
+
+Hiss::DescriptorAllocator::DescriptorAllocator(vk::Device device, uint32_t init_sets)
+    : _device(device),
+      _sets_per_pool(init_sets)
+{}
+
+
+Hiss::DescriptorAllocator::~DescriptorAllocator()
+{
+    for (auto pool: _used_pools)
+        _device.destroyDescriptorPool(pool);
+    for (auto pool: _free_pools)
+        _device.destroyDescriptorPool(pool);
+}
+
+
+vk::DescriptorPool Hiss::DescriptorAllocator::pool_grab()
+{
+    if (!_free_pools.empty())
+    {
+        auto pool = _free_pools.back();
+        _free_pools.pop_back();
+        return pool;
+    }
+
+
+    std::vector<vk::DescriptorPoolSize> pool_sizes;
+    for (auto [type, ratio]: POOL_RATIOS)
+        pool_sizes.push_back(vk::DescriptorPoolSize{
+                .type            = type,
+                .descriptorCount = static_cast<uint32_t>(ratio * static_cast<float>(_sets_per_pool)),
+        });
+
+    LogStatic::logger()->info("[descriptor] create descriptor pool, max sets: {}", _sets_per_pool);
+    auto pool = _device.createDescriptorPool(vk::DescriptorPoolCreateInfo{
+            .maxSets       = _sets_per_pool,
+            .poolSizeCount = static_cast<uint32_t>(pool_sizes.size()),
+            .pPoolSizes    = pool_sizes.data(),
+    });
+
+    /* 下一个 pool 的容量翻倍，pool 的数量是对数级别的 */
+    _sets_per_pool = std::min(_sets_per_pool * 2, MAX_SETS_PER_POOL);
+    return pool;
+}
+
+
+vk::DescriptorSet Hiss::DescriptorAllocator::allocate(vk::DescriptorSetLayout layout)
+{
+    if (!_current)
+    {
+        _current = pool_grab();
+        _used_pools.push_back(_current);
+    }
+
+
+    /* 使用返回 vk::Result 的版本，pool 耗尽时不会抛出异常 */
+    vk::DescriptorSetAllocateInfo info = {
+            .descriptorPool     = _current,
+            .descriptorSetCount = 1,
+            .pSetLayouts        = &layout,
+    };
+    vk::DescriptorSet set;
+    vk::Result        result = _device.allocateDescriptorSets(&info, &set);
+
+
+    /* 当前的 pool 已经耗尽，换一个新的 pool 再试一次 */
+    if (result == vk::Result::eErrorOutOfPoolMemory || result == vk::Result::eErrorFragmentedPool)
+    {
+        _current = pool_grab();
+        _used_pools.push_back(_current);
+
+        info.descriptorPool = _current;
+        result              = _device.allocateDescriptorSets(&info, &set);
+    }
+    if (result != vk::Result::eSuccess)
+        throw std::runtime_error("failed to allocate descriptor set.");
+    return set;
+}
+
+
+std::vector<vk::DescriptorSet> Hiss::DescriptorAllocator::allocate(vk::DescriptorSetLayout layout, uint32_t cnt)
+{
+    std::vector<vk::DescriptorSet> sets;
+    sets.reserve(cnt);
+    for (uint32_t i = 0; i < cnt; ++i)
+        sets.push_back(allocate(layout));
+    return sets;
+}
+
+
+void Hiss::DescriptorAllocator::reset()
+{
+    for (auto pool: _used_pools)
+    {
+        _device.resetDescriptorPool(pool);
+        _free_pools.push_back(pool);
+    }
+    _used_pools.clear();
+    _current = nullptr;
+}
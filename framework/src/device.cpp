@@ -1,6 +1,11 @@
 #include "../device.hpp"
 #include "window.hpp"
 #include <set>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <utility>
+#include <algorithm>
 
 
 bool Hiss::Device::physical_device_pick(vk::Instance instance, vk::SurfaceKHR surface)
@@ -22,11 +27,18 @@ bool Hiss::Device::physical_device_pick(vk::Instance instance, vk::SurfaceKHR su
                 graphics.push_back(i);
             if (queue_properties[i].queueFlags & vk::QueueFlagBits::eCompute)
                 compute.push_back(i);
-            if (physical_device.getSurfaceSupportKHR(i, surface))
+            if (surface && physical_device.getSurfaceSupportKHR(i, surface))
                 present.push_back(i);
         }
+        if (!surface)
+            present = graphics;
         if (graphics.empty() || compute.empty() || present.empty())
-            return false;
+            continue;
+
+        /* 优先使用不支持 graphics 的 compute family，这样的 queue 通常是独立的硬件队列，可以和 graphics 并行 */
+        std::stable_partition(compute.begin(), compute.end(), [&](uint32_t i) {
+            return !(queue_properties[i].queueFlags & vk::QueueFlagBits::eGraphics);
+        });
         _present_queue_family_index  = present;
         _graphics_queue_family_index = graphics;
         _compute_queue_family_index  = compute;
@@ -40,29 +52,58 @@ bool Hiss::Device::physical_device_pick(vk::Instance instance, vk::SurfaceKHR su
 }
 
 
-Hiss::Device::Device(vk::Instance instance, vk::SurfaceKHR surface, const Hiss::Window &window)
+Hiss::Device::Device(vk::Instance instance, vk::SurfaceKHR surface, const Hiss::Window &window,
+                     vk::PresentModeKHR preferred)
 {
-    if (physical_device_pick(instance, surface))
+    if (!physical_device_pick(instance, surface))
         throw std::runtime_error("cannot find suitable physical device.");
 
     logical_device_create();
     present_format_choose(surface);
-    present_mode_choose(surface);
+    present_mode_choose(surface, preferred);
     surface_extent_choose(surface, window);
 }
 
 
+Hiss::Device::Device(vk::Instance instance)
+    : _headless(true)
+{
+    if (!physical_device_pick(instance, nullptr))
+        throw std::runtime_error("cannot find suitable physical device.");
+
+    logical_device_create();
+}
+
+
+Hiss::Device::~Device()
+{
+    _device.destroy();
+}
+
+
 void Hiss::Device::logical_device_create()
 {
-    /* queue 的创建信息 */
+    /**
+     * queue 的创建信息
+     * compute 和 graphics 是同一个 family 时，如果 family 中有多个 queue，compute 使用第 2 个 queue，
+     * 这样 compute 的提交不会排在 graphics 的后面，两者仍然可以重叠执行
+     */
+    uint32_t graphics_family = _graphics_queue_family_index[0];
+    uint32_t compute_family  = _compute_queue_family_index[0];
+    uint32_t compute_queue   = 0;
+    if (compute_family == graphics_family
+        && _physical_device.getQueueFamilyProperties()[compute_family].queueCount > 1)
+        compute_queue = 1;
+
     std::vector<vk::DeviceQueueCreateInfo> queue_info;
-    float                                  queue_priority = 1.f;
-    for (uint32_t queue_family_idx: std::set<uint32_t>{_graphics_queue_family_index[0], _present_queue_family_index[0],
-                                                       _compute_queue_family_index[0]})
+    std::array<float, 2>                   queue_priority = {1.f, 1.f};
+    for (uint32_t queue_family_idx:
+         std::set<uint32_t>{graphics_family, _present_queue_family_index[0], compute_family})
     {
+        uint32_t queue_cnt = queue_family_idx == compute_family ? compute_queue + 1 : 1;
         queue_info.push_back(vk::DeviceQueueCreateInfo{.queueFamilyIndex = queue_family_idx,
-                                                       .queueCount       = 1,
-                                                       .pQueuePriorities = &queue_priority});
+                                                       .queueCount       = queue_cnt,
+                                                       .pQueuePriorities = queue_priority.data()});
     }
 
 
@@ -70,20 +111,53 @@ void Hiss::Device::logical_device_create()
     std::vector<const char *> device_ext_list = {
             /* 这是一个临时的扩展（vulkan_beta.h)，在 metal API 上模拟 vulkan 需要这个扩展 */
             VK_KHR_PORTABILITY_SUBSET_EXTENSION_NAME,
-            /* 可以将渲染结果呈现到 window surface 上 */
-            VK_KHR_SWAPCHAIN_EXTENSION_NAME,
     };
+    /* 可以将渲染结果呈现到 window surface 上 */
+    if (!_headless)
+        device_ext_list.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 
 
-    /* feature */
+    /* feature；大小超过 1 的 point 需要 largePoints，设备支持时开启，通过 large_points_support() 检查 */
+    _large_points = _physical_device.getFeatures().largePoints;
     [[maybe_unused]] vk::PhysicalDeviceFeatures device_feature{
             .tessellationShader = VK_TRUE,
             .sampleRateShading  = VK_TRUE,
+            .largePoints        = _large_points,
             .samplerAnisotropy  = VK_TRUE,
     };
 
+    /**
+     * compute 的 barrier 使用 pipelineBarrier2，需要 vulkan 1.3 的 synchronization2
+     * 设备不支持时不开启，使用 pipelineBarrier2 和 submit2 的示例需要通过 sync2_support() 检查
+     */
+    bool vulkan13 = _physical_device.getProperties().apiVersion >= VK_API_VERSION_1_3;
+    _sync2        = vulkan13
+          && _physical_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan13Features>()
+                     .get<vk::PhysicalDeviceVulkan13Features>()
+                     .synchronization2;
+
+    /* compute 和 graphics 之间的同步使用 timeline semaphore，需要 vulkan 1.2 */
+    bool vulkan12 = _physical_device.getProperties().apiVersion >= VK_API_VERSION_1_2;
+    _timeline_semaphore =
+            vulkan12
+            && _physical_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>()
+                       .get<vk::PhysicalDeviceVulkan12Features>()
+                       .timelineSemaphore;
+    vk::PhysicalDeviceVulkan12Features vulkan12_feature{.timelineSemaphore = _timeline_semaphore};
+    vk::PhysicalDeviceVulkan13Features vulkan13_feature{
+            .pNext            = vulkan12 ? &vulkan12_feature : nullptr,
+            .synchronization2 = _sync2,
+    };
+
+    void *feature_chain = nullptr;
+    if (vulkan13)
+        feature_chain = &vulkan13_feature;
+    else if (vulkan12)
+        feature_chain = &vulkan12_feature;
+
 
     _device = _physical_device.createDevice(vk::DeviceCreateInfo{
+            .pNext                   = feature_chain,
             .queueCreateInfoCount    = (uint32_t) queue_info.size(),
             .pQueueCreateInfos       = queue_info.data(),
             .enabledExtensionCount   = (uint32_t) device_ext_list.size(),
@@ -97,8 +171,7 @@ void Hiss::Device::logical_device_create()
                        .family_index = _graphics_queue_family_index[0]};
     _present_queue  = {.queue        = _device.getQueue(_present_queue_family_index[0], 0),
                        .family_index = _present_queue_family_index[0]};
-    _compute_queue  = {.queue        = _device.getQueue(_compute_queue_family_index[0], 0),
-                       .family_index = _compute_queue_family_index[0]};
+    _compute_queue  = {.queue = _device.getQueue(compute_family, compute_queue), .family_index = compute_family};
 }
 
 
@@ -112,13 +185,9 @@ void Hiss::Device::present_format_choose(vk::SurfaceKHR surface)
 }
 
 
-void Hiss::Device::present_mode_choose(vk::SurfaceKHR surface)
+void Hiss::Device::present_mode_choose(vk::SurfaceKHR surface, vk::PresentModeKHR preferred)
 {
-    std::vector<vk::PresentModeKHR> present_mode_list = _physical_device.getSurfacePresentModesKHR(surface);
-    for (const auto &present_mode: present_mode_list)
-        if (present_mode == vk::PresentModeKHR::eMailbox)
-            _present_mode = present_mode;
-    _present_mode = vk::PresentModeKHR::eFifo;
+    _present_mode = Hiss::present_mode_choose(_physical_device.getSurfacePresentModesKHR(surface), preferred);
 }
 
 
@@ -140,3 +209,166 @@ void Hiss::Device::surface_extent_choose(vk::SurfaceKHR surface, const Hiss::Win
                                  capability.maxImageExtent.height),
     };
 }
+
+
+uint32_t Hiss::Device::memory_type_find(uint32_t type_bits, vk::MemoryPropertyFlags properties) const
+{
+    auto memory_properties = _physical_device.getMemoryProperties();
+    for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i)
+        if ((type_bits & (1u << i)) && (memory_properties.memoryTypes[i].propertyFlags & properties) == properties)
+            return i;
+    throw std::runtime_error("failed to find suitable memory type.");
+}
+
+
+void Hiss::Device::buffer_create(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties,
+                                 vk::Buffer &buffer, vk::DeviceMemory &memory) const
+{
+    buffer = _device.createBuffer(vk::BufferCreateInfo{
+            .size        = size,
+            .usage       = usage,
+            .sharingMode = vk::SharingMode::eExclusive,
+    });
+
+    vk::MemoryRequirements requirements = _device.getBufferMemoryRequirements(buffer);
+    memory                              = _device.allocateMemory(vk::MemoryAllocateInfo{
+                                         .allocationSize  = requirements.size,
+                                         .memoryTypeIndex = memory_type_find(requirements.memoryTypeBits, properties),
+    });
+    _device.bindBufferMemory(buffer, memory, 0);
+}
+
+
+void Hiss::Device::buffer_free(vk::Buffer &buffer, vk::DeviceMemory &memory) const
+{
+    _device.destroy(buffer);
+    _device.free(memory);
+    buffer = nullptr;
+    memory = nullptr;
+}
+
+
+double Hiss::Device::submit_wait(const Queue &queue, vk::CommandPool pool,
+                                 const std::function<void(vk::CommandBuffer)> &record) const
+{
+    vk::CommandBuffer cmd = _device.allocateCommandBuffers(vk::CommandBufferAllocateInfo{
+            .commandPool        = pool,
+            .level              = vk::CommandBufferLevel::ePrimary,
+            .commandBufferCount = 1,
+    })[0];
+
+    vk::MemoryBarrier begin_barrier = {
+            .srcAccessMask = vk::AccessFlagBits::eMemoryWrite,
+            .dstAccessMask = vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite,
+    };
+    vk::MemoryBarrier end_barrier = {
+            .srcAccessMask = vk::AccessFlagBits::eMemoryWrite,
+            .dstAccessMask = vk::AccessFlagBits::eHostRead,
+    };
+    vk::Fence fence = _device.createFence({});
+
+
+    /* record 可能抛出异常（例如容量检查），此时同样要释放 command buffer 和 fence */
+    std::chrono::steady_clock::time_point start, end;
+    try
+    {
+        cmd.begin(vk::CommandBufferBeginInfo{.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eAllCommands, {},
+                            begin_barrier, nullptr, nullptr);
+        record(cmd);
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eHost, {},
+                            end_barrier, nullptr, nullptr);
+        cmd.end();
+
+        start = std::chrono::steady_clock::now();
+        queue.queue.submit(vk::SubmitInfo{.commandBufferCount = 1, .pCommandBuffers = &cmd}, fence);
+        (void) _device.waitForFences({fence}, VK_TRUE, UINT64_MAX);
+        end = std::chrono::steady_clock::now();
+    }
+    catch (...)
+    {
+        _device.destroy(fence);
+        _device.freeCommandBuffers(pool, {cmd});
+        throw;
+    }
+
+    _device.destroy(fence);
+    _device.freeCommandBuffers(pool, {cmd});
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+void Hiss::Device::buffer_upload(const Queue &queue, vk::CommandPool pool, vk::Buffer dst, const void *data,
+                                 vk::DeviceSize size, vk::DeviceSize offset) const
+{
+    Buffer staging(*this, size, vk::BufferUsageFlagBits::eTransferSrc,
+                   vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+    staging.write(data, size);
+    submit_wait(queue, pool, [&](vk::CommandBuffer cmd) {
+        cmd.copyBuffer(staging.handle_get(), dst, {vk::BufferCopy{.dstOffset = offset, .size = size}});
+    });
+}
+
+
+void Hiss::Device::buffer_download(const Queue &queue, vk::CommandPool pool, vk::Buffer src, void *data,
+                                   vk::DeviceSize size, vk::DeviceSize offset) const
+{
+    Buffer staging(*this, size, vk::BufferUsageFlagBits::eTransferDst,
+                   vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+    submit_wait(queue, pool, [&](vk::CommandBuffer cmd) {
+        cmd.copyBuffer(src, staging.handle_get(), {vk::BufferCopy{.srcOffset = offset, .size = size}});
+    });
+    std::memcpy(data, _device.mapMemory(staging.memory_get(), 0, size), size);
+    _device.unmapMemory(staging.memory_get());
+}
+
+
+Hiss::Buffer::Buffer(const Device &device, vk::DeviceSize size, vk::BufferUsageFlags usage,
+                     vk::MemoryPropertyFlags properties)
+    : _device(device.handle_get()),
+      _size(size)
+{
+    device.buffer_create(size, usage, properties, _buffer, _memory);
+}
+
+
+Hiss::Buffer::Buffer(Buffer &&other) noexcept
+    : _device(other._device),
+      _buffer(std::exchange(other._buffer, nullptr)),
+      _memory(std::exchange(other._memory, nullptr)),
+      _size(std::exchange(other._size, 0))
+{}
+
+
+Hiss::Buffer &Hiss::Buffer::operator=(Buffer &&other) noexcept
+{
+    if (this != &other)
+    {
+        reset();
+        _device = other._device;
+        _buffer = std::exchange(other._buffer, nullptr);
+        _memory = std::exchange(other._memory, nullptr);
+        _size   = std::exchange(other._size, 0);
+    }
+    return *this;
+}
+
+
+void Hiss::Buffer::reset()
+{
+    if (_device)
+    {
+        _device.destroy(_buffer);
+        _device.free(_memory);
+    }
+    _buffer = nullptr;
+    _memory = nullptr;
+    _size   = 0;
+}
+
+
+void Hiss::Buffer::write(const void *data, vk::DeviceSize size, vk::DeviceSize offset) const
+{
+    std::memcpy(_device.mapMemory(_memory, offset, size), data, size);
+    _device.unmapMemory(_memory);
+}
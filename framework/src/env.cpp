@@ -1,6 +1,7 @@
 #include "../env.hpp"
 #include "../buffer.hpp"
 #include "../image.hpp"
+#include <algorithm>
 
 Hiss::DeviceInfo::DeviceInfo(const vk::PhysicalDevice &physical_device, const vk::SurfaceKHR &surface)
 {
@@ -10,6 +11,41 @@ Hiss::DeviceInfo::DeviceInfo(const vk::PhysicalDevice &physical_device, const vk
     queue_family_properties    = physical_device.getQueueFamilyProperties();
     support_ext                = physical_device.enumerateDeviceExtensionProperties();
 
+    /**
+     * bindless 和 GPU driven 的 feature 都通过 Vulkan12Features 开启，只有 vulkan 1.2 的设备才能使用
+     * 1.1 的设备不能在 pNext 链中出现这些结构体，保持默认值（都不支持）
+     */
+    vulkan12 = physical_device_properties.apiVersion >= VK_API_VERSION_1_2;
+    if (vulkan12)
+    {
+        auto features2 = physical_device.getFeatures2<vk::PhysicalDeviceFeatures2,
+                                                      vk::PhysicalDeviceDescriptorIndexingFeatures,
+                                                      vk::PhysicalDeviceVulkan12Features>();
+        descriptor_indexing_features       = features2.get<vk::PhysicalDeviceDescriptorIndexingFeatures>();
+        descriptor_indexing_features.pNext = nullptr;
+        vulkan12_features                  = features2.get<vk::PhysicalDeviceVulkan12Features>();
+        vulkan12_features.pNext            = nullptr;
+
+        auto props2 = physical_device.getProperties2<vk::PhysicalDeviceProperties2,
+                                                     vk::PhysicalDeviceDescriptorIndexingProperties>();
+        descriptor_indexing_props       = props2.get<vk::PhysicalDeviceDescriptorIndexingProperties>();
+        descriptor_indexing_props.pNext = nullptr;
+    }
+
+    /* 扩展的 feature 只能在扩展被支持时查询 */
+    auto ext_supported = [&](const char *name) {
+        return std::any_of(support_ext.begin(), support_ext.end(),
+                           [&](const vk::ExtensionProperties &ext) { return std::string(ext.extensionName) == name; });
+    };
+    if (ext_supported(VK_KHR_PRESENT_ID_EXTENSION_NAME) && ext_supported(VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+    {
+        auto features = physical_device.getFeatures2<vk::PhysicalDeviceFeatures2,
+                                                     vk::PhysicalDevicePresentIdFeaturesKHR,
+                                                     vk::PhysicalDevicePresentWaitFeaturesKHR>();
+        present_wait  = features.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId
+                     && features.get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait;
+    }
+
     surface_capability  = physical_device.getSurfaceCapabilitiesKHR(surface);
     surface_format_list = physical_device.getSurfaceFormatsKHR(surface);
     present_mode_list   = physical_device.getSurfacePresentModesKHR(surface);
@@ -27,6 +63,21 @@ Hiss::DeviceInfo::DeviceInfo(const vk::PhysicalDevice &physical_device, const vk
 }
 
 
+bool Hiss::DeviceInfo::bindless_support() const
+{
+    const auto &f = descriptor_indexing_features;
+    return f.runtimeDescriptorArray && f.descriptorBindingPartiallyBound
+        && f.descriptorBindingSampledImageUpdateAfterBind && f.shaderSampledImageArrayNonUniformIndexing;
+}
+
+
+bool Hiss::DeviceInfo::gpu_driven_support() const
+{
+    return vulkan12_features.drawIndirectCount && physical_device_features.multiDrawIndirect
+        && physical_device_features.drawIndirectFirstInstance;
+}
+
+
 vk::SurfaceKHR Hiss::Env::surface_create(const vk::Instance &instance, GLFWwindow *window)
 {
     /* 调用 glfw 来创建 window surface，这样可以避免平台相关的细节 */
@@ -71,14 +122,53 @@ vk::Device Hiss::Env::device_create(const vk::PhysicalDevice &physical_device,
             /* 可以将渲染结果呈现到 window surface 上 */
             VK_KHR_SWAPCHAIN_EXTENSION_NAME,
     };
+    if (physical_info.present_wait)
+    {
+        device_ext_list.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        device_ext_list.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+    }
 
     /* locgical device 需要的 feature */
+    bool        gpu_driven = physical_info.gpu_driven_support();
+    const auto &supported  = physical_info.physical_device_features;
     [[maybe_unused]] vk::PhysicalDeviceFeatures device_feature{
-            .tessellationShader = VK_TRUE,
-            .sampleRateShading  = VK_TRUE,
-            .samplerAnisotropy  = VK_TRUE,
+            .tessellationShader        = VK_TRUE,
+            .sampleRateShading         = VK_TRUE,
+            .multiDrawIndirect         = gpu_driven,
+            .drawIndirectFirstInstance = gpu_driven,
+            .samplerAnisotropy         = VK_TRUE,
+
+            /* 统计 fragment shader 的调用次数等，设备支持时才开启 */
+            .pipelineStatisticsQuery = supported.pipelineStatisticsQuery,
+            .inheritedQueries        = supported.inheritedQueries,
     };
+
+    /**
+     * vulkan 1.2 的 feature，设备支持时才开启；只有 apiVersion >= 1.2 的设备才会把它接入 pNext 链
+     * 同一个 pNext 链中不能同时出现 Vulkan12Features 和 DescriptorIndexingFeatures，因此 bindless 的 feature 也放在这里
+     */
+    bool                               bindless = physical_info.bindless_support();
+    vk::PhysicalDeviceVulkan12Features vulkan12_feature{
+            .drawIndirectCount                            = gpu_driven,
+            .shaderSampledImageArrayNonUniformIndexing    = bindless,
+            .descriptorBindingSampledImageUpdateAfterBind = bindless,
+            .descriptorBindingPartiallyBound              = bindless,
+            .runtimeDescriptorArray                       = bindless,
+    };
+
+    /* present id 和 present wait 用于测量输入到呈现的延迟，设备支持时才开启；1.1 的设备上直接作为链的开头 */
+    vk::PhysicalDevicePresentWaitFeaturesKHR present_wait_feature{.presentWait = VK_TRUE};
+    vk::PhysicalDevicePresentIdFeaturesKHR   present_id_feature{.pNext = &present_wait_feature, .presentId = VK_TRUE};
+
+    void *feature_chain = physical_info.present_wait ? &present_id_feature : nullptr;
+    if (physical_info.vulkan12)
+    {
+        vulkan12_feature.pNext = feature_chain;
+        feature_chain          = &vulkan12_feature;
+    }
+
     vk::DeviceCreateInfo device_create_info = {
+            .pNext                   = feature_chain,
             .queueCreateInfoCount    = (uint32_t) queue_info.size(),
             .pQueueCreateInfos       = queue_info.data(),
             .enabledExtensionCount   = (uint32_t) device_ext_list.size(),
@@ -110,18 +200,6 @@ vk::SurfaceFormatKHR Hiss::Env::present_format_choose(const std::vector<vk::Surf
     return format_list_[0];
 }
 
-/**
- * 从设备支持的 present mode 中选择一种，优先选择 mailbox 类型
- */
-vk::PresentModeKHR Hiss::Env::present_mode_choose(const std::vector<vk::PresentModeKHR> &present_mode_list_)
-{
-    for (const auto &present_mode: present_mode_list_)
-        if (present_mode == vk::PresentModeKHR::eMailbox)
-            return present_mode;
-    return vk::PresentModeKHR::eFifo;
-}
-
-
 /**
  * 根据 glfw window 的大小，获得当前的 extent(pixel)
  * vulkan 使用的是以 pixel 为单位的分辨率，glfw 初始化窗口时使用的是 screen coordinate
@@ -193,6 +271,10 @@ void Hiss::Env::init_once(const vk::Instance &instance)
         });
     }
     env.device         = device_create(env.physical_device, *env.info, queue_info);
+    VULKAN_HPP_DEFAULT_DISPATCHER.init(env.device);    // device 级别的函数，包括 present wait 等扩展的函数
+    env.bindless       = env.info->bindless_support();
+    env.gpu_driven     = env.info->gpu_driven_support();
+    env.present_wait   = env.info->present_wait;
     env.graphics_queue = {
             .queue      = env.device.getQueue(env.info->grahics_queue_families[0], 0),
             .family_idx = env.info->grahics_queue_families[0],
@@ -212,7 +294,6 @@ void Hiss::Env::init_once(const vk::Instance &instance)
 
     /* 确定 surface 相关的属性 */
     env.present_format = present_format_choose(env.info->surface_format_list);
-    env.present_mode   = present_mode_choose(env.info->present_mode_list);
     env.present_extent =
             present_extent_choose(env.info->surface_capability, WindowStatic::window_get());
 
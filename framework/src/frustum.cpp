@@ -0,0 +1,225 @@
+#include "../frustum.hpp"
+#include <bit>
+
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HISS_CULL_AVX2 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define HISS_CULL_NEON 1
+#include <arm_neon.h>
+#endif
+
+
+Hiss::Frustum Hiss::Frustum::extract(const glm::mat4 &m)
+{
+    auto row = [&](int i) { return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+
+    Frustum frustum = {.planes = {
+                               row(3) + row(0), row(3) - row(0),    // left, right
+                               row(3) + row(1), row(3) - row(1),    // bottom, top
+                               row(2), row(3) - row(2),             // near, far
+                       }};
+    for (auto &plane: frustum.planes)
+        plane /= glm::length(glm::vec3(plane));
+    return frustum;
+}
+
+
+bool Hiss::Frustum::sphere_visible(const glm::vec3 &center, float radius) const
+{
+    for (const auto &plane: planes)
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+            return false;
+    return true;
+}
+
+
+Hiss::Frustum::Test Hiss::Frustum::aabb_test(const glm::vec3 &min, const glm::vec3 &max) const
+{
+    Test result = Test::INSIDE;
+    for (const auto &plane: planes)
+    {
+        glm::vec3 n(plane);
+
+        /* p-vertex 在平面外侧：整个 AABB 都在外侧 */
+        glm::vec3 p = glm::mix(min, max, glm::greaterThanEqual(n, glm::vec3(0.f)));
+        if (glm::dot(n, p) + plane.w < 0.f)
+            return Test::OUTSIDE;
+
+        /* n-vertex 在平面外侧：AABB 和平面相交 */
+        glm::vec3 q = glm::mix(max, min, glm::greaterThanEqual(n, glm::vec3(0.f)));
+        if (glm::dot(n, q) + plane.w < 0.f)
+            result = Test::INTERSECT;
+    }
+    return result;
+}
+
+
+void Hiss::BoundsSoA::reserve(size_t cnt)
+{
+    cx.reserve(cnt);
+    cy.reserve(cnt);
+    cz.reserve(cnt);
+    radius.reserve(cnt);
+}
+
+
+uint32_t Hiss::BoundsSoA::add(const glm::vec3 &center, float r)
+{
+    cx.push_back(center.x);
+    cy.push_back(center.y);
+    cz.push_back(center.z);
+    radius.push_back(r);
+    return static_cast<uint32_t>(cx.size() - 1);
+}
+
+
+void Hiss::BoundsSoA::set(uint32_t id, const glm::vec3 &center, float r)
+{
+    cx[id]     = center.x;
+    cy[id]     = center.y;
+    cz[id]     = center.z;
+    radius[id] = r;
+}
+
+
+void Hiss::frustum_cull_scalar(const BoundsSoA &bounds, const Frustum &frustum, size_t begin, size_t end,
+                               std::vector<uint32_t> &visible)
+{
+    for (size_t i = begin; i < end; ++i)
+        if (frustum.sphere_visible(bounds.center(static_cast<uint32_t>(i)), bounds.radius[i]))
+            visible.push_back(static_cast<uint32_t>(i));
+}
+
+
+#if HISS_CULL_AVX2
+/**
+ * 每次测试 8 个包围球：对每个平面计算 8 个有向距离，和 -radius 比较，6 个平面的结果取与
+ * 通过 target attribute 单独为这个函数开启 AVX2，不需要整个工程使用 -mavx2，运行时检测 CPU 是否支持
+ */
+__attribute__((target("avx2,fma"))) static size_t frustum_cull_avx2(const Hiss::BoundsSoA &bounds,
+                                                                     const Hiss::Frustum &frustum, size_t begin,
+                                                                     size_t end, std::vector<uint32_t> &visible)
+{
+    __m256 nx[6], ny[6], nz[6], nw[6];
+    for (int p = 0; p < 6; ++p)
+    {
+        nx[p] = _mm256_set1_ps(frustum.planes[p].x);
+        ny[p] = _mm256_set1_ps(frustum.planes[p].y);
+        nz[p] = _mm256_set1_ps(frustum.planes[p].z);
+        nw[p] = _mm256_set1_ps(frustum.planes[p].w);
+    }
+    const __m256 sign = _mm256_set1_ps(-0.f);
+
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 cx  = _mm256_loadu_ps(bounds.cx.data() + i);
+        __m256 cy  = _mm256_loadu_ps(bounds.cy.data() + i);
+        __m256 cz  = _mm256_loadu_ps(bounds.cz.data() + i);
+        __m256 neg = _mm256_xor_ps(_mm256_loadu_ps(bounds.radius.data() + i), sign);
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p)
+        {
+            __m256 d = _mm256_fmadd_ps(nx[p], cx, _mm256_fmadd_ps(ny[p], cy, _mm256_fmadd_ps(nz[p], cz, nw[p])));
+            inside   = _mm256_and_ps(inside, _mm256_cmp_ps(d, neg, _CMP_GE_OQ));
+        }
+
+        /* 将 mask 中为 1 的位展开为 id */
+        auto mask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+        while (mask)
+        {
+            visible.push_back(static_cast<uint32_t>(i) + std::countr_zero(mask));
+            mask &= mask - 1;
+        }
+    }
+    return i;
+}
+#endif
+
+
+#if HISS_CULL_NEON
+/* 每次测试 4 个包围球，和 AVX2 版本的逻辑相同 */
+static size_t frustum_cull_neon(const Hiss::BoundsSoA &bounds, const Hiss::Frustum &frustum, size_t begin, size_t end,
+                                std::vector<uint32_t> &visible)
+{
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        float32x4_t cx  = vld1q_f32(bounds.cx.data() + i);
+        float32x4_t cy  = vld1q_f32(bounds.cy.data() + i);
+        float32x4_t cz  = vld1q_f32(bounds.cz.data() + i);
+        float32x4_t neg = vnegq_f32(vld1q_f32(bounds.radius.data() + i));
+
+        uint32x4_t inside = vdupq_n_u32(~0u);
+        for (const auto &plane: frustum.planes)
+        {
+            float32x4_t d = vdupq_n_f32(plane.w);
+            d             = vfmaq_n_f32(d, cz, plane.z);
+            d             = vfmaq_n_f32(d, cy, plane.y);
+            d             = vfmaq_n_f32(d, cx, plane.x);
+            inside        = vandq_u32(inside, vcgeq_f32(d, neg));
+        }
+
+        /* 每个 lane 取一位，拼成 4 位的 mask */
+        const uint32x4_t bits = {1, 2, 4, 8};
+        uint32_t         mask = vaddvq_u32(vandq_u32(inside, bits));
+        while (mask)
+        {
+            visible.push_back(static_cast<uint32_t>(i) + std::countr_zero(mask));
+            mask &= mask - 1;
+        }
+    }
+    return i;
+}
+#endif
+
+
+void Hiss::frustum_cull(const BoundsSoA &bounds, const Frustum &frustum, size_t begin, size_t end,
+                        std::vector<uint32_t> &visible)
+{
+    size_t i = begin;
+#if HISS_CULL_AVX2
+    static const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    if (avx2)
+        i = frustum_cull_avx2(bounds, frustum, begin, end, visible);
+#elif HISS_CULL_NEON
+    i = frustum_cull_neon(bounds, frustum, begin, end, visible);
+#endif
+
+    /* SIMD 宽度之外的剩余部分 */
+    frustum_cull_scalar(bounds, frustum, i, end, visible);
+}
+
+
+void Hiss::frustum_cull(const BoundsSoA &bounds, const Frustum &frustum, ThreadPool &thread_pool,
+                        std::vector<uint32_t> &visible)
+{
+    /* 每个线程写入自己的列表，最后按照分段的顺序拼接，结果和单线程版本相同 */
+    uint32_t                           task_cnt = thread_pool.thread_cnt();
+    std::vector<std::vector<uint32_t>> partial(task_cnt);
+    thread_pool.run(task_cnt, [&](uint32_t idx) {
+        size_t begin = bounds.size() * idx / task_cnt;
+        size_t end   = bounds.size() * (idx + 1) / task_cnt;
+        partial[idx].reserve(end - begin);
+        frustum_cull(bounds, frustum, begin, end, partial[idx]);
+    });
+
+    visible.clear();
+    for (const auto &list: partial)
+        visible.insert(visible.end(), list.begin(), list.end());
+}
+
+
+const char *Hiss::frustum_cull_isa()
+{
+#if HISS_CULL_AVX2
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? "avx2" : "scalar";
+#elif HISS_CULL_NEON
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,205 @@
+#include "../fxaa.hpp"
+#include "../image.hpp"
+#include "env.hpp"
+
+
+Hiss::Fxaa::Fxaa(PipelineRegistry &pipelines, DescriptorLayoutCache &layout_cache, DescriptorAllocator &allocator,
+                 const std::string &shader_path)
+    : _pipelines(pipelines)
+{
+    auto env = Hiss::Env::env();
+    LogStatic::logger()->info("[fxaa] create fxaa pass.");
+
+
+    /**
+     * binding 0: sampler2D src
+     * binding 1: writeonly image2D dst
+     */
+    _set_layout = layout_cache.get({
+            vk::DescriptorSetLayoutBinding{
+                    .binding         = 0,
+                    .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+                    .descriptorCount = 1,
+                    .stageFlags      = vk::ShaderStageFlagBits::eCompute,
+            },
+            vk::DescriptorSetLayoutBinding{
+                    .binding         = 1,
+                    .descriptorType  = vk::DescriptorType::eStorageImage,
+                    .descriptorCount = 1,
+                    .stageFlags      = vk::ShaderStageFlagBits::eCompute,
+            },
+    });
+    vk::PushConstantRange push_range = {
+            .stageFlags = vk::ShaderStageFlagBits::eCompute,
+            .offset     = 0,
+            .size       = sizeof(Push),
+    };
+    _pipeline_layout = env->device.createPipelineLayout(vk::PipelineLayoutCreateInfo{
+            .setLayoutCount         = 1,
+            .pSetLayouts            = &_set_layout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges    = &push_range,
+    });
+    _shader = ShaderDesc{.stage = vk::ShaderStageFlagBits::eCompute, .path = shader_path};
+    _shader.spec_add(0, WORKGROUP_SIZE);
+    _set = allocator.allocate(_set_layout);
+
+
+    /* 沿边缘方向的采样落在像素之间，需要线性过滤；超出边界的部分 clamp 到边缘 */
+    _sampler = env->device.createSampler(vk::SamplerCreateInfo{
+            .magFilter    = vk::Filter::eLinear,
+            .minFilter    = vk::Filter::eLinear,
+            .mipmapMode   = vk::SamplerMipmapMode::eNearest,
+            .addressModeU = vk::SamplerAddressMode::eClampToEdge,
+            .addressModeV = vk::SamplerAddressMode::eClampToEdge,
+            .addressModeW = vk::SamplerAddressMode::eClampToEdge,
+            .maxLod       = 0.f,
+    });
+}
+
+
+Hiss::Fxaa::~Fxaa()
+{
+    auto env = Hiss::Env::env();
+
+    output_free();
+    env->device.destroySampler(_sampler);
+    env->device.destroyPipelineLayout(_pipeline_layout);
+}
+
+
+void Hiss::Fxaa::output_free()
+{
+    auto env = Hiss::Env::env();
+
+    env->device.destroy(_output_view);
+    env->device.destroy(_output);
+    env->device.free(_output_mem);
+    _output      = nullptr;
+    _output_mem  = nullptr;
+    _output_view = nullptr;
+    _output_size = 0;
+}
+
+
+void Hiss::Fxaa::resize(vk::ImageView src_view, const vk::Extent2D &max_extent)
+{
+    auto env = Hiss::Env::env();
+    LogStatic::logger()->info("[fxaa] output extent: {}x{}", max_extent.width, max_extent.height);
+
+
+    output_free();
+    _max_extent = max_extent;
+    img_create(
+            vk::ImageCreateInfo{
+                    .imageType     = vk::ImageType::e2D,
+                    .format        = FORMAT,
+                    .extent        = {.width = max_extent.width, .height = max_extent.height, .depth = 1},
+                    .mipLevels     = 1,
+                    .arrayLayers   = 1,
+                    .samples       = vk::SampleCountFlagBits::e1,
+                    .tiling        = vk::ImageTiling::eOptimal,
+                    .usage         = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc,
+                    .sharingMode   = vk::SharingMode::eExclusive,
+                    .initialLayout = vk::ImageLayout::eUndefined,
+            },
+            vk::MemoryPropertyFlagBits::eDeviceLocal, _output, _output_mem);
+    _output_view = img_view_create(_output, FORMAT, vk::ImageAspectFlagBits::eColor, 1);
+    _output_size = env->device.getImageMemoryRequirements(_output).size;
+
+
+    vk::DescriptorImageInfo src_info = {
+            .sampler     = _sampler,
+            .imageView   = src_view,
+            .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+    };
+    vk::DescriptorImageInfo dst_info = {
+            .imageView   = _output_view,
+            .imageLayout = vk::ImageLayout::eGeneral,
+    };
+    env->device.updateDescriptorSets(
+            {
+                    vk::WriteDescriptorSet{
+                            .dstSet          = _set,
+                            .dstBinding      = 0,
+                            .descriptorCount = 1,
+                            .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+                            .pImageInfo      = &src_info,
+                    },
+                    vk::WriteDescriptorSet{
+                            .dstSet          = _set,
+                            .dstBinding      = 1,
+                            .descriptorCount = 1,
+                            .descriptorType  = vk::DescriptorType::eStorageImage,
+                            .pImageInfo      = &dst_info,
+                    },
+            },
+            {});
+}
+
+
+void Hiss::Fxaa::record(vk::CommandBuffer cmd, vk::Image src, const vk::Extent2D &extent)
+{
+    vk::ImageSubresourceRange range = {
+            .aspectMask = vk::ImageAspectFlagBits::eColor,
+            .levelCount = 1,
+            .layerCount = 1,
+    };
+
+
+    /**
+     * src：等待 resolve 写入完成，转换为 shader read only
+     * output：上一帧的 blit 读取完成之后才能覆盖，之前的内容不需要保留
+     */
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eTransfer,
+                        vk::PipelineStageFlagBits::eComputeShader, {}, {}, {},
+                        {
+                                vk::ImageMemoryBarrier{
+                                        .srcAccessMask       = vk::AccessFlagBits::eColorAttachmentWrite,
+                                        .dstAccessMask       = vk::AccessFlagBits::eShaderRead,
+                                        .oldLayout           = vk::ImageLayout::eTransferSrcOptimal,
+                                        .newLayout           = vk::ImageLayout::eShaderReadOnlyOptimal,
+                                        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                                        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                                        .image               = src,
+                                        .subresourceRange    = range,
+                                },
+                                vk::ImageMemoryBarrier{
+                                        .srcAccessMask       = {},
+                                        .dstAccessMask       = vk::AccessFlagBits::eShaderWrite,
+                                        .oldLayout           = vk::ImageLayout::eUndefined,
+                                        .newLayout           = vk::ImageLayout::eGeneral,
+                                        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                                        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                                        .image               = _output,
+                                        .subresourceRange    = range,
+                                },
+                        });
+
+
+    /* 每个 invocation 处理一个像素 */
+    Push push = {
+            .extent   = glm::ivec2(extent.width, extent.height),
+            .inv_size = glm::vec2(1.f / static_cast<float>(_max_extent.width),
+                                  1.f / static_cast<float>(_max_extent.height)),
+    };
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, _pipelines.get(PipelineDesc::compute(_shader, _pipeline_layout)));
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, _pipeline_layout, 0, {_set}, {});
+    cmd.pushConstants(_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(Push), &push);
+    cmd.dispatch((extent.width + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE,
+                 (extent.height + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1);
+
+
+    /* 输出图像之后被 blit 读取 */
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, {}, {}, {},
+                        {vk::ImageMemoryBarrier{
+                                .srcAccessMask       = vk::AccessFlagBits::eShaderWrite,
+                                .dstAccessMask       = vk::AccessFlagBits::eTransferRead,
+                                .oldLayout           = vk::ImageLayout::eGeneral,
+                                .newLayout           = vk::ImageLayout::eTransferSrcOptimal,
+                                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                                .image               = _output,
+                                .subresourceRange    = range,
+                        }});
+}
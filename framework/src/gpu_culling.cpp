@@ -0,0 +1,277 @@
+#include "../gpu_culling.hpp"
+#include <cstring>
+#include <algorithm>
+#include "../buffer.hpp"
+#include "../frustum.hpp"
+#include "env.hpp"
+
+
+Hiss::GpuCulling::GpuCulling(PipelineRegistry &pipelines, DescriptorLayoutCache &layout_cache,
+                             DescriptorAllocator &allocator, uint32_t frame_cnt, const std::string &shader_path)
+    : _pipelines(pipelines),
+      _frames(frame_cnt),
+      _readback(sizeof(uint32_t) * MAX_LODS, frame_cnt)
+{
+    auto env = Hiss::Env::env();
+    LogStatic::logger()->info("[culling] create gpu culling, frames: {}", frame_cnt);
+
+
+    /**
+     * cull shader 的 set：
+     * binding 0: uniform CullUBO
+     * binding 1: readonly buffer Instances
+     * binding 2: writeonly buffer Draws
+     * binding 3: buffer Counts
+     */
+    auto storage_binding = [](uint32_t binding, vk::ShaderStageFlags stage) {
+        return vk::DescriptorSetLayoutBinding{
+                .binding         = binding,
+                .descriptorType  = vk::DescriptorType::eStorageBuffer,
+                .descriptorCount = 1,
+                .stageFlags      = stage,
+        };
+    };
+    _cull_layout = layout_cache.get({
+            vk::DescriptorSetLayoutBinding{
+                    .binding         = 0,
+                    .descriptorType  = vk::DescriptorType::eUniformBuffer,
+                    .descriptorCount = 1,
+                    .stageFlags      = vk::ShaderStageFlagBits::eCompute,
+            },
+            storage_binding(1, vk::ShaderStageFlagBits::eCompute),
+            storage_binding(2, vk::ShaderStageFlagBits::eCompute),
+            storage_binding(3, vk::ShaderStageFlagBits::eCompute),
+    });
+    _instance_layout = layout_cache.get({storage_binding(0, vk::ShaderStageFlagBits::eVertex)});
+    _pipeline_layout = env->device.createPipelineLayout(vk::PipelineLayoutCreateInfo{
+            .setLayoutCount = 1,
+            .pSetLayouts    = &_cull_layout,
+    });
+    _shader = ShaderDesc{.stage = vk::ShaderStageFlagBits::eCompute, .path = shader_path};
+    _shader.spec_add(0, WORKGROUP_SIZE);
+
+
+    _instance_set = allocator.allocate(_instance_layout);
+    for (auto &frame: _frames)
+    {
+        buffer_create(sizeof(CullUBO), vk::BufferUsageFlagBits::eUniformBuffer,
+                      vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                      frame.ubo, frame.ubo_mem);
+        frame.ubo_data = static_cast<CullUBO *>(env->device.mapMemory(frame.ubo_mem, 0, sizeof(CullUBO), {}));
+        buffer_create(sizeof(uint32_t) * MAX_LODS,
+                      vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer
+                              | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc,
+                      vk::MemoryPropertyFlagBits::eDeviceLocal, frame.counts, frame.counts_mem);
+        frame.set = allocator.allocate(_cull_layout);
+    }
+
+    buffers_create(WORKGROUP_SIZE);
+}
+
+
+Hiss::GpuCulling::~GpuCulling()
+{
+    auto env = Hiss::Env::env();
+
+    buffers_free();
+    for (auto &frame: _frames)
+    {
+        env->device.unmapMemory(frame.ubo_mem);
+        env->device.destroy(frame.ubo);
+        env->device.free(frame.ubo_mem);
+        env->device.destroy(frame.counts);
+        env->device.free(frame.counts_mem);
+    }
+    env->device.destroyPipelineLayout(_pipeline_layout);
+}
+
+
+/**
+ * 和实例数量相关的 buffer：实例数据，以及每一帧的 draw command
+ * 每个 LOD 都预留 capacity 个 draw command，最坏的情况下所有的实例都选择同一个 LOD
+ */
+void Hiss::GpuCulling::buffers_create(uint32_t capacity)
+{
+    LogStatic::logger()->info("[culling] instance capacity: {}", capacity);
+    _capacity = capacity;
+
+    buffer_create(sizeof(Instance) * _capacity,
+                  vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                  vk::MemoryPropertyFlagBits::eDeviceLocal, _instances, _instances_mem);
+    for (auto &frame: _frames)
+        buffer_create(sizeof(vk::DrawIndexedIndirectCommand) * MAX_LODS * _capacity,
+                      vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+                      vk::MemoryPropertyFlagBits::eDeviceLocal, frame.draws, frame.draws_mem);
+
+    descriptors_write();
+}
+
+
+void Hiss::GpuCulling::buffers_free()
+{
+    auto env = Hiss::Env::env();
+
+    env->device.destroy(_instances);
+    env->device.free(_instances_mem);
+    for (auto &frame: _frames)
+    {
+        env->device.destroy(frame.draws);
+        env->device.free(frame.draws_mem);
+    }
+}
+
+
+void Hiss::GpuCulling::descriptors_write()
+{
+    auto env = Hiss::Env::env();
+
+
+    /* buffer info 的地址需要在 updateDescriptorSets 之前保持有效 */
+    std::vector<vk::DescriptorBufferInfo> buffer_infos;
+    buffer_infos.reserve(1 + _frames.size() * 4);
+    std::vector<vk::WriteDescriptorSet> writes;
+    auto write_add = [&](vk::DescriptorSet set, uint32_t binding, vk::DescriptorType type, vk::Buffer buffer) {
+        buffer_infos.push_back(vk::DescriptorBufferInfo{.buffer = buffer, .offset = 0, .range = VK_WHOLE_SIZE});
+        writes.push_back(vk::WriteDescriptorSet{
+                .dstSet          = set,
+                .dstBinding      = binding,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType  = type,
+                .pBufferInfo     = &buffer_infos.back(),
+        });
+    };
+
+    write_add(_instance_set, 0, vk::DescriptorType::eStorageBuffer, _instances);
+    for (auto &frame: _frames)
+    {
+        write_add(frame.set, 0, vk::DescriptorType::eUniformBuffer, frame.ubo);
+        write_add(frame.set, 1, vk::DescriptorType::eStorageBuffer, _instances);
+        write_add(frame.set, 2, vk::DescriptorType::eStorageBuffer, frame.draws);
+        write_add(frame.set, 3, vk::DescriptorType::eStorageBuffer, frame.counts);
+    }
+    env->device.updateDescriptorSets(writes, {});
+}
+
+
+void Hiss::GpuCulling::instances_upload(const std::vector<Instance> &instances)
+{
+    auto env      = Hiss::Env::env();
+    _instance_cnt = static_cast<uint32_t>(instances.size());
+    if (instances.empty())
+        return;
+
+
+    /* 容量按照 2 的幂增长 */
+    if (_instance_cnt > _capacity)
+    {
+        uint32_t capacity = _capacity;
+        while (capacity < _instance_cnt)
+            capacity *= 2;
+        buffers_free();
+        buffers_create(capacity);
+    }
+
+
+    vk::DeviceSize   size = sizeof(Instance) * instances.size();
+    vk::Buffer       stage_buffer;
+    vk::DeviceMemory stage_mem;
+    buffer_create(size, vk::BufferUsageFlagBits::eTransferSrc,
+                  vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, stage_buffer,
+                  stage_mem);
+    void *data = env->device.mapMemory(stage_mem, 0, size, {});
+    std::memcpy(data, instances.data(), size);
+    env->device.unmapMemory(stage_mem);
+    {
+        OneTimeCmdBuffer cmd;
+        cmd().copyBuffer(stage_buffer, _instances, {vk::BufferCopy{.size = size}});
+        cmd.end();
+    }
+    env->device.destroy(stage_buffer);
+    env->device.free(stage_mem);
+}
+
+
+void Hiss::GpuCulling::lods_set(const std::vector<Lod> &lods)
+{
+    if (lods.empty() || lods.size() > MAX_LODS)
+        throw std::runtime_error("gpu culling: invalid lod count.");
+    _lods = lods;
+}
+
+
+void Hiss::GpuCulling::cull_record(vk::CommandBuffer cmd, uint32_t frame_idx, const View &view)
+{
+    auto &frame = _frames[frame_idx];
+    frame.total = _instance_cnt;
+
+
+    /* 这一帧的 fence 已经等待过了，可以直接覆盖 uniform buffer */
+    CullUBO ubo = {
+            .local         = view.local,
+            .planes        = Frustum::extract(view.view_proj).planes,
+            .eye           = glm::vec4(view.eye, 1.f),
+            .lods          = {},
+            .instance_cnt  = _instance_cnt,
+            .lod_cnt       = static_cast<uint32_t>(_lods.size()),
+            .lod_scale     = view.lod_scale,
+            .lod_threshold = view.lod_threshold,
+            .draw_capacity = _capacity,
+            .lod_force     = view.lod_force,
+    };
+    std::copy(_lods.begin(), _lods.end(), ubo.lods.begin());
+    std::memcpy(frame.ubo_data, &ubo, sizeof(ubo));
+
+
+    /* 计数器清零 */
+    cmd.fillBuffer(frame.counts, 0, sizeof(uint32_t) * MAX_LODS, 0);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, {},
+                        {vk::MemoryBarrier{
+                                .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+                                .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+                        }},
+                        {}, {});
+
+
+    /* 每个 invocation 处理一个实例 */
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, _pipelines.get(PipelineDesc::compute(_shader, _pipeline_layout)));
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, _pipeline_layout, 0, {frame.set}, {});
+    cmd.dispatch((_instance_cnt + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+
+    /* draw command 和计数器之后会被 draw indirect 读取，计数器还会被 copy 到 readback ring */
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                        vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eTransfer, {},
+                        {vk::MemoryBarrier{
+                                .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+                                .dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead
+                                               | vk::AccessFlagBits::eTransferRead,
+                        }},
+                        {}, {});
+    _readback.copy_record(cmd, frame_idx, frame.counts, 0, sizeof(uint32_t) * MAX_LODS);
+}
+
+
+void Hiss::GpuCulling::draw_record(vk::CommandBuffer cmd, uint32_t frame_idx, uint32_t lod) const
+{
+    const auto    &frame  = _frames[frame_idx];
+    const uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+    cmd.drawIndexedIndirectCount(frame.draws, static_cast<vk::DeviceSize>(stride) * _capacity * lod, frame.counts,
+                                 sizeof(uint32_t) * lod, _capacity, stride);
+}
+
+
+std::optional<Hiss::GpuCulling::Stat> Hiss::GpuCulling::stat(uint32_t frame_idx)
+{
+    const auto *counts = _readback.read<uint32_t>(frame_idx);
+    if (!counts)
+        return std::nullopt;
+
+    Stat stat{.total = _frames[frame_idx].total};
+    for (uint32_t i = 0; i < MAX_LODS; ++i)
+    {
+        stat.lod_visible[i] = counts[i];
+        stat.visible += counts[i];
+    }
+    return stat;
+}
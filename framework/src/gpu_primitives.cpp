@@ -0,0 +1,351 @@
+#include "../gpu_primitives.hpp"
+#include <bit>
+#include "global.hpp"
+
+
+namespace
+{
+
+uint32_t div_up(uint32_t a, uint32_t b)
+{
+    return (a + b - 1) / b;
+}
+
+}    // namespace
+
+
+Hiss::GpuPrimitives::GpuPrimitives(Device &device, PipelineRegistry &pipelines, DescriptorLayoutCache &layout_cache,
+                                   const std::string &shader_dir)
+    : _device(device),
+      _pipelines(pipelines),
+      _allocator(device.handle_get())
+{
+    vk::Device         d  = _device.handle_get();
+    vk::PhysicalDevice pd = _device.physical_device_get();
+
+
+    /**
+     * workgroup 内的 scan 和 rank 需要 compute stage 中的 subgroup arithmetic 和 ballot
+     * 不要求 subgroup 是满的，shader 中的 local_index() 会处理不满的 subgroup；
+     * shared memory 按照每个 workgroup 最多 WORKGROUP_SIZE / MIN_SUBGROUP_SIZE 个 subgroup 分配
+     */
+    auto chain    = pd.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceSubgroupProperties>();
+    auto limits   = chain.get<vk::PhysicalDeviceProperties2>().properties.limits;
+    auto subgroup = chain.get<vk::PhysicalDeviceSubgroupProperties>();
+    auto ops      = vk::SubgroupFeatureFlagBits::eBasic | vk::SubgroupFeatureFlagBits::eArithmetic
+             | vk::SubgroupFeatureFlagBits::eBallot;
+    if (!(subgroup.supportedStages & vk::ShaderStageFlagBits::eCompute) || (subgroup.supportedOperations & ops) != ops)
+        throw std::runtime_error("gpu primitives: subgroup arithmetic and ballot are unsupported in compute shaders.");
+    if (subgroup.subgroupSize < MIN_SUBGROUP_SIZE)
+        throw std::runtime_error("gpu primitives: unsupported subgroup size " + std::to_string(subgroup.subgroupSize));
+    if (limits.maxComputeWorkGroupInvocations < WORKGROUP_SIZE || limits.maxComputeWorkGroupSize[0] < WORKGROUP_SIZE)
+        throw std::runtime_error("gpu primitives: workgroup size exceeds the device limit.");
+    _max_group_cnt      = limits.maxComputeWorkGroupCount[0];
+    _shared_memory_size = limits.maxComputeSharedMemorySize;
+
+
+    std::vector<vk::DescriptorSetLayoutBinding> bindings;
+    for (uint32_t i = 0; i < BINDING_CNT; ++i)
+        bindings.push_back({i, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute});
+    _set_layout = layout_cache.get(bindings);
+
+    vk::PushConstantRange push_range = {
+            .stageFlags = vk::ShaderStageFlagBits::eCompute,
+            .offset     = 0,
+            .size       = sizeof(Push),
+    };
+    _pipeline_layout = d.createPipelineLayout(vk::PipelineLayoutCreateInfo{
+            .setLayoutCount         = 1,
+            .pSetLayouts            = &_set_layout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges    = &push_range,
+    });
+
+
+    auto shader = [&](const std::string &name) {
+        ShaderDesc desc{.stage = vk::ShaderStageFlagBits::eCompute, .path = shader_dir + "/" + name};
+        desc.spec_add(0, WORKGROUP_SIZE);
+        return desc;
+    };
+    _shader_reduce        = shader("prim_reduce.comp.spv");
+    _shader_scan          = shader("prim_scan.comp.spv");
+    _shader_histogram     = shader("prim_histogram.comp.spv");
+    _shader_compact       = shader("prim_compact.comp.spv");
+    _shader_radix_count   = shader("prim_radix_count.comp.spv");
+    _shader_radix_scatter = shader("prim_radix_scatter.comp.spv");
+
+    _dummy = Buffer(_device, sizeof(uint32_t) * 4, vk::BufferUsageFlagBits::eStorageBuffer,
+                    vk::MemoryPropertyFlagBits::eDeviceLocal);
+    LogStatic::logger()->info("[primitives] subgroup size: {}, workgroup size: {}", subgroup.subgroupSize,
+                              WORKGROUP_SIZE);
+}
+
+
+Hiss::GpuPrimitives::~GpuPrimitives()
+{
+    _device.handle_get().destroy(_pipeline_layout);
+}
+
+
+void Hiss::GpuPrimitives::buffers_free()
+{
+    _levels.clear();
+    for (Buffer *b: {&_offsets, &_keys_tmp, &_values_tmp, &_hist})
+        b->reset();
+    _capacity    = 0;
+    _memory_size = 0;
+}
+
+
+void Hiss::GpuPrimitives::reserve(uint32_t capacity)
+{
+    if (capacity <= _capacity)
+        return;
+
+    /* sort 的 block 最小，决定了一次 dispatch 能处理的最大元素数量 */
+    if (div_up(capacity, WORKGROUP_SIZE) > _max_group_cnt)
+        throw std::runtime_error("gpu primitives: capacity exceeds the workgroup count limit.");
+
+    buffers_free();
+    descriptors_reset();
+    _capacity = capacity;
+
+
+    auto create = [this](Buffer &b, uint32_t cnt, vk::BufferUsageFlags usage = {}) {
+        vk::DeviceSize size = sizeof(uint32_t) * cnt;
+        b = Buffer(_device, size, vk::BufferUsageFlagBits::eStorageBuffer | usage,
+                   vk::MemoryPropertyFlagBits::eDeviceLocal);
+        _memory_size += size;
+    };
+
+    /* 每一级的元素数量是上一级的 block 数量，直到只剩一个 block */
+    for (uint32_t cnt = div_up(capacity, BLOCK_SIZE); cnt > 1; cnt = div_up(cnt, BLOCK_SIZE))
+        create(_levels.emplace_back(), cnt);
+    create(_offsets, capacity);
+    create(_keys_tmp, capacity, vk::BufferUsageFlagBits::eTransferSrc);
+    create(_values_tmp, capacity, vk::BufferUsageFlagBits::eTransferSrc);
+    create(_hist, RADIX * div_up(capacity, WORKGROUP_SIZE));
+
+    LogStatic::logger()->info("[primitives] capacity: {}, scan levels: {}, scratch buffers: {:.1f} MB", capacity,
+                              _levels.size(), static_cast<double>(_memory_size) / (1024. * 1024.));
+}
+
+
+void Hiss::GpuPrimitives::descriptors_reset()
+{
+    _allocator.reset();
+    _sets.clear();
+}
+
+
+void Hiss::GpuPrimitives::capacity_check(uint32_t cnt) const
+{
+    if (cnt == 0)
+        throw std::runtime_error("gpu primitives: element count is zero.");
+    if (cnt > _capacity)
+        throw std::runtime_error("gpu primitives: element count exceeds the reserved capacity.");
+}
+
+
+vk::DescriptorSet Hiss::GpuPrimitives::set_get(Bindings bindings)
+{
+    for (auto &b: bindings)
+        if (!b)
+            b = _dummy.handle_get();
+    if (auto iter = _sets.find(bindings); iter != _sets.end())
+        return iter->second;
+
+    vk::DescriptorSet                                    set = _allocator.allocate(_set_layout);
+    std::array<vk::DescriptorBufferInfo, BINDING_CNT>    infos;
+    std::array<vk::WriteDescriptorSet, BINDING_CNT>      writes;
+    for (uint32_t i = 0; i < BINDING_CNT; ++i)
+    {
+        infos[i]  = {bindings[i], 0, VK_WHOLE_SIZE};
+        writes[i] = vk::WriteDescriptorSet{
+                .dstSet          = set,
+                .dstBinding      = i,
+                .descriptorCount = 1,
+                .descriptorType  = vk::DescriptorType::eStorageBuffer,
+                .pBufferInfo     = &infos[i],
+        };
+    }
+    _device.handle_get().updateDescriptorSets(writes, {});
+
+    _sets[bindings] = set;
+    return set;
+}
+
+
+void Hiss::GpuPrimitives::dispatch(vk::CommandBuffer cmd, const ShaderDesc &shader, const Bindings &bindings,
+                                   const Push &push, uint32_t group_cnt)
+{
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute,
+                     _pipelines.get(PipelineDesc::compute(shader, _pipeline_layout)));
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, _pipeline_layout, 0, {set_get(bindings)}, nullptr);
+    cmd.pushConstants(_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(Push), &push);
+    cmd.dispatch(group_cnt, 1, 1);
+
+
+    /* 每个 pass 都读取上一个 pass 的结果，使用 global memory barrier 覆盖所有的 buffer */
+    vk::MemoryBarrier2 barrier = {
+            .srcStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .srcAccessMask = vk::AccessFlagBits2::eShaderWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .dstAccessMask = vk::AccessFlagBits2::eShaderRead | vk::AccessFlagBits2::eShaderWrite,
+    };
+    cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &barrier});
+}
+
+
+/**
+ * 只有一个 block 时直接 scan；否则先求出每个 block 的和（reduce），对它递归 scan，
+ * 最后每个 block 在自己的偏移上再 scan 一次；读取两遍输入，但只写一遍输出
+ */
+void Hiss::GpuPrimitives::scan_levels_record(vk::CommandBuffer cmd, vk::Buffer src, vk::Buffer dst, uint32_t cnt,
+                                             bool inclusive, bool predicate, uint32_t level)
+{
+    ShaderDesc scan = _shader_scan;
+    scan.spec_add(2, static_cast<vk::Bool32>(predicate));
+    uint32_t flags     = inclusive ? FLAG_INCLUSIVE : 0;
+    uint32_t block_cnt = div_up(cnt, BLOCK_SIZE);
+
+    if (block_cnt == 1)
+    {
+        dispatch(cmd, scan, {src, dst}, {.cnt = cnt, .flags = flags}, 1);
+        return;
+    }
+
+    ShaderDesc reduce = _shader_reduce;
+    reduce.spec_add(1, static_cast<uint32_t>(ReduceOp::ADD)).spec_add(2, static_cast<vk::Bool32>(predicate));
+    vk::Buffer sums = _levels.at(level).handle_get();
+
+    dispatch(cmd, reduce, {src, sums}, {.cnt = cnt}, block_cnt);
+    scan_levels_record(cmd, sums, sums, block_cnt, false, false, level + 1);
+    dispatch(cmd, scan, {src, dst, sums}, {.cnt = cnt, .flags = flags | FLAG_OFFSETS}, block_cnt);
+}
+
+
+void Hiss::GpuPrimitives::scan_record(vk::CommandBuffer cmd, vk::Buffer src, vk::Buffer dst, uint32_t cnt,
+                                      bool inclusive)
+{
+    capacity_check(cnt);
+    scan_levels_record(cmd, src, dst, cnt, inclusive, false, 0);
+}
+
+
+void Hiss::GpuPrimitives::reduce_record(vk::CommandBuffer cmd, vk::Buffer src, uint32_t cnt, vk::Buffer dst,
+                                        ReduceOp op)
+{
+    capacity_check(cnt);
+    ShaderDesc reduce = _shader_reduce;
+    reduce.spec_add(1, static_cast<uint32_t>(op)).spec_add(2, static_cast<vk::Bool32>(false));
+
+    /* 每一级将 BLOCK_SIZE 个元素归约为一个，最后一级只有一个 workgroup，直接写入 dst */
+    for (uint32_t level = 0;; ++level)
+    {
+        uint32_t   group_cnt = div_up(cnt, BLOCK_SIZE);
+        vk::Buffer out       = group_cnt == 1 ? dst : _levels.at(level).handle_get();
+        dispatch(cmd, reduce, {src, out}, {.cnt = cnt}, group_cnt);
+        if (group_cnt == 1)
+            break;
+        src = out;
+        cnt = group_cnt;
+    }
+}
+
+
+void Hiss::GpuPrimitives::histogram_record(vk::CommandBuffer cmd, vk::Buffer src, uint32_t cnt, vk::Buffer dst,
+                                           uint32_t bin_cnt, uint32_t shift)
+{
+    capacity_check(cnt);
+    if (!std::has_single_bit(bin_cnt) || bin_cnt > MAX_BINS)
+        throw std::runtime_error("gpu primitives: histogram bin count must be a power of two up to 4096.");
+    if (sizeof(uint32_t) * (bin_cnt + WORKGROUP_SIZE / MIN_SUBGROUP_SIZE + 1) > _shared_memory_size)
+        throw std::runtime_error("gpu primitives: histogram bins exceed the shared memory limit.");
+
+    /* 清零之前等待之前的 compute shader 读写完 dst */
+    vk::MemoryBarrier2 clear_barrier = {
+            .srcStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .srcAccessMask = vk::AccessFlagBits2::eShaderWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eTransfer,
+            .dstAccessMask = vk::AccessFlagBits2::eTransferWrite,
+    };
+    cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &clear_barrier});
+    cmd.fillBuffer(dst, 0, sizeof(uint32_t) * bin_cnt, 0u);
+    vk::MemoryBarrier2 fill_barrier = {
+            .srcStageMask  = vk::PipelineStageFlagBits2::eTransfer,
+            .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .dstAccessMask = vk::AccessFlagBits2::eShaderRead | vk::AccessFlagBits2::eShaderWrite,
+    };
+    cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &fill_barrier});
+
+    ShaderDesc histogram = _shader_histogram;
+    histogram.spec_add(3, bin_cnt);
+    dispatch(cmd, histogram, {src, dst}, {.cnt = cnt, .shift = shift}, div_up(cnt, BLOCK_SIZE));
+}
+
+
+void Hiss::GpuPrimitives::compact_record(vk::CommandBuffer cmd, vk::Buffer src, vk::Buffer flags, uint32_t cnt,
+                                         vk::Buffer dst, vk::Buffer count)
+{
+    capacity_check(cnt);
+    scan_levels_record(cmd, flags, _offsets.handle_get(), cnt, false, true, 0);
+    dispatch(cmd, _shader_compact, {src, dst, _offsets.handle_get(), flags, count}, {.cnt = cnt},
+             div_up(cnt, WORKGROUP_SIZE));
+}
+
+
+/**
+ * 每一趟：count -> 对 digit 优先排列的 histogram 做 exclusive scan -> scatter
+ * keys 和临时 buffer 之间 ping-pong，奇数趟之后结果在临时 buffer 中，需要复制回来
+ */
+void Hiss::GpuPrimitives::sort_record(vk::CommandBuffer cmd, vk::Buffer keys, vk::Buffer values, uint32_t cnt,
+                                      uint32_t key_bits)
+{
+    capacity_check(cnt);
+    if (key_bits == 0 || key_bits > 32)
+        throw std::runtime_error("gpu primitives: key bits must be in [1, 32].");
+
+    uint32_t passes    = div_up(key_bits, RADIX_BITS);
+    uint32_t block_cnt = div_up(cnt, WORKGROUP_SIZE);
+    uint32_t flags     = values ? FLAG_HAS_VALUES : 0;
+    for (uint32_t pass = 0; pass < passes; ++pass)
+    {
+        bool       even       = pass % 2 == 0;
+        vk::Buffer keys_src   = even ? keys : _keys_tmp.handle_get();
+        vk::Buffer keys_dst   = even ? _keys_tmp.handle_get() : keys;
+        vk::Buffer values_src = values ? (even ? values : _values_tmp.handle_get()) : vk::Buffer{};
+        vk::Buffer values_dst = values ? (even ? _values_tmp.handle_get() : values) : vk::Buffer{};
+        Push       push       = {.cnt = cnt, .shift = pass * RADIX_BITS, .flags = flags, .block_cnt = block_cnt};
+
+        dispatch(cmd, _shader_radix_count, {keys_src, {}, _hist.handle_get()}, push, block_cnt);
+        scan_levels_record(cmd, _hist.handle_get(), _hist.handle_get(), RADIX * block_cnt, false, false, 0);
+        dispatch(cmd, _shader_radix_scatter, {keys_src, keys_dst, _hist.handle_get(), values_src, values_dst}, push,
+                 block_cnt);
+    }
+    if (passes % 2 == 0)
+        return;
+
+
+    vk::MemoryBarrier2 scatter_barrier = {
+            .srcStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .srcAccessMask = vk::AccessFlagBits2::eShaderWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eTransfer,
+            .dstAccessMask = vk::AccessFlagBits2::eTransferRead | vk::AccessFlagBits2::eTransferWrite,
+    };
+    cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &scatter_barrier});
+
+    vk::DeviceSize size = sizeof(uint32_t) * cnt;
+    cmd.copyBuffer(_keys_tmp.handle_get(), keys, {vk::BufferCopy{.size = size}});
+    if (values)
+        cmd.copyBuffer(_values_tmp.handle_get(), values, {vk::BufferCopy{.size = size}});
+
+    vk::MemoryBarrier2 copy_barrier = {
+            .srcStageMask  = vk::PipelineStageFlagBits2::eTransfer,
+            .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+            .dstAccessMask = vk::AccessFlagBits2::eShaderRead | vk::AccessFlagBits2::eShaderWrite,
+    };
+    cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &copy_barrier});
+}
@@ -0,0 +1,75 @@
+#include "../gpu_timer.hpp"
+#include <array>
+#include "env.hpp"
+
+
+Hiss::GpuTimer::GpuTimer(uint32_t frame_cnt, uint32_t scope_cnt)
+    : _scope_cnt(scope_cnt),
+      _written(frame_cnt * scope_cnt, false)
+{
+    auto        env    = Hiss::Env::env();
+    const auto &limits = env->info->physical_device_properties.limits;
+
+    _supported = limits.timestampComputeAndGraphics
+              && env->info->queue_family_properties[env->graphics_queue.family_idx].timestampValidBits > 0;
+    _period_ns = limits.timestampPeriod;
+    if (!_supported)
+    {
+        LogStatic::logger()->warn("[gpu timer] timestamp query is not supported.");
+        return;
+    }
+
+    _pool = env->device.createQueryPool(vk::QueryPoolCreateInfo{
+            .queryType  = vk::QueryType::eTimestamp,
+            .queryCount = frame_cnt * scope_cnt * 2,
+    });
+}
+
+
+Hiss::GpuTimer::~GpuTimer()
+{
+    if (_pool)
+        Hiss::Env::env()->device.destroyQueryPool(_pool);
+}
+
+
+void Hiss::GpuTimer::reset_record(vk::CommandBuffer cmd, uint32_t frame_idx)
+{
+    if (!_supported)
+        return;
+    cmd.resetQueryPool(_pool, query_idx(frame_idx, 0), _scope_cnt * 2);
+    for (uint32_t scope = 0; scope < _scope_cnt; ++scope)
+        _written[frame_idx * _scope_cnt + scope] = false;
+}
+
+
+void Hiss::GpuTimer::begin_record(vk::CommandBuffer cmd, uint32_t frame_idx, uint32_t scope)
+{
+    if (_supported)
+        cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, _pool, query_idx(frame_idx, scope));
+}
+
+
+void Hiss::GpuTimer::end_record(vk::CommandBuffer cmd, uint32_t frame_idx, uint32_t scope)
+{
+    if (!_supported)
+        return;
+    cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, _pool, query_idx(frame_idx, scope) + 1);
+    _written[frame_idx * _scope_cnt + scope] = true;
+}
+
+
+std::optional<double> Hiss::GpuTimer::elapsed_ms(uint32_t frame_idx, uint32_t scope)
+{
+    if (!_supported || !_written[frame_idx * _scope_cnt + scope])
+        return std::nullopt;
+
+    /* 不等待：结果还不可用时返回 eNotReady */
+    std::array<uint64_t, 2> ticks{};
+    vk::Result result = Hiss::Env::env()->device.getQueryPoolResults(
+            _pool, query_idx(frame_idx, scope), 2, sizeof(ticks), ticks.data(), sizeof(uint64_t),
+            vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess)
+        return std::nullopt;
+    return static_cast<double>(ticks[1] - ticks[0]) * _period_ns * 1e-6;
+}
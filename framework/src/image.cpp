@@ -284,4 +284,53 @@ void mipmap_generate(vk::Image &image, const vk::Format &format, int32_t width,
 
 
     cmd_buffer.end();
-}
\ No newline at end of file
+}
+
+
+void present_blit_record(vk::CommandBuffer cmd, vk::Image src_image, const vk::Extent2D &src_extent,
+                         vk::Image dst_image, const vk::Extent2D &dst_extent)
+{
+    vk::ImageSubresourceRange range = {
+            .aspectMask = vk::ImageAspectFlagBits::eColor,
+            .levelCount = 1,
+            .layerCount = 1,
+    };
+
+    /* swapchain 的 image 在 acquire semaphore 之后才能写入，semaphore 等待的 stage 是 transfer */
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, {}, {},
+                        {vk::ImageMemoryBarrier{
+                                .srcAccessMask       = {},
+                                .dstAccessMask       = vk::AccessFlagBits::eTransferWrite,
+                                .oldLayout           = vk::ImageLayout::eUndefined,
+                                .newLayout           = vk::ImageLayout::eTransferDstOptimal,
+                                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                                .image               = dst_image,
+                                .subresourceRange    = range,
+                        }});
+
+    vk::ImageSubresourceLayers layers = {.aspectMask = vk::ImageAspectFlagBits::eColor, .layerCount = 1};
+    auto corner = [](const vk::Extent2D &extent) {
+        return vk::Offset3D{static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height), 1};
+    };
+    cmd.blitImage(src_image, vk::ImageLayout::eTransferSrcOptimal, dst_image, vk::ImageLayout::eTransferDstOptimal,
+                  {vk::ImageBlit{
+                          .srcSubresource = layers,
+                          .srcOffsets     = {{vk::Offset3D{0, 0, 0}, corner(src_extent)}},
+                          .dstSubresource = layers,
+                          .dstOffsets     = {{vk::Offset3D{0, 0, 0}, corner(dst_extent)}},
+                  }},
+                  vk::Filter::eLinear);
+
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, {},
+                        {vk::ImageMemoryBarrier{
+                                .srcAccessMask       = vk::AccessFlagBits::eTransferWrite,
+                                .dstAccessMask       = {},
+                                .oldLayout           = vk::ImageLayout::eTransferDstOptimal,
+                                .newLayout           = vk::ImageLayout::ePresentSrcKHR,
+                                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                                .image               = dst_image,
+                                .subresourceRange    = range,
+                        }});
+}
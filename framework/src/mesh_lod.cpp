@@ -0,0 +1,419 @@
+#include "../mesh_lod.hpp"
+#include <queue>
+#include <algorithm>
+#include <unordered_map>
+
+
+namespace
+{
+
+/* 边界的约束平面的权重，越大边界越不容易被简化 */
+constexpr double BOUNDARY_WEIGHT = 10.0;
+
+
+/**
+ * 4x4 的对称矩阵，只保存上三角的 10 个元素
+ * w 是累积的面积权重，用于将误差归一化为长度
+ */
+struct Quadric
+{
+    double a00{}, a01{}, a02{}, a03{};
+    double a11{}, a12{}, a13{};
+    double a22{}, a23{};
+    double a33{};
+    double w{};
+
+
+    /* 平面 ax + by + cz + d = 0，要求 (a, b, c) 是单位向量 */
+    static Quadric plane(const glm::dvec3 &n, double d, double weight)
+    {
+        Quadric q;
+        q.a00 = n.x * n.x * weight, q.a01 = n.x * n.y * weight, q.a02 = n.x * n.z * weight;
+        q.a03 = n.x * d * weight;
+        q.a11 = n.y * n.y * weight, q.a12 = n.y * n.z * weight, q.a13 = n.y * d * weight;
+        q.a22 = n.z * n.z * weight, q.a23 = n.z * d * weight;
+        q.a33 = d * d * weight;
+        q.w   = weight;
+        return q;
+    }
+
+
+    Quadric &operator+=(const Quadric &o)
+    {
+        a00 += o.a00, a01 += o.a01, a02 += o.a02, a03 += o.a03;
+        a11 += o.a11, a12 += o.a12, a13 += o.a13;
+        a22 += o.a22, a23 += o.a23;
+        a33 += o.a33;
+        w += o.w;
+        return *this;
+    }
+
+
+    /* 点 p 到所有平面距离的加权均方根 */
+    [[nodiscard]] double error(const glm::vec3 &p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double e = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x    //
+                 + a11 * y * y + 2 * a12 * y * z + 2 * a13 * y                     //
+                 + a22 * z * z + 2 * a23 * z                                      //
+                 + a33;
+        return w > 0 ? std::sqrt(std::max(e, 0.0) / w) : 0.0;
+    }
+};
+
+
+/* 一次 half-edge collapse 的候选：将 from 合并到 to */
+struct Collapse
+{
+    double   cost;
+    uint32_t from, to;
+    uint32_t from_version, to_version;
+
+    bool operator>(const Collapse &o) const { return cost > o.cost; }
+};
+
+
+class Simplifier
+{
+public:
+    Simplifier(const glm::vec3 *positions, size_t vertex_cnt, const uint32_t *indices, size_t index_cnt);
+
+    /* 简化到三角形数量不超过 target，返回简化后的 index 以及误差 */
+    Hiss::MeshLod simplify(size_t target);
+
+    [[nodiscard]] size_t tri_cnt() const { return _alive_tri_cnt; }
+
+private:
+    std::vector<glm::vec3>               _pos;          // position id -> 位置
+    std::vector<uint32_t>                _wedge;        // position id -> 一个具有该位置的 vertex
+    std::vector<std::array<uint32_t, 3>> _tris;         // 三角形的 position id
+    std::vector<std::array<uint32_t, 3>> _corners;      // 三角形的 vertex id，用于输出 index
+    std::vector<bool>                    _tri_alive;
+    std::vector<std::vector<uint32_t>>   _vert_tris;    // position id -> 相邻的三角形
+    std::vector<Quadric>                 _quadrics;
+    std::vector<bool>                    _vert_alive;
+    std::vector<uint32_t>                _version;
+    size_t                               _alive_tri_cnt{};
+    double                               _max_error{};
+
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<>> _heap;
+
+
+    void quadrics_init();
+    void edge_push(uint32_t from, uint32_t to);
+    bool collapse_valid(uint32_t from, uint32_t to) const;
+    void collapse(uint32_t from, uint32_t to);
+};
+
+
+Simplifier::Simplifier(const glm::vec3 *positions, size_t vertex_cnt, const uint32_t *indices, size_t index_cnt)
+{
+    /* 根据位置焊接顶点：uv 接缝处的多个 vertex 在拓扑上是同一个点 */
+    std::unordered_map<glm::vec3, uint32_t> pos_map;
+    std::vector<uint32_t>                   pos_idx(vertex_cnt);
+    for (uint32_t i = 0; i < vertex_cnt; ++i)
+    {
+        auto [iter, inserted] = pos_map.try_emplace(positions[i], static_cast<uint32_t>(_pos.size()));
+        if (inserted)
+        {
+            _pos.push_back(positions[i]);
+            _wedge.push_back(i);
+        }
+        pos_idx[i] = iter->second;
+    }
+
+
+    size_t tri_cnt = index_cnt / 3;
+    _tris.resize(tri_cnt);
+    _corners.resize(tri_cnt);
+    _tri_alive.resize(tri_cnt, true);
+    _vert_tris.resize(_pos.size());
+    for (uint32_t t = 0; t < tri_cnt; ++t)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            _corners[t][k] = indices[3 * t + k];
+            _tris[t][k]    = pos_idx[indices[3 * t + k]];
+        }
+
+        /* 退化的三角形直接丢弃 */
+        if (_tris[t][0] == _tris[t][1] || _tris[t][1] == _tris[t][2] || _tris[t][2] == _tris[t][0])
+        {
+            _tri_alive[t] = false;
+            continue;
+        }
+        ++_alive_tri_cnt;
+        for (uint32_t v: _tris[t])
+            _vert_tris[v].push_back(t);
+    }
+
+
+    _vert_alive.resize(_pos.size(), true);
+    _version.resize(_pos.size(), 0);
+    quadrics_init();
+
+
+    for (uint32_t t = 0; t < tri_cnt; ++t)
+    {
+        if (!_tri_alive[t])
+            continue;
+        for (int k = 0; k < 3; ++k)
+        {
+            edge_push(_tris[t][k], _tris[t][(k + 1) % 3]);
+            edge_push(_tris[t][(k + 1) % 3], _tris[t][k]);
+        }
+    }
+}
+
+
+/**
+ * 每个顶点的 quadric 是相邻三角形所在平面的面积加权之和
+ * 边界上的边额外加上一个垂直于三角形的约束平面，避免边界向内收缩
+ */
+void Simplifier::quadrics_init()
+{
+    _quadrics.resize(_pos.size());
+
+    std::unordered_map<uint64_t, uint32_t> edge_use;
+    auto edge_key = [](uint32_t a, uint32_t b) -> uint64_t {
+        return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+    };
+
+    for (uint32_t t = 0; t < _tris.size(); ++t)
+    {
+        if (!_tri_alive[t])
+            continue;
+        for (int k = 0; k < 3; ++k)
+            ++edge_use[edge_key(_tris[t][k], _tris[t][(k + 1) % 3])];
+    }
+
+    for (uint32_t t = 0; t < _tris.size(); ++t)
+    {
+        if (!_tri_alive[t])
+            continue;
+
+        glm::dvec3 p0 = _pos[_tris[t][0]], p1 = _pos[_tris[t][1]], p2 = _pos[_tris[t][2]];
+        glm::dvec3 n    = glm::cross(p1 - p0, p2 - p0);
+        double     len  = glm::length(n);
+        if (len <= 0.0)
+            continue;
+        n /= len;
+
+        Quadric q = Quadric::plane(n, -glm::dot(n, p0), len * 0.5);
+        for (uint32_t v: _tris[t])
+            _quadrics[v] += q;
+
+        for (int k = 0; k < 3; ++k)
+        {
+            uint32_t a = _tris[t][k], b = _tris[t][(k + 1) % 3];
+            if (edge_use[edge_key(a, b)] != 1)
+                continue;
+
+            glm::dvec3 pa = _pos[a], pb = _pos[b];
+            glm::dvec3 edge     = pb - pa;
+            glm::dvec3 edge_n   = glm::cross(edge, n);
+            double     edge_len = glm::length(edge_n);
+            if (edge_len <= 0.0)
+                continue;
+            edge_n /= edge_len;
+
+            Quadric bq = Quadric::plane(edge_n, -glm::dot(edge_n, pa), BOUNDARY_WEIGHT * glm::dot(edge, edge));
+            _quadrics[a] += bq;
+            _quadrics[b] += bq;
+        }
+    }
+}
+
+
+void Simplifier::edge_push(uint32_t from, uint32_t to)
+{
+    Quadric q = _quadrics[from];
+    q += _quadrics[to];
+    _heap.push(Collapse{
+            .cost         = q.error(_pos[to]),
+            .from         = from,
+            .to           = to,
+            .from_version = _version[from],
+            .to_version   = _version[to],
+    });
+}
+
+
+/**
+ * 检查 from 合并到 to 之后，周围的三角形是否会翻转
+ */
+bool Simplifier::collapse_valid(uint32_t from, uint32_t to) const
+{
+    bool adjacent = false;
+    for (uint32_t t: _vert_tris[from])
+    {
+        if (!_tri_alive[t])
+            continue;
+
+        const auto &tri = _tris[t];
+        if (tri[0] == to || tri[1] == to || tri[2] == to)
+        {
+            adjacent = true;
+            continue;
+        }
+
+        std::array<glm::vec3, 3> p_old{}, p_new{};
+        for (int k = 0; k < 3; ++k)
+        {
+            p_old[k] = _pos[tri[k]];
+            p_new[k] = tri[k] == from ? _pos[to] : _pos[tri[k]];
+        }
+        glm::vec3 n_old = glm::cross(p_old[1] - p_old[0], p_old[2] - p_old[0]);
+        glm::vec3 n_new = glm::cross(p_new[1] - p_new[0], p_new[2] - p_new[0]);
+        if (glm::dot(n_old, n_new) <= 0.f)
+            return false;
+    }
+
+    /* 两个顶点已经不再相邻，这条边早已不存在 */
+    return adjacent;
+}
+
+
+void Simplifier::collapse(uint32_t from, uint32_t to)
+{
+    /**
+     * 被删除的三角形中，记录 from 的 wedge 对应 to 的哪个 wedge
+     * 保留下来的三角形据此选择同一个 uv 区域的 vertex，避免接缝处的 uv 错乱
+     */
+    std::vector<std::pair<uint32_t, uint32_t>> wedge_map;
+    for (uint32_t t: _vert_tris[from])
+    {
+        if (!_tri_alive[t])
+            continue;
+        const auto &tri = _tris[t];
+        int k_from = -1, k_to = -1;
+        for (int k = 0; k < 3; ++k)
+        {
+            if (tri[k] == from)
+                k_from = k;
+            if (tri[k] == to)
+                k_to = k;
+        }
+        if (k_to < 0)
+            continue;
+
+        wedge_map.emplace_back(_corners[t][k_from], _corners[t][k_to]);
+        _tri_alive[t] = false;
+        --_alive_tri_cnt;
+    }
+
+    for (uint32_t t: _vert_tris[from])
+    {
+        if (!_tri_alive[t])
+            continue;
+        for (int k = 0; k < 3; ++k)
+        {
+            if (_tris[t][k] != from)
+                continue;
+            _tris[t][k] = to;
+
+            uint32_t wedge = _wedge[to];
+            for (auto [w_from, w_to]: wedge_map)
+                if (w_from == _corners[t][k])
+                {
+                    wedge = w_to;
+                    break;
+                }
+            _corners[t][k] = wedge;
+        }
+        _vert_tris[to].push_back(t);
+    }
+
+
+    _quadrics[to] += _quadrics[from];
+    _vert_alive[from] = false;
+    _vert_tris[from].clear();
+    ++_version[to];
+
+
+    /* 移除已经失效的三角形，然后为 to 周围的边重新计算代价 */
+    auto &adj = _vert_tris[to];
+    adj.erase(std::remove_if(adj.begin(), adj.end(), [this](uint32_t t) { return !_tri_alive[t]; }), adj.end());
+    for (uint32_t t: adj)
+        for (uint32_t v: _tris[t])
+        {
+            if (v == to)
+                continue;
+            edge_push(to, v);
+            edge_push(v, to);
+        }
+}
+
+
+Hiss::MeshLod Simplifier::simplify(size_t target)
+{
+    while (_alive_tri_cnt > target && !_heap.empty())
+    {
+        Collapse c = _heap.top();
+        _heap.pop();
+
+        if (!_vert_alive[c.from] || !_vert_alive[c.to])
+            continue;
+        if (c.from_version != _version[c.from] || c.to_version != _version[c.to])
+            continue;
+        if (!collapse_valid(c.from, c.to))
+            continue;
+
+        collapse(c.from, c.to);
+        _max_error = std::max(_max_error, c.cost);
+    }
+
+
+    Hiss::MeshLod lod;
+    lod.error = static_cast<float>(_max_error);
+    lod.indices.reserve(_alive_tri_cnt * 3);
+    for (uint32_t t = 0; t < _tris.size(); ++t)
+        if (_tri_alive[t])
+            lod.indices.insert(lod.indices.end(), _corners[t].begin(), _corners[t].end());
+    return lod;
+}
+
+}    // namespace
+
+
+std::vector<Hiss::MeshLod> Hiss::lod_chain_generate(const glm::vec3 *positions, size_t vertex_cnt,
+                                                    const uint32_t *indices, size_t index_cnt, uint32_t max_levels,
+                                                    float ratio)
+{
+    std::vector<MeshLod> lods;
+
+
+    /* 每个 level 都在上一个 level 的基础上继续简化 */
+    Simplifier simplifier(positions, vertex_cnt, indices, index_cnt);
+    for (uint32_t level = 1; level < max_levels; ++level)
+    {
+        size_t tri_cnt = simplifier.tri_cnt();
+        auto   target  = static_cast<size_t>(static_cast<float>(tri_cnt) * ratio);
+        if (target == 0)
+            break;
+
+        MeshLod lod = simplifier.simplify(target);
+        if (simplifier.tri_cnt() == tri_cnt)    // 无法继续简化了
+            break;
+        lods.push_back(std::move(lod));
+    }
+
+    return lods;
+}
+
+
+uint32_t Hiss::lod_select(const std::vector<float> &errors, float distance, float fov_y, float viewport_height,
+                          float threshold)
+{
+    if (distance <= 0.f)
+        return 0;
+
+    /* 在 distance 处，单位长度投影到屏幕上有多少个像素 */
+    float pixels_per_unit = viewport_height / (2.f * distance * std::tan(fov_y * 0.5f));
+
+    uint32_t lod = 0;
+    for (uint32_t i = 1; i < errors.size(); ++i)
+        if (errors[i] * pixels_per_unit <= threshold)
+            lod = i;
+    return lod;
+}
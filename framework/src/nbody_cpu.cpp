@@ -0,0 +1,435 @@
+#include "../nbody_cpu.hpp"
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HISS_NBODY_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define HISS_NBODY_NEON 1
+#include <arm_neon.h>
+#endif
+
+
+namespace
+{
+
+/**
+ * kernel 的参数；quarters 是 POWER * 4，POWER 是 0.25 的整数倍时 SIMD kernel 可以只用 sqrt 和乘法计算 x^POWER，
+ * 不是整数倍时为 -1，SIMD kernel 退化为标量实现
+ */
+struct View
+{
+    const float *x, *y, *z, *w;
+    float       *ax, *ay, *az;
+    size_t       cnt;    // 补齐之后的长度
+    float        gravity;
+    float        power;
+    float        soften;
+    int          quarters;
+};
+
+
+/**
+ * 所有 kernel 的循环结构相同：i 块 -> j tile -> i 块中的一组质点 -> tile 中的每个 j
+ * 加速度累加在 ax/ay/az 中，跨 tile 时读出再写回，因此调用前需要清零
+ */
+void accel_scalar(const View &v, size_t begin, size_t end)
+{
+    using Hiss::NBodyCpu;
+    for (size_t i0 = begin; i0 < end; i0 += NBodyCpu::I_BLOCK)
+    {
+        size_t i1 = std::min(i0 + NBodyCpu::I_BLOCK, end);
+        for (size_t j0 = 0; j0 < v.cnt; j0 += NBodyCpu::J_TILE)
+        {
+            size_t j1 = std::min(j0 + NBodyCpu::J_TILE, v.cnt);
+            for (size_t i = i0; i < i1; ++i)
+            {
+                float ax = v.ax[i], ay = v.ay[i], az = v.az[i];
+                for (size_t j = j0; j < j1; ++j)
+                {
+                    float dx = v.x[j] - v.x[i];
+                    float dy = v.y[j] - v.y[i];
+                    float dz = v.z[j] - v.z[i];
+                    float s  = v.gravity * v.w[j] / std::pow(dx * dx + dy * dy + dz * dz + v.soften, v.power);
+                    ax += s * dx;
+                    ay += s * dy;
+                    az += s * dz;
+                }
+                v.ax[i] = ax;
+                v.ay[i] = ay;
+                v.az[i] = az;
+            }
+        }
+    }
+}
+
+
+#if HISS_NBODY_X86
+/**
+ * 8 个 i 放在向量的 lane 中，j 广播到所有 lane；x^POWER 由 x 的整数次幂，sqrt(x) 和 sqrt(sqrt(x)) 组合而成
+ * 通过 target attribute 单独为这个函数开启 AVX2，运行时检测 CPU 是否支持
+ */
+__attribute__((target("avx2,fma"))) void accel_avx2(const View &v, size_t begin, size_t end)
+{
+    using Hiss::NBodyCpu;
+    const __m256 gravity = _mm256_set1_ps(v.gravity);
+    const __m256 soften  = _mm256_set1_ps(v.soften);
+
+    for (size_t i0 = begin; i0 < end; i0 += NBodyCpu::I_BLOCK)
+    {
+        size_t i1 = std::min(i0 + NBodyCpu::I_BLOCK, end);
+        for (size_t j0 = 0; j0 < v.cnt; j0 += NBodyCpu::J_TILE)
+        {
+            size_t j1 = std::min(j0 + NBodyCpu::J_TILE, v.cnt);
+            for (size_t i = i0; i < i1; i += 8)
+            {
+                __m256 xi = _mm256_loadu_ps(v.x + i);
+                __m256 yi = _mm256_loadu_ps(v.y + i);
+                __m256 zi = _mm256_loadu_ps(v.z + i);
+                __m256 ax = _mm256_loadu_ps(v.ax + i);
+                __m256 ay = _mm256_loadu_ps(v.ay + i);
+                __m256 az = _mm256_loadu_ps(v.az + i);
+
+                for (size_t j = j0; j < j1; ++j)
+                {
+                    __m256 dx = _mm256_sub_ps(_mm256_set1_ps(v.x[j]), xi);
+                    __m256 dy = _mm256_sub_ps(_mm256_set1_ps(v.y[j]), yi);
+                    __m256 dz = _mm256_sub_ps(_mm256_set1_ps(v.z[j]), zi);
+                    __m256 r2 = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_fmadd_ps(dx, dx, soften)));
+
+                    __m256 p = _mm256_set1_ps(1.f);
+                    for (int k = 0; k < v.quarters / 4; ++k)
+                        p = _mm256_mul_ps(p, r2);
+                    if (v.quarters & 3)
+                    {
+                        __m256 sq = _mm256_sqrt_ps(r2);
+                        if (v.quarters & 2)
+                            p = _mm256_mul_ps(p, sq);
+                        if (v.quarters & 1)
+                            p = _mm256_mul_ps(p, _mm256_sqrt_ps(sq));
+                    }
+
+                    __m256 s = _mm256_div_ps(_mm256_mul_ps(gravity, _mm256_set1_ps(v.w[j])), p);
+                    ax       = _mm256_fmadd_ps(s, dx, ax);
+                    ay       = _mm256_fmadd_ps(s, dy, ay);
+                    az       = _mm256_fmadd_ps(s, dz, az);
+                }
+
+                _mm256_storeu_ps(v.ax + i, ax);
+                _mm256_storeu_ps(v.ay + i, ay);
+                _mm256_storeu_ps(v.az + i, az);
+            }
+        }
+    }
+}
+
+
+/* 和 AVX2 版本相同，每次 16 个 i */
+__attribute__((target("avx512f"))) void accel_avx512(const View &v, size_t begin, size_t end)
+{
+    using Hiss::NBodyCpu;
+    const __m512 gravity = _mm512_set1_ps(v.gravity);
+    const __m512 soften  = _mm512_set1_ps(v.soften);
+
+    for (size_t i0 = begin; i0 < end; i0 += NBodyCpu::I_BLOCK)
+    {
+        size_t i1 = std::min(i0 + NBodyCpu::I_BLOCK, end);
+        for (size_t j0 = 0; j0 < v.cnt; j0 += NBodyCpu::J_TILE)
+        {
+            size_t j1 = std::min(j0 + NBodyCpu::J_TILE, v.cnt);
+            for (size_t i = i0; i < i1; i += 16)
+            {
+                __m512 xi = _mm512_loadu_ps(v.x + i);
+                __m512 yi = _mm512_loadu_ps(v.y + i);
+                __m512 zi = _mm512_loadu_ps(v.z + i);
+                __m512 ax = _mm512_loadu_ps(v.ax + i);
+                __m512 ay = _mm512_loadu_ps(v.ay + i);
+                __m512 az = _mm512_loadu_ps(v.az + i);
+
+                for (size_t j = j0; j < j1; ++j)
+                {
+                    __m512 dx = _mm512_sub_ps(_mm512_set1_ps(v.x[j]), xi);
+                    __m512 dy = _mm512_sub_ps(_mm512_set1_ps(v.y[j]), yi);
+                    __m512 dz = _mm512_sub_ps(_mm512_set1_ps(v.z[j]), zi);
+                    __m512 r2 = _mm512_fmadd_ps(dz, dz, _mm512_fmadd_ps(dy, dy, _mm512_fmadd_ps(dx, dx, soften)));
+
+                    __m512 p = _mm512_set1_ps(1.f);
+                    for (int k = 0; k < v.quarters / 4; ++k)
+                        p = _mm512_mul_ps(p, r2);
+                    if (v.quarters & 3)
+                    {
+                        __m512 sq = _mm512_sqrt_ps(r2);
+                        if (v.quarters & 2)
+                            p = _mm512_mul_ps(p, sq);
+                        if (v.quarters & 1)
+                            p = _mm512_mul_ps(p, _mm512_sqrt_ps(sq));
+                    }
+
+                    __m512 s = _mm512_div_ps(_mm512_mul_ps(gravity, _mm512_set1_ps(v.w[j])), p);
+                    ax       = _mm512_fmadd_ps(s, dx, ax);
+                    ay       = _mm512_fmadd_ps(s, dy, ay);
+                    az       = _mm512_fmadd_ps(s, dz, az);
+                }
+
+                _mm512_storeu_ps(v.ax + i, ax);
+                _mm512_storeu_ps(v.ay + i, ay);
+                _mm512_storeu_ps(v.az + i, az);
+            }
+        }
+    }
+}
+#endif
+
+
+#if HISS_NBODY_NEON
+/* 和 AVX2 版本相同，每次 4 个 i */
+void accel_neon(const View &v, size_t begin, size_t end)
+{
+    using Hiss::NBodyCpu;
+    const float32x4_t gravity = vdupq_n_f32(v.gravity);
+    const float32x4_t soften  = vdupq_n_f32(v.soften);
+
+    for (size_t i0 = begin; i0 < end; i0 += NBodyCpu::I_BLOCK)
+    {
+        size_t i1 = std::min(i0 + NBodyCpu::I_BLOCK, end);
+        for (size_t j0 = 0; j0 < v.cnt; j0 += NBodyCpu::J_TILE)
+        {
+            size_t j1 = std::min(j0 + NBodyCpu::J_TILE, v.cnt);
+            for (size_t i = i0; i < i1; i += 4)
+            {
+                float32x4_t xi = vld1q_f32(v.x + i);
+                float32x4_t yi = vld1q_f32(v.y + i);
+                float32x4_t zi = vld1q_f32(v.z + i);
+                float32x4_t ax = vld1q_f32(v.ax + i);
+                float32x4_t ay = vld1q_f32(v.ay + i);
+                float32x4_t az = vld1q_f32(v.az + i);
+
+                for (size_t j = j0; j < j1; ++j)
+                {
+                    float32x4_t dx = vsubq_f32(vdupq_n_f32(v.x[j]), xi);
+                    float32x4_t dy = vsubq_f32(vdupq_n_f32(v.y[j]), yi);
+                    float32x4_t dz = vsubq_f32(vdupq_n_f32(v.z[j]), zi);
+                    float32x4_t r2 = vfmaq_f32(vfmaq_f32(vfmaq_f32(soften, dx, dx), dy, dy), dz, dz);
+
+                    float32x4_t p = vdupq_n_f32(1.f);
+                    for (int k = 0; k < v.quarters / 4; ++k)
+                        p = vmulq_f32(p, r2);
+                    if (v.quarters & 3)
+                    {
+                        float32x4_t sq = vsqrtq_f32(r2);
+                        if (v.quarters & 2)
+                            p = vmulq_f32(p, sq);
+                        if (v.quarters & 1)
+                            p = vmulq_f32(p, vsqrtq_f32(sq));
+                    }
+
+                    float32x4_t s = vdivq_f32(vmulq_n_f32(gravity, v.w[j]), p);
+                    ax            = vfmaq_f32(ax, s, dx);
+                    ay            = vfmaq_f32(ay, s, dy);
+                    az            = vfmaq_f32(az, s, dz);
+                }
+
+                vst1q_f32(v.ax + i, ax);
+                vst1q_f32(v.ay + i, ay);
+                vst1q_f32(v.az + i, az);
+            }
+        }
+    }
+}
+#endif
+
+}    // namespace
+
+
+Hiss::NBodyCpu::NBodyCpu()
+    : _physics()
+{}
+
+
+Hiss::NBodyCpu::NBodyCpu(const Physics &physics)
+    : _physics(physics)
+{}
+
+
+void Hiss::NBodyCpu::load(const std::vector<Particle> &particles)
+{
+    load(particles.data(), particles.size());
+}
+
+
+void Hiss::NBodyCpu::load(const Particle *particles, size_t cnt)
+{
+    _cnt          = cnt;
+    size_t padded = (cnt + LANE_ALIGN - 1) / LANE_ALIGN * LANE_ALIGN;
+    for (auto *array: {&_x, &_y, &_z, &_w, &_vx, &_vy, &_vz, &_uv, &_ax, &_ay, &_az})
+        array->assign(padded, 0.f);
+
+    for (size_t i = 0; i < cnt; ++i)
+    {
+        _x[i]  = particles[i].pos.x;
+        _y[i]  = particles[i].pos.y;
+        _z[i]  = particles[i].pos.z;
+        _w[i]  = particles[i].pos.w;
+        _vx[i] = particles[i].vel.x;
+        _vy[i] = particles[i].vel.y;
+        _vz[i] = particles[i].vel.z;
+        _uv[i] = particles[i].vel.w;
+    }
+}
+
+
+void Hiss::NBodyCpu::store(std::vector<Particle> &particles) const
+{
+    particles.resize(_cnt);
+    for (size_t i = 0; i < _cnt; ++i)
+        particles[i] = {
+                .pos = glm::vec4(_x[i], _y[i], _z[i], _w[i]),
+                .vel = glm::vec4(_vx[i], _vy[i], _vz[i], _uv[i]),
+        };
+}
+
+
+void Hiss::NBodyCpu::accel_range(Kernel kernel, size_t begin, size_t end)
+{
+    float quarters = _physics.power * 4.f;
+    View  view     = {
+                 .x        = _x.data(),
+                 .y        = _y.data(),
+                 .z        = _z.data(),
+                 .w        = _w.data(),
+                 .ax       = _ax.data(),
+                 .ay       = _ay.data(),
+                 .az       = _az.data(),
+                 .cnt      = _x.size(),
+                 .gravity  = _physics.gravity,
+                 .power    = _physics.power,
+                 .soften   = _physics.soften,
+                 .quarters = quarters >= 0.f && quarters == std::floor(quarters) ? static_cast<int>(quarters) : -1,
+    };
+    if (view.quarters < 0)
+        kernel = Kernel::SCALAR;
+
+    switch (kernel)
+    {
+#if HISS_NBODY_X86
+        case Kernel::AVX2: accel_avx2(view, begin, end); break;
+        case Kernel::AVX512: accel_avx512(view, begin, end); break;
+#elif HISS_NBODY_NEON
+        case Kernel::NEON: accel_neon(view, begin, end); break;
+#endif
+        default: accel_scalar(view, begin, end); break;
+    }
+}
+
+
+/**
+ * 按照 I_BLOCK 划分给各个线程；补齐的质点也参与计算，结果被丢弃
+ */
+void Hiss::NBodyCpu::accel_compute(Kernel kernel, ThreadPool *thread_pool)
+{
+    if (!kernel_support(kernel))
+        throw std::runtime_error(std::string("nbody cpu: kernel is not supported: ") + kernel_name(kernel));
+
+    std::fill(_ax.begin(), _ax.end(), 0.f);
+    std::fill(_ay.begin(), _ay.end(), 0.f);
+    std::fill(_az.begin(), _az.end(), 0.f);
+
+    size_t padded    = _x.size();
+    size_t block_cnt = (padded + I_BLOCK - 1) / I_BLOCK;
+    if (!thread_pool)
+    {
+        accel_range(kernel, 0, padded);
+        return;
+    }
+    thread_pool->parallel_for(block_cnt, [&](size_t begin, size_t end) {
+        accel_range(kernel, begin * I_BLOCK, std::min(end * I_BLOCK, padded));
+    });
+}
+
+
+void Hiss::NBodyCpu::integrate(float delta_time)
+{
+    for (size_t i = 0; i < _cnt; ++i)
+    {
+        _vx[i] += delta_time * _ax[i];
+        _vy[i] += delta_time * _ay[i];
+        _vz[i] += delta_time * _az[i];
+        _x[i] += delta_time * _vx[i];
+        _y[i] += delta_time * _vy[i];
+        _z[i] += delta_time * _vz[i];
+    }
+}
+
+
+void Hiss::NBodyCpu::step(float delta_time, Kernel kernel, ThreadPool *thread_pool)
+{
+    accel_compute(kernel, thread_pool);
+    integrate(delta_time);
+}
+
+
+Hiss::NBodyCpu::Kernel Hiss::NBodyCpu::kernel_best()
+{
+    for (Kernel kernel: {Kernel::AVX512, Kernel::AVX2, Kernel::NEON})
+        if (kernel_support(kernel))
+            return kernel;
+    return Kernel::SCALAR;
+}
+
+
+bool Hiss::NBodyCpu::kernel_support(Kernel kernel)
+{
+    switch (kernel)
+    {
+        case Kernel::SCALAR: return true;
+#if HISS_NBODY_X86
+        case Kernel::AVX2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case Kernel::AVX512: return __builtin_cpu_supports("avx512f");
+#elif HISS_NBODY_NEON
+        case Kernel::NEON: return true;
+#endif
+        default: return false;
+    }
+}
+
+
+const char *Hiss::NBodyCpu::kernel_name(Kernel kernel)
+{
+    switch (kernel)
+    {
+        case Kernel::SCALAR: return "scalar";
+        case Kernel::AVX2: return "avx2";
+        case Kernel::AVX512: return "avx512";
+        case Kernel::NEON: return "neon";
+    }
+    return "unknown";
+}
+
+
+Hiss::NBodyCpu::Error Hiss::NBodyCpu::compare(const std::vector<glm::vec3> &reference,
+                                              const std::vector<glm::vec3> &value)
+{
+    if (reference.size() != value.size())
+        throw std::runtime_error("nbody cpu: compare size mismatch.");
+
+    Error  error;
+    double diff2 = 0., ref2 = 0.;
+    for (size_t i = 0; i < reference.size(); ++i)
+    {
+        glm::dvec3 r = reference[i];
+        glm::dvec3 d = glm::dvec3(value[i]) - r;
+        double     e = glm::dot(r, r) > 0. ? std::sqrt(glm::dot(d, d) / glm::dot(r, r)) : 0.;
+        diff2 += glm::dot(d, d);
+        ref2 += glm::dot(r, r);
+        if (e > error.max)
+        {
+            error.max     = e;
+            error.max_idx = static_cast<uint32_t>(i);
+        }
+    }
+    error.rms = ref2 > 0. ? std::sqrt(diff2 / ref2) : 0.;
+    return error;
+}
@@ -0,0 +1,518 @@
+#include "../obj_loader.hpp"
+#include <bit>
+#include <charconv>
+#include <future>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+namespace
+{
+
+inline bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+inline bool is_digit(char c) { return static_cast<unsigned char>(c - '0') < 10; }
+
+
+inline const char *space_skip(const char *p, const char *end)
+{
+    while (p < end && is_space(*p))
+        ++p;
+    return p;
+}
+
+
+/* SWAR：判断 8 个字符是否都是数字 */
+inline bool eight_digits_is(uint64_t val)
+{
+    return !(((val + 0x4646464646464646) | (val - 0x3030303030303030)) & 0x8080808080808080);
+}
+
+
+/* SWAR：一次解析 8 个数字字符，要求 little endian */
+inline uint32_t eight_digits_parse(uint64_t val)
+{
+    const uint64_t mask = 0x000000FF000000FF;
+    const uint64_t mul1 = 0x000F424000000064;    // 100 + (1000000 << 32)
+    const uint64_t mul2 = 0x0000271000000001;    // 1 + (10000 << 32)
+    val -= 0x3030303030303030;
+    val = (val * 10) + (val >> 8);
+    val = (((val & mask) * mul1) + (((val >> 16) & mask) * mul2)) >> 32;
+    return static_cast<uint32_t>(val);
+}
+
+
+/**
+ * 解析一个浮点数，返回解析结束的位置；结果和 std::from_chars 一样是正确舍入的
+ * 先将所有数字累积到 64 位整数的 mantissa 中，小数部分每次处理 8 个字符
+ * mantissa 不超过 2^24 并且 |exp10| <= 10 时，mantissa 和 10^|exp10| 都可以用 float 精确表示，
+ * 一次 float 乘除法只舍入一次（Clinger 的 fast path）；其他情况交给 std::from_chars
+ * 没有数字时结果为 0
+ */
+const char *float_parse(const char *p, const char *end, float &out)
+{
+    static constexpr float POW10[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+    p        = space_skip(p, end);
+    bool neg = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        neg = *p++ == '-';
+    const char *start = p;
+
+    /* mantissa 最多保存 19 位有效数字，不会溢出 */
+    uint64_t mantissa = 0;
+    int32_t  exp10    = 0;
+    int32_t  digits   = 0;
+    for (; p < end && is_digit(*p); ++p)
+    {
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += mantissa != 0;
+        }
+        else
+            ++exp10;
+    }
+
+    if (p < end && *p == '.')
+    {
+        ++p;
+        while (digits + 8 <= 19 && end - p >= 8)
+        {
+            uint64_t val;
+            std::memcpy(&val, p, sizeof(val));
+            if (!eight_digits_is(val))
+                break;
+            mantissa = mantissa * 100000000 + eight_digits_parse(val);
+            digits += 8;
+            exp10 -= 8;
+            p += 8;
+        }
+        for (; p < end && is_digit(*p); ++p)
+        {
+            if (digits >= 19)
+                continue;
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += mantissa != 0;
+            --exp10;
+        }
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        ++p;
+        bool exp_neg = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            exp_neg = *p++ == '-';
+        int32_t e = 0;
+        for (; p < end && is_digit(*p); ++p)
+            if (e < 10000)
+                e = e * 10 + (*p - '0');
+        exp10 += exp_neg ? -e : e;
+    }
+
+    float value = 0.f;
+    if (mantissa != 0 && mantissa <= (uint64_t(1) << 24) && exp10 >= -10 && exp10 <= 10)
+        value = exp10 < 0 ? static_cast<float>(mantissa) / POW10[-exp10] : static_cast<float>(mantissa) * POW10[exp10];
+    else if (mantissa != 0)
+    {
+        /* 截断了有效数字，或者超出了 fast path 的范围；上溢为 inf，下溢为 0 */
+        auto res = std::from_chars(start, p, value, std::chars_format::general);
+        if (res.ec == std::errc::result_out_of_range)
+            value = exp10 > 0 ? std::numeric_limits<float>::infinity() : 0.f;
+    }
+    out = neg ? -value : value;
+    return p;
+}
+
+
+const char *int_parse(const char *p, const char *end, int64_t &out)
+{
+    bool neg = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        neg = *p++ == '-';
+    int64_t value = 0;
+    for (; p < end && is_digit(*p); ++p)
+        value = value * 10 + (*p - '0');
+    out = neg ? -value : value;
+    return p;
+}
+
+
+/* 关键字之后的名称，去掉首尾的空白 */
+std::string name_get(const char *p, const char *end)
+{
+    p = space_skip(p, end);
+    while (end > p && is_space(end[-1]))
+        --end;
+    return {p, end};
+}
+
+}    // namespace
+
+
+Hiss::ObjLoader::ObjLoader(const std::string &path, uint32_t thread_cnt)
+    : _thread_cnt(std::max<uint32_t>(thread_cnt, 1))
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("failed to open obj file: " + path);
+
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("failed to stat obj file: " + path);
+    }
+    _size = static_cast<size_t>(file_stat.st_size);
+
+    if (_size > 0)
+    {
+        void *data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            close(fd);
+            throw std::runtime_error("failed to mmap obj file: " + path);
+        }
+        madvise(data, _size, MADV_WILLNEED);
+        _data = static_cast<const char *>(data);
+    }
+    close(fd);    // mmap 之后就可以关闭文件了
+}
+
+
+Hiss::ObjLoader::~ObjLoader()
+{
+    if (_data)
+        munmap(const_cast<char *>(_data), _size);
+}
+
+
+void Hiss::ObjLoader::chunk_parse(Chunk &chunk)
+{
+    /* 一个面的所有顶点，relative 表示 index 是相对于 chunk 起点的 */
+    struct FaceVertex
+    {
+        int64_t v, vt;
+        bool    v_relative, vt_relative;
+    };
+    std::vector<FaceVertex> face;
+
+
+    const char *p = chunk.begin;
+    while (p < chunk.end)
+    {
+        auto line_end = static_cast<const char *>(std::memchr(p, '\n', chunk.end - p));
+        if (!line_end)
+            line_end = chunk.end;
+        p = space_skip(p, line_end);
+        if (p == line_end)
+        {
+            p = line_end + 1;
+            continue;
+        }
+
+        switch (*p)
+        {
+            case 'v':
+                if (p + 1 < line_end && is_space(p[1]))
+                {
+                    glm::vec3 pos;
+                    p = float_parse(p + 1, line_end, pos.x);
+                    p = float_parse(p, line_end, pos.y);
+                    float_parse(p, line_end, pos.z);
+                    chunk.positions.push_back(pos);
+                }
+                else if (p + 2 <= line_end && p[1] == 't' && (p + 2 == line_end || is_space(p[2])))
+                {
+                    glm::vec2 uv;
+                    p = float_parse(p + 2, line_end, uv.x);
+                    float_parse(p, line_end, uv.y);
+                    chunk.tex_coords.push_back(uv);
+                }
+                /* vn 以及其他以 v 开头的数据不需要 */
+                break;
+
+            case 'f':
+            {
+                if (p + 1 >= line_end || !is_space(p[1]))
+                    break;
+
+                /* 格式可能是：v，v/vt，v//vn，v/vt/vn；行尾可能有 # 开始的注释 */
+                face.clear();
+                p = space_skip(p + 1, line_end);
+                while (p < line_end && *p != '#')
+                {
+                    FaceVertex fv{.v = 0, .vt = 0, .v_relative = false, .vt_relative = false};
+                    p = int_parse(p, line_end, fv.v);
+                    if (p < line_end && *p == '/')
+                    {
+                        ++p;
+                        if (p < line_end && *p != '/')
+                            p = int_parse(p, line_end, fv.vt);
+                        if (p < line_end && *p == '/')
+                        {
+                            int64_t vn;
+                            p = int_parse(p + 1, line_end, vn);
+                        }
+                    }
+                    if (fv.v == 0)
+                        throw std::runtime_error("obj: invalid face.");
+
+                    /* 正数是从 1 开始的全局 index，负数是相对于当前位置的 index */
+                    if (fv.v > 0)
+                        fv.v -= 1;
+                    else
+                    {
+                        fv.v          = static_cast<int64_t>(chunk.positions.size()) + fv.v;
+                        fv.v_relative = true;
+                    }
+                    if (fv.vt > 0)
+                        fv.vt -= 1;
+                    else if (fv.vt < 0)
+                    {
+                        fv.vt          = static_cast<int64_t>(chunk.tex_coords.size()) + fv.vt;
+                        fv.vt_relative = true;
+                    }
+                    else
+                        fv.vt = NO_INDEX;
+
+                    face.push_back(fv);
+                    p = space_skip(p, line_end);
+                }
+
+
+                /* 将多边形以扇形的方式三角化 */
+                for (size_t i = 2; i < face.size(); ++i)
+                {
+                    for (const FaceVertex &fv: {face[0], face[i - 1], face[i]})
+                    {
+                        if (fv.v_relative)
+                            chunk.fixups.push_back({.corner = chunk.corners.size(), .local = fv.v, .tex = false});
+                        if (fv.vt_relative)
+                            chunk.fixups.push_back({.corner = chunk.corners.size(), .local = fv.vt, .tex = true});
+                        chunk.corners.push_back(Corner{
+                                .v  = fv.v_relative ? 0 : static_cast<uint32_t>(fv.v),
+                                .vt = fv.vt_relative ? 0 : static_cast<uint32_t>(fv.vt),
+                        });
+                    }
+                }
+                break;
+            }
+
+            case 'o':
+            case 'g':
+                if (p + 1 == line_end || is_space(p[1]))
+                    chunk.events.push_back({.corner   = chunk.corners.size(),
+                                            .material = false,
+                                            .name     = name_get(p + 1, line_end)});
+                break;
+
+            case 'u':
+                if (line_end - p > 6 && std::memcmp(p, "usemtl", 6) == 0 && is_space(p[6]))
+                    chunk.events.push_back({.corner   = chunk.corners.size(),
+                                            .material = true,
+                                            .name     = name_get(p + 6, line_end)});
+                break;
+
+            default: break;    // 注释，mtllib，s 等都忽略
+        }
+
+        p = line_end + 1;
+    }
+}
+
+
+void Hiss::ObjLoader::parse()
+{
+    if (_size == 0)
+        return;
+
+    /* 在行边界处将文件切分为多个 chunk */
+    _chunks.resize(_thread_cnt);
+    const char *cursor = _data;
+    const char *end    = _data + _size;
+    for (uint32_t i = 0; i < _thread_cnt; ++i)
+    {
+        const char *chunk_end = end;
+        if (i + 1 < _thread_cnt)
+        {
+            const char *target = std::max(cursor, _data + _size * (i + 1) / _thread_cnt);
+            auto        nl     = static_cast<const char *>(std::memchr(target, '\n', end - target));
+            chunk_end          = nl ? nl + 1 : end;
+        }
+        _chunks[i].begin = cursor;
+        _chunks[i].end   = chunk_end;
+        cursor           = chunk_end;
+    }
+
+    std::vector<std::future<void>> tasks;
+    for (auto &chunk: _chunks)
+        tasks.push_back(std::async(std::launch::async, [&chunk]() { chunk_parse(chunk); }));
+    for (auto &task: tasks)
+        task.get();    // 会重新抛出线程中的异常
+    tasks.clear();
+
+
+    /* 前缀和：每个 chunk 的数据在全局数组中的起点 */
+    size_t position_cnt = 0, tex_coord_cnt = 0;
+    _index_cnt          = 0;
+    for (auto &chunk: _chunks)
+    {
+        chunk.position_base  = position_cnt;
+        chunk.tex_coord_base = tex_coord_cnt;
+        position_cnt += chunk.positions.size();
+        tex_coord_cnt += chunk.tex_coords.size();
+        _index_cnt += chunk.corners.size();
+    }
+
+
+    /* 合并各个 chunk 的数据，并修正相对的 index */
+    _positions.resize(position_cnt);
+    _tex_coords.resize(tex_coord_cnt);
+    for (auto &chunk: _chunks)
+    {
+        tasks.push_back(std::async(std::launch::async, [this, &chunk]() {
+            std::copy(chunk.positions.begin(), chunk.positions.end(), _positions.begin() + chunk.position_base);
+            std::copy(chunk.tex_coords.begin(), chunk.tex_coords.end(), _tex_coords.begin() + chunk.tex_coord_base);
+            for (const Fixup &fixup: chunk.fixups)
+            {
+                size_t  base = fixup.tex ? chunk.tex_coord_base : chunk.position_base;
+                int64_t idx  = fixup.local + static_cast<int64_t>(base);
+                if (idx < 0)
+                    throw std::runtime_error("obj: relative index out of range.");
+                (fixup.tex ? chunk.corners[fixup.corner].vt : chunk.corners[fixup.corner].v) =
+                        static_cast<uint32_t>(idx);
+            }
+            chunk.positions  = {};
+            chunk.tex_coords = {};
+            chunk.fixups     = {};
+        }));
+    }
+    for (auto &task: tasks)
+        task.get();
+
+
+    groups_build();
+}
+
+
+void Hiss::ObjLoader::groups_build()
+{
+    std::string name, material;
+    size_t      start = 0;
+    size_t      base  = 0;
+
+    auto group_close = [&](size_t at) {
+        if (at > start)
+            _groups.push_back(
+                    Group{.name = name, .material = material, .index_offset = start, .index_cnt = at - start});
+        start = at;
+    };
+
+    for (const auto &chunk: _chunks)
+    {
+        for (const auto &event: chunk.events)
+        {
+            group_close(base + event.corner);
+            (event.material ? material : name) = event.name;
+        }
+        base += chunk.corners.size();
+    }
+    group_close(_index_cnt);
+}
+
+
+size_t Hiss::ObjLoader::indices_write(uint32_t *dst)
+{
+    /* 开放寻址的 hash 表，key 是 (v << 32 | vt)，value 是焊接后的 vertex index */
+    constexpr uint64_t EMPTY = std::numeric_limits<uint64_t>::max();
+    size_t             capacity = std::bit_ceil(std::max<size_t>(_positions.size() * 2, 1024));
+    std::vector<uint64_t> keys(capacity, EMPTY);
+    std::vector<uint32_t> values(capacity);
+
+    auto slot_find = [&](uint64_t key) -> size_t {
+        size_t slot = (key * 0x9E3779B97F4A7C15) >> 32 & (capacity - 1);
+        while (keys[slot] != EMPTY && keys[slot] != key)
+            slot = (slot + 1) & (capacity - 1);
+        return slot;
+    };
+
+    auto table_grow = [&]() {
+        capacity *= 2;
+        keys.assign(capacity, EMPTY);
+        values.resize(capacity);
+        for (uint32_t i = 0; i < _weld_keys.size(); ++i)
+        {
+            size_t slot  = slot_find(_weld_keys[i]);
+            keys[slot]   = _weld_keys[i];
+            values[slot] = i;
+        }
+    };
+
+
+    _weld_keys.clear();
+    _weld_keys.reserve(_positions.size());
+    size_t out = 0;
+    for (const auto &chunk: _chunks)
+    {
+        for (const Corner &corner: chunk.corners)
+        {
+            if (corner.v >= _positions.size() || (corner.vt != NO_INDEX && corner.vt >= _tex_coords.size()))
+                throw std::runtime_error("obj: index out of range.");
+
+            if (_weld_keys.size() * 2 >= capacity)
+                table_grow();
+
+            uint64_t key  = static_cast<uint64_t>(corner.v) << 32 | corner.vt;
+            size_t   slot = slot_find(key);
+            if (keys[slot] == EMPTY)
+            {
+                keys[slot]   = key;
+                values[slot] = static_cast<uint32_t>(_weld_keys.size());
+                _weld_keys.push_back(key);
+            }
+            dst[out++] = values[slot];
+        }
+    }
+
+    return _weld_keys.size();
+}
+
+
+void Hiss::ObjLoader::vertices_write(Vertex *dst) const
+{
+    size_t                         vertex_cnt = _weld_keys.size();
+    std::vector<std::future<void>> tasks;
+    for (uint32_t i = 0; i < _thread_cnt; ++i)
+    {
+        size_t begin = vertex_cnt * i / _thread_cnt;
+        size_t end   = vertex_cnt * (i + 1) / _thread_cnt;
+        tasks.push_back(std::async(std::launch::async, [this, dst, begin, end]() {
+            for (size_t k = begin; k < end; ++k)
+            {
+                auto      v  = static_cast<uint32_t>(_weld_keys[k] >> 32);
+                auto      vt = static_cast<uint32_t>(_weld_keys[k]);
+                glm::vec2 uv = vt == NO_INDEX ? glm::vec2(0.f) : _tex_coords[vt];
+
+                /* .obj 文件将 picture 左下角视为 uv 的起点，vulkan 将 data[0] 视为左上角，因此 v 需要翻转 */
+                dst[k] = Vertex{
+                        .pos       = _positions[v],
+                        .color     = {1.f, 1.f, 1.f},
+                        .tex_coord = {uv.x, 1.f - uv.y},
+                };
+            }
+        }));
+    }
+    for (auto &task: tasks)
+        task.get();
+}
+
+
+void Hiss::ObjLoader::positions_write(glm::vec3 *dst) const
+{
+    for (size_t k = 0; k < _weld_keys.size(); ++k)
+        dst[k] = _positions[static_cast<uint32_t>(_weld_keys[k] >> 32)];
+}
@@ -0,0 +1,294 @@
+#include "../pipeline.hpp"
+#include "global.hpp"
+#include "hasher.hpp"
+
+
+vk::PipelineColorBlendAttachmentState Hiss::PipelineDesc::color_blend_opaque()
+{
+    return {
+            .blendEnable = VK_FALSE,
+
+            .srcColorBlendFactor = vk::BlendFactor::eOne,
+            .dstColorBlendFactor = vk::BlendFactor::eZero,
+            .colorBlendOp        = vk::BlendOp::eAdd,
+
+            .srcAlphaBlendFactor = vk::BlendFactor::eOne,
+            .dstAlphaBlendFactor = vk::BlendFactor::eZero,
+            .alphaBlendOp        = vk::BlendOp::eAdd,
+
+            .colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG
+                            | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA,
+    };
+}
+
+
+vk::PipelineColorBlendAttachmentState Hiss::PipelineDesc::color_blend_additive()
+{
+    vk::PipelineColorBlendAttachmentState blend = color_blend_opaque();
+    blend.blendEnable                           = VK_TRUE;
+    blend.dstColorBlendFactor                   = vk::BlendFactor::eOne;
+    blend.dstAlphaBlendFactor                   = vk::BlendFactor::eOne;
+    return blend;
+}
+
+
+vk::PipelineColorBlendAttachmentState Hiss::PipelineDesc::color_blend_premultiplied()
+{
+    vk::PipelineColorBlendAttachmentState blend = color_blend_opaque();
+    blend.blendEnable                           = VK_TRUE;
+    blend.dstColorBlendFactor                   = vk::BlendFactor::eOneMinusSrcAlpha;
+    blend.dstAlphaBlendFactor                   = vk::BlendFactor::eOneMinusSrcAlpha;
+    return blend;
+}
+
+
+Hiss::PipelineDesc Hiss::PipelineDesc::compute(const ShaderDesc &shader, vk::PipelineLayout layout)
+{
+    return PipelineDesc{.shaders = {shader}, .layout = layout};
+}
+
+
+size_t Hiss::PipelineDesc::hash() const
+{
+    Hasher h;
+
+    /* 每个 vector 都先加入长度，避免不同的划分得到相同的字节序列 */
+    h.add(shaders.size());
+    for (const auto &shader: shaders)
+    {
+        h.add(shader.stage).add(shader.path).add(shader.entry);
+        h.add(shader.spec_entries.size());
+        for (const auto &entry: shader.spec_entries)
+            h.add(entry.constantID).add(entry.offset).add(entry.size);
+        h.add(shader.spec_data.size());
+        for (uint8_t b: shader.spec_data)
+            h.add(b);
+    }
+
+    h.add(vertex_bindings.size());
+    for (const auto &binding: vertex_bindings)
+        h.add(binding.binding).add(binding.stride).add(binding.inputRate);
+    h.add(vertex_attrs.size());
+    for (const auto &attr: vertex_attrs)
+        h.add(attr.location).add(attr.binding).add(attr.format).add(attr.offset);
+    h.add(topology).add(primitive_restart);
+
+    h.add(depth_clamp).add(rasterizer_discard).add(polygon_mode).add(cull_mode).add(front_face);
+    h.add(depth_bias).add(depth_bias_constant).add(depth_bias_clamp).add(depth_bias_slope).add(line_width);
+
+    h.add(samples).add(sample_shading).add(min_sample_shading).add(alpha_to_coverage);
+
+    h.add(depth_test).add(depth_write).add(depth_compare).add(stencil_test).add(stencil_front).add(stencil_back);
+
+    h.add(color_blends.size());
+    for (const auto &blend: color_blends)
+    {
+        h.add(blend.blendEnable).add(blend.srcColorBlendFactor).add(blend.dstColorBlendFactor).add(blend.colorBlendOp);
+        h.add(blend.srcAlphaBlendFactor).add(blend.dstAlphaBlendFactor).add(blend.alphaBlendOp);
+        h.add(blend.colorWriteMask);
+    }
+    for (float c: blend_constants)
+        h.add(c);
+
+    h.add(dynamic_states.size());
+    for (auto state: dynamic_states)
+        h.add(state);
+
+    h.add(layout).add(render_pass).add(subpass);
+    return h.value();
+}
+
+
+Hiss::PipelineRegistry::PipelineRegistry(vk::Device device, std::shared_ptr<ShaderLibrary> shader_library)
+    : _device(device),
+      _shader_library(std::move(shader_library))
+{
+    /* 同一个 registry 中的 pipeline 共享 pipeline cache，不同的 desc 之间也可以复用编译结果 */
+    _cache = _device.createPipelineCache(vk::PipelineCacheCreateInfo{});
+}
+
+
+Hiss::PipelineRegistry::~PipelineRegistry()
+{
+    clear();
+    _device.destroyPipelineCache(_cache);
+}
+
+
+vk::Pipeline Hiss::PipelineRegistry::get(const PipelineDesc &desc)
+{
+    /* 编译也在锁内进行，保证同一个 desc 只会被编译一次 */
+    std::lock_guard lock(_mutex);
+
+    if (auto iter = _pipelines.find(desc); iter != _pipelines.end())
+    {
+        ++_stat.hit;
+        return iter->second.pipeline;
+    }
+
+    ++_stat.miss;
+    LogStatic::logger()->info("[pipeline] create pipeline, hash: {:016x}, total: {}", desc.hash(),
+                              _pipelines.size() + 1);
+    Entry entry;
+    entry.pipeline = desc.is_compute() ? compute_pipeline_create(desc, entry) : graphics_pipeline_create(desc, entry);
+    return _pipelines.emplace(desc, std::move(entry)).first->second.pipeline;
+}
+
+
+void Hiss::PipelineRegistry::clear()
+{
+    std::lock_guard lock(_mutex);
+    for (auto &[desc, entry]: _pipelines)
+        _device.destroyPipeline(entry.pipeline);
+    _pipelines.clear();    // 同时释放 shader module 的引用
+}
+
+
+size_t Hiss::PipelineRegistry::size() const
+{
+    std::lock_guard lock(_mutex);
+    return _pipelines.size();
+}
+
+
+Hiss::PipelineRegistry::Stat Hiss::PipelineRegistry::stat() const
+{
+    std::lock_guard lock(_mutex);
+    return _stat;
+}
+
+
+std::vector<vk::PipelineShaderStageCreateInfo>
+Hiss::PipelineRegistry::stages_create(const PipelineDesc &desc, Entry &entry,
+                                      std::vector<vk::SpecializationInfo> &spec_infos)
+{
+    /* stage info 中保存的是 spec info 的指针，因此需要提前分配好空间 */
+    spec_infos.resize(desc.shaders.size());
+
+    std::vector<vk::PipelineShaderStageCreateInfo> stages;
+    for (size_t i = 0; i < desc.shaders.size(); ++i)
+    {
+        const auto &shader = desc.shaders[i];
+        entry.shaders.push_back(_shader_library->acquire(shader.path));
+
+        spec_infos[i] = vk::SpecializationInfo{
+                .mapEntryCount = static_cast<uint32_t>(shader.spec_entries.size()),
+                .pMapEntries   = shader.spec_entries.data(),
+                .dataSize      = shader.spec_data.size(),
+                .pData         = shader.spec_data.data(),
+        };
+        stages.push_back(vk::PipelineShaderStageCreateInfo{
+                .stage               = shader.stage,
+                .module              = entry.shaders.back()->module,
+                .pName               = shader.entry.c_str(),
+                .pSpecializationInfo = shader.spec_entries.empty() ? nullptr : &spec_infos[i],
+        });
+    }
+    return stages;
+}
+
+
+vk::Pipeline Hiss::PipelineRegistry::graphics_pipeline_create(const PipelineDesc &desc, Entry &entry)
+{
+    std::vector<vk::SpecializationInfo> spec_infos;
+    auto                                stages = stages_create(desc, entry, spec_infos);
+
+
+    vk::PipelineVertexInputStateCreateInfo vertex_input = {
+            .vertexBindingDescriptionCount   = static_cast<uint32_t>(desc.vertex_bindings.size()),
+            .pVertexBindingDescriptions      = desc.vertex_bindings.data(),
+            .vertexAttributeDescriptionCount = static_cast<uint32_t>(desc.vertex_attrs.size()),
+            .pVertexAttributeDescriptions    = desc.vertex_attrs.data(),
+    };
+    vk::PipelineInputAssemblyStateCreateInfo assembly = {
+            .topology               = desc.topology,
+            .primitiveRestartEnable = desc.primitive_restart,
+    };
+
+
+    /* viewport 和 scissor 通常是 dynamic 的，这里只需要给出数量 */
+    vk::PipelineViewportStateCreateInfo viewport_state = {
+            .viewportCount = 1,
+            .scissorCount  = 1,
+    };
+
+
+    vk::PipelineRasterizationStateCreateInfo rasterization = {
+            .depthClampEnable        = desc.depth_clamp,
+            .rasterizerDiscardEnable = desc.rasterizer_discard,
+            .polygonMode             = desc.polygon_mode,
+            .cullMode                = desc.cull_mode,
+            .frontFace               = desc.front_face,
+            .depthBiasEnable         = desc.depth_bias,
+            .depthBiasConstantFactor = desc.depth_bias_constant,
+            .depthBiasClamp          = desc.depth_bias_clamp,
+            .depthBiasSlopeFactor    = desc.depth_bias_slope,
+            .lineWidth               = desc.line_width,
+    };
+    vk::PipelineMultisampleStateCreateInfo multisample = {
+            .rasterizationSamples  = desc.samples,
+            .sampleShadingEnable   = desc.sample_shading,
+            .minSampleShading      = desc.min_sample_shading,
+            .pSampleMask           = nullptr,
+            .alphaToCoverageEnable = desc.alpha_to_coverage,
+            .alphaToOneEnable      = VK_FALSE,
+    };
+    vk::PipelineDepthStencilStateCreateInfo depth_stencil = {
+            .depthTestEnable       = desc.depth_test,
+            .depthWriteEnable      = desc.depth_write,
+            .depthCompareOp        = desc.depth_compare,
+            .depthBoundsTestEnable = VK_FALSE,
+            .stencilTestEnable     = desc.stencil_test,
+            .front                 = desc.stencil_front,
+            .back                  = desc.stencil_back,
+    };
+    vk::PipelineColorBlendStateCreateInfo color_blend = {
+            .logicOpEnable   = VK_FALSE,
+            .logicOp         = vk::LogicOp::eCopy,
+            .attachmentCount = static_cast<uint32_t>(desc.color_blends.size()),
+            .pAttachments    = desc.color_blends.data(),
+            .blendConstants  = desc.blend_constants,
+    };
+    vk::PipelineDynamicStateCreateInfo dynamic_state = {
+            .dynamicStateCount = static_cast<uint32_t>(desc.dynamic_states.size()),
+            .pDynamicStates    = desc.dynamic_states.data(),
+    };
+
+
+    vk::GraphicsPipelineCreateInfo pipeline_info = {
+            .stageCount          = static_cast<uint32_t>(stages.size()),
+            .pStages             = stages.data(),
+            .pVertexInputState   = &vertex_input,
+            .pInputAssemblyState = &assembly,
+            .pViewportState      = &viewport_state,
+            .pRasterizationState = &rasterization,
+            .pMultisampleState   = &multisample,
+            .pDepthStencilState  = &depth_stencil,
+            .pColorBlendState    = &color_blend,
+            .pDynamicState       = desc.dynamic_states.empty() ? nullptr : &dynamic_state,
+            .layout              = desc.layout,
+            .renderPass          = desc.render_pass,
+            .subpass             = desc.subpass,
+            .basePipelineHandle  = VK_NULL_HANDLE,
+            .basePipelineIndex   = -1,
+    };
+    auto [result, pipeline] = _device.createGraphicsPipeline(_cache, pipeline_info);
+    if (result != vk::Result::eSuccess)
+        throw std::runtime_error("failed to create graphics pipeline.");
+    return pipeline;
+}
+
+
+vk::Pipeline Hiss::PipelineRegistry::compute_pipeline_create(const PipelineDesc &desc, Entry &entry)
+{
+    std::vector<vk::SpecializationInfo> spec_infos;
+    auto                                stages = stages_create(desc, entry, spec_infos);
+
+    auto [result, pipeline] = _device.createComputePipeline(_cache, vk::ComputePipelineCreateInfo{
+                                                                            .stage  = stages.front(),
+                                                                            .layout = desc.layout,
+                                                                    });
+    if (result != vk::Result::eSuccess)
+        throw std::runtime_error("failed to create compute pipeline.");
+    return pipeline;
+}
@@ -0,0 +1,75 @@
+#include "../pipeline_stat.hpp"
+#include <bit>
+#include "env.hpp"
+
+
+Hiss::PipelineStatQuery::PipelineStatQuery(uint32_t frame_cnt, vk::QueryPipelineStatisticFlags stats)
+    : _stats(stats),
+      _stat_cnt(std::popcount(static_cast<VkQueryPipelineStatisticFlags>(stats))),
+      _written(frame_cnt, false)
+{
+    auto        env      = Hiss::Env::env();
+    const auto &features = env->info->physical_device_features;
+
+    _supported = features.pipelineStatisticsQuery;
+    _inherited = _supported && features.inheritedQueries;
+    if (!_supported)
+    {
+        LogStatic::logger()->warn("[pipeline stat] pipeline statistics query is not supported.");
+        return;
+    }
+
+    _pool = env->device.createQueryPool(vk::QueryPoolCreateInfo{
+            .queryType          = vk::QueryType::ePipelineStatistics,
+            .queryCount         = frame_cnt,
+            .pipelineStatistics = stats,
+    });
+}
+
+
+Hiss::PipelineStatQuery::~PipelineStatQuery()
+{
+    if (_pool)
+        Hiss::Env::env()->device.destroyQueryPool(_pool);
+}
+
+
+void Hiss::PipelineStatQuery::reset_record(vk::CommandBuffer cmd, uint32_t frame_idx)
+{
+    if (!_supported)
+        return;
+    cmd.resetQueryPool(_pool, frame_idx, 1);
+    _written[frame_idx] = false;
+}
+
+
+void Hiss::PipelineStatQuery::begin_record(vk::CommandBuffer cmd, uint32_t frame_idx)
+{
+    if (_supported)
+        cmd.beginQuery(_pool, frame_idx, {});
+}
+
+
+void Hiss::PipelineStatQuery::end_record(vk::CommandBuffer cmd, uint32_t frame_idx)
+{
+    if (!_supported)
+        return;
+    cmd.endQuery(_pool, frame_idx);
+    _written[frame_idx] = true;
+}
+
+
+std::optional<std::vector<uint64_t>> Hiss::PipelineStatQuery::results(uint32_t frame_idx)
+{
+    if (!_supported || !_written[frame_idx])
+        return std::nullopt;
+
+    /* 不等待：结果还不可用时返回 eNotReady */
+    std::vector<uint64_t> values(_stat_cnt);
+    vk::Result            result = Hiss::Env::env()->device.getQueryPoolResults(
+            _pool, frame_idx, 1, sizeof(uint64_t) * values.size(), values.data(), sizeof(uint64_t) * values.size(),
+            vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess)
+        return std::nullopt;
+    return values;
+}
@@ -0,0 +1,142 @@
+#include "../present_policy.hpp"
+#include <thread>
+#include <algorithm>
+
+
+Hiss::PresentPolicy Hiss::PresentPolicy::low_latency()
+{
+    return PresentPolicy{
+            .name       = "low latency",
+            .mode       = vk::PresentModeKHR::eMailbox,
+            .image_cnt  = 3,
+            .fps_limit  = 0.,
+            .late_latch = true,
+    };
+}
+
+
+Hiss::PresentPolicy Hiss::PresentPolicy::power_saving()
+{
+    return PresentPolicy{
+            .name       = "power saving",
+            .mode       = vk::PresentModeKHR::eFifo,
+            .image_cnt  = 2,
+            .fps_limit  = 30.,
+            .late_latch = false,
+    };
+}
+
+
+vk::PresentModeKHR Hiss::present_mode_choose(const std::vector<vk::PresentModeKHR> &supported,
+                                             vk::PresentModeKHR                     preferred)
+{
+    if (std::find(supported.begin(), supported.end(), preferred) != supported.end())
+        return preferred;
+
+    /* 按照延迟从低到高的顺序，选择延迟不低于 preferred 的模式 */
+    static const std::vector<vk::PresentModeKHR> order = {
+            vk::PresentModeKHR::eImmediate,
+            vk::PresentModeKHR::eMailbox,
+            vk::PresentModeKHR::eFifoRelaxed,
+            vk::PresentModeKHR::eFifo,
+    };
+    auto begin = std::find(order.begin(), order.end(), preferred);
+    if (preferred == vk::PresentModeKHR::eMailbox)
+        begin = order.begin();    // MAILBOX 不可用时，IMMEDIATE 的延迟更接近
+    for (auto it = begin; it != order.end(); ++it)
+        if (std::find(supported.begin(), supported.end(), *it) != supported.end())
+            return *it;
+    return vk::PresentModeKHR::eFifo;
+}
+
+
+uint32_t Hiss::swapchain_image_cnt(const vk::SurfaceCapabilitiesKHR &capability, uint32_t requested)
+{
+    uint32_t image_cnt = requested == 0 ? capability.minImageCount + 1 : requested;
+    image_cnt          = std::max(image_cnt, capability.minImageCount);
+    if (capability.maxImageCount > 0)
+        image_cnt = std::min(image_cnt, capability.maxImageCount);
+    return image_cnt;
+}
+
+
+void Hiss::FrameLimiter::fps_set(double fps)
+{
+    _interval = fps > 0. ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1. / fps))
+                         : Clock::duration::zero();
+    _next     = Clock::now();
+}
+
+
+void Hiss::FrameLimiter::wait()
+{
+    if (_interval == Clock::duration::zero())
+        return;
+
+    /* 落后超过一帧时不再追赶，从当前时间重新开始计时 */
+    auto now = Clock::now();
+    if (now > _next + _interval)
+        _next = now;
+
+    constexpr auto SPIN = std::chrono::milliseconds(1);
+    if (_next - now > SPIN)
+        std::this_thread::sleep_for(_next - now - SPIN);
+    while (Clock::now() < _next)
+        std::this_thread::yield();
+    _next += _interval;
+}
+
+
+void Hiss::PresentLatency::input_record(uint64_t frame_id)
+{
+    _pending.push_back(Frame{.id = frame_id, .input = Clock::now(), .submitted = false});
+    if (_pending.size() > MAX_PENDING)
+        _pending.pop_front();
+}
+
+
+void Hiss::PresentLatency::submit_record(uint64_t frame_id)
+{
+    auto it = std::find_if(_pending.rbegin(), _pending.rend(), [&](const Frame &f) { return f.id == frame_id; });
+    if (it == _pending.rend())
+        return;
+
+    it->submitted = true;
+    _sum.input_to_submit += std::chrono::duration<double, std::milli>(Clock::now() - it->input).count();
+    ++_sum.submitted;
+}
+
+
+void Hiss::PresentLatency::present_record(uint64_t frame_id)
+{
+    auto now = Clock::now();
+    while (!_pending.empty() && _pending.front().id <= frame_id)
+    {
+        if (_pending.front().id == frame_id)
+        {
+            _sum.input_to_present += std::chrono::duration<double, std::milli>(now - _pending.front().input).count();
+            ++_sum.presented;
+        }
+        _pending.pop_front();
+    }
+}
+
+
+std::optional<uint64_t> Hiss::PresentLatency::oldest_pending() const
+{
+    if (_pending.empty() || !_pending.front().submitted)
+        return std::nullopt;
+    return _pending.front().id;
+}
+
+
+Hiss::PresentLatency::Stat Hiss::PresentLatency::stat_take()
+{
+    Stat stat = _sum;
+    if (stat.submitted > 0)
+        stat.input_to_submit /= stat.submitted;
+    if (stat.presented > 0)
+        stat.input_to_present /= stat.presented;
+    _sum = {};
+    return stat;
+}
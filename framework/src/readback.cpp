@@ -0,0 +1,99 @@
+#include "../readback.hpp"
+#include "../buffer.hpp"
+#include "env.hpp"
+
+
+Hiss::ReadbackRing::ReadbackRing(vk::DeviceSize slot_size, uint32_t slot_cnt)
+    : _device(Hiss::Env::env()->device),
+      _slot_size(slot_size)
+{
+    vk::MemoryPropertyFlags props = memory_props_choose(Hiss::Env::env()->info->pdevice_mem_props);
+
+    _slots.resize(slot_cnt);
+    for (auto &slot: _slots)
+    {
+        buffer_create(_slot_size, vk::BufferUsageFlagBits::eTransferDst, props, slot.buffer, slot.memory);
+        slot.data = _device.mapMemory(slot.memory, 0, VK_WHOLE_SIZE, {});
+    }
+}
+
+
+Hiss::ReadbackRing::ReadbackRing(const Device &device, vk::DeviceSize slot_size, uint32_t slot_cnt)
+    : _device(device.handle_get()),
+      _slot_size(slot_size)
+{
+    vk::MemoryPropertyFlags props = memory_props_choose(device.physical_device_get().getMemoryProperties());
+
+    _slots.resize(slot_cnt);
+    for (auto &slot: _slots)
+    {
+        device.buffer_create(_slot_size, vk::BufferUsageFlagBits::eTransferDst, props, slot.buffer, slot.memory);
+        slot.data = _device.mapMemory(slot.memory, 0, VK_WHOLE_SIZE, {});
+    }
+}
+
+
+/**
+ * 是否有 host visible + host cached 的内存，有的话 CPU 读取的速度更快
+ */
+vk::MemoryPropertyFlags Hiss::ReadbackRing::memory_props_choose(const vk::PhysicalDeviceMemoryProperties &mem_props)
+{
+    vk::MemoryPropertyFlags host_cached =
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCached;
+    for (uint32_t i = 0; i < mem_props.memoryTypeCount; ++i)
+        if (BITS_CONTAIN(mem_props.memoryTypes[i].propertyFlags, host_cached))
+        {
+            /* 不一定是 coherent 的，统一在读取之前 invalidate */
+            _coherent = false;
+            return host_cached;
+        }
+
+    _coherent = true;
+    return vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+}
+
+
+Hiss::ReadbackRing::~ReadbackRing()
+{
+    for (auto &slot: _slots)
+    {
+        _device.unmapMemory(slot.memory);
+        _device.destroy(slot.buffer);
+        _device.free(slot.memory);
+    }
+}
+
+
+void Hiss::ReadbackRing::copy_record(vk::CommandBuffer cmd, uint32_t slot, vk::Buffer src,
+                                     vk::DeviceSize src_offset, vk::DeviceSize size)
+{
+    if (size > _slot_size)
+        throw std::runtime_error("readback size exceeds slot size.");
+
+    cmd.copyBuffer(src, _slots[slot].buffer, {vk::BufferCopy{.srcOffset = src_offset, .dstOffset = 0, .size = size}});
+
+    /* 让 transfer 的写入对 host 可见 */
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, {},
+                        {vk::MemoryBarrier{
+                                .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+                                .dstAccessMask = vk::AccessFlagBits::eHostRead,
+                        }},
+                        {}, {});
+    _slots[slot].written = true;
+}
+
+
+const void *Hiss::ReadbackRing::data_get(uint32_t slot)
+{
+    auto &s = _slots[slot];
+    if (!s.written)
+        return nullptr;
+
+    if (!_coherent)
+        _device.invalidateMappedMemoryRanges({vk::MappedMemoryRange{
+                .memory = s.memory,
+                .offset = 0,
+                .size   = VK_WHOLE_SIZE,
+        }});
+    return s.data;
+}
@@ -0,0 +1,91 @@
+#include "../redraw.hpp"
+#include <stdexcept>
+#include <algorithm>
+
+
+Hiss::RedrawTracker::RedrawTracker(const Config &config)
+    : _config(config)
+{
+    if (config.wait_timeout <= 0. || config.represent_period < 0.)
+        throw std::runtime_error("redraw tracker: invalid config.");
+}
+
+
+void Hiss::RedrawTracker::enable(bool enabled)
+{
+    _enabled = enabled;
+    _dirty |= DIRTY_SETTING;
+}
+
+
+bool Hiss::RedrawTracker::represent_due() const
+{
+    return _config.represent_period > 0.
+        && Clock::now() - _last_present >= std::chrono::duration<double>(_config.represent_period);
+}
+
+
+Hiss::RedrawTracker::Action Hiss::RedrawTracker::frame_begin()
+{
+    Action action = Action::IDLE;
+    if (!_enabled || _dirty != DIRTY_NONE)
+        action = Action::DRAW;
+    else if (_represent || represent_due())
+        action = Action::REPRESENT;
+
+    switch (action)
+    {
+        case Action::DRAW: ++_stat.drawn; break;
+        case Action::REPRESENT: ++_stat.represented; break;
+        case Action::IDLE: ++_stat.idle; return action;
+    }
+
+    _stat.dirty |= _dirty;
+
+    /* 重新绘制的结果同样满足窗口刷新的要求 */
+    _dirty        = DIRTY_NONE;
+    _represent    = false;
+    _last_present = Clock::now();
+    return action;
+}
+
+
+bool Hiss::RedrawTracker::idle() const
+{
+    return _enabled && _dirty == DIRTY_NONE && !_represent && !represent_due();
+}
+
+
+void Hiss::RedrawTracker::idle_wait() const
+{
+    double timeout = _config.wait_timeout;
+    if (_config.represent_period > 0.)
+    {
+        double elapsed = std::chrono::duration<double>(Clock::now() - _last_present).count();
+        timeout        = std::clamp(_config.represent_period - elapsed, 0., timeout);
+    }
+    glfwWaitEventsTimeout(timeout);
+}
+
+
+Hiss::RedrawTracker::Stat Hiss::RedrawTracker::stat_take()
+{
+    Stat stat = _stat;
+    _stat     = {};
+    return stat;
+}
+
+
+std::string Hiss::RedrawTracker::dirty_str(uint32_t dirty)
+{
+    static const std::pair<uint32_t, const char *> names[] = {
+            {DIRTY_CAMERA, "camera"}, {DIRTY_UNIFORM, "uniform"}, {DIRTY_RESIZE, "resize"},
+            {DIRTY_ASSET, "asset"},   {DIRTY_SETTING, "setting"},
+    };
+
+    std::string str;
+    for (const auto &[bit, name]: names)
+        if (dirty & bit)
+            str += str.empty() ? std::string(name) : std::string("|") + name;
+    return str.empty() ? "none" : str;
+}
@@ -6,9 +6,9 @@
 /**
  * 创建 render pass，主要包含：attachement，subpass，subpass dependency
  */
-vk::RenderPass render_pass_create(const FramebufferLayout_temp &framebuffer_layout)
+vk::RenderPass render_pass_create(const FramebufferLayout_temp &framebuffer_layout, bool depth_prepass)
 {
-    LogStatic::logger()->info("create render pass.");
+    LogStatic::logger()->info("create render pass, depth prepass: {}.", depth_prepass);
     auto env = *Hiss::Env::env();
 
 
@@ -73,14 +73,26 @@ vk::RenderPass render_pass_create(const FramebufferLayout_temp &framebuffer_layo
             .stencilLoadOp  = vk::AttachmentLoadOp::eDontCare,
             .stencilStoreOp = vk::AttachmentStoreOp::eDontCare,
             .initialLayout  = vk::ImageLayout::eUndefined,
-            .finalLayout    = vk::ImageLayout::ePresentSrcKHR,
+            .finalLayout    = framebuffer_layout.resolve_final_layout,
     };
 
+    /**
+     * 采样数为 1 时不能 resolve：color attachment 直接就是最终的图像（swapchain 的 image 或者离屏的 image），
+     * 使用 resolve attachment 的格式和 final layout，framebuffer 中只有 color 和 depth 两个 attachment
+     */
+    bool msaa = framebuffer_layout.color_sample != vk::SampleCountFlagBits::e1;
+    if (!msaa)
+    {
+        color_attach.format      = framebuffer_layout.resolve_format;
+        color_attach.finalLayout = framebuffer_layout.resolve_final_layout;
+    }
+
     std::vector<vk::AttachmentDescription> attachments = {
             color_attach,
             depth_attach,
-            resolve_attach,
     };
+    if (msaa)
+        attachments.push_back(resolve_attach);
 
 
     /* subpass 引用的 attachment，depth 只有 1 个，color 可以有多个 */
@@ -99,17 +111,30 @@ vk::RenderPass render_pass_create(const FramebufferLayout_temp &framebuffer_layo
             .layout     = vk::ImageLayout::eColorAttachmentOptimal,
     };
 
+    /* 有 depth pre-pass 时，主 pass 只读取 depth */
+    vk::AttachmentReference depth_read_attach_ref = {
+            .attachment = 1,
+            .layout     = vk::ImageLayout::eDepthStencilReadOnlyOptimal,
+    };
+
 
     std::vector<vk::SubpassDescription> subpass = {
             vk::SubpassDescription{
                     .pipelineBindPoint       = vk::PipelineBindPoint::eGraphics,
                     .colorAttachmentCount    = (uint32_t) color_attach_refs.size(),
                     .pColorAttachments       = color_attach_refs.data(),
-                    .pResolveAttachments     = &resolve_attach_ref,
-                    .pDepthStencilAttachment = &depth_attach_ref,
+                    .pResolveAttachments     = msaa ? &resolve_attach_ref : nullptr,
+                    .pDepthStencilAttachment = depth_prepass ? &depth_read_attach_ref : &depth_attach_ref,
             },
     };
 
+    /* depth pre-pass：没有 color attachment，只写入 depth */
+    if (depth_prepass)
+        subpass.insert(subpass.begin(), vk::SubpassDescription{
+                                                .pipelineBindPoint       = vk::PipelineBindPoint::eGraphics,
+                                                .pDepthStencilAttachment = &depth_attach_ref,
+                                        });
+
 
     /**
      * dst subpass 依赖于 src subpass，可以参考下面的回答
@@ -139,6 +164,36 @@ vk::RenderPass render_pass_create(const FramebufferLayout_temp &framebuffer_layo
             },
     };
 
+    /* 离屏的 resolve attachment 之后会被 blit 或者后处理的 compute shader 读取，下一帧写入之前需要等待读取完成 */
+    if (framebuffer_layout.resolve_final_layout == vk::ImageLayout::eTransferSrcOptimal)
+        dependency.front().srcStageMask |= vk::PipelineStageFlagBits::eTransfer
+                                         | vk::PipelineStageFlagBits::eComputeShader;
+
+    /**
+     * 有 depth pre-pass 时，color attachment 第一次在 subpass 1 中使用，需要一个同样的 external dependency，
+     * 否则会使用隐式的 dependency（srcStage = TOP）
+     * 主 pass 的 depth test 需要等待 pre-pass 写入 depth；只依赖于同一个像素，因此是 by region 的
+     * depth 的写入可能发生在 early 或者 late fragment test 中，两个 stage 都需要包含在 src 中
+     */
+    if (depth_prepass)
+    {
+        vk::SubpassDependency color_dependency = dependency.front();
+        color_dependency.dstSubpass            = 1;
+        dependency.push_back(color_dependency);
+
+        dependency.push_back(vk::SubpassDependency{
+                .srcSubpass      = 0,
+                .dstSubpass      = 1,
+                .srcStageMask    = vk::PipelineStageFlagBits::eEarlyFragmentTests
+                                 | vk::PipelineStageFlagBits::eLateFragmentTests,
+                .dstStageMask    = vk::PipelineStageFlagBits::eEarlyFragmentTests
+                                 | vk::PipelineStageFlagBits::eLateFragmentTests,
+                .srcAccessMask   = vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+                .dstAccessMask   = vk::AccessFlagBits::eDepthStencilAttachmentRead,
+                .dependencyFlags = vk::DependencyFlagBits::eByRegion,
+        });
+    }
+
 
     vk::RenderPassCreateInfo render_pass_info = {
             .attachmentCount = (uint32_t) attachments.size(),
@@ -154,247 +209,43 @@ vk::RenderPass render_pass_create(const FramebufferLayout_temp &framebuffer_layo
 }
 
 
-vk::Pipeline pipeline_create(const vk::PipelineLayout &pipeline_layout,
-                             const vk::RenderPass &render_pass)
+vk::DescriptorSetLayout descriptor_set_layout_create(Hiss::DescriptorLayoutCache &layout_cache)
 {
-    LogStatic::logger()->info("create pipeline.");
-    auto env = Hiss::Env::env();
-
-
-    /* 根据字节码创建 shader module */
-    auto shader_module_create = [](const std::string &file_path) -> vk::ShaderModule {
-        std::vector<char> code          = read_file(file_path);
-        vk::ShaderModuleCreateInfo info = {
-                .codeSize = code.size(), /* 单位是字节 */
-                // vector 容器可以保证转换为 uint32 后仍然是对齐的
-                .pCode = reinterpret_cast<const uint32_t *>(code.data()),
-        };
-        return Hiss::Env::env()->device.createShaderModule(info);
-    };
-    vk::ShaderModule vert_shader_module = shader_module_create(SHADER("triangle.vert.spv"));
-    vk::ShaderModule frag_shader_module = shader_module_create(SHADER( "/triangle.frag.spv"));
-    std::vector<vk::PipelineShaderStageCreateInfo> shader_stage_create_info = {
-            vk::PipelineShaderStageCreateInfo{
-                    .stage  = vk::ShaderStageFlagBits::eVertex,
-                    .module = vert_shader_module,
-                    .pName  = "main",    // 入口函数
-            },
-            vk::PipelineShaderStageCreateInfo{
-                    .stage  = vk::ShaderStageFlagBits::eFragment,
-                    .module = frag_shader_module,
-                    .pName  = "main",
-            },
-    };
-
-
-    /* vertex buffer 以及 vertex attribute 的信息 */
-    auto vert_bind_description = Vertex::binding_description_get();
-    auto vert_attr_description = Vertex::attr_description_get();
-    vk::PipelineVertexInputStateCreateInfo vertex_input_create_info_ = {
-            /* vertex buffer 的信息 */
-            .vertexBindingDescriptionCount = static_cast<uint32_t>(vert_bind_description.size()),
-            .pVertexBindingDescriptions    = vert_bind_description.data(),
-
-            /* vertex attribute 的信息 */
-            .vertexAttributeDescriptionCount = (uint32_t) vert_attr_description.size(),
-            .pVertexAttributeDescriptions    = vert_attr_description.data(),
-    };
-
-
-    /* 图元装配的信息 */
-    vk::PipelineInputAssemblyStateCreateInfo assembly_info = {
-            /* 每三个顶点组成一个三角形，不重用顶点 */
-            .topology = vk::PrimitiveTopology::eTriangleList,
-
-            /* 是否允许值为 0xFFFF 或 0xFFFFFFFF 索引来分解三角形 */
-            .primitiveRestartEnable = VK_FALSE,
-    };
-
-
-    /**
-     * viewport 配置
-     * scissor 测试发生在 viewport 变换之后，未通过的会被丢弃
-     * NDC -> framebuffer -> scissor test
-     */
-    vk::Viewport viewport = {
-            .x        = 0.f,
-            .y        = 0.f,
-            .width    = (float) env->present_extent.width,
-            .height   = (float) env->present_extent.height,
-            .minDepth = 0.f,
-            .maxDepth = 1.f,
-    };
-    vk::Rect2D scissors = {
-            .offset = {0, 0},
-            .extent = env->present_extent,
-    };
-    vk::PipelineViewportStateCreateInfo viewport_state = {
-            .viewportCount = 1,
-            .pViewports    = &viewport,
-            .scissorCount  = 1,
-            .pScissors     = &scissors,
-    };
-
-
-    /* 光栅化阶段 */
-    vk::PipelineRasterizationStateCreateInfo rasterization_state = {
-            /* 超出深度范围的深度是被 clamp 还是被丢弃，需要 GPU feature */
-            .depthClampEnable        = VK_FALSE,
-            .rasterizerDiscardEnable = VK_FALSE,
-
-            /* 绘制线框/绘制顶点/绘制实心图形（除了 FILL 外，其他的都需要 GPU feature） */
-            .polygonMode = vk::PolygonMode::eFill,
-
-            /* 背面剔除，发生在 viewport 变换之后 */
-            .cullMode  = vk::CullModeFlagBits::eBack,
-            .frontFace = vk::FrontFace::eCounterClockwise,
-            /* 基于 bias 或 fragment 的斜率来更改 depth（在 shadow map 中会用到） */
-            .depthBiasEnable         = VK_FALSE,
-            .depthBiasConstantFactor = 0.f,
-            .depthBiasClamp          = 0.f,
-            .depthBiasSlopeFactor    = 0.f,
-
-            /* 如果线宽不为 1，需要 GPU feature */
-            .lineWidth = 1.f,
-    };
-
-
-    /* MSAA */
-    vk::PipelineMultisampleStateCreateInfo multisample_state = {
-            /* 使用最高的 MSAA */
-            .rasterizationSamples  = Hiss::Env::max_sample_cnt(),
-            .sampleShadingEnable   = VK_TRUE,
-            .minSampleShading      = .2f,
-            .pSampleMask           = nullptr,
-            .alphaToCoverageEnable = VK_FALSE,
-            .alphaToOneEnable      = VK_FALSE,
-    };
-
-
-    /* 深度测试和模版测试 */
-    vk::PipelineDepthStencilStateCreateInfo depth_stencil_info = {
-            .depthTestEnable  = VK_TRUE,
-            .depthWriteEnable = VK_TRUE,
-            .depthCompareOp   = vk::CompareOp::eLess,
-            /* 这个选项可以只显示某个深度范围的 fragment */
-            .depthBoundsTestEnable = VK_FALSE,
-            .stencilTestEnable     = VK_FALSE,
-    };
-
-
-    /* blend：需要分别为每个 color attachment 指定 blend 设置 */
-    vk::PipelineColorBlendAttachmentState color_blend_attachment = {
-            .blendEnable = VK_FALSE, /* blend 的开关 */
-
-            .srcColorBlendFactor = vk::BlendFactor::eOne,
-            .dstColorBlendFactor = vk::BlendFactor::eZero,
-            .colorBlendOp        = vk::BlendOp::eAdd,
-
-            .srcAlphaBlendFactor = vk::BlendFactor::eOne,
-            .dstAlphaBlendFactor = vk::BlendFactor::eZero,
-            .alphaBlendOp        = vk::BlendOp::eAdd,
-
-            .colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG
-                            | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA,
-    };
-    vk::PipelineColorBlendStateCreateInfo color_blend_state = {
-            .logicOpEnable   = VK_FALSE,
-            .logicOp         = vk::LogicOp::eCopy,
-            .attachmentCount = 1,
-            .pAttachments    = &color_blend_attachment,
-            .blendConstants  = {{0.f, 0.f, 0.f, 0.f}},
-    };
-
-
-    /* 创建 pipeline */
-    vk::GraphicsPipelineCreateInfo pipeline_create_info = {
-            /* shader stages */
-            .stageCount = (uint32_t) shader_stage_create_info.size(),
-            .pStages    = shader_stage_create_info.data(),
-
-            /* vertex */
-            .pVertexInputState   = &vertex_input_create_info_,
-            .pInputAssemblyState = &assembly_info,
-
-            /* pipeline 的固定功能 */
-            .pViewportState      = &viewport_state,
-            .pRasterizationState = &rasterization_state,
-            .pMultisampleState   = &multisample_state,
-            .pDepthStencilState  = &depth_stencil_info,
-            .pColorBlendState    = &color_blend_state,
-            .pDynamicState       = nullptr,
-
-            /* uniform 相关 */
-            .layout = pipeline_layout,
-
-            /* 绑定到哪个 render pass */
-            .renderPass = render_pass,
-            .subpass    = 0, /* index of subpass */
-
-            /* 是否继承自其他的 pipelien。如果继承，需要在 flags 中指定 */
-            .basePipelineHandle = VK_NULL_HANDLE,
-            .basePipelineIndex  = -1,
-    };
-    vk::Result result;
-    vk::Pipeline graphics_pipeline;
-    std::tie(result, graphics_pipeline) =
-            env->device.createGraphicsPipeline(VK_NULL_HANDLE, pipeline_create_info);
-    if (result != vk::Result::eSuccess)
-        throw std::runtime_error("failed to create graphics pipeline.");
-
-
-    /* 释放临时资源 */
-    env->device.destroyShaderModule(vert_shader_module);
-    env->device.destroyShaderModule(frag_shader_module);
-
-    return graphics_pipeline;
-}
-
-
-vk::DescriptorSetLayout descriptor_set_layout_create()
-{
-    LogStatic::logger()->info("create descriptor set layout.");
-
-
-    vk::DescriptorSetLayoutBinding uniform_binding = {
-            .binding         = 0,
-            .descriptorType  = vk::DescriptorType::eUniformBuffer,
-            .descriptorCount = 1, /* 大于 1 表示数组 */
-            .stageFlags      = vk::ShaderStageFlagBits::eVertex,
-    };
-    vk::DescriptorSetLayoutBinding sampler_binding = {
-            .binding            = 1,
-            .descriptorType     = vk::DescriptorType::eCombinedImageSampler,
-            .descriptorCount    = 1,
-            .stageFlags         = vk::ShaderStageFlagBits::eFragment,
-            .pImmutableSamplers = nullptr,
-    };
-
-
     /**
      * 这个 layout 表示：
      * layout(binding = 0) uniform UniformBlock;
      * layout(binding = 1) uniform sampler2D;
+     * 相同的 bindings 只会创建一次 layout，layout 由 cache 负责销毁
      */
-    std::array<vk::DescriptorSetLayoutBinding, 2> bindings = {
-            uniform_binding,
-            sampler_binding,
-    };
-    return Hiss::Env::env()->device.createDescriptorSetLayout({
-            .bindingCount = static_cast<uint32_t>(bindings.size()),
-            .pBindings    = bindings.data(),
+    return layout_cache.get({
+            vk::DescriptorSetLayoutBinding{
+                    .binding         = 0,
+                    .descriptorType  = vk::DescriptorType::eUniformBuffer,
+                    .descriptorCount = 1, /* 大于 1 表示数组 */
+                    .stageFlags      = vk::ShaderStageFlagBits::eVertex,
+            },
+            vk::DescriptorSetLayoutBinding{
+                    .binding            = 1,
+                    .descriptorType     = vk::DescriptorType::eCombinedImageSampler,
+                    .descriptorCount    = 1,
+                    .stageFlags         = vk::ShaderStageFlagBits::eFragment,
+                    .pImmutableSamplers = nullptr,
+            },
     });
 }
 
 
 vk::PipelineLayout
-pipeline_layout_create(const std::vector<vk::DescriptorSetLayout> &descriptor_set_layout)
+pipeline_layout_create(const std::vector<vk::DescriptorSetLayout> &descriptor_set_layout,
+                       const std::vector<vk::PushConstantRange>      &push_constant_ranges)
 {
     LogStatic::logger()->info("create pipeline layout.");
 
     return Hiss::Env::env()->device.createPipelineLayout(vk::PipelineLayoutCreateInfo{
-            .setLayoutCount = (uint32_t) descriptor_set_layout.size(),
-            .pSetLayouts    = descriptor_set_layout.data(),
+            .setLayoutCount         = (uint32_t) descriptor_set_layout.size(),
+            .pSetLayouts            = descriptor_set_layout.data(),
+            .pushConstantRangeCount = (uint32_t) push_constant_ranges.size(),
+            .pPushConstantRanges    = push_constant_ranges.data(),
     });
 }
 
@@ -404,7 +255,7 @@ pipeline_layout_create(const std::vector<vk::DescriptorSetLayout> &descriptor_se
  */
 std::vector<vk::DescriptorSet>
 create_descriptor_set(const vk::DescriptorSetLayout &descriptor_set_layout,
-                      const vk::DescriptorPool &descriptor_pool, uint32_t frames_in_flight,
+                      Hiss::DescriptorAllocator &descriptor_allocator, uint32_t frames_in_flight,
                       std::array<vk::Buffer, 2U> uniform_buffer_list,
                       const vk::ImageView &tex_img_view, const vk::Sampler &tex_sampler)
 {
@@ -415,16 +266,9 @@ create_descriptor_set(const vk::DescriptorSetLayout &descriptor_set_layout,
     if (uniform_buffer_list.size() != frames_in_flight)
         throw std::runtime_error("descriptor buffer count error.");
 
-    // 为每一帧都创建一个 descriptor set
-    std::vector<vk::DescriptorSet> des_set_list;
-    {
-        std::vector<vk::DescriptorSetLayout> layouts(frames_in_flight, descriptor_set_layout);
-        des_set_list = env->device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo{
-                .descriptorPool     = descriptor_pool,
-                .descriptorSetCount = (uint32_t) layouts.size(),
-                .pSetLayouts        = layouts.data(),
-        });
-    }
+    // 为每一帧都创建一个 descriptor set，allocator 会按需增长，不需要预先计算 pool 的容量
+    std::vector<vk::DescriptorSet> des_set_list =
+            descriptor_allocator.allocate(descriptor_set_layout, frames_in_flight);
 
 
     for (size_t i = 0; i < frames_in_flight; ++i)
@@ -0,0 +1,47 @@
+#include "../render_scale.hpp"
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+
+
+Hiss::RenderScale::RenderScale(const Config &config)
+    : _config(config),
+      _scale(config.max_scale)
+{
+    if (config.min_scale <= 0.f || config.min_scale > config.max_scale || config.target_ms <= 0.)
+        throw std::runtime_error("render scale: invalid config.");
+}
+
+
+void Hiss::RenderScale::reset()
+{
+    _scale       = _config.max_scale;
+    _smoothed_ms = 0.;
+}
+
+
+float Hiss::RenderScale::update(double gpu_ms)
+{
+    if (gpu_ms <= 0.)
+        return _scale;
+    _smoothed_ms = _smoothed_ms == 0. ? gpu_ms : _smoothed_ms + (gpu_ms - _smoothed_ms) * _config.smoothing;
+
+    double ratio = _config.target_ms / _smoothed_ms;
+    if (std::abs(ratio - 1.) < _config.tolerance)
+        return _scale;
+
+    auto desired = static_cast<float>(_scale * std::sqrt(ratio));
+    desired      = std::clamp(desired, _scale - _config.max_step, _scale + _config.max_step);
+    _scale       = std::clamp(desired, _config.min_scale, _config.max_scale);
+    return _scale;
+}
+
+
+vk::Extent2D Hiss::RenderScale::extent(const vk::Extent2D &full_extent) const
+{
+    auto scaled = [&](uint32_t size) {
+        auto value = static_cast<uint32_t>(static_cast<float>(size) * _scale) & ~7u;
+        return std::clamp(value, std::min(8u, size), size);
+    };
+    return vk::Extent2D{scaled(full_extent.width), scaled(full_extent.height)};
+}
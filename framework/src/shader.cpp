@@ -0,0 +1,143 @@
+#include "../shader.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "global.hpp"
+
+
+namespace
+{
+
+constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+
+/* 只读的文件映射，析构时自动 unmap */
+class FileMap
+{
+public:
+    explicit FileMap(const std::string &path)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("failed to open shader file: " + path);
+
+        struct stat file_stat{};
+        fstat(fd, &file_stat);
+        _size = static_cast<size_t>(file_stat.st_size);
+        if (_size > 0)
+        {
+            void *data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED)
+                _data = data;
+        }
+        close(fd);
+        if (!_data)
+            throw std::runtime_error("failed to map shader file: " + path);
+    }
+
+    ~FileMap() { munmap(_data, _size); }
+
+    FileMap(const FileMap &)            = delete;
+    FileMap &operator=(const FileMap &) = delete;
+
+    /* mmap 返回的地址是页对齐的 */
+    [[nodiscard]] const uint32_t *words() const { return static_cast<const uint32_t *>(_data); }
+    [[nodiscard]] size_t          size() const { return _size; }
+
+private:
+    void  *_data{};
+    size_t _size{};
+};
+
+
+/* 以 32 bit 为单位的 FNV-1a，SPIR-V 的长度一定是 4 的倍数 */
+uint64_t spirv_hash(const uint32_t *words, size_t word_cnt)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < word_cnt; ++i)
+    {
+        hash ^= words[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+}    // namespace
+
+
+Hiss::ShaderLibrary::~ShaderLibrary()
+{
+    if (size_t cnt = size())
+        LogStatic::logger()->warn("[shader] {} shader modules still in use when library destroyed.", cnt);
+}
+
+
+std::shared_ptr<const Hiss::Shader> Hiss::ShaderLibrary::alive_find(uint64_t hash)
+{
+    auto iter = _shaders.find(hash);
+    return iter == _shaders.end() ? nullptr : iter->second.lock();
+}
+
+
+std::shared_ptr<const Hiss::Shader> Hiss::ShaderLibrary::acquire(const std::string &path)
+{
+    std::lock_guard lock(_mutex);
+
+
+    /* 路径已经加载过，并且 module 仍然存活，就不需要再读取文件 */
+    if (auto iter = _path_hash.find(path); iter != _path_hash.end())
+        if (auto shader = alive_find(iter->second))
+            return shader;
+
+
+    FileMap file(path);
+    if (file.size() % 4 != 0 || file.size() < 20 || file.words()[0] != SPIRV_MAGIC)
+        throw std::runtime_error("invalid SPIR-V file: " + path);
+
+    uint64_t hash     = spirv_hash(file.words(), file.size() / 4);
+    _path_hash[path] = hash;
+
+    /* 内容相同的 shader 之前已经通过其他的路径加载过了 */
+    if (auto shader = alive_find(hash))
+        return shader;
+
+
+    LogStatic::logger()->info("[shader] create shader module: {}, hash: {:016x}", path, hash);
+    auto *raw = new Shader{
+            .module = _device.createShaderModule(vk::ShaderModuleCreateInfo{
+                    .codeSize = file.size(),    // 单位是字节
+                    .pCode    = file.words(),
+            }),
+            .hash   = hash,
+            .path   = path,
+    };
+    std::shared_ptr<const Shader> shader(raw, [this](const Shader *s) { shader_release(s); });
+    _shaders[hash] = shader;
+    return shader;
+}
+
+
+void Hiss::ShaderLibrary::shader_release(const Shader *shader)
+{
+    {
+        std::lock_guard lock(_mutex);
+
+        /* 同一个 hash 可能已经有了新创建的 shader，这时不能删除 */
+        if (auto iter = _shaders.find(shader->hash); iter != _shaders.end() && iter->second.expired())
+            _shaders.erase(iter);
+    }
+
+    _device.destroyShaderModule(shader->module);
+    delete shader;
+}
+
+
+size_t Hiss::ShaderLibrary::size() const
+{
+    std::lock_guard lock(_mutex);
+    size_t          cnt = 0;
+    for (const auto &[hash, shader]: _shaders)
+        cnt += !shader.expired();
+    return cnt;
+}
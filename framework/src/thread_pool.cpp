@@ -0,0 +1,98 @@
+#include "../thread_pool.hpp"
+#include <algorithm>
+
+
+Hiss::ThreadPool::ThreadPool(uint32_t thread_cnt)
+{
+    thread_cnt = std::max(thread_cnt, 1u);
+    for (uint32_t i = 0; i < thread_cnt; ++i)
+        _workers.emplace_back(&ThreadPool::worker_loop, this, i);
+}
+
+
+Hiss::ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(_mutex);
+        _stop = true;
+    }
+    _start_cv.notify_all();
+    for (auto &worker: _workers)
+        worker.join();
+}
+
+
+void Hiss::ThreadPool::worker_loop(uint32_t worker_idx)
+{
+    uint64_t generation = 0;
+    while (true)
+    {
+        const std::function<void(uint32_t)> *task;
+        {
+            std::unique_lock lock(_mutex);
+            _start_cv.wait(lock, [&] { return _stop || _generation != generation; });
+            if (_stop)
+                return;
+            generation = _generation;
+            if (worker_idx >= _task_cnt)
+                continue;
+            task = _task;
+        }
+
+
+        std::exception_ptr exception;
+        try
+        {
+            (*task)(worker_idx);
+        } catch (...)
+        {
+            exception = std::current_exception();
+        }
+
+
+        {
+            std::lock_guard lock(_mutex);
+            if (exception && !_exception)
+                _exception = exception;
+            if (--_remain == 0)
+                _finish_cv.notify_one();
+        }
+    }
+}
+
+
+void Hiss::ThreadPool::run(uint32_t task_cnt, const std::function<void(uint32_t)> &fn)
+{
+    task_cnt = std::min(task_cnt, thread_cnt());
+    if (task_cnt == 0)
+        return;
+
+    std::unique_lock lock(_mutex);
+    _task      = &fn;
+    _task_cnt  = task_cnt;
+    _remain    = task_cnt;
+    _exception = nullptr;
+    ++_generation;
+    _start_cv.notify_all();
+
+    _finish_cv.wait(lock, [&] { return _remain == 0; });
+    _task = nullptr;
+    if (_exception)
+        std::rethrow_exception(_exception);
+}
+
+
+void Hiss::ThreadPool::parallel_for(size_t cnt, const std::function<void(size_t, size_t)> &fn, uint32_t task_cnt)
+{
+    if (task_cnt == 0)
+        task_cnt = thread_cnt();
+    task_cnt = static_cast<uint32_t>(std::min<size_t>({task_cnt, thread_cnt(), cnt}));
+    if (task_cnt == 0)
+        return;
+
+    run(task_cnt, [&](uint32_t idx) {
+        size_t begin = cnt * idx / task_cnt;
+        size_t end   = cnt * (idx + 1) / task_cnt;
+        fn(begin, end);
+    });
+}
@@ -0,0 +1,68 @@
+#include "../tuning_cache.hpp"
+#include <sstream>
+#include <fstream>
+
+
+Hiss::TuningCache::TuningCache(std::string path)
+    : _path(std::move(path))
+{
+    std::ifstream file(_path);
+    std::string   line;
+    while (std::getline(file, line))
+    {
+        std::istringstream    stream(line);
+        std::string           device, name;
+        std::vector<uint32_t> values;
+        if (!(stream >> device >> name))
+            continue;
+        for (uint32_t value; stream >> value;)
+            values.push_back(value);
+        _entries[{device, name}] = std::move(values);
+    }
+}
+
+
+std::string Hiss::TuningCache::device_key(vk::PhysicalDevice physical_device)
+{
+    auto chain = physical_device.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceIDProperties>();
+    const auto &properties = chain.get<vk::PhysicalDeviceProperties2>().properties;
+    const auto &id         = chain.get<vk::PhysicalDeviceIDProperties>();
+
+    std::ostringstream key;
+    key << std::hex;
+    for (uint8_t byte: id.deviceUUID)
+        key << static_cast<uint32_t>(byte >> 4) << static_cast<uint32_t>(byte & 0xF);
+    key << "-" << std::dec << properties.driverVersion;
+    return key.str();
+}
+
+
+std::optional<std::vector<uint32_t>> Hiss::TuningCache::get(const std::string &device, const std::string &name) const
+{
+    auto iter = _entries.find({device, name});
+    if (iter == _entries.end())
+        return std::nullopt;
+    return iter->second;
+}
+
+
+void Hiss::TuningCache::set(const std::string &device, const std::string &name, const std::vector<uint32_t> &values)
+{
+    _entries[{device, name}] = values;
+}
+
+
+void Hiss::TuningCache::save() const
+{
+    std::ofstream file(_path);
+    if (!file)
+        throw std::runtime_error("fail to open tuning cache: " + _path);
+
+    for (const auto &[key, values]: _entries)
+    {
+        file << key.first << " " << key.second;
+        for (uint32_t value: values)
+            file << " " << value;
+        file << "\n";
+    }
+}
@@ -74,6 +74,41 @@ void vertex_buffer_create(const std::vector<Vertex> &vertices, vk::Buffer &verte
     }
 
 
+    env->device.destroyBuffer(stage_buffer);
+    env->device.free(stage_buffer_memory);
+}
+
+
+void instance_buffer_create(const std::vector<InstanceData> &instances, vk::Buffer &instance_buffer,
+                            vk::DeviceMemory &instance_memory)
+{
+    LogStatic::logger()->info("create instance buffer, instances: {}", instances.size());
+    auto env = Hiss::Env::env();
+
+    vk::DeviceSize buffer_size = sizeof(instances[0]) * instances.size();
+
+
+    /* instance data -> stage buffer */
+    vk::Buffer       stage_buffer;
+    vk::DeviceMemory stage_buffer_memory;
+    buffer_create(buffer_size, vk::BufferUsageFlagBits::eTransferSrc,
+                  vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                  stage_buffer, stage_buffer_memory);
+    auto data = env->device.mapMemory(stage_buffer_memory, 0, buffer_size, {});
+    std::memcpy(data, instances.data(), (size_t) buffer_size);
+    env->device.unmapMemory(stage_buffer_memory);
+
+
+    /* stage buffer -> instance buffer */
+    buffer_create(buffer_size, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer,
+                  vk::MemoryPropertyFlagBits::eDeviceLocal, instance_buffer, instance_memory);
+    {
+        OneTimeCmdBuffer one_time_cmd_buffer;
+        one_time_cmd_buffer().copyBuffer(stage_buffer, instance_buffer, {vk::BufferCopy{.size = buffer_size}});
+        one_time_cmd_buffer.end();
+    }
+
+
     env->device.destroyBuffer(stage_buffer);
     env->device.free(stage_buffer_memory);
 }
@@ -3,6 +3,7 @@
 #include "image.hpp"
 #include "global.hpp"
 #include "include_vk.hpp"
+#include "present_policy.hpp"
 
 
 /**
@@ -20,21 +21,24 @@ private:
     vk::SwapchainKHR _swapchain;
     std::vector<vk::Image> _images;
     std::vector<vk::ImageView> _image_views;
+    vk::PresentModeKHR _present_mode;
 
-    Swapchain()
+    explicit Swapchain(const Hiss::PresentPolicy &policy)
     {
-        _swapchain   = Swapchain::create_swapchain();
-        _images      = Hiss::Env::env()->device.getSwapchainImagesKHR(_swapchain);
-        _image_views = Swapchain::create_swapchain_view(_images);
+        _present_mode = Hiss::present_mode_choose(Hiss::Env::env()->info->present_mode_list, policy.mode);
+        _swapchain    = Swapchain::create_swapchain(_present_mode, policy.image_cnt);
+        _images       = Hiss::Env::env()->device.getSwapchainImagesKHR(_swapchain);
+        _image_views  = Swapchain::create_swapchain_view(_images);
 
 
-        LogStatic::logger()->info("[swapchain] swapchain create, image count: {}", _images.size());
+        LogStatic::logger()->info("[swapchain] swapchain create, image count: {}, present mode: {}", _images.size(),
+                                  vk::to_string(_present_mode));
     }
 
 public:
-    static std::shared_ptr<Swapchain> create()
+    static std::shared_ptr<Swapchain> create(const Hiss::PresentPolicy &policy = {})
     {
-        return std::shared_ptr<Swapchain>(new Swapchain());
+        return std::shared_ptr<Swapchain>(new Swapchain(policy));
     }
 
     ~Swapchain() { this->free(); }
@@ -52,6 +56,8 @@ public:
 
 
     std::vector<vk::ImageView> &img_views() { return _image_views; }
+    std::vector<vk::Image>     &images() { return _images; }
+    vk::PresentModeKHR          present_mode() const { return _present_mode; }
 
 
     /**
@@ -76,11 +82,17 @@ public:
 
     /**
      * 告知 present queue，swapchain 上的指定 image 可以 present 了
+     * @param present_id 非 0 并且设备支持 VK_KHR_present_id 时，附加在这次 present 上，之后可以用 present_wait 等待
      * @return 检测 window 大小是否发生变化，决定是否要 recreate swapchain
      */
-    Recreate present(uint32_t img_idx, const std::vector<vk::Semaphore> &wait_semaphore)
+    Recreate present(uint32_t img_idx, const std::vector<vk::Semaphore> &wait_semaphore, uint64_t present_id = 0)
     {
+        vk::PresentIdKHR id_info = {
+                .swapchainCount = 1,
+                .pPresentIds    = &present_id,
+        };
         vk::PresentInfoKHR info = {
+                .pNext              = present_id != 0 && Hiss::Env::env()->present_wait ? &id_info : nullptr,
                 .waitSemaphoreCount = static_cast<uint32_t>(wait_semaphore.size()),
                 .pWaitSemaphores    = wait_semaphore.data(),
                 .swapchainCount     = 1,
@@ -101,13 +113,34 @@ public:
     }
 
 
+    /**
+     * 等待 present id 不小于 present_id 的 image 被呈现到屏幕上（VK_KHR_present_wait）
+     * @param timeout 纳秒，为 0 时只查询，不阻塞
+     * @return 是否已经呈现；设备不支持 present wait 时总是返回 false
+     */
+    bool present_wait(uint64_t present_id, uint64_t timeout)
+    {
+        auto env = Hiss::Env::env();
+        if (!env->present_wait)
+            return false;
+
+        auto result = static_cast<vk::Result>(
+                VULKAN_HPP_DEFAULT_DISPATCHER.vkWaitForPresentKHR(env->device, _swapchain, present_id, timeout));
+        if (result == vk::Result::eTimeout)
+            return false;
+        if (result != vk::Result::eSuccess && result != vk::Result::eSuboptimalKHR)
+            throw std::runtime_error("failed to wait for present.");
+        return true;
+    }
+
+
     /**
      * 回收旧的 swapchain 资源，创建新的 swapchain
      */
     void recreate() { this->free(); }
 
 private:
-    static vk::SwapchainKHR create_swapchain()
+    static vk::SwapchainKHR create_swapchain(vk::PresentModeKHR present_mode, uint32_t requested_image_cnt)
     {
         LogStatic::logger()->info("create swapchain.");
         auto env = Hiss::Env::env();
@@ -116,11 +149,9 @@ private:
         /**
          * 确定 swapchain 中 image 的数量
          * minImageCount 至少是 1; maxImageCount 为 0 时表示没有限制
+         * image 越多，CPU 可以领先显示越多帧，吞吐更稳定，但是输入到呈现的延迟也越高
          */
-        uint32_t image_cnt = env->info->surface_capability.minImageCount + 1;
-        if (env->info->surface_capability.maxImageCount > 0 &&
-            image_cnt > env->info->surface_capability.maxImageCount)
-            image_cnt = env->info->surface_capability.maxImageCount;
+        uint32_t image_cnt = Hiss::swapchain_image_cnt(env->info->surface_capability, requested_image_cnt);
 
 
         /**
@@ -135,6 +166,12 @@ private:
             queue_families.push_back(idx);
 
 
+        /* 动态分辨率需要将离屏渲染的结果 blit 到 swapchain 的 image 上 */
+        vk::ImageUsageFlags image_usage = vk::ImageUsageFlagBits::eColorAttachment;
+        if (env->info->surface_capability.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferDst)
+            image_usage |= vk::ImageUsageFlagBits::eTransferDst;
+
+
         vk::SwapchainCreateInfoKHR create_info = {
                 .surface = env->surface,
                 /* vulkan 可能会创建更多的 image */
@@ -143,7 +180,7 @@ private:
                 .imageColorSpace       = env->present_format.colorSpace,
                 .imageExtent           = env->present_extent,
                 .imageArrayLayers      = 1,
-                .imageUsage            = vk::ImageUsageFlagBits::eColorAttachment,
+                .imageUsage            = image_usage,
                 .imageSharingMode      = queue_families.size() == 1 ? vk::SharingMode::eExclusive
                                                                     : vk::SharingMode::eConcurrent,
                 .queueFamilyIndexCount = static_cast<uint32_t>(queue_families.size()),
@@ -152,7 +189,7 @@ private:
                 .preTransform = env->info->surface_capability.currentTransform,
                 /* 如果一个 window 中有多个 surface，是否根据 alpha 值与其他 surface 进行复合 */
                 .compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque,
-                .presentMode    = env->present_mode,
+                .presentMode    = present_mode,
                 /* 是否丢弃 surface 不可见区域的渲染操作，可提升性能 */
                 .clipped      = VK_TRUE,
                 .oldSwapchain = {},
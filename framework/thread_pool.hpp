@@ -0,0 +1,57 @@
+#pragma once
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+
+namespace Hiss
+{
+
+/**
+ * 常驻的 worker 线程，避免每一帧都创建线程
+ * run() 会把同一个任务分发给前 task_cnt 个 worker，worker 的编号是固定的，
+ * 因此可以用 worker 编号索引线程私有的资源（例如每个线程的 command pool）
+ * run() 和 parallel_for() 会阻塞直到所有任务完成，worker 中抛出的异常会在调用线程中重新抛出
+ * 同一时刻只能有一个线程调用 run()
+ */
+class ThreadPool
+{
+public:
+    explicit ThreadPool(uint32_t thread_cnt = std::thread::hardware_concurrency());
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &)            = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+
+    [[nodiscard]] uint32_t thread_cnt() const { return static_cast<uint32_t>(_workers.size()); }
+
+    /* 在编号为 [0, task_cnt) 的 worker 上各执行一次 fn(worker_idx) */
+    void run(uint32_t task_cnt, const std::function<void(uint32_t worker_idx)> &fn);
+
+    /**
+     * 将 [0, cnt) 均匀地划分为 task_cnt 段（为 0 时使用所有的 worker），并行执行 fn(begin, end)
+     */
+    void parallel_for(size_t cnt, const std::function<void(size_t begin, size_t end)> &fn, uint32_t task_cnt = 0);
+
+
+private:
+    std::vector<std::thread> _workers;
+
+    std::mutex                           _mutex;
+    std::condition_variable              _start_cv;
+    std::condition_variable              _finish_cv;
+    const std::function<void(uint32_t)> *_task{};
+    uint32_t                             _task_cnt{};
+    uint32_t                             _remain{};         // 还没有完成的任务数量
+    uint64_t                             _generation{};     // 每次 run 加一，用来唤醒 worker
+    bool                                 _stop = false;
+    std::exception_ptr                   _exception;
+
+
+    void worker_loop(uint32_t worker_idx);
+};
+
+}    // namespace Hiss
@@ -0,0 +1,49 @@
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include <optional>
+#include "include_vk.hpp"
+
+
+namespace Hiss
+{
+
+/**
+ * 自动调优结果的缓存，按照设备保存在文本文件中，每一行是一条记录：
+ *  <device key> <name> <value 0> <value 1> ...
+ * device key 是 deviceUUID 加上 driverVersion，更换驱动之后旧的结果不再使用
+ * name 由调用者决定，例如 "nbody.calculate"；value 是若干个 uint32，一般是 specialization constant
+ */
+class TuningCache
+{
+public:
+    static constexpr const char *DEFAULT_PATH = "tuning_cache.txt";    // 相对于工作目录
+
+
+    /* 读取 path 中的记录；文件不存在时为空的缓存 */
+    explicit TuningCache(std::string path = DEFAULT_PATH);
+
+
+    /* 物理设备的 key：32 位十六进制的 deviceUUID，"-"，driverVersion */
+    static std::string device_key(vk::PhysicalDevice physical_device);
+
+    [[nodiscard]] std::optional<std::vector<uint32_t>> get(const std::string &device,
+                                                           const std::string &name) const;
+
+    void set(const std::string &device, const std::string &name, const std::vector<uint32_t> &values);
+
+    /* 写回文件，写入失败时抛出异常 */
+    void save() const;
+
+    [[nodiscard]] const std::string &path() const { return _path; }
+
+
+private:
+    std::string _path;
+
+    /* key 是 (device key, name) */
+    std::map<std::pair<std::string, std::string>, std::vector<uint32_t>> _entries;
+};
+
+}    // namespace Hiss
@@ -57,6 +57,52 @@ struct Vertex {
 };
 
 
+/**
+ * 每个实例的数据，通过 input rate 为 instance 的 vertex binding 传入 shader
+ * 一次 draw 就可以绘制所有的实例，shader 中的声明：
+ *  layout(location = first_location)     in mat4 in_model;    // 占用 4 个连续的 location
+ *  layout(location = first_location + 4) in vec4 in_instance_color;
+ */
+struct InstanceData {
+    glm::mat4 model{1.f};
+    glm::vec4 color{1.f};    // 和顶点颜色相乘
+
+
+    static vk::VertexInputBindingDescription binding_description_get(uint32_t binding)
+    {
+        return vk::VertexInputBindingDescription{
+                .binding   = binding,
+                .stride    = sizeof(InstanceData),
+                .inputRate = vk::VertexInputRate::eInstance,    // 每个实例前进一次，而不是每个顶点
+        };
+    }
+
+
+    /**
+     * mat4 需要拆成 4 个 vec4 的属性，每一列一个 location
+     */
+    static std::array<vk::VertexInputAttributeDescription, 5> attr_description_get(uint32_t binding,
+                                                                                    uint32_t first_location)
+    {
+        std::array<vk::VertexInputAttributeDescription, 5> attrs{};
+        for (uint32_t col = 0; col < 4; ++col)
+            attrs[col] = vk::VertexInputAttributeDescription{
+                    .location = first_location + col,
+                    .binding  = binding,
+                    .format   = vk::Format::eR32G32B32A32Sfloat,
+                    .offset   = static_cast<uint32_t>(offsetof(InstanceData, model) + sizeof(glm::vec4) * col),
+            };
+        attrs[4] = vk::VertexInputAttributeDescription{
+                .location = first_location + 4,
+                .binding  = binding,
+                .format   = vk::Format::eR32G32B32A32Sfloat,
+                .offset   = offsetof(InstanceData, color),
+        };
+        return attrs;
+    }
+};
+
+
 /**
  * 为了让 Vertex 能够使用 hash 函数，将模版 specialize
  */
@@ -84,4 +130,11 @@ void index_buffer_create(const std::vector<uint32_t> &indices, vk::Buffer &index
  * 创建 vertex buffer，将 vertex 数据填入其中
  */
 void vertex_buffer_create(const std::vector<Vertex> &vertices, vk::Buffer &vertex_buffer,
-                           vk::DeviceMemory &vertex_memory);
\ No newline at end of file
+                           vk::DeviceMemory &vertex_memory);
+
+
+/**
+ * 创建 instance buffer，将实例数据填入其中，作为 input rate 为 instance 的 vertex buffer 使用
+ */
+void instance_buffer_create(const std::vector<InstanceData> &instances, vk::Buffer &instance_buffer,
+                            vk::DeviceMemory &instance_memory);
@@ -0,0 +1,84 @@
+/**
+ * Barnes-Hut 各个 pass 共用的声明，通过 GL_GOOGLE_include_directive 引入
+ *
+ * 树是 Karras 2012 的 binary radix tree：按 Morton code 排序之后，N 个质点是叶子，N - 1 个内部节点；
+ * 节点统一存放在 nodes 中，[0, N - 1) 是内部节点，[N - 1, 2N - 1) 是叶子，根节点的下标总是 0
+ * 每 3 层 radix tree 相当于一层 octree，因此可以使用和 octree 相同的 opening angle 判据
+ */
+
+layout(constant_id = 0) const uint WORKGROUP_SIZE = 256;
+layout(local_size_x_id = 0) in;
+
+
+struct Particle {
+    vec4 pos;    // xyz: position, w: mass
+    vec4 vel;    // xyz: velocity, w: uv coord
+};
+
+struct Node {
+    vec4 com_mass;    // xyz: 质心, w: 总质量
+    vec4 bmin;        // 包围盒
+    vec4 bmax;
+    int  left;        // 子节点在 nodes 中的下标，叶子为 -1
+    int  right;
+    int  parent;      // 根节点为 -1
+    uint visits;      // 自底向上归约时，到达这个节点的子节点数量
+};
+
+
+layout(std430, binding = 0) buffer Particles {
+    Particle particles[];
+};
+
+layout(binding = 1) uniform UBO {
+    float delta_time;
+    int   particle_count;
+} ubo;
+
+/* 场景的包围盒，float 编码为保序的 uint，使用 atomicMin / atomicMax 归约 */
+layout(std430, binding = 2) buffer Bounds {
+    uvec4 bounds_min;
+    uvec4 bounds_max;
+};
+
+/* 排序的 key 和 value：写入之后由 GpuPrimitives 原地排序，之后的 pass 读取排好序的结果 */
+layout(std430, binding = 3) buffer KeysSrc {
+    uint keys_src[];
+};
+layout(std430, binding = 4) buffer ValuesSrc {
+    uint values_src[];
+};
+
+/* 每个质点一个 uint 的临时结果，Morton 重排用来存放 coherence 的 flag */
+layout(std430, binding = 5) buffer KeysDst {
+    uint keys_dst[];
+};
+
+layout(std430, binding = 8) coherent buffer Nodes {
+    Node nodes[];
+};
+
+/* 这一步写入的质点：遍历写入新的速度，Morton 重排将质点收集到这里；可以和 particles 是同一个 buffer */
+layout(std430, binding = 10) buffer ParticlesDst {
+    Particle particles_dst[];
+};
+
+
+layout(push_constant) uniform Push {
+    float theta;    // opening angle
+} push;
+
+
+uint particle_cnt() {
+    return uint(ubo.particle_count);
+}
+
+
+uint float_to_ordered(float f) {
+    uint u = floatBitsToUint(f);
+    return (u & 0x80000000u) != 0u ? ~u : u | 0x80000000u;
+}
+
+float ordered_to_float(uint u) {
+    return uintBitsToFloat((u & 0x80000000u) != 0u ? u & 0x7FFFFFFFu : ~u);
+}
@@ -0,0 +1,23 @@
+#version 450
+
+/**
+ * 将方形的 quad 或者点裁剪为圆形，不透明度从中心向边缘衰减
+ * 输出 premultiplied alpha：加法混合只使用 rgb，排序之后的 over 混合同时使用 alpha
+ */
+
+layout(constant_id = 0) const bool QUAD = true;
+
+layout(location = 0) in vec3 in_color;
+layout(location = 1) in vec2 in_coord;
+layout(location = 0) out vec4 out_color;
+
+
+void main() {
+    vec2  coord = QUAD ? in_coord : gl_PointCoord * 2.0 - 1.0;
+    float r2    = dot(coord, coord);
+    if (r2 > 1.0)
+        discard;
+
+    float alpha = 1.0 - r2;
+    out_color   = vec4(in_color * alpha, alpha);
+}
@@ -1,5 +1,72 @@
-#version 120
+#version 450
+
+/**
+ * 绘制质点：vertex pulling，直接从模拟写入的 storage buffer 中读取质点，没有 vertex buffer 和 vertex input
+ *  - QUAD:   每个质点是一个 instance，4 个顶点组成面向相机的 triangle strip，大小随距离正确缩放
+ *  - 否则:   每个质点是一个点（point sprite），点的大小不超过 16，也不超过设备的 pointSizeRange
+ *  - SORTED: 按 order 中的下标绘制，order 是按深度从远到近排序之后的质点下标
+ * 大小随质量增大；颜色由所在的星系（uv）决定，输出 premultiplied alpha
+ */
+
+layout(constant_id = 0) const bool  QUAD           = true;
+layout(constant_id = 1) const bool  SORTED         = false;
+layout(constant_id = 2) const float POINT_SIZE_MAX = 1.0;    // 设备支持的最大 point size
+
+const float INTENSITY = 0.35;     // 加法混合时大量质点叠加，需要降低每个质点的亮度
+const float RADIUS    = 0.004;    // 质点在 view space 中的半径，乘以质量决定的 size
+
+
+struct Particle {
+    vec4 pos;    // xyz: position, w: mass
+    vec4 vel;    // xyz: velocity, w: uv coord
+};
+
+layout(binding = 0) uniform UBO {
+    mat4 projection;
+    mat4 view;
+    vec2 screen_dim;
+} ubo;
+
+layout(std430, binding = 1) readonly buffer Particles {
+    Particle particles[];
+};
+
+layout(std430, binding = 2) readonly buffer Order {
+    uint order[];
+};
+
+layout(location = 0) out vec3 out_color;
+layout(location = 1) out vec2 out_coord;    // quad 中的位置，[-1, 1]
+
 
 void main() {
+    uint idx = uint(QUAD ? gl_InstanceIndex : gl_VertexIndex);
+    if (SORTED)
+        idx = order[idx];
+    Particle p = particles[idx];
+
+    vec4  eye_pos  = ubo.view * vec4(p.pos.xyz, 1.0);
+    float distance = max(-eye_pos.z, 0.1);
+
+    /* 星系中心的质量远大于普通质点，取对数避免点过大 */
+    float size  = 1.0 + log(1.0 + p.pos.w) * 0.25;
+    float speed = length(p.vel.xyz);
+    out_color   = (0.5 + 0.5 * cos(6.2831853 * (p.vel.w + vec3(0.0, 0.33, 0.67)))) * (0.6 + 0.1 * min(speed, 4.0));
+    out_color *= INTENSITY;
 
+    if (QUAD)
+    {
+        /* 半径至少覆盖一个像素，避免远处的质点闪烁 */
+        float focal  = abs(ubo.projection[1][1]);
+        float radius = max(size * RADIUS, distance / (ubo.screen_dim.y * focal));
+        out_coord    = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1) * 2.0 - 1.0;
+        eye_pos.xy += out_coord * radius;
+        gl_Position = ubo.projection * eye_pos;
+    }
+    else
+    {
+        out_coord    = vec2(0.0);
+        gl_Position  = ubo.projection * eye_pos;
+        gl_PointSize = clamp(size * ubo.screen_dim.y * 0.01 / distance, 1.0, min(16.0, POINT_SIZE_MAX));
+    }
 }
@@ -0,0 +1,78 @@
+/**
+ * SPH 各个 pass 共用的声明，通过 GL_GOOGLE_include_directive 引入
+ *
+ * 邻居搜索使用均匀网格的空间哈希：cell 的边长等于光滑半径 h，因此邻居一定位于周围的 27 个 cell 中
+ * 每一步用 counting sort 重建网格：hash 统计每个 bucket 的数量 -> scan 得到起始位置 -> scatter
+ * 之后的 pass 都按照排序之后的顺序处理质点，同一个 cell 的质点在内存中连续
+ */
+
+layout(constant_id = 0) const uint WORKGROUP_SIZE = 256;
+layout(local_size_x_id = 0) in;
+
+
+struct Particle {
+    vec4 pos;    // xyz: position, w: 上一步的密度
+    vec4 vel;    // xyz: velocity
+};
+
+
+/* 模拟的状态，integrate 按照排序之后的顺序写回，因此每一步之后空间上相邻的质点在内存中也相邻 */
+layout(std430, binding = 0) buffer Particles {
+    Particle particles[];
+};
+
+/* kernel 的系数由 host 根据 h 计算：poly6 = 315 / (64 pi h^9)，spiky = 45 / (pi h^6) */
+layout(binding = 1) uniform UBO {
+    vec4  box;             // xyz: 容器的大小，容器的最小角在原点
+    vec4  gravity;
+    float h;
+    float mass;
+    float rest_density;
+    float stiffness;       // p = stiffness * (rho - rest_density)
+    float viscosity;       // 动力粘度 mu
+    float delta_time;
+    float wall_damping;    // 碰到容器壁之后保留的法向速度
+    float poly6;
+    float spiky;
+    uint  particle_cnt;
+    uint  hash_mask;       // bucket 的数量减 1，bucket 的数量是 2 的幂
+} ubo;
+
+layout(std430, binding = 2) buffer Sorted {
+    Particle sorted[];
+};
+
+layout(std430, binding = 3) buffer Keys {
+    uint keys[];
+};
+
+/* 质点在自己的 bucket 中的序号，由 atomicAdd 得到 */
+layout(std430, binding = 4) buffer Ranks {
+    uint ranks[];
+};
+
+layout(std430, binding = 5) buffer CellCount {
+    uint cell_count[];
+};
+
+layout(std430, binding = 6) buffer CellStart {
+    uint cell_start[];
+};
+
+/* 排序之后每个质点的 (density, pressure) */
+layout(std430, binding = 7) buffer Fluid {
+    vec2 fluid[];
+};
+
+layout(std430, binding = 8) buffer Accel {
+    vec4 accel[];
+};
+
+
+ivec3 cell_of(vec3 pos) {
+    return ivec3(floor(pos / ubo.h));
+}
+
+uint cell_hash(ivec3 cell) {
+    return (uint(cell.x) * 73856093u ^ uint(cell.y) * 19349663u ^ uint(cell.z) * 83492791u) & ubo.hash_mask;
+}
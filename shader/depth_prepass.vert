@@ -0,0 +1,19 @@
+#version 450
+
+/* depth pre-pass：只需要顶点的位置，没有 fragment shader */
+layout(location = 0) in vec3 in_position;
+
+/* 主 pass 使用 eEqual 比较 depth，两个 pass 的 gl_Position 必须完全一致 */
+invariant gl_Position;
+
+layout(binding = 0) uniform UniformBufferObject {
+    vec3 foo;
+    vec3 foo2;
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+void main() {
+    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(in_position, 1.0);
+}
@@ -0,0 +1,19 @@
+#version 450
+
+/* depth pre-pass：顶点的位置以及 input rate 为 instance 的 model 矩阵 */
+layout(location = 0) in vec3 in_position;
+layout(location = 3) in mat4 in_model;
+
+invariant gl_Position;
+
+layout(binding = 0) uniform UniformBufferObject {
+    vec3 foo;
+    vec3 foo2;
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+void main() {
+    gl_Position = ubo.proj * ubo.view * in_model * ubo.model * vec4(in_position, 1.0);
+}
@@ -0,0 +1,28 @@
+#version 450
+
+/* depth pre-pass：顶点的位置，实例的变换从 GPU 剔除使用的 storage buffer 中读取 */
+layout(location = 0) in vec3 in_position;
+
+invariant gl_Position;
+
+layout(binding = 0) uniform UniformBufferObject {
+    vec3 foo;
+    vec3 foo2;
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+struct Instance {
+    mat4 model;
+    vec4 bound;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer Instances {
+    Instance instances[];
+};
+
+void main() {
+    mat4 model  = instances[gl_InstanceIndex].model * ubo.model;
+    gl_Position = ubo.proj * ubo.view * model * vec4(in_position, 1.0);
+}
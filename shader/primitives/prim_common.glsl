@@ -0,0 +1,112 @@
+/**
+ * GPU primitives 各个 pass 共用的声明，通过 GL_GOOGLE_include_directive 引入
+ * 所有的数据都是 uint；每个 pass 最多使用 5 个 storage buffer，不使用的 binding 绑定到一个占位的 buffer
+ *
+ * workgroup 中的位置统一使用 local_index()：subgroup 的编号优先，和 subgroup 内 scan / ballot 的顺序一致
+ * 规范没有规定 gl_LocalInvocationIndex 到 subgroup 的映射，scan 和稳定排序依赖这个顺序
+ * 没有 VK_PIPELINE_SHADER_STAGE_CREATE_REQUIRE_FULL_SUBGROUPS_BIT 时 subgroup 可能不是满的，local_index() 也能处理
+ */
+
+#extension GL_KHR_shader_subgroup_basic : require
+#extension GL_KHR_shader_subgroup_arithmetic : require
+#extension GL_KHR_shader_subgroup_ballot : require
+
+layout(constant_id = 0) const uint WORKGROUP_SIZE = 256;
+layout(local_size_x_id = 0) in;
+
+const uint ITEMS_PER_INVOCATION = 4;    // scan 和 reduce 中每个 invocation 处理的元素数量
+const uint BLOCK_SIZE           = WORKGROUP_SIZE * ITEMS_PER_INVOCATION;
+const uint MIN_SUBGROUP_SIZE    = 4;
+const uint MAX_SUBGROUPS        = WORKGROUP_SIZE / MIN_SUBGROUP_SIZE;
+
+const uint FLAG_INCLUSIVE  = 1u << 0;    // scan：inclusive，否则 exclusive
+const uint FLAG_OFFSETS    = 1u << 1;    // scan：每个 block 加上 buffer 2 中的偏移
+const uint FLAG_HAS_VALUES = 1u << 2;    // radix sort：同时移动 value
+
+
+layout(std430, binding = 0) buffer Buffer0 {
+    uint data0[];
+};
+layout(std430, binding = 1) buffer Buffer1 {
+    uint data1[];
+};
+layout(std430, binding = 2) buffer Buffer2 {
+    uint data2[];
+};
+layout(std430, binding = 3) buffer Buffer3 {
+    uint data3[];
+};
+layout(std430, binding = 4) buffer Buffer4 {
+    uint data4[];
+};
+
+
+layout(push_constant) uniform Push {
+    uint cnt;          // 元素的数量
+    uint shift;        // histogram 和 radix sort 的 bit 偏移
+    uint flags;
+    uint block_cnt;    // radix sort 中 block 的数量，每个 block 是一个 workgroup
+} push;
+
+
+shared uint s_subgroup[MAX_SUBGROUPS];
+shared uint s_subgroup_base[MAX_SUBGROUPS];
+shared uint s_total;
+
+
+/**
+ * invocation 在 workgroup 中的位置，是 [0, WORKGROUP_SIZE) 的一个排列
+ * 所有 subgroup 都是满的时候直接由 subgroup 的编号得到；
+ * 否则每个 subgroup 的起始位置是前面所有 subgroup 中 invocation 数量的和，通过 shared memory 求出
+ * 包含 barrier，需要在 uniform control flow 中调用，每个 shader 只调用一次
+ */
+uint local_index() {
+    if (gl_NumSubgroups * gl_SubgroupSize == WORKGROUP_SIZE)
+        return gl_SubgroupID * gl_SubgroupSize + gl_SubgroupInvocationID;
+
+    uvec4 active = subgroupBallot(true);
+    if (subgroupElect())
+        s_subgroup_base[gl_SubgroupID] = subgroupBallotBitCount(active);
+    barrier();
+
+    uint base = 0;
+    for (uint s = 0; s < gl_SubgroupID; ++s)
+        base += s_subgroup_base[s];
+    return base + subgroupBallotExclusiveBitCount(active);
+}
+
+
+/**
+ * workgroup 内的 exclusive scan，每个 invocation 一个值，按照 local_index() 的顺序；total 是所有值的和
+ * 先在 subgroup 内 scan，再由第一个 subgroup 对各个 subgroup 的和 scan
+ * 包含 barrier，需要在 uniform control flow 中调用
+ */
+uint workgroup_exclusive_add(uint value, out uint total) {
+    uint prefix = subgroupExclusiveAdd(value);
+    uint sum    = subgroupAdd(value);
+    if (subgroupElect())
+        s_subgroup[gl_SubgroupID] = sum;
+    barrier();
+
+    if (gl_SubgroupID == 0)
+    {
+        uint carry = 0;
+        for (uint base = 0; base < gl_NumSubgroups; base += gl_SubgroupSize)
+        {
+            uint i = base + gl_SubgroupInvocationID;
+            uint v = i < gl_NumSubgroups ? s_subgroup[i] : 0;
+            uint p = subgroupExclusiveAdd(v);
+            if (i < gl_NumSubgroups)
+                s_subgroup[i] = carry + p;
+            carry += subgroupAdd(v);
+        }
+        if (subgroupElect())
+            s_total = carry;
+    }
+    barrier();
+
+    total       = s_total;
+    uint result = s_subgroup[gl_SubgroupID] + prefix;
+    barrier();    // 之后可以再次使用 s_subgroup
+    return result;
+}
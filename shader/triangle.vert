@@ -7,6 +7,9 @@ layout(location = 2) in vec2 in_tex_coord;
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 
+/* 和 depth pre-pass 的 vertex shader 计算出完全相同的 depth */
+invariant gl_Position;
+
 layout(binding = 0) uniform UniformBufferObject {
     vec3 foo;
     vec3 foo2;
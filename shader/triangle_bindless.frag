@@ -0,0 +1,23 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+/* bindless：所有的 texture 和 sampler 都在 set 1 中，通过 push constant 中的下标访问 */
+layout(set = 1, binding = 0) uniform texture2D textures[];
+layout(set = 1, binding = 1) uniform sampler samplers[];
+
+layout(push_constant) uniform Material {
+    uint texture_idx;
+    uint sampler_idx;
+} material;
+
+
+void main() {
+    /* push constant 在一个 draw 内是 uniform 的，因此不需要 nonuniformEXT */
+    vec3 albedo = texture(sampler2D(textures[material.texture_idx], samplers[material.sampler_idx]), fragTexCoord).rgb;
+    outColor = vec4(albedo * fragColor, 1.0);
+}
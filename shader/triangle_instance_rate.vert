@@ -0,0 +1,29 @@
+#version 450
+
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec3 in_color;
+layout(location = 2) in vec2 in_tex_coord;
+
+/* 实例数据：input rate 为 instance 的 vertex binding，每个实例前进一次 */
+layout(location = 3) in mat4 in_model;
+layout(location = 7) in vec4 in_instance_color;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+/* 和 depth pre-pass 的 vertex shader 计算出完全相同的 depth */
+invariant gl_Position;
+
+layout(binding = 0) uniform UniformBufferObject {
+    vec3 foo;
+    vec3 foo2;
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+void main() {
+    gl_Position  = ubo.proj * ubo.view * in_model * ubo.model * vec4(in_position, 1.0);
+    fragColor    = in_color * in_instance_color.rgb;
+    fragTexCoord = in_tex_coord;
+}
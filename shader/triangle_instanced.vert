@@ -0,0 +1,36 @@
+#version 450
+
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec3 in_color;
+layout(location = 2) in vec2 in_tex_coord;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+/* 和 depth pre-pass 的 vertex shader 计算出完全相同的 depth */
+invariant gl_Position;
+
+layout(binding = 0) uniform UniformBufferObject {
+    vec3 foo;
+    vec3 foo2;
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+/* 实例数据，由 GPU 剔除写入的 draw command 的 firstInstance 就是实例的下标；set 1 是 bindless 的 texture */
+struct Instance {
+    mat4 model;
+    vec4 bound;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer Instances {
+    Instance instances[];
+};
+
+void main() {
+    mat4 model   = instances[gl_InstanceIndex].model * ubo.model;
+    gl_Position  = ubo.proj * ubo.view * model * vec4(in_position, 1.0);
+    fragColor    = in_color;
+    fragTexCoord = in_tex_coord;
+}